@@ -40,6 +40,15 @@
 #include <time.h>
 #include <ctype.h>
 
+#ifndef _OPENMP
+#define OCRO_THREAD 0
+#define OCRO_MAXTHREADS 1
+#else
+#include <omp.h>
+#define OCRO_THREAD omp_get_thread_num()
+#define OCRO_MAXTHREADS omp_get_max_threads()
+#endif
+
 static const double PI = 3.1415926535;
 
 int cWidth = 32;
@@ -47,6 +56,7 @@ int cHeight = 0;
 int hDpi = 96;
 int vDpi = 0;
 int nLines = 40;
+int batchSize = 256;
 narray<strg> inputFilenames;
 autodel<ocropus::IBookStore> bookStore;
 
@@ -75,8 +85,14 @@ double min_yAmpl = 2.0;
 double max_yAmpl = 5.0;
 
 // -- constant seed to ensure deterministic --
+// every line gets its own random stream derived from the seed and the
+// line number, so the output doesn't depend on the number of threads
 int seed = 123456789;
 
+// -- size of the precomputed elastic displacement fields --
+int elasticWidth = 4096;
+int elasticHeight = 512;
+
 void printUsage(int argc, char *argv[]);
 void parseArgs(int argc, char *argv[]);
 void printArgs(FILE* file);
@@ -84,19 +100,68 @@ void printArgs(FILE* file);
 using namespace colib;
 using namespace iulib;
 
-int renderText(intarray& seg, bytearray& gray, ustrg& string, int x0, int y0, FT_Face& face) {
-    bool onePixel = false;
-    for(int i=0; i<string.length(); i++) {
-        int error = FT_Load_Char(face, string[i].ord(), FT_LOAD_RENDER);
+void initFreeType(FT_Library& library, FT_Face& face);
+
+/**
+ * A FreeType face together with the glyphs rendered with it so far.
+ * FreeType faces must not be shared between threads, so every worker
+ * thread has one of these.
+ **/
+struct GlyphCache {
+    FT_Library library;
+    FT_Face face;
+    // glyphs by character code; -1 if not rendered yet
+    intarray index;
+    objlist<bytearray> bitmaps;
+    intarray left, top, advanceX, advanceY;
+
+    GlyphCache() {
+        initFreeType(library, face);
+    }
+    ~GlyphCache() {
+        FT_Done_Face(face);
+        FT_Done_FreeType(library);
+    }
+
+    // returns the glyph number, or -1 if the glyph can't be loaded
+    int glyph(int code) {
+        if(code < index.length() && index(code) >= 0)
+            return index(code);
+        int error = FT_Load_Char(face, code, FT_LOAD_RENDER);
         if(error) {
             fprintf(stderr, "error during loading the glyph\n");
-            return error;
+            return -1;
         }
-        for(int y=0; y<face->glyph->bitmap.rows; y++) {
-            for(int x=0; x<face->glyph->bitmap.width; x++) {
-                int x1 = x0 + x + face->glyph->bitmap_left;
-                int y1 = y0 + face->glyph->bitmap_top - y + 1;
-                int value = face->glyph->bitmap.buffer[y*face->glyph->bitmap.width+x];
+        FT_Bitmap& bitmap = face->glyph->bitmap;
+        bytearray& image = bitmaps.push();
+        image.resize(bitmap.width, bitmap.rows);
+        for(int y=0; y<bitmap.rows; y++)
+            for(int x=0; x<bitmap.width; x++)
+                image(x, y) = bitmap.buffer[y*bitmap.width+x];
+        left.push(face->glyph->bitmap_left);
+        top.push(face->glyph->bitmap_top);
+        advanceX.push(face->glyph->advance.x >> 6);
+        advanceY.push(face->glyph->advance.y >> 6);
+        while(index.length() <= code)
+            index.push(-1);
+        index(code) = bitmaps.length() - 1;
+        return index(code);
+    }
+};
+
+int renderText(intarray& seg, bytearray& gray, ustrg& string, int x0, int y0, GlyphCache& glyphs) {
+    bool onePixel = false;
+    for(int i=0; i<string.length(); i++) {
+        int g = glyphs.glyph(string[i].ord());
+        if(g < 0) {
+            return -1;
+        }
+        bytearray& bitmap = glyphs.bitmaps(g);
+        for(int y=0; y<bitmap.dim(1); y++) {
+            for(int x=0; x<bitmap.dim(0); x++) {
+                int x1 = x0 + x + glyphs.left(g);
+                int y1 = y0 + glyphs.top(g) - y + 1;
+                int value = bitmap(x, y);
                 if(value) {
                     seg(x1, y1) = i+1;
                     gray(x1, y1) = value;
@@ -104,8 +169,8 @@ int renderText(intarray& seg, bytearray& gray, ustrg& string, int x0, int y0, FT
                 }
             }
         }
-        x0 += face->glyph->advance.x >> 6;
-        y0 += face->glyph->advance.y >> 6;
+        x0 += glyphs.advanceX(g);
+        y0 += glyphs.advanceY(g);
     }
     if(!onePixel) {
         return -1;
@@ -154,8 +219,97 @@ void removeCntrl(iustrg<T>& s) {
     s.assign(s2);
 }
 
-float uni(float min, float max) {
-    return drand48() * (max - min) + min;
+float uni(ocropus::DegradationRandom& random, float min, float max) {
+    return random.uniform() * (max - min) + min;
+}
+
+/**
+ * One line of input text and, after rendering, the degraded line
+ * image and its character segmentation.
+ **/
+struct Sample {
+    int k;
+    ustrg string;
+    bool ok;
+    strg error;
+    bytearray perfect;
+    bytearray gray;
+    intarray seg;
+};
+
+/**
+ * Render, wiggle and degrade one line; this only depends on the text
+ * and on the line number k, so lines can be processed in any order.
+ **/
+void renderSample(Sample& sample, GlyphCache& glyphs, ocropus::ElasticMaps& maps,
+        int x0, int y0, int cPixelWidth, int cPixelHeight) {
+    ustrg& string = sample.string;
+    sample.ok = false;
+    if(string.empty()) {
+        return;
+    }
+    ocropus::DegradationRandom random(seed, sample.k);
+
+    intarray seg(x0 + cPixelWidth * string.length() * 2, y0 + cPixelHeight * 2);
+    bytearray gray(seg.dim(0), seg.dim(1));
+    fill(seg, 0);
+    fill(gray, 0);
+    if(renderText(seg, gray, string, 10, 25, glyphs) != 0) {
+        return;
+    }
+    tighten(seg);
+    tighten(gray);
+    pad_by(seg, cPixelWidth/2, cPixelHeight/2);
+    pad_by(gray, cPixelWidth/2, cPixelHeight/2);
+    complement(gray);
+    if(verbose) {
+        sample.perfect.copy(gray);
+    }
+    float xRad = uni(random, min_xRad, max_xRad);
+    float yRad = uni(random, min_yRad, max_yRad);
+    float xAmpl = uni(random, min_xAmpl, max_xAmpl);
+    float yAmpl = uni(random, min_yAmpl, max_yAmpl);
+    float xShift = uni(random, 0.0, gray.dim(0));
+    float yShift = uni(random, 0.0, gray.dim(1));
+
+    wiggle(gray, xRad, yRad, xAmpl, yAmpl, xShift, yShift, (unsigned char)0xFF, true);
+    wiggle(seg, xRad, yRad, xAmpl, yAmpl, xShift, yShift, 0, false);
+
+    propagate_labels(seg);
+
+    ocropus::degrade(gray, random, &maps,
+            jitter_mean, jitter_sigma,
+            sensitivity_mean, sensitivity_sigma,
+            threshold_mean, threshold_sigma);
+
+    sample.seg.resize(seg.dim(0), seg.dim(1));
+    for(int i=0; i<seg.length1d(); i++) {
+        if(gray.at1d(i) < 200 ) {
+            sample.seg.at1d(i) = seg.at1d(i);
+        } else {
+            sample.seg.at1d(i) = 0xFFFFFF;
+        }
+    }
+    sample.gray.move(gray);
+    sample.ok = true;
+}
+
+/**
+ * Render all samples of a batch in parallel; every thread uses its
+ * own glyph cache.
+ **/
+void renderBatch(objlist<Sample>& batch, objlist<GlyphCache>& glyphs, ocropus::ElasticMaps& maps,
+        int x0, int y0, int cPixelWidth, int cPixelHeight) {
+#pragma omp parallel for schedule(dynamic)
+    for(int i=0; i<batch.length(); i++) {
+        // exceptions must not leave the parallel region
+        try {
+            renderSample(batch(i), glyphs(OCRO_THREAD), maps, x0, y0, cPixelWidth, cPixelHeight);
+        } catch(const char* e) {
+            batch(i).ok = false;
+            batch(i).error = e;
+        }
+    }
 }
 
 
@@ -214,18 +368,64 @@ void initFreeType(FT_Library& library, FT_Face& face) {
     }
 }
 
+/**
+ * Write a rendered batch in input order; page breaks happen here, so
+ * they come out the same as if the lines had been rendered one by one.
+ **/
+void writeBatch(objlist<Sample>& batch, bytearray& pageImage, intarray& pageSeg,
+        int& page, int& line, int cPixelHeight, FILE* logFile) {
+    for(int i=0; i<batch.length(); i++) {
+        Sample& sample = batch(i);
+        int k = sample.k;
+        if(!sample.error.empty()) {
+            throwf("line %d: %s", k, sample.error.c_str());
+        }
+        // -- page break --
+        if(k % nLines == 0) {
+            if(line > 0) {
+                writePage(pageImage, pageSeg, page);
+            }
+            page++;
+            pageImage.fill(0);
+            pageSeg.fill(0);
+        }
+        // -- skip emtpy lines --
+        if(sample.string.empty()) {
+            continue;
+        }
+        line = (k%nLines) + 1;
+        if(!sample.ok) {
+            continue;
+        }
+        if(verbose) {
+            bookStore->putLine(sample.perfect, page, line, "perfect");
+        }
+        if(writePages) {
+            drawPage(pageImage, pageSeg, sample.gray, sample.seg, line, cPixelHeight);
+        }
+        bookStore->putLine(sample.gray, page, line);
+        bookStore->putLine(sample.seg, page, line, "cseg.gt");
+        bookStore->putLine(sample.string, page, line, "gt");
+
+        fwriteUTF8(sample.string, logFile);
+        fprintf(logFile, "\n");
+    }
+}
+
 int main(int argc, char* argv[]) {
     try{
-        srand48(seed);
         if(!setlocale(LC_CTYPE, "de_DE.UTF-8")) {
             fprintf(stderr, "Can't set the locale!\n");
             exit(-1);
         }
         parseArgs(argc, argv);
 
-        FT_Library library;
-        FT_Face face;
-        initFreeType(library, face);
+        // -- one face and glyph cache per thread --
+        objlist<GlyphCache> glyphs;
+        for(int i=0; i<OCRO_MAXTHREADS; i++) {
+            glyphs.push();
+        }
+        FT_Face face = glyphs(0).face;
         // -- determine approx. character sizes in pixel --
         FT_Load_Char(face, 'M', FT_LOAD_RENDER);
         int cPixelWidth = face->glyph->bitmap.width;
@@ -245,14 +445,11 @@ int main(int argc, char* argv[]) {
         make_component(bookStore, "OldBookStore");
         bookStore->setPrefix(outDir);
 
-        autodel<ocropus::ICleanupGray> degrade;
-        make_component(degrade, "Degradation");
-        degrade->pset("jitter_mean", jitter_mean);
-        degrade->pset("jitter_sigma", jitter_sigma);
-        degrade->pset("sensitivity_mean", sensitivity_mean);
-        degrade->pset("sensitivity_sigma", sensitivity_sigma);
-        degrade->pset("threshold_mean", threshold_mean);
-        degrade->pset("threshold_sigma", threshold_sigma);
+        // -- displacement fields shared by all lines; stream -1 is
+        // not used by any line --
+        ocropus::ElasticMaps maps;
+        ocropus::DegradationRandom mapRandom(seed, -1);
+        maps.init(mapRandom, elasticWidth, elasticHeight);
 
         FILE* logFile = fopen(outDir + "/" + logFilename, "w");
         printArgs(logFile);
@@ -262,6 +459,7 @@ int main(int argc, char* argv[]) {
         int line = 0;
         bytearray pageImage(cPixelWidth * 100 * 2, cPixelHeight * nLines * 3);
         intarray pageSeg(cPixelWidth * 100 * 2, cPixelHeight * nLines * 3);
+        objlist<Sample> batch;
         for(int inputIndex = 0; inputIndex<inputFilenames.length(); inputIndex++) {
             FILE* inputFile = fopen(inputFilenames[inputIndex], "r");
             if(inputFile == NULL) {
@@ -270,77 +468,20 @@ int main(int argc, char* argv[]) {
             }
             fprintf(logFile, "\nfile: %s\n\n", inputFilenames[inputIndex].c_str());
             while(!feof(inputFile)) {
-                ustrg string;
-                fgetsUTF8(string, inputFile);
-                // -- page break --
-                if(k % nLines == 0) {
-                    if(line > 0) {
-                        writePage(pageImage, pageSeg, page);
-                    }
-                    page++;
-                    pageImage.fill(0);
-                    pageSeg.fill(0);
-                }
-                removeCntrl(string);
-                // -- skip emtpy lines --
-                if(string.empty()) {
-                    k++;
-                    continue;
-                }
-                line = (k%nLines) + 1;
-
-                intarray seg(x0 + cPixelWidth * string.length() * 2, y0 + cPixelHeight * 2);
-                bytearray gray(seg.dim(0), seg.dim(1));
-                fill(seg, 0);
-                fill(gray, 0);
-                if(renderText(seg, gray, string, 10, 25, face) != 0) {
-                    k++;
-                    continue;
-                }
-                tighten(seg);
-                tighten(gray);
-                pad_by(seg, cPixelWidth/2, cPixelHeight/2);
-                pad_by(gray, cPixelWidth/2, cPixelHeight/2);
-                complement(gray);
-                if(verbose) {
-                    bookStore->putLine(gray, page, line, "perfect");
-                }
-                float xRad = uni(min_xRad, max_xRad);
-                float yRad = uni(min_yRad, max_yRad);
-                float xAmpl = uni(min_xAmpl, max_xAmpl);
-                float yAmpl = uni(min_yAmpl, max_yAmpl);
-                float xShift = uni(0.0, gray.dim(0));
-                float yShift = uni(0.0, gray.dim(1));
-
-                wiggle(gray, xRad, yRad, xAmpl, yAmpl, xShift, yShift, (unsigned char)0xFF, true);
-                wiggle(seg, xRad, yRad, xAmpl, yAmpl, xShift, yShift, 0, false);
-
-                propagate_labels(seg);
-
-                bytearray gray2;
-                degrade->cleanup(gray2, gray);
-                gray.move(gray2);
-
-                intarray segDide(seg.dim(0), seg.dim(1));
-                for(int i=0; i<seg.length1d(); i++) {
-                    if(gray.at1d(i) < 200 ) {
-                        segDide.at1d(i) = seg.at1d(i);
-                    } else {
-                        segDide.at1d(i) = 0xFFFFFF;
-                    }
+                Sample& sample = batch.push();
+                fgetsUTF8(sample.string, inputFile);
+                removeCntrl(sample.string);
+                sample.k = k++;
+                if(batch.length() >= batchSize) {
+                    renderBatch(batch, glyphs, maps, x0, y0, cPixelWidth, cPixelHeight);
+                    writeBatch(batch, pageImage, pageSeg, page, line, cPixelHeight, logFile);
+                    batch.clear();
                 }
-
-                if(writePages) {
-                    drawPage(pageImage, pageSeg, gray, segDide, line, cPixelHeight);
-                }
-                bookStore->putLine(gray, page, line);
-                bookStore->putLine(segDide, page, line, "cseg.gt");
-                bookStore->putLine(string, page, line, "gt");
-
-                fwriteUTF8(string, logFile);
-                fprintf(logFile, "\n");
-                k++;
             }
+            // -- the log groups lines by file --
+            renderBatch(batch, glyphs, maps, x0, y0, cPixelWidth, cPixelHeight);
+            writeBatch(batch, pageImage, pageSeg, page, line, cPixelHeight, logFile);
+            batch.clear();
             fclose(inputFile);
         }
         writePage(pageImage, pageSeg, page);
@@ -368,6 +509,8 @@ void printUsage(int argc, char *argv[]) {
     printf("  -H, --height=POINTS             chracter height in points (default: same as width)\n");
     printf("  -d, --dpi=POINTS                dots per inch (default: %d)\n", hDpi);
     printf("  -l, --lines=VALUE               number of lines per page (default: %d)\n", nLines);
+    printf("  -B, --batch=VALUE               number of lines rendered in parallel (default: %d)\n", batchSize);
+    printf("  -r, --seed=VALUE                random seed (default: %d)\n", seed);
     printf("  -j  --jitter_mean=VALUE         didegrade (default: %.3f)\n", jitter_mean);
     printf("  -J  --jitter_sigma=VALUE        didegrade (default: %.3f)\n", jitter_sigma);
     printf("  -s  --sensitivity_mean=VALUE    didegrade (default: %.3f)\n", sensitivity_mean);
@@ -391,6 +534,7 @@ void printArgs(FILE* file) {
     fprintf(file, "height: %d\n", cHeight);
     fprintf(file, "dpi: %d\n", hDpi);
     fprintf(file, "lines: %d\n", nLines);
+    fprintf(file, "batch: %d\n", batchSize);
     fprintf(file, "jitter_mean: %.3f\n", jitter_mean);
     fprintf(file, "jitter_sigma: %.3f\n", jitter_sigma);
     fprintf(file, "sensitivity_mean: %.3f\n", sensitivity_mean);
@@ -424,6 +568,8 @@ void parseArgs(int argc, char *argv[]) {
         {"height", required_argument, 0, 'H'},
         {"dpi", required_argument, 0, 'd'},
         {"lines", required_argument, 0, 'l'},
+        {"batch", required_argument, 0, 'B'},
+        {"seed", required_argument, 0, 'r'},
         {"jitter_mean", required_argument, 0, 'j'},
         {"jitter_sigma", required_argument, 0, 'J'},
         {"sensitivity_mean", required_argument, 0, 's'},
@@ -437,7 +583,7 @@ void parseArgs(int argc, char *argv[]) {
     };
     int c;
     int option_index = 0;
-    while ((c = getopt_long(argc, argv, "o:b:f:w:H:d:l:j:J:s:S:t:T:L:hvp",long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "o:b:f:w:H:d:l:B:r:j:J:s:S:t:T:L:hvp",long_options, &option_index)) != -1) {
         switch (c) {
         case 'o':
             outDir = optarg;
@@ -463,6 +609,12 @@ void parseArgs(int argc, char *argv[]) {
         case 'l':
             nLines = atoi(optarg);
             break;
+        case 'B':
+            batchSize = atoi(optarg);
+            break;
+        case 'r':
+            seed = atoi(optarg);
+            break;
         case 'j':
             jitter_mean = atof(optarg);
             break;
@@ -500,6 +652,9 @@ void parseArgs(int argc, char *argv[]) {
             inputFilenames.push(argv[index]);
         }
     }
+    if(batchSize < 1) {
+        batchSize = 1;
+    }
     if(cHeight == 0) {
         cHeight = cWidth;
     }
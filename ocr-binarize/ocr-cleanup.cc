@@ -54,19 +54,78 @@ namespace ocropus {
 #endif
 
 
-    static void count_noise_boxes(intarray &counts,bytearray &image,int mw,int mh){
+    // Page state shared by the binary cleanup stages when they run
+    // inside StandardPreprocessing.  The page is modified in place.
+    // The connected components of its non-white pixels are computed on
+    // first use and reused by later stages until a stage changes pixels
+    // without keeping them up to date.
+
+    struct CleanupContext {
+        bytearray &image;
+        intarray labels;
+        ConnectedComponents ccs;
+        bool valid;
+
+        CleanupContext(bytearray &image) : image(image) {
+            valid = false;
+        }
+        void components() {
+            if(valid) return;
+            makelike(labels,image);
+            int n = image.length1d();
+#pragma omp parallel for schedule(static)
+            for(int i=0;i<n;i++)
+                labels.at1d(i) = image.at1d(i)!=255;
+            ccs.label(labels);
+            valid = true;
+        }
+        void changed() {
+            valid = false;
+        }
+        bool present(int i) {
+            return ccs.present(i);
+        }
+        // erase the components i with which(i) set from the page,
+        // keeping the analysis valid
+        void remove(bytearray &which) {
+            int n = image.length1d();
+#pragma omp parallel for schedule(static)
+            for(int k=0;k<n;k++)
+                if(which(labels.at1d(k))) image.at1d(k) = 255;
+            ccs.remove(labels,which);
+        }
+    };
+
+    // Binary cleanup stages that can work on a CleanupContext directly.
+    struct ICleanupInPlace {
+        virtual ~ICleanupInPlace() {}
+        virtual void cleanup(CleanupContext &context) = 0;
+    };
+
+    // make sure it's binary
+    static void make_binary(bytearray &image) {
+        int n = image.length1d();
+#pragma omp parallel for schedule(static)
+        for(int i=0;i<n;i++)
+            if(image.at1d(i)>128) image.at1d(i) = 255;
+    }
+
+    static void cleanup_with_context(ICleanupInPlace &stage,bytearray &out,bytearray &in) {
+        out = in;
+        make_binary(out);
+        CleanupContext context(out);
+        stage.cleanup(context);
+    }
+
+    static void count_noise_boxes(intarray &counts,CleanupContext &context,int mw,int mh){
         static int max_n = 50000;
-        intarray segmentation;
-        segmentation = image;
-        using namespace narray_ops;
-        sub(255,segmentation);
-        int n = label_components(segmentation);
-        if(n>max_n) throw "too many connected components in count_noise_boxes";
-        narray<rectangle> bboxes;
-        bounding_boxes(bboxes,segmentation);
+        context.components();
+        if(context.ccs.n>max_n) throw "too many connected components in count_noise_boxes";
+        narray<rectangle> &bboxes = context.ccs.boxes;
         counts.resize(2);
         counts = 0;
         for(int i=1;i<bboxes.length();i++) {
+            if(!context.present(i)) continue;
             rectangle b = bboxes(i);
             if(b.width()<=mw && b.height()<=mh)
                 counts(0)++;
@@ -75,7 +134,7 @@ namespace ocropus {
         }
     }
 
-    struct RmHalftone : ICleanupBinary {
+    struct RmHalftone : ICleanupBinary,ICleanupInPlace {
         p_float factor;
         p_int threshold;
         p_int max_n_;
@@ -92,28 +151,32 @@ namespace ocropus {
             return "rmhalftone";
         }
 
-        void cleanup(bytearray &out,bytearray &in_) {
-            bytearray in;
-            in = in_;
-            // make sure it's binary
-            for(int i=0;i<out.length();i++)
-                if(in[i]>128) in[i] = 255;
-            out = in;
+        void cleanup(bytearray &out,bytearray &in) {
+            cleanup_with_context(*this,out,in);
+        }
+
+        void cleanup(CleanupContext &context) {
+            bytearray &image = context.image;
             intarray counts;
-            count_noise_boxes(counts,in,threshold,threshold);
+            count_noise_boxes(counts,context,threshold,threshold);
             if(counts(0)>factor*counts(1)) {
                 debugf("info","removing halftoning\n");
-                // get rid of halftoning
-                binary_close_rect(out,3,1);
-                binary_close_rect(out,1,3);
-                binary_open_circle(out,1);
-                for(int i=0;i<out.length();i++)
-                    if(in[i]) out[i] = 255;
+                // get rid of halftoning; done on packed bits, which
+                // is much faster than byte morphology on full pages
+                BitImage original,bits;
+                bits_pack(original,image);
+                bits_copy(bits,original);
+                bits_close_rect(bits,3,1);
+                bits_close_rect(bits,1,3);
+                bits_open_circle(bits,1);
+                bits_or(bits,original);
+                bits_unpack(image,bits);
+                context.changed();
             }
         }
     };
 
-    struct RmUnderline : ICleanupBinary {
+    struct RmUnderline : ICleanupBinary,ICleanupInPlace {
         const char *description() {
             return "remove underlines (defaults for 300dpi images)";
         }
@@ -122,25 +185,26 @@ namespace ocropus {
             return "rmunderline300";
         }
 
-        void cleanup(bytearray &out,bytearray &in_) {
-            bytearray in;
-            in = in_;
-            // make sure it's binary
-            for(int i=0;i<out.length();i++)
-                if(in[i]>128) in[i] = 255;
-            out = in;
+        void cleanup(bytearray &out,bytearray &in) {
+            cleanup_with_context(*this,out,in);
+        }
+
+        void cleanup(CleanupContext &context) {
             // get rid of underlines
-            bytearray underlines;
-            underlines = in;
-            binary_erode_rect(underlines,2,1);
-            binary_close_rect(underlines,200,1);
-            binary_erode_rect(underlines,1,5);
-            for(int i=0;i<out.length();i++)
-                if(underlines[i]==0) out[i] = 255;
+            BitImage original,underlines;
+            bits_pack(original,context.image);
+            bits_copy(underlines,original);
+            bits_erode_rect(underlines,2,1);
+            bits_close_rect(underlines,200,1);
+            bits_erode_rect(underlines,1,5);
+            bits_invert(underlines);
+            bits_or(underlines,original);
+            bits_unpack(context.image,underlines);
+            context.changed();
         }
     };
 
-    struct RmBig: ICleanupBinary {
+    struct RmBig: ICleanupBinary,ICleanupInPlace {
         RmBig() {
             pdef("max_n",50000,"maximum number of components");
             pdef("mw",300,"maximum width");
@@ -157,41 +221,38 @@ namespace ocropus {
         }
 
         void cleanup(bytearray &image,bytearray &in) {
-            image = in;
-            // make sure it's binary
-            for(int i=0;i<image.length();i++)
-                if(image[i]>128) image[i] = 255;
-            intarray segmentation;
-            segmentation = image;
+            cleanup_with_context(*this,image,in);
+        }
 
+        void cleanup(CleanupContext &context) {
             // compute bounding boxes
-            using namespace narray_ops;
-            sub(255,segmentation);
-            int n = label_components(segmentation);
-            if(n>pgetf("max_n")) throw "too many connected components in RmBig";
-            narray<rectangle> bboxes;
-            bounding_boxes(bboxes,segmentation);
+            context.components();
+            if(context.ccs.n>pgetf("max_n")) throw "too many connected components in RmBig";
+            narray<rectangle> &bboxes = context.ccs.boxes;
             debugf("info","got %d bboxes\n",bboxes.length());
 
-            // remove large components
+            // remove large components, all in one pass over the page;
+            // the remaining components stay valid for the stages after
+            // this one
             int mw = pgetf("mw");
             int mh = pgetf("mh");
             float minaspect = pgetf("minaspect");
             float maxaspect = pgetf("maxaspect");
+            if(bboxes.length()==0) return;
+            bytearray which(bboxes.length());
+            fill(which,0);
             for(int i=1;i<bboxes.length();i++) {
+                if(!context.present(i)) continue;
                 rectangle b = bboxes(i);
                 float aspect = b.height() * 1.0/b.width();
-                if(b.width()>=mw || b.height()>=mh || aspect<minaspect || aspect>maxaspect) {
-                    for(int x=b.x0;x<b.x1;x++)
-                        for(int y=b.y0;y<b.y1;y++)
-                            if(segmentation(x,y)==i)
-                                image(x,y) = 255;
-                }
+                if(b.width()>=mw || b.height()>=mh || aspect<minaspect || aspect>maxaspect)
+                    which(i) = 1;
             }
+            context.remove(which);
         }
     };
 
-    struct AutoInvert : ICleanupBinary {
+    struct AutoInvert : ICleanupBinary,ICleanupInPlace {
         AutoInvert() {
             pdef("fraction",0.7,"fraction above which to invert");
             pdef("minheight",100,"minimum height for autoinvert");
@@ -206,19 +267,23 @@ namespace ocropus {
         }
 
         void cleanup(bytearray &out,bytearray &in) {
-            out = in;
+            cleanup_with_context(*this,out,in);
+        }
+
+        void cleanup(CleanupContext &context) {
+            bytearray &out = context.image;
             if(out.dim(1)<pgetf("minheight")) return;
-            // make sure it's binary
-            for(int i=0;i<out.length();i++)
-                if(out[i]>128) out[i] = 255;
-            out = in;
-            // get rid of underlines
+            int n = out.length1d();
             int count = 0;
-            for(int i=0;i<out.length();i++)
-                if(out[i]==0) count++;
-            if(count>=pgetf("fraction")*out.length())
-                for(int i=0;i<out.length();i++)
-                    out[i] = 255*!out[i];
+#pragma omp parallel for schedule(static) reduction(+:count)
+            for(int i=0;i<n;i++)
+                if(out.at1d(i)==0) count++;
+            if(count>=pgetf("fraction")*n) {
+#pragma omp parallel for schedule(static)
+                for(int i=0;i<n;i++)
+                    out.at1d(i) = 255*!out.at1d(i);
+                context.changed();
+            }
         }
     };
 
@@ -306,31 +371,77 @@ namespace ocropus {
                     make_component(binclean[i],pget(s));
             }
         }
+        void report(const char *stage,const char *name,double start) {
+            debugf("timing","%s (%s) %.1f ms\n",stage,name,1000*(now()-start));
+        }
+        void report(const char *stage,int i,const char *name,double start) {
+            char buf[100];
+            sprintf(buf,"%s%d",stage,i);
+            report(buf,name,start);
+        }
         void cleanup_gray(bytearray &out,bytearray &in) {
             bytearray temp;
             out = in;
             for(int i=0;i<grayclean.length();i++) {
                 if(!grayclean[i]) continue;
+                double start = now();
                 try {
                     grayclean[i]->cleanup_gray(temp,out);
                     out.move(temp);
                 } catch(const char *s) {
                     debugf("warn","grayclean%d failed: %s\n",i,s);
                 }
+                report("grayclean",i,grayclean[i]->name(),start);
             }
         }
+        // The binary stages share one page buffer and one component
+        // analysis; stages defined in this file work on it in place,
+        // any others get the usual copy in and out.
         void cleanup(bytearray &out,bytearray &in) {
-            bytearray temp;
             out = in;
+            make_binary(out);
+            CleanupContext context(out);
+            cleanup(context);
+        }
+        void cleanup(CleanupContext &context) {
             for(int i=0;i<binclean.length();i++) {
                 if(!binclean[i]) continue;
+                double start = now();
                 try {
-                    binclean[i]->cleanup(temp,out);
-                    out.move(temp);
+                    ICleanupInPlace *stage = dynamic_cast<ICleanupInPlace*>(binclean[i].ptr());
+                    if(stage) {
+                        stage->cleanup(context);
+                    } else {
+                        bytearray temp;
+                        binclean[i]->cleanup(temp,context.image);
+                        context.image.move(temp);
+                        context.changed();
+                    }
                 } catch(const char *s) {
                     debugf("warn","binclean%d failed: %s\n",i,s);
                 }
+                report("binclean",i,binclean[i]->name(),start);
+            }
+        }
+        // Binary deskewing of the cleaned up page; deskewers that can
+        // use the component analysis of the page get it instead of
+        // labeling the page again.
+        void deskew(bytearray &out,CleanupContext &context) {
+            double start = now();
+            try {
+                IDeskewWithBoxes *deskewer = dynamic_cast<IDeskewWithBoxes*>(bindeskew.ptr());
+                if(deskewer) {
+                    context.components();
+                    deskewer->deskew(out,context.image,context.ccs.boxes);
+                } else {
+                    bindeskew->cleanup(out,context.image);
+                }
+            } catch(const char *s) {
+                debugf("warn","bindeskew failed: %s\n",s);
+                // just continue as if nothing happened
+                out.move(context.image);
             }
+            report("bindeskew",bindeskew->name(),start);
         }
         void binarize(bytearray &out,bytearray &in) {
             bytearray gray;
@@ -338,24 +449,23 @@ namespace ocropus {
         }
         void binarize(bytearray &out,bytearray &gray,bytearray &in) {
             if(contains_only(in,0,255)) {
-                bytearray temp;
-                cleanup(out,in);
                 if(bindeskew) {
-                    temp.move(out);
-                    try {
-                        bindeskew->cleanup(out,temp);
-                    } catch(const char *s) {
-                        debugf("warn","graydeskew failed: %s\n",s);
-                        // just continue as if nothing happened
-                        out.move(temp);
-                    }
+                    bytearray page;
+                    page = in;
+                    make_binary(page);
+                    CleanupContext context(page);
+                    cleanup(context);
+                    deskew(out,context);
                     gray = out;
+                } else {
+                    cleanup(out,in);
                 }
             } else {
                 bool deskewed = 0;
                 bytearray temp;
                 cleanup_gray(out,in);
                 if(graydeskew) {
+                    double start = now();
                     temp.move(out);
                     try {
                         graydeskew->cleanup_gray(out,temp);
@@ -364,10 +474,12 @@ namespace ocropus {
                         // just continue as if nothing happened
                         out.move(temp);
                     }
+                    report("graydeskew",graydeskew->name(),start);
                     deskewed = 1;
                     gray = out;
                 }
                 temp.move(out);
+                double start = now();
                 try {
                     binarizer->binarize(out,temp);
                     temp.move(out);
@@ -375,16 +487,14 @@ namespace ocropus {
                     debugf("warn","binarizer failed: %s\n",s);
                     // just continue as if nothing happened
                 }
-                cleanup(out,temp);
+                report("binarizer",binarizer->name(),start);
                 if(!deskewed && bindeskew) {
-                    temp.move(out);
-                    try {
-                        bindeskew->cleanup(out,temp);
-                    } catch(const char *s) {
-                        debugf("warn","bindeskew failed: %s\n",s);
-                        // just continue as if nothing happened
-                        out.move(temp);
-                    }
+                    make_binary(temp);
+                    CleanupContext context(temp);
+                    cleanup(context);
+                    deskew(out,context);
+                } else {
+                    cleanup(out,temp);
                 }
             }
         }
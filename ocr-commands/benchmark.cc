@@ -0,0 +1,506 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: benchmark.cc
+// Purpose: timing the recognition pipeline on synthetic pages
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de, www.ocropus.org
+
+#include <math.h>
+#include "colib/colib.h"
+#include "iulib/iulib.h"
+#include "ocropus.h"
+#include "ocr-commands.h"
+
+#ifndef _OPENMP
+#define OCRO_THREAD 0
+#else
+#include <omp.h>
+#define OCRO_THREAD omp_get_thread_num()
+#endif
+
+namespace ocropus {
+
+    using namespace iulib;
+    using namespace colib;
+    using namespace narray_ops;
+
+    // The pages are made up of blocky glyphs (stems, bowls, ascenders,
+    // descenders, dots) set in columns of paragraphs with short last
+    // lines, then degraded in gray.  Everything is drawn from a random
+    // stream seeded by benchmark_seed and the page number, so the same
+    // parameters give the same pages on every machine.
+
+    namespace {
+        void fill_rect(bytearray &image,int x0,int y0,int x1,int y1) {
+            x0 = max(x0,0); y0 = max(y0,0);
+            x1 = min(x1,image.dim(0)); y1 = min(y1,image.dim(1));
+            for(int x=x0;x<x1;x++)
+                for(int y=y0;y<y1;y++)
+                    image(x,y) = 0;
+        }
+
+        // draws a glyph with its baseline at y; returns its width
+        int draw_glyph(bytearray &image,int x,int y,int xh,int kind) {
+            int s = max(1,xh/6);
+            int w = xh*2/3;
+            int asc = xh*3/2, desc = xh/2;
+            switch(kind) {
+            case 0: // o
+                fill_rect(image,x,y,x+s,y+xh);
+                fill_rect(image,x+w-s,y,x+w,y+xh);
+                fill_rect(image,x,y,x+w,y+s);
+                fill_rect(image,x,y+xh-s,x+w,y+xh);
+                break;
+            case 1: // l
+                w = s;
+                fill_rect(image,x,y,x+s,y+asc);
+                break;
+            case 2: // p
+                fill_rect(image,x,y-desc,x+s,y+xh);
+                fill_rect(image,x+w-s,y+xh/2,x+w,y+xh);
+                fill_rect(image,x,y+xh/2,x+w,y+xh/2+s);
+                fill_rect(image,x,y+xh-s,x+w,y+xh);
+                break;
+            case 3: // n
+                fill_rect(image,x,y,x+s,y+xh);
+                fill_rect(image,x+w-s,y,x+w,y+xh);
+                fill_rect(image,x,y+xh-s,x+w,y+xh);
+                break;
+            case 4: // i
+                w = s;
+                fill_rect(image,x,y,x+s,y+xh);
+                fill_rect(image,x,y+xh+s,x+s,y+xh+2*s);
+                break;
+            default: // e
+                fill_rect(image,x,y,x+s,y+xh);
+                fill_rect(image,x,y,x+w,y+s);
+                fill_rect(image,x,y+xh/2,x+w,y+xh/2+s);
+                fill_rect(image,x,y+xh-s,x+w,y+xh);
+                fill_rect(image,x+w-s,y+xh/2,x+w,y+xh);
+                break;
+            }
+            return w;
+        }
+
+        // fills a line from x0 to x1 with words; returns the right edge
+        int draw_line(bytearray &image,int x0,int x1,int y,int xh,
+                      DegradationRandom &random) {
+            int x = x0, right = x0;
+            int gap = max(1,xh/4), space = xh*2/3;
+            for(;;) {
+                int n = 1+int(8*random.uniform());
+                if(x+n*(xh*2/3+gap)>x1) break;
+                for(int i=0;i<n;i++)
+                    x += draw_glyph(image,x,y,xh,int(6*random.uniform()))+gap;
+                right = x-gap;
+                x += space;
+            }
+            return right;
+        }
+
+        int make_page(bytearray &image,int dpi,int ncolumns,
+                      DegradationRandom &random) {
+            int w = dpi*17/2, h = dpi*11;
+            image.resize(w,h);
+            fill(image,255);
+            int xh = max(6,dpi*6/100);
+            int pitch = xh*9/4;
+            int margin = dpi/2, gutter = dpi/3;
+            int cw = (w-2*margin-(ncolumns-1)*gutter)/ncolumns;
+            int nlines = 0;
+            for(int c=0;c<ncolumns;c++) {
+                int x0 = margin+c*(cw+gutter);
+                int paragraph = 0;
+                for(int y=h-margin-2*xh;y>margin;y-=pitch) {
+                    // leave a blank line between paragraphs
+                    if(paragraph<=0) {
+                        paragraph = 5+int(10*random.uniform());
+                        continue;
+                    }
+                    int x1 = x0+cw;
+                    if(--paragraph==0) x1 = x0+int(cw*(0.3+0.5*random.uniform()));
+                    if(draw_line(image,x0,x1,y,xh,random)>x0) nlines++;
+                }
+            }
+            degrade(image,random,0,.2,.1,.05,.02,0,0);
+            return nlines;
+        }
+
+        // appends s as a JSON string, quotes included
+        void append_json_string(strg &out,const char *s) {
+            out += "\"";
+            for(const unsigned char *p=(const unsigned char *)s;*p;p++) {
+                char c[8];
+                if(*p=='"' || *p=='\\') sprintf(c,"\\%c",*p);
+                else if(*p<0x20) sprintf(c,"\\u%04x",*p);
+                else sprintf(c,"%c",*p);
+                out += c;
+            }
+            out += "\"";
+        }
+
+        struct StageTimes {
+            strg stage,component,unit;
+            floatarray latencies;
+            double seconds;
+            // the peak resident set size is only ever known for the
+            // whole process, so a stage gets how much it raised it
+            double peak_before;
+            StageTimes(const char *stage,const char *component,const char *unit,int n) {
+                this->stage = stage;
+                this->component = component;
+                this->unit = unit;
+                latencies.resize(n);
+                fill(latencies,0);
+                seconds = 0;
+                peak_before = peak_memory();
+            }
+            double percentile(floatarray &sorted,double p) {
+                int n = sorted.length();
+                if(n==0) return 0;
+                int i = int(ceil(p*n))-1;
+                return sorted(max(0,min(n-1,i)));
+            }
+        };
+
+        // a previous run of the benchmark, one record per line
+        struct Baseline {
+            narray<strg> keys;
+            floatarray throughputs,medians;
+
+            static bool field(strg &result,const char *line,const char *name) {
+                strg pattern;
+                sprintf(pattern,"\"%s\":",name);
+                const char *p = strstr(line,pattern);
+                if(!p) return false;
+                p += strlen(pattern);
+                bool quoted = *p=='"';
+                if(quoted) p++;
+                result = "";
+                for(;*p;p++) {
+                    if(quoted ? *p=='"' : (*p==',' || *p=='}')) break;
+                    char c[2] = {*p,0};
+                    if(quoted && *p=='\\' && p[1]=='u' && strlen(p)>=6) {
+                        // only control characters are written this way
+                        char hex[5] = {p[2],p[3],p[4],p[5],0};
+                        c[0] = char(strtol(hex,0,16));
+                        p += 5;
+                    } else if(quoted && *p=='\\' && p[1]) {
+                        c[0] = *++p;
+                    }
+                    result += c;
+                }
+                return true;
+            }
+            static void key(strg &result,const char *stage,const char *component,int threads) {
+                sprintf(result,"%s %s %d",stage,component,threads);
+            }
+            void load(const char *path) {
+                stdio stream(path,"r");
+                char line[10000];
+                while(fgets(line,sizeof line,stream)) {
+                    strg stage,component,threads,throughput,median;
+                    if(!field(stage,line,"stage") || !field(component,line,"component") ||
+                       !field(threads,line,"threads") || !field(throughput,line,"throughput") ||
+                       !field(median,line,"p50"))
+                        continue;
+                    key(keys.push(),stage,component,atoi(threads));
+                    throughputs.push(atof(throughput));
+                    medians.push(atof(median));
+                }
+                debugf("info","%s: %d baseline records\n",path,keys.length());
+            }
+            int find(const char *k) {
+                for(int i=0;i<keys.length();i++)
+                    if(keys(i)==k) return i;
+                return -1;
+            }
+        };
+
+        struct Cleanup {
+            strg name;
+            autodel<ICleanupBinary> component;
+        };
+
+        struct Recognizer {
+            autodel<IRecognizeLine> linerec;
+            autodel<OcroFST> langmod;
+        };
+
+        // lattices produced by the line recognizer, for the language model
+        struct Lattices {
+            narray<OcroFST*> fsts;
+            Lattices(int n) {
+                fsts.resize(n);
+                for(int i=0;i<n;i++) fsts(i) = 0;
+            }
+            ~Lattices() {
+                for(int i=0;i<fsts.length();i++)
+                    delete fsts(i);
+            }
+        };
+
+        void set_threads(int n) {
+#ifdef _OPENMP
+            omp_set_num_threads(n);
+#else
+            if(n>1) debugf("warn","compiled without OpenMP, running single threaded\n");
+#endif
+        }
+
+        // writes one JSON record per stage and thread count
+        struct Benchmark {
+            FILE *output;
+            Baseline baseline;
+            double tolerance;
+            int threads;
+            int regressions;
+
+            Benchmark() {
+                output = stdout;
+                tolerance = 0.1;
+                threads = 1;
+                regressions = 0;
+            }
+
+            void report(StageTimes &times) {
+                int n = times.latencies.length();
+                floatarray sorted;
+                copy(sorted,times.latencies);
+                quicksort(sorted);
+                double throughput = times.seconds>0 ? n/times.seconds : 0;
+                double p50 = times.percentile(sorted,0.5);
+                strg stage,component,unit;
+                append_json_string(stage,times.stage);
+                append_json_string(component,times.component);
+                append_json_string(unit,times.unit);
+                double peak = peak_memory();
+                fprintf(output,"{\"stage\":%s,\"component\":%s,\"threads\":%d,"
+                        "\"items\":%d,\"unit\":%s,\"seconds\":%.6f,\"throughput\":%.4f,"
+                        "\"p50\":%.6f,\"p90\":%.6f,\"p99\":%.6f,\"max\":%.6f,"
+                        "\"peak_rss_growth_kb\":%.0f,\"process_peak_rss_kb\":%.0f",
+                        stage.c_str(),component.c_str(),threads,
+                        n,unit.c_str(),times.seconds,throughput,
+                        p50,times.percentile(sorted,0.9),times.percentile(sorted,0.99),
+                        n>0?sorted(n-1):0.0,peak-times.peak_before,peak);
+                strg k;
+                Baseline::key(k,times.stage,times.component,threads);
+                int i = baseline.find(k);
+                if(i>=0) {
+                    double old_throughput = baseline.throughputs(i);
+                    double old_p50 = baseline.medians(i);
+                    bool slower = throughput<old_throughput*(1-tolerance) ||
+                        (old_p50>0 && p50>old_p50*(1+tolerance));
+                    fprintf(output,",\"baseline_throughput\":%.4f,\"baseline_p50\":%.6f,\"regression\":%s",
+                            old_throughput,old_p50,slower?"true":"false");
+                    if(slower) {
+                        debugf("warn","regression in %s (%s) at %d threads: %.4f %s/s, was %.4f\n",
+                               times.stage.c_str(),times.component.c_str(),threads,
+                               throughput,times.unit.c_str(),old_throughput);
+                        regressions++;
+                    }
+                }
+                fprintf(output,"}\n");
+                fflush(output);
+            }
+        };
+    }
+
+    int main_benchmark(int argc,char **argv) {
+        param_int npages("benchmark_pages",4,"number of synthetic pages");
+        param_int dpi("benchmark_dpi",300,"resolution of the synthetic pages");
+        param_int ncolumns("benchmark_columns",2,"number of text columns on the synthetic pages");
+        param_int seed("benchmark_seed",0,"seed for generating the pages");
+        param_string cthreads("benchmark_threads","1,2,4,8","thread counts to run the stages with");
+        param_string cbaseline("benchmark_baseline","","output of an earlier run to compare against");
+        param_float tolerance("benchmark_tolerance",0.1,"relative slowdown reported as a regression");
+        param_string cbinarizer("binarizer","BinarizeBySauvola","binarization component");
+        param_string ccleanup("cleanup","DocClean,PageFrameRAST","binary cleanup components, applied in order");
+        param_string csegmenter("psegmenter","SegmentPageByRAST","segmenter to use at the page level");
+        param_string cmodel("cmodel",DEFAULT_DATA_DIR "/default.model","character model used for recognition");
+        param_string lmodel("lmodel",DEFAULT_DATA_DIR "/default.fst","language model used for recognition");
+        param_int beam_width("beam_width",100,"number of nodes in a beam generation");
+        if(argc!=1) throw "usage: ocropus benchmark > results.jsonl";
+
+        Benchmark bench;
+        bench.tolerance = tolerance;
+        if(strcmp(cbaseline,"")) bench.baseline.load(cbaseline);
+
+        intarray thread_counts;
+        narray<strg> fields;
+        split_string(fields,cthreads,",");
+        for(int i=0;i<fields.length();i++) {
+            int n = atoi(fields(i));
+            if(n<1) throwf("%s: bad thread count",fields(i).c_str());
+            thread_counts.push(n);
+        }
+        CHECK_ARG(thread_counts.length()>0);
+
+        objlist<bytearray> pages;
+        for(int i=0;i<npages;i++) pages.push();
+        intarray expected(npages);
+#pragma omp parallel for schedule(dynamic)
+        for(int i=0;i<npages;i++) {
+            DegradationRandom random(seed,i);
+            expected(i) = make_page(pages(i),dpi,ncolumns,random);
+        }
+        debugf("info","%d pages of %dx%d, %d lines on the first\n",
+               int(npages),pages(0).dim(0),pages(0).dim(1),expected(0));
+
+        autodel<IBinarize> binarizer;
+        make_component(binarizer,cbinarizer);
+        narray<strg> cleanup_names;
+        split_string(cleanup_names,ccleanup,",");
+        objlist<Cleanup> cleanups;
+        for(int i=0;i<cleanup_names.length();i++) {
+            Cleanup &c = cleanups.push();
+            c.name = cleanup_names(i);
+            make_component(c.component,c.name);
+        }
+        autodel<ISegmentPage> segmenter;
+        make_component(segmenter,csegmenter);
+
+        // one recognizer per thread, loaded before anything is timed
+        int max_threads = max(thread_counts);
+        objlist<Recognizer> recognizers;
+        bool have_linerec = file_exists(cmodel);
+        bool have_langmod = strcmp(lmodel,"") && file_exists(lmodel);
+        if(!have_linerec) debugf("warn","%s: not found, skipping line recognition\n",(const char *)cmodel);
+        if(!have_langmod) debugf("info","no language model, skipping the langmod stage\n");
+        for(int i=0;i<max_threads && have_linerec;i++) {
+            Recognizer &r = recognizers.push();
+            linerec_load(r.linerec,cmodel);
+            if(have_langmod) {
+                r.langmod = make_OcroFST();
+                r.langmod->load(lmodel);
+            }
+        }
+
+        for(int t=0;t<thread_counts.length();t++) {
+            bench.threads = thread_counts(t);
+            set_threads(bench.threads);
+
+            // page level components get all the threads for a page
+            objlist<bytearray> binary;
+            for(int i=0;i<npages;i++) binary.push();
+            StageTimes binarize("binarize",cbinarizer,"page",npages);
+            for(int i=0;i<npages;i++) {
+                double start = now();
+                binarizer->binarize(binary(i),pages(i));
+                binarize.latencies(i) = now()-start;
+                binarize.seconds += binarize.latencies(i);
+            }
+            bench.report(binarize);
+
+            // labeling of the binary pages, which the layout stages
+            // below all do at least once
+            StageTimes components("components","ConnectedComponents","page",npages);
+            for(int i=0;i<npages;i++) {
+                intarray labels;
+                makelike(labels,binary(i));
+                for(int j=0;j<labels.length1d();j++)
+                    labels.at1d(j) = binary(i).at1d(j)==0;
+                double start = now();
+                ConnectedComponents cc;
+                cc.label(labels);
+                components.latencies(i) = now()-start;
+                components.seconds += components.latencies(i);
+            }
+            bench.report(components);
+
+            for(int c=0;c<cleanups.length();c++) {
+                StageTimes cleanup("cleanup",cleanups(c).name,"page",npages);
+                for(int i=0;i<npages;i++) {
+                    bytearray temp;
+                    double start = now();
+                    cleanups(c).component->cleanup(temp,binary(i));
+                    cleanup.latencies(i) = now()-start;
+                    cleanup.seconds += cleanup.latencies(i);
+                    move(binary(i),temp);
+                }
+                bench.report(cleanup);
+            }
+
+            objlist<bytearray> lines;
+            StageTimes segment("segment",csegmenter,"page",npages);
+            for(int i=0;i<npages;i++) {
+                intarray seg;
+                double start = now();
+                segmenter->segment(seg,binary(i));
+                segment.latencies(i) = now()-start;
+                segment.seconds += segment.latencies(i);
+                RegionExtractor regions;
+                regions.setPageLines(seg);
+                debugf("benchmark","page %d: %d lines found, %d drawn\n",
+                       i,regions.length()-1,expected(i));
+                for(int j=1;j<regions.length();j++)
+                    regions.extract(lines.push(),pages(i),j,1);
+            }
+            bench.report(segment);
+
+            if(!have_linerec) continue;
+
+            // lines are independent, so they are spread over the threads
+            int nlines = lines.length();
+            Lattices lattices(nlines);
+            StageTimes linerec("linerec",cmodel,"line",nlines);
+            double start = now();
+#pragma omp parallel for schedule(dynamic)
+            for(int i=0;i<nlines;i++) {
+                Recognizer &r = recognizers(OCRO_THREAD);
+                double line_start = now();
+                try {
+                    lattices.fsts(i) = make_OcroFST();
+                    r.linerec->recognizeLine(*lattices.fsts(i),lines(i));
+                } catch(...) {
+                    // bad lines cost time too; they're counted
+                }
+                linerec.latencies(i) = now()-line_start;
+            }
+            linerec.seconds = now()-start;
+            bench.report(linerec);
+
+            if(!have_langmod) continue;
+            StageTimes langmod("langmod",lmodel,"line",nlines);
+            start = now();
+#pragma omp parallel for schedule(dynamic)
+            for(int i=0;i<nlines;i++) {
+                Recognizer &r = recognizers(OCRO_THREAD);
+                double line_start = now();
+                try {
+                    ustrg str;
+                    if(lattices.fsts(i))
+                        beam_search(str,*lattices.fsts(i),*r.langmod,beam_width);
+                } catch(...) {
+                }
+                langmod.latencies(i) = now()-line_start;
+            }
+            langmod.seconds = now()-start;
+            bench.report(langmod);
+        }
+
+        if(bench.regressions>0) {
+            debugf("warn","%d regressions against %s\n",bench.regressions,(const char *)cbaseline);
+            return 1;
+        }
+        return 0;
+    }
+}
@@ -35,6 +35,7 @@
 #include "ocropus.h"
 #include "glinerec.h"
 #include "bookstore.h"
+#include "ocr-commands.h"
 
 namespace ocropus {
     void hocr_dump_preamble(FILE *output) {
@@ -54,13 +55,54 @@ namespace ocropus {
         fprintf(output, "</head>\n");
     }
 
+    // The line index caches the bounding box of every text line of a page
+    // next to the page segmentation, so that output generation doesn't
+    // have to decode the pseg image again. Each row of the index is
+    // (lineno,id,x0,y0,x1,y1), where lineno is the number of the region
+    // in the RegionExtractor and id its color in the pseg image; which
+    // of the two the lines are stored under depends on the book store,
+    // so pages2lines records it in a "keys" line after the size.
+
+    void write_line_index(IBookStore &bookstore,int page,RegionExtractor &regions,int w,int h) {
+        stdio stream(bookstore.path(page,-1,"lines","txt"),"w");
+        fprintf(stream,"size %d %d\n",w,h);
+        fprintf(stream,"keys %s\n",bookstore.linesByNumber()?"number":"color");
+        for(int i=1;i<regions.length();i++) {
+            if(regions.bbox(i).empty()) continue;
+            fprintf(stream,"%d %06x %d %d %d %d\n",i,regions.id(i),
+                    regions.x0(i),regions.y0(i),regions.x1(i),regions.y1(i));
+        }
+    }
+
+    bool read_line_index(intarray &index,int &h,bool &by_number,IBookStore &bookstore,int page) {
+        index.clear();
+        stdio stream(bookstore.open("r",page,-1,"lines","txt"),true);
+        if(!stream) return false;
+        int w;
+        if(fscanf(stream,"size %d %d\n",&w,&h)!=2) return false;
+        // indexes written before the keys were recorded go by the store
+        by_number = bookstore.linesByNumber();
+        char keys[16];
+        if(fscanf(stream,"keys %15s\n",keys)==1) {
+            if(!strcmp(keys,"number")) by_number = true;
+            else if(!strcmp(keys,"color")) by_number = false;
+            else return false;
+        }
+        intarray row(6);
+        while(fscanf(stream,"%d %x %d %d %d %d\n",
+                     &row[0],&row[1],&row[2],&row[3],&row[4],&row[5])==6)
+            rowpush(index,row);
+        // anything left over means an index in another format
+        return feof(stream);
+    }
+
     void hocr_dump_line(FILE *output,IBookStore &bookstore,
-                        RegionExtractor &r, int page, int line, int h) {
+                        intarray &index,int row,int page,int line,int h) {
         fprintf(output, "<span class=\"ocr_line\"");
-        if(line > 0 && line < r.length()) {
+        if(row>=0) {
             fprintf(output, " title=\"bbox %d %d %d %d\"",
-                        r.x0(line), h - 1 - r.y0(line),
-                        r.x1(line), h - 1 - r.y1(line));
+                        index(row,2), h - 1 - index(row,3),
+                        index(row,4), h - 1 - index(row,5));
         }
         fprintf(output, ">\n");
         ustrg s;
@@ -72,47 +114,102 @@ namespace ocropus {
     }
 
     void hocr_dump_page(FILE *output, IBookStore & bookstore, int page) {
-        strg pattern;
-
-        intarray page_seg;
-        //bookstore.getPageSegmentation(page_seg, page);
-        if (!bookstore.getPage(page_seg, page, "pseg")) {
-            if(page>0)
-                debugf("warn","%d: page not found\n",page);
+        intarray index;
+        int h = 0;
+        bool by_number;
+        if(!read_line_index(index,h,by_number,bookstore,page)) {
+            // no line index (e.g., the book was split by an older version);
+            // fall back to the page segmentation
+            index.clear();
+            intarray page_seg;
+            bool found;
+#pragma omp critical
+            found = bookstore.getPage(page_seg, page, "pseg");
+            if(!found) {
+                if(page>0)
+                    debugf("warn","%d: page not found\n",page);
                 return;
+            }
+            h = page_seg.dim(1);
+            by_number = bookstore.linesByNumber();
+            RegionExtractor regions;
+            regions.setPageLines(page_seg);
+            intarray row(6);
+            for(int i=1;i<regions.length();i++) {
+                if(regions.bbox(i).empty()) continue;
+                row[0] = i;
+                row[1] = regions.id(i);
+                row[2] = regions.x0(i);
+                row[3] = regions.y0(i);
+                row[4] = regions.x1(i);
+                row[5] = regions.y1(i);
+                rowpush(index,row);
+            }
         }
-        int h = page_seg.dim(1);
 
-        RegionExtractor regions;
-        regions.setPageLines(page_seg);
-        rectarray bboxes;
+        // from the line ids of the book store to rows of the index
+        inthash< Integer<-1> > rows;
+        int key = by_number ? 0 : 1;
+        for(int i=0;i<index.dim(0);i++)
+            rows(index(i,key)) = i;
 
         fprintf(output, "<div class=\"ocr_page\">\n");
-        
+
         int nlines = bookstore.linesOnPage(page);
 
         for(int i=0;i<nlines;i++) {
             int line = bookstore.getLineId(page,i);
-            hocr_dump_line(output, bookstore, regions, page, line, h);
+            // -1 for lines without a region, which get no bbox
+            int row = rows(line);
+            hocr_dump_line(output, bookstore, index, row, page, line, h);
         }
         fprintf(output, "</div>\n");
     }
 
     int main_buildhtml(int argc,char **argv) {
         param_string cbookstore("bookstore","SmartBookStore","storage abstraction for book");
+        param_int window("hocr_window",64,"number of pages rendered in parallel before they are written");
         if(argc!=2) throw "usage: ... dir";
         autodel<IBookStore> bookstore;
         make_component(bookstore,cbookstore);
         bookstore->setPrefix(argv[1]);
-        
+
         FILE *output = stdout;
         hocr_dump_preamble(output);
         fprintf(output, "<html>\n");
         hocr_dump_head(output);
         fprintf(output, "<body>\n");
+
+        // Pages are rendered in parallel into memory buffers, a window at a
+        // time, and then written in page order; memory use is bounded by
+        // the size of the window, not the size of the book.
+
         int npages = bookstore->numberOfPages();
-        for(int page=0;page<npages;page++) {
-            hocr_dump_page(output, *bookstore, page);
+        int nwindow = max(1,int(window));
+        narray<char*> buffers(nwindow);
+        narray<size_t> sizes(nwindow);
+        for(int start=0;start<npages;start+=nwindow) {
+            int end = min(npages,start+nwindow);
+#pragma omp parallel for schedule(dynamic,1)
+            for(int page=start;page<end;page++) {
+                char *buffer = 0;
+                size_t size = 0;
+                FILE *stream = open_memstream(&buffer,&size);
+                try {
+                    hocr_dump_page(stream, *bookstore, page);
+                } catch(const char *s) {
+                    debugf("error","page %d: %s\n",page,s);
+                } catch(...) {
+                    debugf("error","page %d (no details)\n",page);
+                }
+                fclose(stream);
+                buffers[page-start] = buffer;
+                sizes[page-start] = size;
+            }
+            for(int page=start;page<end;page++) {
+                fwrite(buffers[page-start],1,sizes[page-start],output);
+                free(buffers[page-start]);
+            }
         }
         fprintf(output, "</body>\n");
         fprintf(output, "</html>\n");
@@ -70,7 +70,7 @@ namespace ocropus {
             fprintf(stderr,"%s: could not open\n",argv[1]);
             return 1;
         }
-        comp = load_component(model);
+        comp = load_any_model(argv[1]);
         comp->info();
         return 0;
     }
@@ -38,16 +38,104 @@
 
 namespace ocropus {
     extern void cleanup_for_eval(strg &);
+    extern void cleanup_for_eval(ustrg &);
+
+    namespace {
+        // Sparse confusion counts indexed by pairs of Unicode code points,
+        // with 0 standing for the empty string (insertions and deletions).
+        // Open addressing with linear probing; the number of buckets is
+        // always a power of two.
+
+        struct ConfusionCounts {
+            intarray from,to,count;
+            int n;
+
+            ConfusionCounts() {
+                init(64);
+            }
+            void init(int nbuckets) {
+                from.resize(nbuckets);
+                fill(from,-1);
+                to.resize(nbuckets);
+                fill(to,-1);
+                count.resize(nbuckets);
+                fill(count,0);
+                n = 0;
+            }
+            int bucket(int i,int j) {
+                unsigned h = unsigned(i)*2654435761u ^ unsigned(j)*2246822519u;
+                return (h ^ (h>>15)) & (from.length()-1);
+            }
+            int &operator()(int i,int j) {
+                if(2*(n+1)>from.length()) grow();
+                int index = bucket(i,j);
+                while(from[index]!=-1) {
+                    if(from[index]==i && to[index]==j) return count[index];
+                    index = (index+1) & (from.length()-1);
+                }
+                from[index] = i;
+                to[index] = j;
+                n++;
+                return count[index];
+            }
+            void grow() {
+                intarray ofrom,oto,ocount;
+                move(ofrom,from);
+                move(oto,to);
+                move(ocount,count);
+                init(2*ofrom.length());
+                for(int k=0;k<ofrom.length();k++)
+                    if(ofrom[k]!=-1) (*this)(ofrom[k],oto[k]) = ocount[k];
+            }
+            void add(ConfusionCounts &other) {
+                for(int k=0;k<other.from.length();k++)
+                    if(other.from[k]!=-1) (*this)(other.from[k],other.to[k]) += other.count[k];
+            }
+            // one (count,from,to) row per actual confusion
+            void errors(intarray &list) {
+                list.resize(n,3);
+                int row = 0;
+                for(int k=0;k<from.length();k++) {
+                    if(from[k]==-1 || from[k]==to[k] || count[k]==0) continue;
+                    list(row,0) = count[k];
+                    list(row,1) = from[k];
+                    list(row,2) = to[k];
+                    row++;
+                }
+                list.resize(row,3);
+            }
+        };
+
+        bool read_utf8_line(ustrg &result,const char *path) {
+            strg s;
+            try {
+                fgets(s, stdio(path,"r"));
+            } catch(const char *error) {
+                return false;
+            }
+            result.clear();
+            result.utf8Decode(s.c_str(),s.length());
+            return true;
+        }
+
+        void utf8_char(utf8strg &result,int c) {
+            ustrg s;
+            s.push(nuchar(c==0?'_':c<=32?'?':c));
+            s.utf8EncodeTerm(result);
+        }
+    }
 
     int main_evaluate(int argc,char **argv) {
         if(argc!=2) throw "usage: ... dir";
         strg s;
         sprintf(s, "%s/[0-9][0-9][0-9][0-9]/[0-9][0-9][0-9][0-9].gt.txt",argv[1]);
         Glob files(s);
-        float total = 0.0, tchars = 0, pchars = 0, lines = 0;
-        for(int index=0;index<files.length();index++) {
+        int nfiles = files.length();
+        double total = 0.0, tchars = 0, pchars = 0, lines = 0;
+#pragma omp parallel for schedule(dynamic,16) reduction(+:total,tchars,pchars,lines)
+        for(int index=0;index<nfiles;index++) {
             if(index%1000==0)
-                debugf("info","%s (%d/%d)\n",files(index),index,files.length());
+                debugf("info","%s (%d/%d)\n",files(index),index,nfiles);
 
             strg base = files(index);
             base.erase(base.find("."));
@@ -90,78 +178,97 @@ namespace ocropus {
         return 0;
     }
 
+    // Like main_evaluate, but reads the transcripts as UTF-8 and also
+    // accumulates the confusions. Every thread keeps its own sparse
+    // counts, which are merged once all lines have been compared.
+
     int main_evalconf(int argc,char **argv) {
+        param_int topk("eval_topk",100,"number of most frequent confusions reported by evalconf (0=all)");
+        param_string summary("eval_summary","","write a JSON summary of evalconf to this file");
         if(argc!=2) throw "usage: ... dir";
         strg s;
         sprintf(s,"%s/[0-9][0-9][0-9][0-9]/[0-9][0-9][0-9][0-9].gt.txt",argv[1]);
         Glob files(s);
-        float total = 0.0, tchars = 0, pchars = 0, lines = 0;
-        intarray confusion(256,256); // FIXME/tmb limited to 256x256, replace with int2hash
-        confusion = 0;
-        for(int index=0;index<files.length();index++) {
-            if(index%1000==0)
-                debugf("info","%s (%d/%d)\n",files(index),index,files.length());
+        int nfiles = files.length();
+        double total = 0.0, tchars = 0, pchars = 0, lines = 0;
+        ConfusionCounts confusion;
+#pragma omp parallel
+        {
+            ConfusionCounts local;
+            intarray from,to;
+#pragma omp for schedule(dynamic,16) reduction(+:total,tchars,pchars,lines)
+            for(int index=0;index<nfiles;index++) {
+                if(index%1000==0)
+                    debugf("info","%s (%d/%d)\n",files(index),index,nfiles);
 
-            strg base = files(index);
-            base.erase(base.length()-7);
+                strg base = files(index);
+                base.erase(base.length()-7);
 
-            strg truth;
-            try {
-                fgets(truth, stdio(files(index),"r"));
-            } catch(const char *error) {
-                continue;
-            }
+                ustrg truth;
+                if(!read_utf8_line(truth,files(index))) continue;
 
-            strg s = base + ".txt";
-            strg predicted;
-            try {
-                fgets(predicted, stdio(s,"r"));
-            } catch(const char *error) {
-                continue;
-            }
+                strg s = base + ".txt";
+                ustrg predicted;
+                if(!read_utf8_line(predicted,s)) continue;
 
-            cleanup_for_eval(truth);
-            cleanup_for_eval(predicted);
-            ustrg ntruth = truth;
-            ustrg npredicted = predicted;
-            float dist = edit_distance(confusion,ntruth,npredicted,1,1,1);
+                cleanup_for_eval(truth);
+                cleanup_for_eval(predicted);
+                float dist = edit_distance(from,to,truth,predicted,1,1,1);
+                for(int k=0;k<from.length();k++)
+                    local(from[k],to[k])++;
 
-            total += dist;
-            tchars += truth.length();
-            pchars += predicted.length();
-            lines++;
+                total += dist;
+                tchars += truth.length();
+                pchars += predicted.length();
+                lines++;
 
-            debugf("transcript",
-                    "%g\t%s\t%s\t%s\n",
-                    dist,
-                    files(index),
-                    truth.c_str(),
-                    predicted.c_str());
-        }
-        intarray list(65536,3); // FIXME/tmb replace with hash table when we move to Unicode
-        int row = 0;
-        for(int i=0;i<confusion.dim(0);i++) {
-            for(int j=0;j<confusion.dim(1);j++) {
-                if(confusion(i,j)==0) continue;
-                if(i==j) continue;
-                list(row,0) = confusion(i,j);
-                list(row,1) = i;
-                list(row,2) = j;
-                row++;
+                if(debug("transcript")) {
+                    utf8strg utf8Truth,utf8Predicted;
+                    truth.utf8EncodeTerm(utf8Truth);
+                    predicted.utf8EncodeTerm(utf8Predicted);
+                    debugf("transcript",
+                            "%g\t%s\t%s\t%s\n",
+                            dist,
+                            files(index),
+                            utf8Truth.c_str(),
+                            utf8Predicted.c_str());
+                }
             }
+#pragma omp critical
+            confusion.add(local);
         }
-        intarray perm;
-        rowsort(perm,list);
-        for(int k=0;k<perm.length();k++) {
-            int index = perm(k);
-            int count = list(index,0);
+
+        // report the most frequent confusions first
+
+        intarray list,perm;
+        confusion.errors(list);
+        if(list.dim(0)>0) rowsort(perm,list);
+        int nreport = perm.length();
+        if(topk>0 && topk<nreport) nreport = topk;
+        utf8strg ci,cj;
+        for(int k=0;k<nreport;k++) {
+            int index = perm(perm.length()-1-k);
             int i = list(index,1);
             int j = list(index,2);
-            if(count==0) continue;
-            printf("%6d   %3d %3d   %c %c\n",
-                    count,i,j,
-                    i==0?'_':(i>32&&i<128)?i:'?',
-                    j==0?'_':(j>32&&j<128)?j:'?');
+            utf8_char(ci,i);
+            utf8_char(cj,j);
+            printf("%6d   %6x %6x   %s %s\n",list(index,0),i,j,ci.c_str(),cj.c_str());
+        }
+        printf("rate %g total_error %g true_chars %g predicted_chars %g lines %g\n",
+                tchars>0?total/tchars:0.0,total,tchars,pchars,lines);
+
+        if(strcmp(summary,"")) {
+            stdio stream(summary,"w");
+            fprintf(stream,"{\"files\": %d, \"lines\": %g, \"rate\": %g, "
+                    "\"total_error\": %g, \"true_chars\": %g, \"predicted_chars\": %g,\n",
+                    nfiles,lines,tchars>0?total/tchars:0.0,total,tchars,pchars);
+            fprintf(stream," \"confusions\": [");
+            for(int k=0;k<nreport;k++) {
+                int index = perm(perm.length()-1-k);
+                fprintf(stream,"%s\n  {\"count\": %d, \"from\": %d, \"to\": %d}",
+                        k?",":"",list(index,0),list(index,1),list(index,2));
+            }
+            fprintf(stream,"]}\n");
         }
         return 0;
     }
@@ -54,6 +54,7 @@ namespace ocropus {
         param_bool continue_partial("continue_partial",0,"don't compute outputs that already exist");
         param_float maxheight("max_line_height",300,"maximum line height");
         param_float maxaspect("max_line_aspect",1.0,"maximum line aspect ratio");
+        param_string stage_cache("stage_cache","","directory for reusing recognition results across runs (empty=off)");
         if(argc!=2) throw "usage: cmodel=... ocropus lines2fsts dir";
         dinit(512,512);
         autodel<IRecognizeLine> linerec;
@@ -66,6 +67,13 @@ namespace ocropus {
             nfiles += bookstore->linesOnPage(page);
         int eval_total=0,eval_tchars=0,eval_pchars=0,eval_lines=0,eval_no_ground_truth=0;
         debugf("info","cmodel=%s\n",(const char *)cmodel);
+        // results are keyed on the line image and on everything about
+        // the recognizer that can change them; config holds the latter
+        StageCache cache(stage_cache);
+        strg config;
+        // cleared by the first thread that can't compute config; read
+        // by all of them, so it is a flag rather than cache.dir
+        volatile bool use_cache = cache.enabled();
         for(int page=0;page<bookstore->numberOfPages();page++) {
             int nlines = bookstore->linesOnPage(page);
 #pragma omp parallel for private(linerec) shared(finished) schedule(dynamic,4)
@@ -79,6 +87,18 @@ namespace ocropus {
                         debugf("info","loading %s failed\n",(const char *)cmodel);
                         abort(); // can't do much else in OpenMP
                     }
+#pragma omp critical
+                    if(use_cache && config.empty()) try {
+                        StageKey key("lines2fsts");
+                        key.add_file(cmodel);
+                        key.add(*linerec);
+                        key.add(double(maxheight));
+                        key.add(double(maxaspect));
+                        key.hex(config);
+                    } catch(...) {
+                        debugf("warn","cannot compute cache key for %s, not caching\n",(const char *)cmodel);
+                        use_cache = false;
+                    }
                     debugf("progress","page %04d line %06x\n",page,line);
                     if(continue_partial) {
                         strg s;
@@ -99,7 +119,24 @@ namespace ocropus {
                     bookstore->getLine(image,page,line);
                     autodel<IGenericFst> result(make_OcroFST());
                     intarray segmentation;
-                    try {
+                    strg key,entry;
+                    bool cached = false;
+                    bool caching = use_cache;
+                    if(caching) {
+                        StageKey k("lines2fsts");
+                        k.add(config);
+                        k.add(image);
+                        k.hex(key);
+                        if(cache.find(entry,key,"fst")) try {
+                            result->load(entry);
+                            cached = true;
+                            debugf("cache","%s: reusing %s\n",line_path,key.c_str());
+                        } catch(...) {
+                            // collected or damaged; recompute
+                            result = make_OcroFST();
+                        }
+                    }
+                    if(!cached) try {
                         CHECK_ARG(image.dim(1)<maxheight);
                         CHECK_ARG(image.dim(1)*1.0/image.dim(0)<maxaspect);
                         try {
@@ -121,16 +158,26 @@ namespace ocropus {
                     }
 
                     if(save_fsts) {
-                        strg s;
+                        strg s,rseg;
                         s = bookstore->path(page,line,0,"fst");
+                        rseg = bookstore->path(page,line,"rseg","png");
                         result->save(s);
-                        if(segmentation.length()>0) {
-                            dsection("line_segmentation");
-                            make_line_segmentation_white(segmentation);
-                            s = bookstore->path(page,line,"rseg","png");
-                            write_image_packed(s,segmentation);
-                            dshowr(segmentation);
-                            dwait();
+                        if(cached) {
+                            // entries without a segmentation have no
+                            // rseg; don't leave one from an older run
+                            if(!cache.get(key,"rseg.png",rseg))
+                                unlink(rseg);
+                        } else {
+                            if(segmentation.length()>0) {
+                                dsection("line_segmentation");
+                                make_line_segmentation_white(segmentation);
+                                write_image_packed(rseg,segmentation);
+                                dshowr(segmentation);
+                                dwait();
+                                if(caching) cache.put(key,"rseg.png",rseg);
+                            }
+                            // the fst marks the entry as complete, so it goes last
+                            if(caching) cache.put(key,"fst",s);
                         }
                     }
 
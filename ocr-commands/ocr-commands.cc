@@ -79,11 +79,15 @@ namespace ocropus {
         ustrg result;
         for(int i=0;i<s.length();i++) {
             int c = s[i].ord();
+            if(c<32||c==127) continue;
             if(space && c==' ') continue;
-            if(nonanum && !isalnum(c)) continue;
-            if(nonalpha && !isalpha(c)) continue;
-            if(c<32||c>127) continue;
-            if(scase && isupper(c)) c = tolower(c);
+            // the character classes below only apply to ASCII; all other
+            // code points are kept so that evaluation stays Unicode clean
+            if(c<128) {
+                if(nonanum && !isalnum(c)) continue;
+                if(nonalpha && !isalpha(c)) continue;
+                if(scase && isupper(c)) c = tolower(c);
+            }
             result.push_back(nuchar(c));
         }
         s = result;
@@ -99,6 +103,16 @@ namespace ocropus {
     }
 
     void linerec_load(autodel<IRecognizeLine> &linerec,const char *cmodel) {
+        if(is_sectioned_model(cmodel)) {
+            IComponent *component = load_sectioned_model(cmodel);
+            IRecognizeLine *result = dynamic_cast<IRecognizeLine*>(component);
+            if(!result) {
+                delete component;
+                throwf("%s: not a line recognizer",cmodel);
+            }
+            linerec = result;
+            return;
+        }
 #if LOAD_OBSOLETE_FORMATS_OPTIONALLY
         linerec = glinerec::make_Linerec();
         try {
@@ -134,7 +148,6 @@ namespace ocropus {
 
     int main_book2pages(int argc,char **argv) {
         param_string cbookstore("bookstore","SmartBookStore","storage abstraction for book");
-        int pageno = 0;
         const char *outdir = argv[1];
 
         autodel<IBookStore> bookstore;
@@ -148,21 +161,50 @@ namespace ocropus {
 
         bookstore->setPrefix(outdir);
 
-        strg s;
-        for(int arg=2;arg<argc;arg++) {
-            Pages pages;
-            pages.parseSpec(argv[arg]);
-            while(pages.nextPage()) {
-                pageno++;
-                debugf("info","page %d\n",pageno);
-                mkdir(s,0777);
-                bytearray page_binary,page_gray;
-                pages.getGray(page_gray);
-                bookstore->putPage(page_gray,pageno);
-                pages.getBinary(page_binary);
-                bookstore->putPage(page_binary,pageno,"bin");
+        Pages all;
+        for(int arg=2;arg<argc;arg++)
+            all.addSpec(argv[arg]);
+        int npages = all.nPages();
+        const char *error = 0;
+
+        // Pages are decoded, binarized and written by several workers,
+        // each with its own Pages (and hence its own binarizer and open
+        // TIFF handle).  Page numbers follow the order of the input,
+        // whichever worker handles a page.  Chunks of consecutive pages
+        // let a worker step through a multi-page TIFF without reopening it.
+#pragma omp parallel
+        {
+            autodel<Pages> pages;
+#pragma omp critical
+            {
+                pages = new Pages();
+                pages->shareFiles(all);
+            }
+#pragma omp for schedule(dynamic,4)
+            for(int index=0;index<npages;index++) {
+                bool failed;
+#pragma omp critical
+                failed = error!=0;
+                if(failed) continue;
+                int pageno = index+1;
+                try {
+                    debugf("info","page %d\n",pageno);
+                    pages->getPage(index);
+                    bytearray page_binary,page_gray;
+                    pages->takeGray(page_gray);
+                    bookstore->putPage(page_gray,pageno);
+                    pages->takeBinary(page_binary);
+                    bookstore->putPage(page_binary,pageno,"bin");
+                } catch(const char *s) {
+#pragma omp critical
+                    if(!error) error = s;
+                } catch(...) {
+#pragma omp critical
+                    if(!error) error = "error converting page";
+                }
             }
         }
+        if(error) throw error;
         return 0;
     }
 
@@ -230,6 +272,7 @@ namespace ocropus {
                 bookstore->putPage(page_seg,pageno,"pseg");
                 RegionExtractor regions;
                 regions.setPageLines(page_seg);
+                write_line_index(*bookstore,pageno,regions,page_seg.dim(0),page_seg.dim(1));
                 int grow = extract_grow;
                 for(int lineno=1;lineno<regions.length();lineno++) {
                     try {
@@ -242,7 +285,7 @@ namespace ocropus {
                         CHECK_ARG(line_image.dim(1)<maxheight);
                         CHECK_ARG(line_image.dim(1)*1.0/line_image.dim(0)<maxaspect);
                         int id = regions.id(lineno);
-                        if(!strcmp(cbookstore,"OldBookStore")) id = lineno;
+                        if(bookstore->linesByNumber()) id = lineno;
                         bookstore->putLine(line_image,pageno,id);
                     } catch(const char *s) {
                         debugf("error","%s: page %d line %d\n",s,pageno,lineno);
@@ -266,11 +309,60 @@ namespace ocropus {
     }
 
 
+    void recognize_line(narray<strg> &output,IRecognizeLine &linerec,
+                        OcroFST *langmod,int beam_width,bytearray &line_image) {
+        autodel<OcroFST> result(make_OcroFST());
+        linerec.recognizeLine(*result,line_image);
+        ustrg str;
+        if(!langmod) {
+            result->bestpath(str);
+        } else {
+            double cost = beam_search(str,*result,*langmod,beam_width);
+            if(cost>1e10) throw "beam search failed";
+        }
+        utf8strg utf8Output;
+        str.utf8EncodeTerm(utf8Output);
+        output.push() = utf8Output.c_str();
+    }
+
+    void recognize_page(narray<strg> &output,Pages &pages,ISegmentPage &segmenter,
+                        IRecognizeLine &linerec,OcroFST *langmod,int beam_width) {
+        bytearray page_binary,page_gray;
+        intarray page_seg;
+        pages.getBinary(page_binary);
+        pages.getGray(page_gray);
+        segmenter.segment(page_seg,page_binary);
+        RegionExtractor regions;
+        regions.setPageLines(page_seg);
+        for(int i=1;i<regions.length();i++) {
+            try {
+                bytearray line_image;
+                regions.extract(line_image,page_gray,i,1);
+                recognize_line(output,linerec,langmod,beam_width,line_image);
+            } catch(const char *error) {
+                debugf("error","%s line %d: %s\n",pages.getFileName(),i,error);
+            }
+        }
+    }
+
     int main_page(int argc,char **argv) {
         param_int beam_width("beam_width", 100, "number of nodes in a beam generation");
         param_string csegmenter("csegmenter","SegmentPageByRAST","page segmentation component");
         param_string cmodel("cmodel",DEFAULT_DATA_DIR "/default.model","character model used for recognition");
         param_string lmodel("lmodel",DEFAULT_DATA_DIR "/default.fst","language model used for recognition");
+        param_string service("service","","socket of a running 'ocropus serve' to send the pages to");
+        if(strcmp(service,"")) {
+            // the service has its own models loaded
+            narray<strg> overrides;
+            sprintf(overrides.push(),"beam_width=%d",int(beam_width));
+            for(int arg=1;arg<argc;arg++) {
+                narray<strg> output;
+                submit_job(output,service,"page",argv[arg],overrides);
+                for(int i=0;i<output.length();i++)
+                    printf("%s\n",output(i).c_str());
+            }
+            return 0;
+        }
         // create the segmenter
         autodel<ISegmentPage> segmenter;
         make_component(segmenter,csegmenter);
@@ -294,33 +386,10 @@ namespace ocropus {
             Pages pages;
             pages.parseSpec(argv[arg]);
             while(pages.nextPage()) {
-                bytearray page_binary,page_gray;
-                intarray page_seg;
-                pages.getBinary(page_binary);
-                pages.getGray(page_gray);
-                segmenter->segment(page_seg,page_binary);
-                RegionExtractor regions;
-                regions.setPageLines(page_seg);
-                for(int i=1;i<regions.length();i++) {
-                    try {
-                        bytearray line_image;
-                        regions.extract(line_image,page_gray,i,1);
-                        autodel<OcroFST> result(make_OcroFST());
-                        linerec->recognizeLine(*result,line_image);
-                        ustrg str;
-                        if(!langmod) {
-                            result->bestpath(str);
-                        } else {
-                            double cost = beam_search(str,*result,*langmod,beam_width);
-                            if(cost>1e10) throw "beam search failed";
-                        }
-                        utf8strg utf8Output;
-                        str.utf8EncodeTerm(utf8Output);
-                        printf("%s\n",utf8Output.c_str());
-                    } catch(const char *error) {
-                        debugf("error","%s\n",error);
-                    }
-                }
+                narray<strg> output;
+                recognize_page(output,pages,*segmenter,*linerec,langmod.ptr(),beam_width);
+                for(int i=0;i<output.length();i++)
+                    printf("%s\n",output(i).c_str());
             }
         }
         return 0;
@@ -687,6 +756,33 @@ namespace ocropus {
         return 0;
     }
 
+    int main_convertmodel(int argc,char **argv) {
+        param_bool sectioned("sectioned",1,"write the sectioned model format (0=single stream)");
+        if(argc!=3) throw "usage: ... input-model output-model";
+        if(file_exists(argv[2])) throwf("%s: already exists",argv[2]);
+        autodel<IComponent> model;
+        model = load_any_model(argv[1]);
+        if(!model) throwf("%s: empty model",argv[1]);
+        debugf("info","converting %s (%s) to %s\n",argv[1],model->name(),
+               sectioned?"sectioned format":"single stream");
+        if(sectioned) {
+            save_sectioned_model(argv[2],model.ptr());
+        } else {
+            // a sectioned model loads everything it still needs
+            // from the input while being saved
+            save_component(stdio(argv[2],"w"),model.ptr());
+        }
+        return 0;
+    }
+
+    int main_cachegc(int argc,char **argv) {
+        param_float max_mbytes("cache_max_mbytes",2000,"remove least recently used results beyond this size (0=no limit)");
+        param_float max_days("cache_max_days",30,"remove results not used for this many days (0=no limit)");
+        if(argc!=2) throw "usage: cache_max_mbytes=... cache_max_days=... ocropus cache-gc dir";
+        stage_cache_gc(argv[1],max_mbytes,max_days);
+        return 0;
+    }
+
     int main_bookstore(int argc,char **argv) {
         param_string cbookstore("bookstore","SmartBookStore","storage abstraction for book");
         autodel<IBookStore> bookstore;
@@ -795,7 +891,7 @@ namespace ocropus {
                 "convert the pages in dir/... into lines");
         SECTION("line recognition and language modeling")
         D("lines2fsts dir",
-                    "convert the lines in dir/... into fsts (lattices); cmodel=...")
+                    "convert the lines in dir/... into fsts (lattices); cmodel=...; stage_cache=cachedir reuses earlier results")
         D("fsts2bestpaths dir",
                 "find the best interpretation of the fsts in dir/... without a language model");
         D("fsts2textdir",
@@ -804,11 +900,13 @@ namespace ocropus {
         D("evaluate dir",
                 "evaluate the quality of the OCR output in dir/...");
         D("evalconf dir",
-                "evaluate the quality of the OCR output in dir/... and outputs confusion matrix");
+                "evaluate the quality of the OCR output in dir/... and output the most frequent confusions; eval_topk=... eval_summary=...");
         D("findconf dir from to",
                 "finds instances of confusion of from to to (according to edit distance)");
         D("evaluate1 file1 file2",
                 "compute the edit distance between the two files");
+        D("benchmark",
+                "time the pipeline on synthetic pages and print JSON records; benchmark_threads=1,2,4,8 benchmark_baseline=old.jsonl ...");
         SECTION("training");
         D("align dir",
                 "align fsts with ground truth transcripts");
@@ -822,7 +920,11 @@ namespace ocropus {
         D("recognize1 logdir model line1 line2...",
                 "recognize images of individual lines of text given on the command line; ocrolog=glr ocrologdir=...");
         D("page image.png",
-                "recognize a single page of text without adaptivity, but with a language model");
+                "recognize a single page of text without adaptivity, but with a language model; service=socket sends it to a running service");
+        D("serve socket",
+                "keep the models loaded and recognize jobs sent to the Unix domain socket; service_workers=... service_queue=...");
+        D("submit socket page|line file... [name=value...]",
+                "send page or line jobs to a running service, with parameter overrides (beam_width, linerec.<param>, segmenter.<param>)");
         SECTION("components");
         D("components",
                 "list available components (of any type)");
@@ -830,6 +932,10 @@ namespace ocropus {
                 "output the available parameters for the given component");
         D("cinfo model",
                 "load the classifier model and print information on it");
+        D("convert-model old new",
+                "convert a model to the sectioned format, whose parts are loaded on first use; sectioned=0 converts back");
+        D("cache-gc cachedir",
+                "remove old results from a stage_cache directory; cache_max_mbytes=... cache_max_days=...");
         SECTION("results");
         D("buildhtml dir",
                 "creates an HTML representation of the OCR output in dir/...");
@@ -853,6 +959,9 @@ namespace ocropus {
     extern int main_align(int argc,char **argv);
     extern int main_fsts2text(int argc,char **argv);
     extern int main_fsts2bestpaths(int argc,char **argv);
+    extern int main_serve(int argc,char **argv);
+    extern int main_benchmark(int argc,char **argv);
+    extern int main_submit(int argc,char **argv);
 
     void load_extensions(const char *dir) {
 #ifdef DLOPEN
@@ -895,6 +1004,9 @@ namespace ocropus {
             if(!strcmp(argv[1],"linfo")) return main_linfo(argc-1,argv+1);
             if(!strcmp(argv[1],"cleanhtml")) return main_buildhtml(argc-1,argv+1);
             if(!strcmp(argv[1],"components")) return main_components(argc-1,argv+1);
+            if(!strcmp(argv[1],"benchmark")) return main_benchmark(argc-1,argv+1);
+            if(!strcmp(argv[1],"cache-gc")) return main_cachegc(argc-1,argv+1);
+            if(!strcmp(argv[1],"convert-model")) return main_convertmodel(argc-1,argv+1);
             if(!strcmp(argv[1],"evalconf")) return main_evalconf(argc-1,argv+1);
             if(!strcmp(argv[1],"evaluate")) return main_evaluate(argc-1,argv+1);
             if(!strcmp(argv[1],"evaluate1")) return main_evalfiles(argc-1,argv+1);
@@ -910,6 +1022,8 @@ namespace ocropus {
             if(!strcmp(argv[1],"pages2lines")) return main_pages2lines(argc-1,argv+1);
             if(!strcmp(argv[1],"params")) return main_params(argc-1,argv+1);
             if(!strcmp(argv[1],"recognize1")) return main_recognize1(argc-1,argv+1);
+            if(!strcmp(argv[1],"serve")) return main_serve(argc-1,argv+1);
+            if(!strcmp(argv[1],"submit")) return main_submit(argc-1,argv+1);
             if(!strcmp(argv[1],"trainseg")) return main_trainseg(argc-1,argv+1);
             if(!strcmp(argv[1],"bookstore")) return main_bookstore(argc-1,argv+1);
             if(!strcmp(argv[1],"cleanup")) return main_cleanup(argc-1,argv+1);
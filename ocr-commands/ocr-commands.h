@@ -32,6 +32,16 @@ namespace ocropus {
     void scale_fst(OcroFST &fst,float scale);
     void store_costs(const char *base, floatarray &costs);
     void rseg_to_cseg(intarray &cseg, intarray &rseg, intarray &ids);
+    void write_line_index(IBookStore &bookstore,int page,RegionExtractor &regions,int w,int h);
+    bool read_line_index(intarray &index,int &h,bool &by_number,IBookStore &bookstore,int page);
+    // recognize the current page of pages, or a single line, appending
+    // the text of its lines to output
+    void recognize_page(narray<strg> &output,Pages &pages,ISegmentPage &segmenter,
+                        IRecognizeLine &linerec,OcroFST *langmod,int beam_width);
+    void recognize_line(narray<strg> &output,IRecognizeLine &linerec,
+                        OcroFST *langmod,int beam_width,bytearray &line_image);
+    void submit_job(narray<strg> &output,const char *socket,const char *kind,
+                    const char *path,narray<strg> &overrides);
 }
 
 namespace glinerec {
@@ -0,0 +1,428 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: service.cc
+// Purpose: resident recognition service on a Unix domain socket
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de, www.ocropus.org
+
+#define __warn_unused_result__ __far__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "colib/colib.h"
+#include "iulib/iulib.h"
+#include "ocropus.h"
+#include "glinerec.h"
+#include "bookstore.h"
+#include "ocr-commands.h"
+
+// Loading the line recognizer and the language model takes most of the
+// time of a small recognition job.  "ocropus serve" loads them once and
+// then recognizes pages and lines sent to it over a Unix domain socket,
+// one job per connection:
+//
+//     request:   page <spec>          (or: line <path>)
+//                cwd=<dir>            directory relative paths are taken from
+//                <name>=<value>       zero or more parameter overrides
+//                                     (beam_width, linerec.<param>,
+//                                     segmenter.<param>)
+//                <empty line>
+//     response:  ok <n>               followed by n lines of text
+//                error <message>
+//
+// A page spec is an image or an @list of images, as for "ocropus page".
+// Relative paths, including those inside an @list, are resolved against
+// the client's directory, since the server can't change its own for a
+// job.  Overrides only apply to the job that carries them.  A client
+// that sends nothing for service_timeout seconds is dropped.
+
+namespace ocropus {
+    using namespace iulib;
+    using namespace colib;
+
+    namespace {
+        int connect_service(const char *path) {
+            int fd = socket(AF_UNIX,SOCK_STREAM,0);
+            if(fd<0) throw "cannot create socket";
+            sockaddr_un address;
+            memset(&address,0,sizeof address);
+            address.sun_family = AF_UNIX;
+            if(strlen(path)>=sizeof address.sun_path) throwf("%s: socket path too long",path);
+            strcpy(address.sun_path,path);
+            if(connect(fd,(sockaddr*)&address,sizeof address)<0) {
+                close(fd);
+                throwf("%s: cannot connect (%s)",path,strerror(errno));
+            }
+            return fd;
+        }
+
+        void chomp(char *p) {
+            int n = strlen(p);
+            while(n>0 && (p[n-1]=='\n' || p[n-1]=='\r')) p[--n] = 0;
+        }
+
+        void resolve(strg &result,const char *dir,const char *path) {
+            if(path[0]=='/' || !*dir) result = path;
+            else sprintf(result,"%s/%s",dir,path);
+        }
+
+        // the loaders share global state (see lines2fsts), so workers
+        // load their models one at a time
+        pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+        // One worker's copy of everything a job needs; recognizers keep
+        // per-line state, so workers can't share them.
+        struct Recognizer {
+            autodel<ISegmentPage> segmenter;
+            autodel<IRecognizeLine> linerec;
+            autodel<OcroFST> langmod;
+            Pages pages;
+            int beam_width;
+
+            void load(const char *csegmenter,const char *cmodel,const char *lmodel) {
+                pthread_mutex_lock(&load_lock);
+                try {
+                    make_component(segmenter,csegmenter);
+                    linerec_load(linerec,cmodel);
+                    if(lmodel && strcmp(lmodel,"")) {
+                        langmod = make_OcroFST();
+                        langmod->load(lmodel);
+                    }
+                } catch(...) {
+                    pthread_mutex_unlock(&load_lock);
+                    throw;
+                }
+                pthread_mutex_unlock(&load_lock);
+            }
+
+            void page(narray<strg> &output,const char *cwd,const char *spec) {
+                strg path;
+                pages.clear();
+                if(spec[0]=='@') {
+                    resolve(path,cwd,spec+1);
+                    stdio stream(path,"r");
+                    char buffer[9999];
+                    while(fgets(buffer,sizeof buffer,stream)) {
+                        chomp(buffer);
+                        if(!*buffer) continue;
+                        resolve(path,cwd,buffer);
+                        pages.addFile(path);
+                    }
+                } else {
+                    resolve(path,cwd,spec);
+                    pages.addFile(path);
+                }
+                pages.rewind();
+                while(pages.nextPage())
+                    recognize_page(output,pages,*segmenter,*linerec,langmod.ptr(),beam_width);
+            }
+
+            void line(narray<strg> &output,const char *cwd,const char *path) {
+                strg resolved;
+                resolve(resolved,cwd,path);
+                bytearray image;
+                read_image_gray(image,resolved);
+                recognize_line(output,*linerec,langmod.ptr(),beam_width,image);
+            }
+        };
+
+        // Component parameters changed by a request, so that they can
+        // be put back afterwards. Only parameters that were actually
+        // changed are recorded, and one that can't be put back doesn't
+        // keep the others from being restored.
+        struct Overrides {
+            narray<IComponent*> components;
+            narray<strg> names;
+            narray<strg> values;
+
+            void set(IComponent *component,const char *name,const char *value) {
+                strg old = component->pget(name);
+                component->pset(name,value);
+                components.push(component);
+                names.push() = name;
+                values.push() = old;
+            }
+            void restore() {
+                for(int i=components.length()-1;i>=0;i--) {
+                    try {
+                        components(i)->pset(names(i),values(i));
+                    } catch(const char *message) {
+                        debugf("error","restoring %s: %s\n",names(i).c_str(),message);
+                    } catch(...) {
+                        debugf("error","restoring %s\n",names(i).c_str());
+                    }
+                }
+                components.clear();
+                names.clear();
+                values.clear();
+            }
+        };
+
+        struct Service {
+            strg csegmenter,cmodel,lmodel;
+            int default_beam_width;
+
+            // accepted connections waiting for a worker
+            pthread_mutex_t lock;
+            pthread_cond_t not_empty;
+            pthread_cond_t not_full;
+            intarray queue;
+            int head,count;
+
+            Service(int capacity) {
+                pthread_mutex_init(&lock,0);
+                pthread_cond_init(&not_empty,0);
+                pthread_cond_init(&not_full,0);
+                queue.resize(capacity);
+                head = 0;
+                count = 0;
+            }
+
+            void put(int fd) {
+                pthread_mutex_lock(&lock);
+                while(count==queue.length())
+                    pthread_cond_wait(&not_full,&lock);
+                queue((head+count)%queue.length()) = fd;
+                count++;
+                pthread_cond_signal(&not_empty);
+                pthread_mutex_unlock(&lock);
+            }
+
+            int get() {
+                pthread_mutex_lock(&lock);
+                while(count==0)
+                    pthread_cond_wait(&not_empty,&lock);
+                int fd = queue(head);
+                head = (head+1)%queue.length();
+                count--;
+                pthread_cond_signal(&not_full);
+                pthread_mutex_unlock(&lock);
+                return fd;
+            }
+
+            void handle(Recognizer &recognizer,int fd) {
+                FILE *in = fdopen(fd,"r");
+                FILE *out = fdopen(dup(fd),"w");
+                if(!in || !out) {
+                    if(in) fclose(in); else close(fd);
+                    if(out) fclose(out);
+                    return;
+                }
+                Overrides overrides;
+                narray<strg> output;
+                strg error;
+                try {
+                    char buffer[10000];
+                    if(!fgets(buffer,sizeof buffer,in)) throw "empty request";
+                    chomp(buffer);
+                    char *path = strchr(buffer,' ');
+                    if(!path) throw "bad request";
+                    *path++ = 0;
+                    strg kind = buffer;
+                    strg file = path;
+                    strg cwd;
+                    recognizer.beam_width = default_beam_width;
+                    while(fgets(buffer,sizeof buffer,in)) {
+                        chomp(buffer);
+                        if(!*buffer) break;
+                        char *value = strchr(buffer,'=');
+                        if(!value) throwf("%s: bad parameter override",buffer);
+                        *value++ = 0;
+                        if(!strcmp(buffer,"cwd"))
+                            cwd = value;
+                        else if(!strcmp(buffer,"beam_width"))
+                            recognizer.beam_width = atoi(value);
+                        else if(!strncmp(buffer,"linerec.",8))
+                            overrides.set(recognizer.linerec.ptr(),buffer+8,value);
+                        else if(!strncmp(buffer,"segmenter.",10))
+                            overrides.set(recognizer.segmenter.ptr(),buffer+10,value);
+                        else
+                            throwf("%s: unknown parameter",buffer);
+                    }
+                    if(ferror(in)) throw "timed out reading the request";
+                    if(kind=="page") recognizer.page(output,cwd,file);
+                    else if(kind=="line") recognizer.line(output,cwd,file);
+                    else throwf("%s: unknown job type",kind.c_str());
+                } catch(const char *message) {
+                    error = message;
+                } catch(...) {
+                    error = "recognition failed";
+                }
+                overrides.restore();
+                if(error.empty()) {
+                    fprintf(out,"ok %d\n",output.length());
+                    for(int i=0;i<output.length();i++)
+                        fprintf(out,"%s\n",output(i).c_str());
+                } else {
+                    fprintf(out,"error %s\n",error.c_str());
+                }
+                fclose(out);
+                fclose(in);
+            }
+
+            static void *work(void *arg) {
+                Service *service = (Service*)arg;
+                autodel<Recognizer> recognizer(new Recognizer());
+                try {
+                    recognizer->load(service->csegmenter,service->cmodel,service->lmodel);
+                } catch(const char *message) {
+                    fprintf(stderr,"FATAL: %s\n",message);
+                    exit(1);
+                } catch(...) {
+                    fprintf(stderr,"FATAL: cannot load the models\n");
+                    exit(1);
+                }
+                for(;;) service->handle(*recognizer,service->get());
+                return 0;
+            }
+        };
+    }
+
+    int main_serve(int argc,char **argv) {
+        param_int nworkers("service_workers",4,"number of jobs processed at the same time");
+        param_int backlog("service_queue",64,"number of accepted jobs waiting for a worker");
+        param_int timeout("service_timeout",60,"seconds to wait for a client to send or receive");
+        param_int beam_width("beam_width", 100, "number of nodes in a beam generation");
+        param_string csegmenter("csegmenter","SegmentPageByRAST","page segmentation component");
+        param_string cmodel("cmodel",DEFAULT_DATA_DIR "/default.model","character model used for recognition");
+        param_string lmodel("lmodel",DEFAULT_DATA_DIR "/default.fst","language model used for recognition");
+        if(argc!=2) throw "usage: ... socket";
+        if(nworkers<1 || backlog<1) throw "service_workers and service_queue must be positive";
+
+        // clients going away must not kill the service
+        signal(SIGPIPE,SIG_IGN);
+
+        Service state(backlog);
+        state.csegmenter = csegmenter;
+        state.cmodel = cmodel;
+        state.lmodel = lmodel;
+        state.default_beam_width = beam_width;
+
+        int listener = socket(AF_UNIX,SOCK_STREAM,0);
+        if(listener<0) throw "cannot create socket";
+        sockaddr_un address;
+        memset(&address,0,sizeof address);
+        address.sun_family = AF_UNIX;
+        if(strlen(argv[1])>=sizeof address.sun_path) throwf("%s: socket path too long",argv[1]);
+        strcpy(address.sun_path,argv[1]);
+        // a socket left behind by an earlier service is replaced,
+        // anything else at that path is not ours to remove
+        struct stat info;
+        if(lstat(argv[1],&info)==0) {
+            if(!S_ISSOCK(info.st_mode))
+                throwf("%s: exists and is not a socket",argv[1]);
+            if(unlink(argv[1])<0)
+                throwf("%s: cannot remove old socket (%s)",argv[1],strerror(errno));
+        }
+        if(bind(listener,(sockaddr*)&address,sizeof address)<0)
+            throwf("%s: cannot bind (%s)",argv[1],strerror(errno));
+        if(listen(listener,backlog)<0)
+            throwf("%s: cannot listen (%s)",argv[1],strerror(errno));
+
+        for(int i=0;i<nworkers;i++) {
+            pthread_t thread;
+            if(pthread_create(&thread,0,Service::work,&state))
+                throw "cannot start worker";
+            pthread_detach(thread);
+        }
+        debugf("info","serving on %s with %d workers\n",argv[1],int(nworkers));
+
+        for(;;) {
+            int fd = accept(listener,0,0);
+            if(fd<0) {
+                if(errno==EINTR) continue;
+                throwf("accept failed (%s)",strerror(errno));
+            }
+            // clients that stall must not hold on to a worker
+            timeval limit;
+            limit.tv_sec = timeout;
+            limit.tv_usec = 0;
+            setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&limit,sizeof limit);
+            setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&limit,sizeof limit);
+            state.put(fd);
+        }
+        return 0;
+    }
+
+    void submit_job(narray<strg> &output,const char *socket,const char *kind,
+                    const char *path,narray<strg> &overrides) {
+        char cwd[PATH_MAX];
+        if(!getcwd(cwd,sizeof cwd)) throwf("cannot get the current directory (%s)",strerror(errno));
+        int fd = connect_service(socket);
+        FILE *out = fdopen(dup(fd),"w");
+        FILE *in = fdopen(fd,"r");
+        if(!in || !out) throw "cannot open socket streams";
+        fprintf(out,"%s %s\n",kind,path);
+        fprintf(out,"cwd=%s\n",cwd);
+        for(int i=0;i<overrides.length();i++)
+            fprintf(out,"%s\n",overrides(i).c_str());
+        fprintf(out,"\n");
+        fclose(out);
+        output.clear();
+        char buffer[10000];
+        strg error;
+        if(!fgets(buffer,sizeof buffer,in)) {
+            error = "no response";
+        } else {
+            chomp(buffer);
+            int n;
+            if(!strncmp(buffer,"error ",6)) {
+                error = buffer+6;
+            } else if(sscanf(buffer,"ok %d",&n)!=1) {
+                error = "bad response";
+            } else {
+                for(int i=0;i<n;i++) {
+                    if(!fgets(buffer,sizeof buffer,in)) {
+                        error = "truncated response";
+                        break;
+                    }
+                    chomp(buffer);
+                    output.push() = buffer;
+                }
+            }
+        }
+        fclose(in);
+        if(!error.empty()) throwf("%s: %s",path,error.c_str());
+    }
+
+    int main_submit(int argc,char **argv) {
+        if(argc<4) throw "usage: ... socket page|line file... [name=value...]";
+        narray<strg> overrides;
+        for(int i=3;i<argc;i++)
+            if(strchr(argv[i],'=')) overrides.push() = argv[i];
+        for(int i=3;i<argc;i++) {
+            if(strchr(argv[i],'=')) continue;
+            narray<strg> output;
+            submit_job(output,argv[1],argv[2],argv[i],overrides);
+            for(int j=0;j<output.length();j++)
+                printf("%s\n",output(j).c_str());
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,131 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: every line buildhtml writes for a book split by pages2lines
+//          has its bounding box, whatever the book store
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ocropus.h"
+
+using namespace colib;
+using namespace iulib;
+using namespace ocropus;
+
+namespace ocropus {
+    extern int main_pages2lines(int argc,char **argv);
+    extern int main_buildhtml(int argc,char **argv);
+}
+
+// a page with a few lines of blocky "characters" at 300dpi sizes
+static void make_page(bytearray &page) {
+    page.resize(1200,900);
+    fill(page,255);
+    for(int l=0;l<5;l++) {
+        int y0 = 800-l*150;
+        for(int x=100;x<1050;x+=40) {
+            if(x%280==260) continue;
+            for(int i=x;i<x+28;i++)
+                for(int j=y0-40;j<y0;j++)
+                    page(i,j) = 0;
+        }
+    }
+}
+
+static void run(int (*command)(int,char**),const char *dir) {
+    char name[] = "test";
+    strg arg(dir);
+    char *argv[] = {name,(char*)arg.c_str(),0};
+    command(2,argv);
+}
+
+// runs buildhtml on the book in dir and returns the number of lines
+// in the output; bboxes is the number of those with a bounding box
+static int count_lines(int &bboxes,const char *dir) {
+    strg path;
+    sprintf(path,"%s/out.html",dir);
+    fflush(stdout);
+    int saved = dup(1);
+    int fd = open(path,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    CHECK_CONDITION(saved>=0 && fd>=0);
+    dup2(fd,1);
+    close(fd);
+    run(main_buildhtml,dir);
+    fflush(stdout);
+    dup2(saved,1);
+    close(saved);
+    stdio stream(path,"r");
+    char line[10000];
+    int n = 0;
+    bboxes = 0;
+    while(fgets(line,sizeof line,stream)) {
+        if(!strstr(line,"class=\"ocr_line\"")) continue;
+        n++;
+        if(strstr(line,"title=\"bbox ")) bboxes++;
+    }
+    return n;
+}
+
+int main() {
+    init_ocropus_components();
+    char dir[] = "/tmp/test-buildhtml-XXXXXX";
+    CHECK_CONDITION(mkdtemp(dir));
+    bytearray page;
+    make_page(page);
+    {
+        autodel<IBookStore> bookstore;
+        make_component("OldBookStore",bookstore);
+        bookstore->setPrefix(dir);
+        bookstore->putPage(page,0);
+    }
+
+    // split as an old book, then once more through SmartBookStore,
+    // which finds the old line files and keeps the old layout
+    setenv("bookstore","OldBookStore",1);
+    run(main_pages2lines,dir);
+    unsetenv("bookstore");
+    run(main_pages2lines,dir);
+    autodel<IBookStore> bookstore;
+    make_component("SmartBookStore",bookstore);
+    bookstore->setPrefix(dir);
+    CHECK_CONDITION(bookstore->linesByNumber());
+    CHECK_CONDITION(bookstore->linesOnPage(0)>=5);
+
+    int bboxes;
+    int n = count_lines(bboxes,dir);
+    CHECK_CONDITION(n==bookstore->linesOnPage(0));
+    CHECK_CONDITION(bboxes==n);
+
+    // the same without the line index, from the page segmentation
+    unlink(bookstore->path(0,-1,"lines","txt"));
+    n = count_lines(bboxes,dir);
+    CHECK_CONDITION(n==bookstore->linesOnPage(0));
+    CHECK_CONDITION(bboxes==n);
+
+    strg command;
+    sprintf(command,"rm -rf %s",dir);
+    CHECK_CONDITION(system(command)==0);
+    return 0;
+}
@@ -141,11 +141,11 @@ namespace ocropus {
             return true;
         }
         make_line_segmentation_black(charimage);
-        label_components(charimage,false);
+        ConnectedComponents components;
+        components.label(charimage);
 
         // Clean non-text and noisy boxes and get character statistics
-        rectarray bboxes;
-        bounding_boxes(bboxes,charimage);
+        rectarray &bboxes = components.boxes;
         if(!bboxes.length()){
             set_default_line_info(intercept, slope, xheight,
                                   descender_sink, ascender_rise, charimage);
@@ -245,10 +245,10 @@ namespace ocropus {
         intarray seg;
         seg = charimage;
         sub(max(seg),seg);
-        label_components(seg,false);
+        ConnectedComponents components;
+        components.label(seg);
 
-        rectarray bboxes;
-        bounding_boxes(bboxes,seg);
+        rectarray &bboxes = components.boxes;
         if(bboxes.length()<2) return false;
 
         autodel<CTextlineRAST> ctextline;
@@ -32,7 +32,7 @@ float log_reg_factor = 2.16423e-07;
 float log_reg_offset = 0;
 int log_reg_feature_len = 177;
 
-float log_reg_data[] = {
+extern const float log_reg_data[] = {
 -213.908,
 -10.3569,
 71.7576,
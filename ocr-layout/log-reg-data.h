@@ -34,7 +34,7 @@ extern int log_reg_class_num;
 extern float log_reg_factor;
 extern float log_reg_offset;
 extern int log_reg_feature_len;
-extern float log_reg_data[];
+extern const float log_reg_data[];
 
 }
 
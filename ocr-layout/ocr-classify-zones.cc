@@ -126,410 +126,214 @@ namespace ocropus {
         }
     }
 
-
-
-    void ZoneFeatures::horizontalRunLengths(floatarray &resulthist,
-                                              floatarray &resultstats,
-                                              const bytearray &image){
-
-        int imwidth  = image.dim(0);
-        int imheight = image.dim(1);
-
-        intarray histogram_fg;
-        histogram_fg.resize(MAX_LEN);
-        fill(histogram_fg,0);
-        intarray histogram_bg;
-        histogram_bg.resize(MAX_LEN);
-        fill(histogram_bg,0);
-
-        int current_run_length_bg = 0;
-        int current_run_length_fg = 0;
-        int run_length_count_fg = 0;
-        int run_length_count_bg = 0;
-        bool end_fg = false;
-        bool end_bg = false;
-        // indicator that the end of the running segment occurs
-        float mean_fg = 0, variance_fg = 0;
-        float mean_bg = 0, variance_bg = 0;
-        for(int j = 0; j < imheight; j++){
-            for(int i = 0; i < imwidth; i++){
-                if(image(i,j) == 0){
-                    current_run_length_fg++;
-                    end_fg = false;
-                }
-                else
-                    end_fg = true;
-
-                if((current_run_length_fg > 0) && (end_fg || (i == imwidth-1))){
-                    current_run_length_fg = min(current_run_length_fg, MAX_LEN);
-                    histogram_fg(current_run_length_fg-1)++;
-                    run_length_count_fg++;
-                    mean_fg += current_run_length_fg;
-                    variance_fg += current_run_length_fg * current_run_length_fg;
-                    current_run_length_fg = 0;
-                    end_fg = false;
-                }
-
-                if(image(i,j) == 255){
-                    current_run_length_bg++;
-                    end_bg = false;
-                }
-                else
-                    end_bg = true;
-
-                if((current_run_length_bg > 0) && (end_bg || (i == imwidth-1))){
-                    current_run_length_bg = min(current_run_length_bg, MAX_LEN);
-                    histogram_bg(current_run_length_bg-1)++;
-                    run_length_count_bg++;
-                    mean_bg += current_run_length_bg;
-                    variance_bg += current_run_length_bg * current_run_length_bg;
-                    current_run_length_bg = 0;
-                    end_bg = false;
-                }
-
+    namespace {
+        const int RL_BINS = 8;      // histogram length after compressHist
+
+        // Index of the compressHist bin of a (clipped) run length; the
+        // bins hold the lengths 1, 2-3, 4-7, ..., 64-127, 128.
+        inline int run_length_bin(int len) {
+            int bin = 0;
+            while(len > 1 && bin < RL_BINS-1) {
+                len >>= 1;
+                bin++;
             }
+            return bin;
         }
-        compressHist(histogram_fg);
-        compressHist(histogram_bg);
-        for(int i=0, l=histogram_fg.length(); i<l; i++)
-            resulthist.push(histogram_fg[i]);
-        for(int i=0, l=histogram_bg.length(); i<l; i++)
-            resulthist.push(histogram_bg[i]);
-
-        if(run_length_count_fg){
-            mean_fg/= run_length_count_fg;
-            variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
-        }
-        else{
-            mean_fg=0; variance_fg=0;
-        }
-        resultstats.push(run_length_count_fg);
-        resultstats.push(mean_fg);
-        resultstats.push(variance_fg);
-
-        if(run_length_count_bg){
-            mean_bg/= run_length_count_bg;
-            variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
-        }
-        else{
-            mean_bg=0; variance_bg=0;
-        }
-        resultstats.push(run_length_count_bg);
-        resultstats.push(mean_bg);
-        resultstats.push(variance_bg);
-
-    }
 
-    void ZoneFeatures::verticalRunLengths(floatarray &resulthist,
-                                            floatarray &resultstats,
-                                            const bytearray &image){
-
-        int imwidth  = image.dim(0);
-        int imheight = image.dim(1);
-
-        intarray histogram_fg;
-        histogram_fg.resize(MAX_LEN);
-        fill(histogram_fg,0);
-        intarray histogram_bg;
-        histogram_bg.resize(MAX_LEN);
-        fill(histogram_bg,0);
-
-        int current_run_length_bg = 0;
-        int current_run_length_fg = 0;
-        int run_length_count_fg = 0;
-        int run_length_count_bg = 0;
-        bool end_fg = false;
-        bool end_bg = false;
-        // indicator that the end of the running segment occurs
-        float mean_fg = 0, variance_fg = 0;
-        float mean_bg = 0, variance_bg = 0;
-        for(int i = 0; i < imwidth; i++){
-            for(int j = 0; j < imheight; j++){
-                if(image(i,j) == 0){
-                    current_run_length_fg++;
-                    end_fg = false;
-                }
-                else
-                    end_fg = true;
-
-                if((current_run_length_fg > 0) && (end_fg || (i == imheight-1))){
-                    current_run_length_fg = min(current_run_length_fg, MAX_LEN);
-                    histogram_fg(current_run_length_fg-1)++;
-                    run_length_count_fg++;
-                    mean_fg += current_run_length_fg;
-                    variance_fg += current_run_length_fg * current_run_length_fg;
-                    current_run_length_fg = 0;
-                    end_fg = false;
+        // Histograms and moments of the foreground (0) and background (1)
+        // runs in one direction.
+        struct RunLengthStats {
+            int hist[2][RL_BINS];
+            int count[2];
+            double sum[2], sum2[2];
+
+            RunLengthStats() {
+                for(int c = 0; c < 2; c++) {
+                    for(int b = 0; b < RL_BINS; b++)
+                        hist[c][b] = 0;
+                    count[c] = 0;
+                    sum[c] = sum2[c] = 0;
                 }
-
-                if(image(i,j) == 255){
-                    current_run_length_bg++;
-                    end_bg = false;
-                }
-                else
-                    end_bg = true;
-
-                if((current_run_length_bg > 0) && (end_bg || (i == imheight-1))){
-                    current_run_length_bg = min(current_run_length_bg, MAX_LEN);
-                    histogram_bg(current_run_length_bg-1)++;
-                    run_length_count_bg++;
-                    mean_bg += current_run_length_bg;
-                    variance_bg += current_run_length_bg * current_run_length_bg;
-                    current_run_length_bg = 0;
-                    end_bg = false;
-                }
-
             }
-        }
-        compressHist(histogram_fg);
-        compressHist(histogram_bg);
-        for(int i=0, l=histogram_fg.length(); i<l; i++)
-            resulthist.push(histogram_fg[i]);
-        for(int i=0, l=histogram_bg.length(); i<l; i++)
-            resulthist.push(histogram_bg[i]);
-
-        if(run_length_count_fg){
-            mean_fg/= run_length_count_fg;
-            variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
-        }
-        else{
-            mean_fg=0; variance_fg=0;
-        }
-        resultstats.push(run_length_count_fg);
-        resultstats.push(mean_fg);
-        resultstats.push(variance_fg);
-
-        if(run_length_count_bg){
-            mean_bg/= run_length_count_bg;
-            variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
-        }
-        else{
-            mean_bg=0; variance_bg=0;
-        }
-        resultstats.push(run_length_count_bg);
-        resultstats.push(mean_bg);
-        resultstats.push(variance_bg);
-
-    }
-
-    void ZoneFeatures::mainDiagRunLengths(floatarray &resulthist,
-                                             floatarray &resultstats,
-                                             const bytearray &image){
-
-        int imwidth  = image.dim(0);
-        int imheight = image.dim(1);
-
-        intarray histogram_fg;
-        histogram_fg.resize(MAX_LEN);
-        fill(histogram_fg,0);
-        intarray histogram_bg;
-        histogram_bg.resize(MAX_LEN);
-        fill(histogram_bg,0);
-
-        int current_run_length_bg = 0;
-        int current_run_length_fg = 0;
-        int run_length_count_fg = 0;
-        int run_length_count_bg = 0;
-        bool end_fg = false;
-        bool end_bg = false;
-        // indicator that the end of the running segment occurs
-        float mean_fg = 0, variance_fg = 0;
-        float mean_bg = 0, variance_bg = 0;
-
-        int pix = 0;
-        for(int i = 0; i < imwidth + imheight; i++){
-            for(int j = 0; j < min(imwidth, imheight); j++){
-                if(i < imwidth){
-                    if(j < i+1)
-                        pix = image(i-j, j);
-                    else
-                        j = imwidth*imheight;
-                }
-                else{
-                    if(j < imwidth-1+imheight-i)
-                        pix = image(imwidth - j - 1, i - (imwidth-1) + j);
-                    else
-                        j = imwidth*imheight;
-                }
-
-                if((pix == 0) && (j != imwidth*imheight)){
-                    current_run_length_fg++;
-                    end_fg = false;
-                }
-                else
-                    end_fg = true;
-
-                if( (current_run_length_fg > 0) &&
-                    (end_fg || (j == imwidth*imheight))){
-                    current_run_length_fg = min(current_run_length_fg, MAX_LEN);
-                    histogram_fg(current_run_length_fg-1)++;
-                    run_length_count_fg++;
-                    mean_fg += current_run_length_fg;
-                    variance_fg += current_run_length_fg * current_run_length_fg;
-                    current_run_length_fg = 0;
-                    end_fg = false;
+            void add(int color, int len) {
+                len = min(len, MAX_LEN);
+                hist[color][run_length_bin(len)]++;
+                count[color]++;
+                sum[color] += len;
+                sum2[color] += double(len) * len;
+            }
+            // fg and bg histograms, then count, mean and variance of fg
+            // and bg runs
+            void write(float *hist_out, float *stats_out) {
+                for(int c = 0; c < 2; c++) {
+                    for(int b = 0; b < RL_BINS; b++)
+                        *hist_out++ = hist[c][b];
+                    double mean = 0, variance = 0;
+                    if(count[c]) {
+                        mean = sum[c] / count[c];
+                        variance = sum2[c] / count[c] - mean * mean;
+                    }
+                    *stats_out++ = count[c];
+                    *stats_out++ = mean;
+                    *stats_out++ = variance;
                 }
-
-                if((pix == 255) && (j != imwidth*imheight)){
-                    current_run_length_bg++;
-                    end_bg = false;
+            }
+        };
+
+        // Run state of every line (row, column or diagonal) of one
+        // direction. Runs strictly inside a line are final as soon as they
+        // end; the first and the last run of each line are kept, since
+        // depending on the direction they may continue into the
+        // neighboring lines.
+        struct LineRuns {
+            intarray first_color, first_len, color, len, nruns, npixels;
+
+            void init(int n) {
+                first_color.resize(n);
+                first_len.resize(n);
+                color.resize(n);
+                len.resize(n);
+                nruns.resize(n);
+                npixels.resize(n);
+                fill(first_color, 0);
+                fill(first_len, 0);
+                fill(color, 0);
+                fill(len, 0);
+                fill(nruns, 0);
+                fill(npixels, 0);
+            }
+            void push(RunLengthStats &stats, int l, int c) {
+                npixels[l]++;
+                if(nruns[l] == 0) {
+                    color[l] = c;
+                    len[l] = 1;
+                    nruns[l] = 1;
+                } else if(color[l] == c) {
+                    len[l]++;
+                } else {
+                    if(nruns[l] == 1) {
+                        first_color[l] = color[l];
+                        first_len[l] = len[l];
+                    } else {
+                        stats.add(color[l], len[l]);
+                    }
+                    color[l] = c;
+                    len[l] = 1;
+                    nruns[l]++;
                 }
-                else
-                    end_bg = true;
-
-                if( (current_run_length_bg > 0) &&
-                    (end_bg || (j == imwidth*imheight))){
-                    current_run_length_bg = min(current_run_length_bg, MAX_LEN);
-                    histogram_bg(current_run_length_bg-1)++;
-                    run_length_count_bg++;
-                    mean_bg += current_run_length_bg;
-                    variance_bg += current_run_length_bg * current_run_length_bg;
-                    current_run_length_bg = 0;
-                    end_bg = false;
+            }
+            // Visit the lines start..end-1 in order; a run that reaches the
+            // end of a line continues into the next one unless the line is
+            // shorter than break_below pixels. The run still pending at the
+            // end is returned in carry_color/carry_len.
+            void finish(RunLengthStats &stats, int break_below,
+                        int &carry_color, int &carry_len, int start, int end) {
+                for(int l = start; l < end; l++) {
+                    if(nruns[l] == 0)
+                        continue;
+                    int head_color = nruns[l] == 1 ? color[l] : first_color[l];
+                    int head_len = nruns[l] == 1 ? len[l] : first_len[l];
+                    if(carry_len > 0) {
+                        if(carry_color == head_color)
+                            head_len += carry_len;
+                        else
+                            stats.add(carry_color, carry_len);
+                    }
+                    if(nruns[l] == 1) {
+                        carry_color = head_color;
+                        carry_len = head_len;
+                    } else {
+                        stats.add(head_color, head_len);
+                        carry_color = color[l];
+                        carry_len = len[l];
+                    }
+                    if(npixels[l] < break_below) {
+                        stats.add(carry_color, carry_len);
+                        carry_len = 0;
+                    }
                 }
             }
-        }
-
-
-        compressHist(histogram_fg);
-        compressHist(histogram_bg);
-        for(int i=0, l=histogram_fg.length(); i<l; i++)
-            resulthist.push(histogram_fg[i]);
-        for(int i=0, l=histogram_bg.length(); i<l; i++)
-            resulthist.push(histogram_bg[i]);
-
-        if(run_length_count_fg){
-            mean_fg/= run_length_count_fg;
-            variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
-        }
-        else{
-            mean_fg=0; variance_fg=0;
-        }
-        resultstats.push(run_length_count_fg);
-        resultstats.push(mean_fg);
-        resultstats.push(variance_fg);
-
-        if(run_length_count_bg){
-            mean_bg/= run_length_count_bg;
-            variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
-        }
-        else{
-            mean_bg=0; variance_bg=0;
-        }
-        resultstats.push(run_length_count_bg);
-        resultstats.push(mean_bg);
-        resultstats.push(variance_bg);
-
+        };
     }
 
-    void ZoneFeatures::sideDiagRunLengths(floatarray &resulthist,
-                                             floatarray &resultstats,
-                                             const bytearray &image){
-
-        int imwidth  = image.dim(0);
-        int imheight = image.dim(1);
-
-        intarray histogram_fg;
-        histogram_fg.resize(MAX_LEN);
-        fill(histogram_fg,0);
-        intarray histogram_bg;
-        histogram_bg.resize(MAX_LEN);
-        fill(histogram_bg,0);
-
-        int current_run_length_bg = 0;
-        int current_run_length_fg = 0;
-        int run_length_count_fg = 0;
-        int run_length_count_bg = 0;
-        bool end_fg = false;
-        bool end_bg = false;
-        // indicator that the end of the running segment occurs
-        float mean_fg = 0, variance_fg = 0;
-        float mean_bg = 0, variance_bg = 0;
-
-        int pix = 0;
-        for(int i = 0; i < imwidth + imheight; i++){
-            for(int j = 0; j < min(imwidth, imheight); j++){
-                if(i < imheight){
-                    if(j < i+1)
-                        pix = image(j, (imheight-1) - i + j);
-                    else
-                        j = imwidth*imheight;
-                }
-                else{
-                    if(j < imwidth-1+imheight-i)
-                        pix = image(i - (imheight-1) + j, j);
-                    else
-                        j = imwidth*imheight;
-                }
-
-                if((pix == 0) && (j != imwidth*imheight)){
-                    current_run_length_fg++;
-                    end_fg = false;
-                }
-                else
-                    end_fg = true;
-
-                if( (current_run_length_fg > 0) &&
-                    (end_fg || (j == imwidth*imheight))){
-                    current_run_length_fg = min(current_run_length_fg, MAX_LEN);
-                    histogram_fg(current_run_length_fg-1)++;
-                    run_length_count_fg++;
-                    mean_fg += current_run_length_fg;
-                    variance_fg += current_run_length_fg * current_run_length_fg;
-                    current_run_length_fg = 0;
-                    end_fg = false;
-                }
-
-                if((pix == 255) && (j != imwidth*imheight)){
-                    current_run_length_bg++;
-                    end_bg = false;
-                }
-                else
-                    end_bg = true;
-
-                if( (current_run_length_bg > 0) &&
-                    (end_bg || (j == imwidth*imheight))){
-                    current_run_length_bg = min(current_run_length_bg, MAX_LEN);
-                    histogram_bg(current_run_length_bg-1)++;
-                    run_length_count_bg++;
-                    mean_bg += current_run_length_bg;
-                    variance_bg += current_run_length_bg * current_run_length_bg;
-                    current_run_length_bg = 0;
-                    end_bg = false;
-                }
+    void ZoneFeatures::runLengths(floatarray &feature,
+                                  const bytearray &image,
+                                  const rectangle &r){
+        int w = r.x1 - r.x0;
+        int h = r.y1 - r.y0;
+        int mindim = min(w, h);
+
+        RunLengthStats horizontal, vertical, main_diag, side_diag;
+        LineRuns rows, columns, main_diags, side_diags;
+        rows.init(h);
+        columns.init(w);
+        main_diags.init(w + h - 1);
+        side_diags.init(w + h - 1);
+
+        // single row-major pass; every pixel extends the runs of its row,
+        // column, and both diagonals, all of which are visited in the same
+        // order as by the original per-direction loops (which are kept
+        // as the reference in tests/test-zone-runlengths.cc)
+        for(int y = 0; y < h; y++){
+            for(int x = 0; x < w; x++){
+                int c = image(r.x0 + x, r.y0 + y) != 0;
+                rows.push(horizontal, y, c);
+                if(x != h - 1)
+                    columns.push(vertical, x, c);
+                main_diags.push(main_diag, x + y, c);
+                side_diags.push(side_diag, x - y + h - 1, c);
             }
         }
 
-
-        compressHist(histogram_fg);
-        compressHist(histogram_bg);
-        for(int i=0, l=histogram_fg.length(); i<l; i++)
-            resulthist.push(histogram_fg[i]);
-        for(int i=0, l=histogram_bg.length(); i<l; i++)
-            resulthist.push(histogram_bg[i]);
-
-        if(run_length_count_fg){
-            mean_fg/= run_length_count_fg;
-            variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
-        }
-        else{
-            mean_fg=0; variance_fg=0;
-        }
-        resultstats.push(run_length_count_fg);
-        resultstats.push(mean_fg);
-        resultstats.push(variance_fg);
-
-        if(run_length_count_bg){
-            mean_bg/= run_length_count_bg;
-            variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
-        }
-        else{
-            mean_bg=0; variance_bg=0;
+        int carry_color = 0, carry_len = 0;
+
+        // rows never continue into each other
+        rows.finish(horizontal, w + 1, carry_color, carry_len, 0, h);
+
+        // diagonals shorter than the zone's smaller dimension end their
+        // runs; the last pending run is recorded
+        main_diags.finish(main_diag, mindim, carry_color, carry_len, 0, w + h - 1);
+        if(carry_len > 0)
+            main_diag.add(carry_color, carry_len);
+        carry_len = 0;
+        side_diags.finish(side_diag, mindim, carry_color, carry_len, 0, w + h - 1);
+        if(carry_len > 0)
+            side_diag.add(carry_color, carry_len);
+        carry_len = 0;
+
+        // The original vertical loop lets runs continue from one column into the
+        // next and never records the last pending run; also, since it
+        // tests the column index against the height, every pixel of column
+        // h-1 ends a run. This is reproduced exactly because the
+        // classifier weights were trained on these features.
+        int special = h - 1;
+        if(special < w) {
+            columns.finish(vertical, 0, carry_color, carry_len, 0, special);
+            int top = image(r.x0 + special, r.y0) != 0;
+            if(carry_len > 0 && carry_color == top) {
+                vertical.add(top, carry_len + 1);
+            } else {
+                if(carry_len > 0)
+                    vertical.add(carry_color, carry_len);
+                vertical.add(top, 1);
+            }
+            for(int y = 1; y < h; y++)
+                vertical.add(image(r.x0 + special, r.y0 + y) != 0, 1);
+            carry_len = 0;
+            columns.finish(vertical, 0, carry_color, carry_len, special + 1, w);
+        } else {
+            columns.finish(vertical, 0, carry_color, carry_len, 0, w);
         }
-        resultstats.push(run_length_count_bg);
-        resultstats.push(mean_bg);
-        resultstats.push(variance_bg);
 
+        int offset = feature.length();
+        for(int i = 0; i < 4 * 2 * RL_BINS + 4 * 6; i++)
+            feature.push(0);
+        float *hist_out = &feature[offset];
+        float *stats_out = &feature[offset + 4 * 2 * RL_BINS];
+        horizontal.write(hist_out, stats_out);
+        vertical.write(hist_out + 2 * RL_BINS, stats_out + 6);
+        main_diag.write(hist_out + 4 * RL_BINS, stats_out + 12);
+        side_diag.write(hist_out + 6 * RL_BINS, stats_out + 18);
     }
 
     void ZoneFeatures::concompHist(floatarray &result,
@@ -608,35 +412,39 @@ namespace ocropus {
     }
 
     void ZoneFeatures::extractFeatures(floatarray &feature, bytearray &image){
-        if(!contains_only(image, byte(0), byte(255))){
-            fprintf(stderr,"Binary image expected! ");
-            fprintf(stderr,"skipping feature extraction...\n");
-            return ;
+        extractFeatures(feature, image, rectangle(0, 0, image.dim(0), image.dim(1)));
+    }
+
+    void ZoneFeatures::extractFeatures(floatarray &feature, bytearray &image,
+                                       const rectangle &r){
+        for(int i = r.x0; i < r.x1; i++){
+            for(int j = r.y0; j < r.y1; j++){
+                if(image(i,j) != 0 && image(i,j) != 255){
+                    fprintf(stderr,"Binary image expected! ");
+                    fprintf(stderr,"skipping feature extraction...\n");
+                    return ;
+                }
+            }
         }
 
         // RUNNING LENGTHS
-        floatarray rl_stats;
-        horizontalRunLengths(feature,rl_stats,image);
-        verticalRunLengths(feature,rl_stats,image);
-        mainDiagRunLengths(feature,rl_stats,image);
-        sideDiagRunLengths(feature,rl_stats,image);
-
-        for(int index=0; index<rl_stats.length(); index++)
-            feature.push(rl_stats[index]);
+        runLengths(feature,image,r);
 
         // CONNECTED COMPONENTS
-        bytearray in;
-        copy(in, image);
-        invert(in);
+        // (foreground pixels of the zone become non-zero)
+        intarray charimage;
+        charimage.resize(r.x1 - r.x0, r.y1 - r.y0);
+        for(int i = 0; i < charimage.dim(0); i++)
+            for(int j = 0; j < charimage.dim(1); j++)
+                charimage(i,j) = (image(r.x0+i, r.y0+j) == 0);
 
         // Do connected component analysis
-        intarray charimage;
-        copy(charimage,in);
-        label_components(charimage,false);
+        ConnectedComponents components;
+        components.label(charimage);
 
         // Clean non-text and noisy boxes and get character statistics
-        rectarray bboxes,boxes;
-        bounding_boxes(bboxes,charimage);
+        rectarray &bboxes = components.boxes;
+        rectarray boxes;
         for(int i=0, l=bboxes.length(); i<l; i++)
             if(bboxes[i].area())
                 boxes.push(bboxes[i]);
@@ -654,18 +462,13 @@ namespace ocropus {
     }
 
     void LogReg::loadData(){
+        // the weights are used in place; they are compiled in and
+        // never change, so there is nothing to copy
         class_num = log_reg_class_num;
         factor = log_reg_factor;
         offset = log_reg_offset;
         feature_len = log_reg_feature_len;
-        lambda.resize(class_num, feature_len);
-
-        int index = 0;
-        for(int i = 0; i < class_num; i++){
-            for(int j = 0; j < feature_len; j++){
-                lambda(i,j) = log_reg_data[index++];
-            }
-        }
+        lambda = log_reg_data;
     }
 
     zone_class LogReg::classify(floatarray &feature){
@@ -678,7 +481,7 @@ namespace ocropus {
         for(int k = 0; k < class_num; k++){
             sum = 0;
             for(int j = 0; j < feature_len; j++)
-                sum += lambda(k,j) * feature(j);
+                sum += weight(k,j) * feature(j);
             sum = exp(factor * sum + feature_len * offset);
             if (sum > sum_max){
                 sum_max = sum;
@@ -712,7 +515,7 @@ namespace ocropus {
         for(int k = 0; k < class_num; k++){
             sum = 0;
             for(int j = 0; j < feature_len; j++)
-                sum += lambda(k,j) * feature(j);
+                sum += weight(k,j) * feature(j);
             sum = exp(factor * sum + feature_len * offset);
 
             probability[k] = sum;
@@ -724,6 +527,43 @@ namespace ocropus {
 
     }
 
+    void LogReg::getClassProbabilities(floatarray &probability,
+                                       floatarray &features,
+                                       bytearray &valid){
+        int n = features.dim(0);
+        ASSERT(features.dim(1) == feature_len);
+        probability.resize(n, class_num);
+        fill(probability, -1);
+
+        // scores = features * lambda^T, one row per zone
+        floatarray scores(n, class_num);
+        fill(scores, 0);
+        for(int i = 0; i < n; i++){
+            if(!valid[i])
+                continue;
+            for(int k = 0; k < class_num; k++){
+                const float *w = lambda + k * feature_len;
+                float sum = 0;
+                for(int j = 0; j < feature_len; j++)
+                    sum += w[j] * features(i,j);
+                scores(i,k) = sum;
+            }
+        }
+
+        for(int i = 0; i < n; i++){
+            if(!valid[i])
+                continue;
+            float sum_total = 0;
+            for(int k = 0; k < class_num; k++){
+                float sum = exp(factor * scores(i,k) + feature_len * offset);
+                probability(i,k) = sum;
+                sum_total += sum;
+            }
+            for(int k = 0; k < class_num; k++)
+                probability(i,k) /= sum_total;
+        }
+    }
+
     LogReg *make_LogReg() {
         return new LogReg();
     }
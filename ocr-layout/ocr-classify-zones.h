@@ -50,19 +50,17 @@ namespace ocropus {
     struct ZoneFeatures{
 
         void extractFeatures(colib::floatarray &features, colib::bytearray &image);
-
-        void horizontalRunLengths(colib::floatarray &resulthist,
-                                    colib::floatarray &resultstats,
-                                    const colib::bytearray &image);
-        void verticalRunLengths(colib::floatarray &resulthist,
-                                    colib::floatarray &resultstats,
-                                    const colib::bytearray &image);
-        void mainDiagRunLengths(colib::floatarray &resulthist,
-                                    colib::floatarray &resultstats,
-                                    const colib::bytearray &image);
-        void sideDiagRunLengths(colib::floatarray &resulthist,
-                                    colib::floatarray &resultstats,
-                                    const colib::bytearray &image);
+        // features of the zone r of the image, without copying it
+        void extractFeatures(colib::floatarray &features, colib::bytearray &image,
+                             const colib::rectangle &r);
+
+        // The histograms of the horizontal, vertical, main and side
+        // diagonal runs of foreground and background pixels of the
+        // zone, followed by count, mean and variance of each, appended
+        // to features in one pass over the zone.
+        void runLengths(colib::floatarray &features,
+                        const colib::bytearray &image,
+                        const colib::rectangle &r);
 
         void compressHist(colib::intarray &histogram);
         void compress2DHist(colib::intarray &histogram);
@@ -82,12 +80,20 @@ namespace ocropus {
         int   class_num;
         float factor;
         float offset;
-        colib::floatarray lambda;
+        const float *lambda;  // class_num x feature_len, row major
 
         void loadData();
+        float weight(int k, int j) {
+            return lambda[k * feature_len + j];
+        }
         zone_class classify(colib::floatarray &feature);
         void getClassProbabilities(colib::floatarray &prob,
                                    colib::floatarray &feature);
+        // Score all zones of a page at once; features has one row per
+        // zone, rows that aren't valid get probabilities of -1.
+        void getClassProbabilities(colib::floatarray &prob,
+                                   colib::floatarray &features,
+                                   colib::bytearray &valid);
     };
 
     LogReg *make_LogReg();
@@ -72,6 +72,10 @@ namespace ocropus {
         all_params[1] = interval(-max_slope,max_slope);
     }
 
+    void CTextlineRASTBasic::setSlopeRange(double min_slope, double max_slope){
+        all_params[1] = interval(min_slope,max_slope);
+    }
+
     void CTextlineRASTBasic::setMaxYintercept(double ymin, double ymax){
         all_params[0] = interval(ymin,ymax);
     }
@@ -112,6 +112,7 @@ namespace ocropus {
         
         void setDefaultParameters();
         void setMaxSlope(double max_slope);
+        void setSlopeRange(double min_slope, double max_slope);
         void setMaxYintercept(double ymin, double ymax);
         void prepare();
         void makeSubStates(colib::narray<CState> &substates,CState &state);
@@ -42,49 +42,103 @@ namespace ocropus {
         return deskewer->getSkewAngle(in);
     }
 
+    double estimate_skew_by_rast(colib::rectarray &bboxes){
+        autodel<DeskewPageByRAST> deskewer(new DeskewPageByRAST());
+        return deskewer->getSkewAngle(bboxes);
+    }
+
+    // Pick at most n boxes as nbands horizontal bands, one from the middle
+    // of each of nbands equally populated strata of the page.
+    static void sample_bands(rectarray &out, rectarray &boxes, int n, int nbands) {
+        int total = boxes.length();
+        if(total <= n) {
+            copy(out, boxes);
+            return;
+        }
+        intarray index(total);
+        floatarray values(total);
+        for(int i = 0; i<total; i++) {
+            index(i) = i;
+            values(i) = boxes[i].ycenter();
+        }
+        quicksort(index, values);
+        nbands = max(1, min(nbands, n));
+        int per_band = n/nbands;
+        out.clear();
+        for(int b = 0; b<nbands; b++) {
+            int center = int((b+0.5)*total/nbands);
+            int start = max(0, min(total-per_band, center-per_band/2));
+            for(int i = start; i<start+per_band; i++)
+                out.push(boxes[index(i)]);
+        }
+    }
+
     double DeskewPageByRAST::getSkewAngle(bytearray &in) {
         // Binarize if input image is grayscale
-        bytearray binarized;
-        makelike(binarized, in);
-        autodel<IBinarize> binarizer(make_BinarizeBySauvola());
+        intarray charimage;
         if(contains_only(in, byte(0), byte(255))) {
-            copy(binarized, in);
+            copy(charimage, in);
         } else {
+            bytearray binarized;
+            autodel<IBinarize> binarizer(make_BinarizeBySauvola());
             binarizer->binarize(binarized,in);
+            copy(charimage, binarized);
         }
 
         // Do connected component analysis
-        intarray charimage;
-        copy(charimage, binarized);
         make_page_binary_and_black(charimage);
-        label_components(charimage, false);
-        rectarray bboxes;
-        bounding_boxes(bboxes, charimage);
+        ConnectedComponents components;
+        components.label(charimage);
+        rectarray &bboxes = components.boxes;
         return getSkewAngle(bboxes);
     }
 
-    double DeskewPageByRAST::getSkewAngle(rectarray &bboxes) {
-        // Clean non-text and noisy boxes and get character statistics
-        autodel<CharStats> charstats(make_CharStats());
-        charstats->getCharBoxes(bboxes);
+    bool DeskewPageByRAST::findSlope(double &slope, CharStats &stats,
+                                     rectarray &boxes, int n,
+                                     double min_slope, double max_slope,
+                                     double adelta) {
+        autodel<CharStats> charstats(make_CharStats(stats));
+        sample_bands(charstats->char_boxes, boxes, n, nbands);
         charstats->calcCharStats();
-        if(bboxes.length()>max_n)
-            throw "too many character boxes for deskewing";
 
         // Extract textlines
         autodel<CTextlineRAST> ctextline(make_CTextlineRAST());
         narray<TextLine> textlines;
         ctextline->max_results=1;
         ctextline->min_gap = int(charstats->word_spacing*1.5);
-        ctextline->setMaxSlope(0.5);
+        ctextline->setSlopeRange(min_slope, max_slope);
+        ctextline->adelta = adelta;
         ctextline->extract(textlines, charstats);
-        if(textlines.length())
-            return atan(textlines[0].m);
-        else{
+        if(!textlines.length())
+            return false;
+        slope = textlines[0].m;
+        return true;
+    }
+
+    double DeskewPageByRAST::getSkewAngle(rectarray &bboxes) {
+        // Clean non-text and noisy boxes
+        autodel<CharStats> charstats(make_CharStats());
+        charstats->getCharBoxes(bboxes);
+        rectarray char_boxes;
+        char_boxes.move(charstats->char_boxes);
+
+        double slope = 0;
+        bool found;
+        if(char_boxes.length() <= coarse_n) {
+            found = findSlope(slope, *charstats, char_boxes, max_n, -0.5, 0.5, 0.001);
+        } else {
+            found = findSlope(slope, *charstats, char_boxes, coarse_n, -0.5, 0.5, 0.01);
+            double fine;
+            if(found && findSlope(fine, *charstats, char_boxes, max_n,
+                                  slope-fine_range, slope+fine_range, 0.001))
+                slope = fine;
+        }
+        if(!found) {
             fprintf(stderr,"Warning: no textlines found. ");
             fprintf(stderr,"Skipping deskewing ...\n");
             return 0;
         }
+        return atan(slope);
     }
 
     void DeskewPageByRAST::cleanup_gray(bytearray &image, bytearray &in) {
@@ -92,8 +146,15 @@ namespace ocropus {
     }
 
     void DeskewPageByRAST::cleanup(bytearray &image, bytearray &in) {
+        rotate(image, in, (float) getSkewAngle(in));
+    }
+
+    void DeskewPageByRAST::deskew(bytearray &image, bytearray &in, rectarray &bboxes) {
+        rotate(image, in, (float) getSkewAngle(bboxes));
+    }
+
+    void DeskewPageByRAST::rotate(bytearray &image, bytearray &in, float angle) {
         makelike(image, in);
-        float angle = (float) getSkewAngle(in);
         float cx = image.dim(0)/2.0;
         float cy = image.dim(1)/2.0;
         if(contains_only(in, byte(0), byte(255)))
@@ -104,7 +165,6 @@ namespace ocropus {
             fprintf(stderr, "Skew angle found = %.3f degrees\n", angle*RAD_TO_DEG);
             write_png(stdio(debug_deskew, "w"), image);
         }
-
     }
 
     ICleanupBinary *make_DeskewPageByRAST() {
@@ -33,10 +33,25 @@ namespace ocropus {
 
     using namespace colib;
 
-    struct DeskewPageByRAST : virtual ICleanupBinary, virtual ICleanupGray {
+    // The skew is estimated coarse to fine: on dense pages, first from a
+    // sample of character boxes over the full range of slopes, then from
+    // a larger sample over a narrow range around the first estimate.
+    // Samples are horizontal bands spread over the page, so they still
+    // contain whole text lines, and their size bounds the time per page.
+    // Note that pages with coarse_n to max_n boxes, which used to be
+    // searched in a single pass, now take the coarse to fine path;
+    // set coarse_n to max_n to get the single pass back.
+
+    struct DeskewPageByRAST : virtual ICleanupBinary, virtual ICleanupGray, IDeskewWithBoxes {
         p_int max_n;
+        p_int coarse_n;
+        p_int nbands;
+        p_float fine_range;
         DeskewPageByRAST() {
-            max_n.bind(this,"max_n",10000,"maximum number of character boxes for deskewing");
+            max_n.bind(this,"max_n",10000,"maximum number of character boxes used for deskewing");
+            coarse_n.bind(this,"coarse_n",2000,"pages with more character boxes than this are deskewed coarse to fine");
+            nbands.bind(this,"nbands",8,"number of bands character boxes are sampled from");
+            fine_range.bind(this,"fine_range",0.02,"slope range searched around the coarse estimate");
         }
         ~DeskewPageByRAST() {
         }
@@ -61,6 +76,11 @@ namespace ocropus {
         double getSkewAngle(rectarray &bboxes);
         void cleanup_gray(bytearray &image, bytearray &in);
         void cleanup(bytearray &image, bytearray &in);
+        void deskew(bytearray &image, bytearray &in, rectarray &bboxes);
+    private:
+        bool findSlope(double &slope, CharStats &stats, rectarray &boxes,
+                       int n, double min_slope, double max_slope, double adelta);
+        void rotate(bytearray &image, bytearray &in, float angle);
     };
 
 }
@@ -59,11 +59,11 @@ namespace ocropus {
             makelike(charimage,in);
             for(int i=0,l=in.length1d(); i<l; i++)
                 charimage.at1d(i) = !in.at1d(i);
-            label_components(charimage,false);
+            ConnectedComponents components;
+            components.label(charimage);
 
             // Clean non-text and noisy boxes and get character statistics
-            rectarray bboxes;
-            bounding_boxes(bboxes,charimage);
+            rectarray &bboxes = components.boxes;
             ASSERT(bboxes.length()!=0);
 
             // get char stats
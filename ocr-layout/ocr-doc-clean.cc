@@ -68,11 +68,11 @@ namespace ocropus {
             copy(result_bf_inverted,result_bf);
             make_page_binary_and_black(result_bf_inverted);
             copy(charimage,result_bf_inverted);
-            label_components(charimage,false);
+            ConnectedComponents components;
+            components.label(charimage);
 
             // Clean noisy boxes
-            rectarray bboxes;
-            bounding_boxes(bboxes,charimage);
+            rectarray &bboxes = components.boxes;
             noisefilter->ccanalysis(result_cc,result_bf,bboxes);
 
             //run whitefilter on output of connected component analysis result
@@ -49,6 +49,7 @@
 #include "ocr-doc-clean-concomp.h"
 #include "ocr-pageframe-rast.h"
 
+#include "ocr-projections.h"
 #include "ocr-pageseg-wcuts.h"
 #include "ocr-pageseg-xycut.h"
 #include "ocr-word-segmentation.h"
@@ -58,47 +58,43 @@ namespace ocropus {
                                             bool need_visualization,
                                             rectarray &extra_obstacles) {
 
-        // FIXME/faisal remove this dead code --tmb
-        float startTime = clock()/float(CLOCKS_PER_SEC);
+        // wall clock, since clock() adds up the time of all threads
+        double start_time = now();
         const int zero   = 0;
         const int yellow = ocropus::IMAGE_COLOR; /* 0x00ff0000;*/ //0x00ffff00;
         bytearray in;
         copy(in, in_not_inverted);
         make_page_binary_and_black(in);
-        fprintf(stdout,"Time elapsed (autoinvert): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
-        float timeUsed = (clock()/float(CLOCKS_PER_SEC)) - startTime;
-        cout << "Time elapsed " << timeUsed << endl;
-
-        debugf("info","Time elapsed = %.3f \n",timeUsed);
+        debugf("timing","rast autoinvert %.3f\n",now()-start_time);
 
         // Do connected component analysis
         intarray charimage;
         copy(charimage,in);
-        label_components(charimage,false);
-        //fprintf(stderr,"Time elapsed (label_components): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
+        ConnectedComponents components;
+        components.label(charimage);
+        //debugf("timing","rast label_components %.3f\n",now()-start_time);
 
         // Clean non-text and noisy boxes and get character statistics
-        rectarray bboxes;
-        bounding_boxes(bboxes,charimage);
+        rectarray &bboxes = components.boxes;
         if(bboxes.length()==0){
             makelike(image,in);
             fill(image,0x00ffffff);
             return ;
         }
-        //fprintf(stderr,"Time elapsed (bounding_boxes): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
+        //debugf("timing","rast bounding_boxes %.3f\n",now()-start_time);
         autodel<CharStats> charstats(make_CharStats());
         charstats->getCharBoxes(bboxes);
         charstats->calcCharStats();
         if(debug_layout>=2){
             charstats->print();
         }
-        fprintf(stderr,"Time elapsed (charstats): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
+        debugf("timing","rast charstats %.3f\n",now()-start_time);
 
         // Compute Whitespace Cover
         autodel<WhitespaceCover> whitespaces(make_WhitespaceCover(0,0,in.dim(0),in.dim(1)));
         rectarray whitespaceboxes;
         whitespaces->compute(whitespaceboxes,charstats->char_boxes);
-        fprintf(stderr,"Time elapsed (whitespaces): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
+        debugf("timing","rast whitespaces %.3f\n",now()-start_time);
 
         // Find whitespace column separators (gutters)
         autodel<ColSeparators> whitespace_obstacles(make_ColSeparators());
@@ -130,7 +126,7 @@ namespace ocropus {
             textline_obstacles.push(extra_obstacles[i]);
         for(int i=0;i<vert_rulings.length();i++)
             textline_obstacles.push(vert_rulings[i]);
-        fprintf(stderr,"Time elapsed (gutters): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
+        debugf("timing","rast gutters %.3f\n",now()-start_time);
 
         // Extract textlines
         narray<TextLine> textlines;
@@ -168,7 +164,7 @@ namespace ocropus {
         autodel<ReadingOrderByTopologicalSort>
             reading_order(make_ReadingOrderByTopologicalSort());
         reading_order->sortTextlines(textlines,gutters,hor_rulings,vert_rulings,*charstats);
-        //fprintf(stderr,"Time elapsed (ctextline): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
+        //debugf("timing","rast ctextline %.3f\n",now()-start_time);
 
         rectarray textcolumns;
         rectarray paragraphs;
@@ -210,7 +206,7 @@ namespace ocropus {
         color_encoding->encode();
         copy(image,color_encoding->outputImage);
 
-        //fprintf(stderr,"Time elapsed (find-columns): %.3f \n",(clock()/float(CLOCKS_PER_SEC)) - startTime);
+        //debugf("timing","rast find-columns %.3f\n",now()-start_time);
         if(debug_layout){
             for(int i=0; i<textlines.length();i++)
                 textlines[i].print();
@@ -69,10 +69,10 @@ namespace ocropus {
 
             intarray charimage;
             copy(charimage,in);
-            label_components(charimage,false);
+            ConnectedComponents components;
+            components.label(charimage);
 
-            rectarray bboxes;
-            bounding_boxes(bboxes,charimage);
+            rectarray &bboxes = components.boxes;
             if(bboxes.length()==0){
                 makelike(image,in);
                 fill(image,0x00ffffff);
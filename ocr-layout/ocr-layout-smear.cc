@@ -56,8 +56,11 @@ struct SegmentPageByMorphTrivial : ISegmentPage {
         copy(temp,in);
         invert(temp);
         copy(image,temp);
-        binary_open_rect(temp,cwidth,cheight);
-        binary_close_rect(temp,swidth,sheight);
+        BitImage bits;
+        bits_pack(bits,temp);
+        bits_open_rect(bits,cwidth,cheight);
+        bits_close_rect(bits,swidth,sheight);
+        bits_unpack(temp,bits);
         intarray labels;
         copy(labels,temp);
         label_components(labels,false);
@@ -38,8 +38,18 @@ namespace ocropus {
     ICleanupBinary *make_DeskewPageByRAST();
     ICleanupGray *make_DeskewGrayPageByRAST();
 
-    // Get skew angle of the page using RAST
+    // Get skew angle of the page using RAST, either from the page
+    // image or from the bounding boxes of its connected components
+    // (box 0 being the whole page, as bounding_boxes returns them)
     double estimate_skew_by_rast(bytearray &in);
+    double estimate_skew_by_rast(rectarray &bboxes);
+
+    // Deskewers that can use the connected components of a page that
+    // the caller has already binarized and labeled
+    struct IDeskewWithBoxes {
+        virtual ~IDeskewWithBoxes() {}
+        virtual void deskew(bytearray &out,bytearray &in,rectarray &bboxes) = 0;
+    };
 
     // Text/Image segmentation
     ICleanupBinary *make_RemoveImageRegionsBinary();
@@ -29,6 +29,83 @@
 
 using namespace ocropus;
 using namespace colib;
+
+namespace {
+    // Images are stored column by column, so the filters below split
+    // the page into strips of columns; each strip is scanned by one
+    // thread and the per-strip counts are merged afterwards. The
+    // filters only need these counts, no morphology, so the page isn't
+    // packed into a BitImage: packing would read every pixel once, just
+    // as counting does.
+    enum { tile_width = 64 };
+
+    // sums(x) is the number of black pixels in columns 0..x-1
+    void column_sums(intarray &sums,bytearray &image) {
+        int w = image.dim(0), h = image.dim(1);
+        intarray counts(w);
+#pragma omp parallel for schedule(static)
+        for(int x=0;x<w;x++) {
+            int n = 0;
+            for(int y=0;y<h;y++)
+                if(image(x,y)==black) n++;
+            counts(x) = n;
+        }
+        sums.resize(w+1);
+        sums(0) = 0;
+        for(int x=0;x<w;x++)
+            sums(x+1) = sums(x)+counts(x);
+    }
+
+    // sums(y) is the number of black pixels in rows 0..y-1 between
+    // columns x0 and x1 (inclusive)
+    void row_sums(intarray &sums,bytearray &image,int x0,int x1) {
+        int h = image.dim(1);
+        int ntiles = max(0,(x1-x0+1+tile_width-1)/tile_width);
+        intarray counts(max(ntiles,1),h);
+        fill(counts,0);
+#pragma omp parallel for schedule(dynamic,1)
+        for(int t=0;t<ntiles;t++) {
+            int tx0 = x0+t*tile_width;
+            int tx1 = min(tx0+tile_width-1,x1);
+            for(int x=tx0;x<=tx1;x++)
+                for(int y=0;y<h;y++)
+                    if(image(x,y)==black) counts(t,y)++;
+        }
+        sums.resize(h+1);
+        sums(0) = 0;
+        for(int y=0;y<h;y++) {
+            int n = 0;
+            for(int t=0;t<ntiles;t++) n += counts(t,y);
+            sums(y+1) = sums(y)+n;
+        }
+    }
+
+    // same as NoiseFilter::blackRatio, for a window lo..hi (inclusive)
+    // of the running sums, each entry of which covers size pixels
+    float window_ratio(intarray &sums,int lo,int hi,int size) {
+        int blackpixels = sums(hi+1)-sums(lo);
+        int total = (hi-lo+1) * size;
+        return (float)blackpixels/(float)total;
+    }
+
+    // same as NoiseFilter::remove for each region; note that the
+    // region coordinates are inclusive, as for remove
+    void remove_all(bytearray &image,rectarray &regions) {
+        int ntiles = (image.dim(0)+tile_width-1)/tile_width;
+#pragma omp parallel for schedule(dynamic,1)
+        for(int t=0;t<ntiles;t++) {
+            int tx0 = t*tile_width;
+            int tx1 = min(tx0+tile_width-1,image.dim(0)-1);
+            for(int i=0;i<regions.length();i++) {
+                rectangle &r = regions(i);
+                for(int x=max(r.x0,tx0);x<=min(r.x1,tx1);x++)
+                    for(int y=r.y0;y<=r.y1;y++)
+                        if(image(x,y)==black) image(x,y) = white;
+            }
+        }
+    }
+}
+
 namespace ocropus {
 
 
@@ -67,6 +144,7 @@ namespace ocropus {
 
         int white = 0xff;
         int black = 0x00;
+#pragma omp parallel for schedule(static)
         for (int i=x0 ; i<=x1 ;i++) {
             for (int j=y0; j<=y1 ;j++) {
                 if(image(i,j)==black){image(i,j)=white;}
@@ -77,9 +155,7 @@ namespace ocropus {
     void NoiseFilter::blackFilter(bytearray &out , bytearray &original,
                                   float threshold, int xstep, int ystep,
                                   int xwidth, int yheight){
-        bytearray in,in_removable;
-        copy(in_removable,original);
-        copy(in,original);
+        bytearray &in = original;
         int ximage=in.dim(0);
         int yimage=in.dim(1);
         int left;
@@ -89,6 +165,11 @@ namespace ocropus {
         int leftr=0;
         int rightr=ximage-1;
         float blackratio=0.0;
+        // all the decisions are made on the input image; the regions
+        // to be removed are collected and painted at the end
+        rectarray removed;
+        intarray sums;
+        column_sums(sums,in);
         //scan the left border first
         int start = (int) ximage/3;
         right=start;
@@ -96,9 +177,9 @@ namespace ocropus {
         top=yimage-1;
         left=start-xwidth+1;
         while(left>=0) {
-            blackratio=blackRatio(left,bottom,right,top,in);
+            blackratio=window_ratio(sums,left,right,yimage);
             if(blackratio>threshold) {
-                remove(0,0,right,top,in_removable);
+                removed.push(rectangle(0,0,right,top));
                 leftr=right;
                 break;
             }
@@ -112,15 +193,16 @@ namespace ocropus {
         top=yimage-1;
         right=start+xwidth-1;
         while(right<ximage) {
-            blackratio=blackRatio(left,bottom,right,top,in);
+            blackratio=window_ratio(sums,left,right,yimage);
             if(blackratio>threshold) {
-                remove(left,bottom,ximage-1,top,in_removable);
+                removed.push(rectangle(left,bottom,ximage-1,top));
                 rightr=left;
                 break;
             }
             right=right+xstep;
             left=left+xstep;
         }
+        row_sums(sums,in,leftr,rightr);
         //scan the top border now
         start = (int) (yimage*24)/25;
         left=leftr;
@@ -128,9 +210,9 @@ namespace ocropus {
         bottom=start;
         top=start+yheight-1;
         while(top<yimage) {
-            blackratio=blackRatio(left,bottom,right,top,in);
+            blackratio=window_ratio(sums,bottom,top,right-left+1);
             if(blackratio>threshold){
-                remove(0,bottom,ximage-1,yimage-1,in_removable);
+                removed.push(rectangle(0,bottom,ximage-1,yimage-1));
                 break;
             }
             top=top+ystep;
@@ -143,15 +225,16 @@ namespace ocropus {
         top=start;
         bottom=start-yheight+1;
         while(bottom>=0){
-            blackratio=blackRatio(left,bottom,right,top,in);
+            blackratio=window_ratio(sums,bottom,top,right-left+1);
             if(blackratio>threshold){
-                remove(0,0,ximage-1,top,in_removable);
+                removed.push(rectangle(0,0,ximage-1,top));
                 break;
             }
             top=top-ystep;
             bottom=bottom-ystep;
         }
-        copy(out,in_removable);
+        copy(out,original);
+        remove_all(out,removed);
     }
 
 
@@ -162,9 +245,7 @@ namespace ocropus {
     void NoiseFilter::whiteFilter(bytearray &out,bytearray &original,
                                   float threshold, int xstep, int ystep,
                                   int xwidth, int yheight) {
-        bytearray in,in_removable;
-        copy(in,original);
-        copy(in_removable,original);
+        bytearray &in = original;
         int ximage=in.dim(0);
         int yimage=in.dim(1);
         int left;
@@ -174,6 +255,9 @@ namespace ocropus {
         int leftr=0;
         int rightr=ximage-1;
         float whiteratio;
+        rectarray removed;
+        intarray sums;
+        column_sums(sums,in);
         //scanning the left border first
         int start= (int) ximage/5;
         right=start;
@@ -181,9 +265,9 @@ namespace ocropus {
         top=yimage-1;
         left=start-xwidth+1;
         while(left>=0){
-            whiteratio=whiteRatio(left,bottom,right,top,in);
+            whiteratio=(1.0-window_ratio(sums,left,right,yimage));
             if(whiteratio>threshold){
-                remove(0,0,right-xwidth+1,top,in_removable);
+                removed.push(rectangle(0,0,right-xwidth+1,top));
                 leftr=right;
                 //printf("removed left %g\n",whiteratio);
                 break;
@@ -198,9 +282,9 @@ namespace ocropus {
         top=yimage-1;
         right=start+xwidth-1;
         while(right<ximage) {
-            whiteratio=whiteRatio(left,bottom,right,top,in);
+            whiteratio=(1.0-window_ratio(sums,left,right,yimage));
             if(whiteratio>threshold) {
-                remove(left+xwidth-1,bottom,ximage-1,top,in_removable);
+                removed.push(rectangle(left+xwidth-1,bottom,ximage-1,top));
                 rightr=left;
                 //printf("removed right %g\n",whiteratio);
                 break;
@@ -208,6 +292,7 @@ namespace ocropus {
             right=right+xstep;
             left=left+xstep;
         }
+        row_sums(sums,in,leftr,rightr);
         //scan the top border now
         start = (int) (yimage*24)/25;
         left=leftr;
@@ -215,9 +300,9 @@ namespace ocropus {
         bottom=start;
         top=start+yheight-1;
         while(top<yimage) {
-            whiteratio=whiteRatio(left,bottom,right,top,in);
+            whiteratio=(1.0-window_ratio(sums,bottom,top,right-left+1));
             if(whiteratio>threshold){
-                remove(0,bottom+yheight-1,ximage-1,yimage-1,in_removable);
+                removed.push(rectangle(0,bottom+yheight-1,ximage-1,yimage-1));
                 break;
             }
             top=top+ystep;
@@ -230,16 +315,17 @@ namespace ocropus {
         top=start;
         bottom=start-yheight+1;
         while(bottom>=0){
-            whiteratio=whiteRatio(left,bottom,right,top,in);
+            whiteratio=(1.0-window_ratio(sums,bottom,top,right-left+1));
             if(whiteratio>threshold){
-                remove(0,0,ximage-1,top-yheight+1,in_removable);
+                removed.push(rectangle(0,0,ximage-1,top-yheight+1));
                 //printf("removed bottom %g\n",whiteratio);
                 break;
             }
             top=top-ystep;
             bottom=bottom-ystep;
         }
-        copy(out,in_removable);
+        copy(out,original);
+        remove_all(out,removed);
     }
 
     void NoiseFilter::ccanalysis(bytearray &out,bytearray &in,rectarray &bboxes){
@@ -247,6 +333,7 @@ namespace ocropus {
         //max_height = (int) (2*in.dim(1)/3.0);
         max_width = in.dim(0);
         max_height = in.dim(1);
+        rectarray kept;
         for(int i=0; i<bboxes.length(); i++){
             if(bboxes(i).width()  >= max_width)  continue;
             if(bboxes(i).height() >= max_height) continue;
@@ -254,10 +341,24 @@ namespace ocropus {
             if(bboxes(i).y0 < border_margin )    continue;
             if(bboxes(i).x1 > in.dim(0) - border_margin )   continue;
             if(bboxes(i).y1 > in.dim(1) - border_margin )   continue;
+            kept.push(bboxes(i));
+        }
 
-            for(int y=bboxes(i).y0; y<bboxes(i).y1; y++){
-                for(int x=bboxes(i).x0; x<bboxes(i).x1; x++){
-                    out(x,y) = in(x,y);
+        // boxes overlap, so each strip of columns copies its own
+        // part of every box
+        int ntiles = (in.dim(0)+tile_width-1)/tile_width;
+#pragma omp parallel for schedule(dynamic,1)
+        for(int t=0; t<ntiles; t++){
+            int tx0 = t*tile_width;
+            int tx1 = min(tx0+tile_width,in.dim(0));
+            for(int i=0; i<kept.length(); i++){
+                rectangle &b = kept(i);
+                int x0 = max(b.x0,tx0);
+                int x1 = min(b.x1,tx1);
+                for(int x=x0; x<x1; x++){
+                    for(int y=b.y0; y<b.y1; y++){
+                        out(x,y) = in(x,y);
+                    }
                 }
             }
         }
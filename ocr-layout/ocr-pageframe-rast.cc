@@ -272,7 +272,8 @@ namespace ocropus {
         segmenter->segment(lineimage,in);
         //replace_values(lineimage,0x00ffff00,0x00ffffff);
         int N_MAX_COLUMNS = 32; // defined by color coding convention
-        for(int i=0,l=lineimage.length1d(); i<l; i++){
+#pragma omp parallel for schedule(static)
+        for(int i=0; i<lineimage.length1d(); i++){
             // Red channel represents column index
             int red_value = lineimage.at1d(i) >> 16;
             if (red_value > N_MAX_COLUMNS )
@@ -375,17 +376,26 @@ namespace ocropus {
                              bytearray &in,
                              rectangle &pageframe){
         makelike(out,in);
-        fill(out,255);
         rectangle imagedim = rectangle(0,0,in.dim(0),in.dim(1));
-        if(imagedim.contains(pageframe.x0,pageframe.y0) &&
-           imagedim.contains(pageframe.x1-1,pageframe.y1-1)){
-            for(int x=pageframe.x0;x<pageframe.x1;x++)
-                for(int y=pageframe.y0;y<pageframe.y1;y++)
-                    if(!in(x,y))
-                        out(x,y)=in(x,y);
-        }else{
+        bool inside = imagedim.contains(pageframe.x0,pageframe.y0) &&
+            imagedim.contains(pageframe.x1-1,pageframe.y1-1);
+        if(!inside){
+            fill(out,255);
             fprintf(stderr,"Error: page frame exceeds image dimensions.\n");
             pageframe.println(stderr);
+            return;
+        }
+        // clear and copy in one pass over the columns, in parallel
+        int h = in.dim(1);
+#pragma omp parallel for schedule(static)
+        for(int x=0;x<in.dim(0);x++) {
+            bool xin = (x>=pageframe.x0 && x<pageframe.x1);
+            for(int y=0;y<h;y++) {
+                if(xin && y>=pageframe.y0 && y<pageframe.y1 && !in(x,y))
+                    out(x,y) = 0;
+                else
+                    out(x,y) = 255;
+            }
         }
     }
 
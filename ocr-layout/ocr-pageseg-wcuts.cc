@@ -332,11 +332,11 @@ namespace ocropus {
         // Do connected component analysis
         intarray charimage;
         copy(charimage,in);
-        label_components(charimage,false);
+        ConnectedComponents components;
+        components.label(charimage);
 
         // Clean non-text and noisy boxes and get character statistics
-        rectarray bboxes;
-        bounding_boxes(bboxes,charimage);
+        rectarray &bboxes = components.boxes;
         if(bboxes.length()<=1){
             makelike(image,in);
             fill(image,0x00ffffff);
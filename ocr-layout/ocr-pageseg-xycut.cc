@@ -38,69 +38,6 @@ namespace ocropus {
     param_int debug_xycut_intermediate("debug",0,"print intermediate results"
         "to stdout");
     
-    // compute integral image for BINARY images
-    static void compute_integral_image(bytearray& img, 
-                                       intarray& int_img_hor, 
-                                       intarray& int_img_ver){
-        int_img_ver.resize(img.dim(0), img.dim(1)) ;
-        int_img_hor.resize(img.dim(0), img.dim(1)) ;
-        for (int x = 0; x < int_img_ver.dim(0); x++) {
-            for (int y = 0; y < int_img_ver.dim(1); y++) {
-                int_img_ver(x,y) = 0 ;
-                int_img_hor(x,y) = 0 ;
-            }
-        }
-        for (int x = 0; x < int_img_ver.dim(0); x++) {
-            int count = 0 ;
-            for (int y = 0; y < int_img_ver.dim(1); y++) {
-                if (img(x,y) == 0) {
-                    count++ ;
-                }
-                int_img_ver(x,y) = count ;
-            }
-        }
-        
-        for (int y = 0; y < int_img_hor.dim(1); y++) {
-            int count = 0 ;
-            for (int x = 0; x < int_img_hor.dim(0); x++) {
-                if (img(x,y) == 0) {
-                    count++ ;
-                }
-                int_img_hor(x,y) = count ;
-            }
-        }
-    }
-
-    // Compute horizontal and vertical projection profiles for a given rectangle
-    // r out of integral image
-    static void get_projection_profiles(intarray& proj_on_yaxis, 
-                                        intarray& proj_on_xaxis,
-                                        rectangle& r, 
-                                        intarray& int_img_hor, 
-                                        intarray& int_img_ver) {
-        // Mao. Fig.3. 2.a)
-        proj_on_yaxis.resize((int)r.y1 - (int)r.y0) ;
-        fill(proj_on_yaxis,0);
-
-        proj_on_xaxis.resize((int)r.x1 - (int)r.x0) ;
-        fill(proj_on_xaxis,0);
-
-        // JvB: y<= (int)...: all pixels inside the rectangle have to be included.
-        for (int y = (int)r.y0; y < (int)r.y1; y++){
-            int m=0;
-            if(r.x0-1>=0)
-                m=int_img_hor((int)r.x0-1, y);
-            proj_on_yaxis(y - (int)r.y0) = int_img_hor((int)r.x1-1, y) - m;
-        }
-        for (int x = (int)r.x0; x < (int)r.x1; x++){
-            int m=0;
-            if(r.y0-1>=0)
-                m=int_img_ver(x,(int)r.y0-1);
-            proj_on_xaxis(x - (int)r.x0) = int_img_ver(x, (int)r.y1-1) - m;
-        }
-    }
-
-
     // shrink to the bounding boy of all the black pixels in the rectangle and
     // remove noise
     static void shrink_and_clean(rectangle& r, 
@@ -213,114 +150,79 @@ namespace ocropus {
         }
     }
     
-    static void insertRectToTree(int index, 
-                                 rectarray& tree, 
-                                 rectangle rL, 
-                                 rectangle rR) {
-        int left = index * 2 + 1 ;
-        int right = index * 2 + 2 ;
-        while (right+1 > tree.length()) // increased size of tree if necessary
-            tree.push(rectangle(-1, -1, -1, -1)) ;
-        tree[left] = rL ;
-        tree[right] = rR ;
-    }
-
+    // Mao, Fig.3: Step 2.  The cut tree is processed breadth first
+    // from a work list; only the leaves are kept, in the order in which
+    // they are found.
     static void xycut(rectarray& blocks, 
-                      rectarray& tree, 
-                      intarray& int_img_hor,
-                      intarray& int_img_ver, 
+                      PageProjections& projections,
                       int tnx, int tny, int tcx, int tcy) {
         // arrays to save the projection profile
         intarray proj_on_yaxis ; // his_x
         intarray proj_on_xaxis ; // his_y
         
-        // Mao. Fig.3. 2.0)
-        // adding whole page as root node
-        rectangle page = rectangle(0, 0, int_img_ver.dim(0),
-                        int_img_ver.dim(1)) ;
-        tree.push(page) ; // push root rectangle to tree
-        
-        // compute factor that is needed for noise removal
-        if (int_img_hor.dim(0) <= 0 || 
-            int_img_ver.dim(1) <= 0 || 
-            int_img_hor.length1d() != int_img_ver.length1d()) {
+        if (projections.w <= 0 || projections.h <= 0) {
             fprintf(stderr, "ocr-pageseg-xycut: xycut: Error in image dim!\n");
-			return;
-            //exit(0) ;
+            return;
         }
-        double factor_tnx = (double)tnx / (double)int_img_hor.dim(1) ;
-        double factor_tny = (double)tny / (double)int_img_ver.dim(0) ;
-        
-        int i = 0 ;
-        rectangle r = tree.at(0) ;
-        while (i < tree.length()) {
-            // take node in queue and process it
-            
-            if (tree[i].x0 >= 0 
-                && tree[i].y0 >= 0 
-                && tree[i].x1 >= 0 
-                && tree[i].y1 >= 0) {
-                // compute projection profile
-                get_projection_profiles(proj_on_yaxis, proj_on_xaxis, 
-                                        r, int_img_hor, int_img_ver) ;
-                
-                
+        // compute factor that is needed for noise removal
+        double factor_tnx = (double)tnx / (double)projections.h ;
+        double factor_tny = (double)tny / (double)projections.w ;
+
+        // Mao. Fig.3. 2.0)
+        // adding whole page as root node
+        rectarray work;
+        work.push(rectangle(0, 0, projections.w, projections.h)) ;
+        for (int i = 0; i < work.length(); i++) {
+            rectangle r = work[i] ;
+            // compute projection profile
+            projections.row_profile(proj_on_yaxis, r) ;
+            projections.column_profile(proj_on_xaxis, r) ;
+
             // Mao. Fig.3. 2.b) & 2.c)
             // save old starting points of rectangle, before shrinking
-                int old_x0 = (int)r.x0 ;
-                int old_y0 = (int)r.y0 ;
+            int old_x0 = (int)r.x0 ;
+            int old_y0 = (int)r.y0 ;
             // remove noise and shrink to effectively used area
-                shrink_and_clean(r, proj_on_yaxis, proj_on_xaxis, factor_tnx, factor_tny);
+            shrink_and_clean(r, proj_on_yaxis, proj_on_xaxis, factor_tnx, factor_tny);
             // changes the values of r!!!
-        
+
             // Mao. Fig.3. 2.d)
-//                 int dir = -1 ;
-                int cut_pos_y = -1 ;
-                int gap_y = -1 ;
-                int cut_pos_x = -1 ;
-                int gap_x = -1 ;
+            int cut_pos_y = -1 ;
+            int gap_y = -1 ;
+            int cut_pos_x = -1 ;
+            int gap_x = -1 ;
 
-                
             // find widest gap and its middle and the direction of the cut to be
             // done (0 = hor, 1 = ver)
-                get_widest_gap(cut_pos_y, gap_y, 
-                               cut_pos_x, gap_x, 
-                               proj_on_yaxis, proj_on_xaxis) ;
-            
-                // split in the right direction
-                if (gap_y >= gap_x && gap_y > tcy) {
-                    rectangle rB, rT ; // rectangleTop rectangleBottom
-                    split_rect(rB, rT, r, HORIZONTAL_CUT, old_y0 + cut_pos_y) ;
-                    insertRectToTree(i, tree, rB, rT) ;
-                }
-                else if (gap_y >= gap_x && gap_y <= tcy && gap_x > tcx) {
-                    rectangle rL, rR ; // rectangleTop rectangleBottom
-                    split_rect(rL, rR, r, VERTICAL_CUT, old_x0 + cut_pos_x) ;
-                    insertRectToTree(i, tree, rL, rR) ;
-                }
-                else if (gap_x > gap_y && gap_x > tcx) {
-                    rectangle rL, rR ; // rectangleTop rectangleBottom
-                    split_rect(rL, rR, r, VERTICAL_CUT, old_x0 + cut_pos_x) ;
-                    insertRectToTree(i, tree, rL, rR) ;
-                }
-                else if (gap_x > gap_y && gap_x <= tcx && gap_y > tcy) {
-                    rectangle rL, rR ; // rectangleTop rectangleBottom
-                    split_rect(rL, rR, r, HORIZONTAL_CUT, old_y0 + cut_pos_y) ;
-                    insertRectToTree(i, tree, rL, rR) ;
-                }
-                
-                else {
-                //insert dummy rects
-                    rectangle rL = rectangle(-1, -1, -1, -1) ;
-                    rectangle rR = rectangle(-1, -1, -1, -1) ;
+            get_widest_gap(cut_pos_y, gap_y, 
+                           cut_pos_x, gap_x, 
+                           proj_on_yaxis, proj_on_xaxis) ;
+
+            // split in the right direction
+            int dir = -1, pos = -1 ;
+            if (gap_y >= gap_x && gap_y > tcy) {
+                dir = HORIZONTAL_CUT ; pos = old_y0 + cut_pos_y ;
+            }
+            else if (gap_y >= gap_x && gap_y <= tcy && gap_x > tcx) {
+                dir = VERTICAL_CUT ; pos = old_x0 + cut_pos_x ;
+            }
+            else if (gap_x > gap_y && gap_x > tcx) {
+                dir = VERTICAL_CUT ; pos = old_x0 + cut_pos_x ;
+            }
+            else if (gap_x > gap_y && gap_x <= tcx && gap_y > tcy) {
+                dir = HORIZONTAL_CUT ; pos = old_y0 + cut_pos_y ;
+            }
+
+            if (dir >= 0) {
+                rectangle r1, r2 ;
+                split_rect(r1, r2, r, dir, pos) ;
+                work.push(r1) ;
+                work.push(r2) ;
+            }
+            else {
                 // insert leaf rect to result blocks
-                    rectangle ret_rect = rectangle(r.x0, r.y0, r.x1, r.y1) ;
-                    blocks.push(ret_rect) ;
-                }
+                blocks.push(r) ;
             }
-            i++ ;
-            if(i<tree.length())
-                r = tree[i] ;
         }
     }
 
@@ -377,15 +279,12 @@ namespace ocropus {
         }
         
         // Mao, Fig.3: Step 1.
-        intarray int_img_hor ;
-        intarray int_img_ver ;
-        compute_integral_image(in, int_img_hor, int_img_ver) ;
-        
+        PageProjections projections;
+        projections.compute(in);
+
         // Mao, Fig.3: Step 2.
         rectarray blocks ;
-        rectarray tree ;
-        
-        xycut(blocks, tree, int_img_hor, int_img_ver, tnx, tny, tcx, tcy) ;
+        xycut(blocks, projections, tnx, tny, tcx, tcy) ;
         
         int cflen = blocks.length();
         
@@ -395,14 +294,7 @@ namespace ocropus {
             // Do a logical OR of zone index with R=1 to assign all
             // zones to the first column
             int color = (i+1)|(0x00010000);
-            rectangle r = blocks[i];
-
-            for(int x=r.x0; x<r.x1; x++){
-                for(int y=r.y0; y<r.y1; y++){
-                    if(in(x,y) == 0)
-                        image(x,y) = color ;
-                }
-            }
+            projections.paint(image, blocks[i], color);
         }
         if(debug_xycut_intermediate){
             for (int i = 0; i < blocks.length(); i++) {
@@ -410,8 +302,8 @@ namespace ocropus {
                         blocks[i].x0, blocks[i].y0, blocks[i].x1, blocks[i].y1);
             }
             write_image_packed("xycuts-cuts.png",image);
-            write_image_packed("xycuts-inthor.png",int_img_hor);
-            write_image_packed("xycuts-intver.png",int_img_ver);
+            write_image_packed("xycuts-inthor.png",projections.row_prefix);
+            write_image_packed("xycuts-intver.png",projections.column_prefix);
         }
     }
 
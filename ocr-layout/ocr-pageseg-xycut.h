@@ -32,6 +32,7 @@
 
 #include "ocropus.h"
 #include "ocr-layout.h"
+#include "ocr-projections.h"
 
 namespace ocropus {
 
@@ -0,0 +1,122 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: OCRopus
+// File: ocr-projections.cc
+// Purpose: projection profiles and block painting for page segmenters
+// Responsible: Joost van Beusekom (joost@iupr.net)
+// Reviewer: Faisal Shafait (faisal.shafait@dfki.de)
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#include "ocropus.h"
+#include "ocr-layout-internal.h"
+
+using namespace colib;
+
+namespace ocropus {
+
+    void PageProjections::compute(bytearray &image) {
+        w = image.dim(0);
+        h = image.dim(1);
+        row_prefix.resize(w+1,h);
+        column_prefix.resize(w,h+1);
+        run_offsets.resize(w+1);
+        intarray nruns(w);
+
+        // columns are independent; count the runs on the way
+#pragma omp parallel for schedule(static)
+        for(int x=0;x<w;x++) {
+            int count = 0, n = 0;
+            bool inside = false;
+            column_prefix(x,0) = 0;
+            for(int y=0;y<h;y++) {
+                bool black = image(x,y)==0;
+                if(black) count++;
+                if(black && !inside) n++;
+                inside = black;
+                column_prefix(x,y+1) = count;
+            }
+            nruns(x) = n;
+        }
+
+        // rows accumulate across columns, so split the page into
+        // horizontal strips instead
+        const int strip = 64;
+        int nstrips = (h+strip-1)/strip;
+#pragma omp parallel for schedule(static)
+        for(int s=0;s<nstrips;s++) {
+            int y0 = s*strip, y1 = min(h,y0+strip);
+            for(int y=y0;y<y1;y++)
+                row_prefix(0,y) = 0;
+            for(int x=0;x<w;x++)
+                for(int y=y0;y<y1;y++)
+                    row_prefix(x+1,y) = row_prefix(x,y) + (image(x,y)==0);
+        }
+
+        run_offsets(0) = 0;
+        for(int x=0;x<w;x++)
+            run_offsets(x+1) = run_offsets(x) + nruns(x);
+        runs.resize(2*run_offsets(w));
+#pragma omp parallel for schedule(static)
+        for(int x=0;x<w;x++) {
+            int k = 2*run_offsets(x);
+            int y = 0;
+            while(y<h) {
+                if(image(x,y)!=0) {
+                    y++;
+                    continue;
+                }
+                runs(k++) = y;
+                while(y<h && image(x,y)==0) y++;
+                runs(k++) = y;
+            }
+        }
+    }
+
+    void PageProjections::row_profile(intarray &profile,rectangle r) {
+        profile.resize(r.y1-r.y0);
+        for(int y=r.y0;y<r.y1;y++)
+            profile(y-r.y0) = row_count(y,r.x0,r.x1);
+    }
+
+    void PageProjections::column_profile(intarray &profile,rectangle r) {
+        profile.resize(r.x1-r.x0);
+        for(int x=r.x0;x<r.x1;x++)
+            profile(x-r.x0) = column_count(x,r.y0,r.y1);
+    }
+
+    void PageProjections::paint(intarray &image,rectangle r,int value) {
+        int x0 = max(r.x0,0), x1 = min(r.x1,w);
+        int y0 = max(r.y0,0), y1 = min(r.y1,h);
+        for(int x=x0;x<x1;x++) {
+            // first run of the column that ends below y0
+            int lo = run_offsets(x), hi = run_offsets(x+1);
+            while(lo<hi) {
+                int mid = (lo+hi)/2;
+                if(runs(2*mid+1)<=y0) lo = mid+1;
+                else hi = mid;
+            }
+            for(int k=lo;k<run_offsets(x+1) && runs(2*k)<y1;k++) {
+                int start = max(runs(2*k),y0), end = min(runs(2*k+1),y1);
+                for(int y=start;y<end;y++)
+                    image(x,y) = value;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,75 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: OCRopus
+// File: ocr-projections.h
+// Purpose: projection profiles and block painting for page segmenters
+// Responsible: Joost van Beusekom (joost@iupr.net)
+// Reviewer: Faisal Shafait (faisal.shafait@dfki.de)
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#ifndef h_ocrprojections__
+#define h_ocrprojections__
+
+#include "ocropus.h"
+
+namespace ocropus {
+
+    // Precomputed once per page for segmenters that need the projection
+    // profiles of many rectangles of the page, like the XY-cut.
+    // Black pixels are those with value 0.  Prefix sums along every row
+    // and every column make the number of black pixels in any horizontal
+    // or vertical run of pixels a difference of two entries.  The black
+    // runs of every column allow blocks of the page to be painted
+    // without visiting their white pixels.
+
+    struct PageProjections {
+        int w,h;
+        // row_prefix(x,y): black pixels (i,y) with i<x; (w+1) x h
+        colib::intarray row_prefix;
+        // column_prefix(x,y): black pixels (x,j) with j<y; w x (h+1)
+        colib::intarray column_prefix;
+        // black runs [runs(2k),runs(2k+1)) of column x, for k from
+        // run_offsets(x) to run_offsets(x+1)-1
+        colib::intarray run_offsets;
+        colib::intarray runs;
+
+        PageProjections() {
+            w = h = 0;
+        }
+        void compute(colib::bytearray &image);
+
+        int row_count(int y,int x0,int x1) {
+            return row_prefix(x1,y) - row_prefix(x0,y);
+        }
+        int column_count(int x,int y0,int y1) {
+            return column_prefix(x,y1) - column_prefix(x,y0);
+        }
+
+        // projection of r onto the y axis (one entry per row of r)
+        // and onto the x axis (one entry per column of r)
+        void row_profile(colib::intarray &profile,colib::rectangle r);
+        void column_profile(colib::intarray &profile,colib::rectangle r);
+
+        // set the black pixels of r in image to value
+        void paint(colib::intarray &image,colib::rectangle r,int value);
+    };
+
+}
+
+#endif
@@ -97,60 +97,158 @@ namespace ocropus {
 
     }
 
-    static void construct_graph(narray<line> &lines, narray<bool> &lines_dag){
-        //lines_dag(i,j) = 1 iff there is a directed edge from i to j
-        int graph_length = lines.length();
+    // The precedence relation between lines i<j is
+    //   - for lines overlapping in x, the one with the larger top first,
+    //   - otherwise the left one first, unless some line overlapping both
+    //     in x lies strictly between them vertically, in which case
+    //     there is no edge.
+    // On multi-column pages this relation is dense (every line of a column
+    // precedes every line of the columns to its right), so it is never
+    // stored.  Instead, the depth first search generates the successors of
+    // a line on the fly, in index order, which visits lines in exactly the
+    // same order as a search over the full adjacency matrix.
+
+    namespace {
+        struct ReadingOrderGraph {
+            narray<line> &lines;
+            int n;
+            intarray by_end;        // lines sorted by decreasing end
+            intarray nspanning;     // nspanning(i) = #lines with end >= lines[i].start
+            int source;             // line that greater/less were computed for
+            floatarray greater;     // smallest c above the source's c, by prefix of by_end
+            floatarray less;        // largest c below the source's c, by prefix of by_end
+
+            ReadingOrderGraph(narray<line> &lines) : lines(lines) {
+                n = lines.length();
+                floatarray values(n);
+                by_end.resize(n);
+                for(int i=0;i<n;i++) {
+                    by_end(i) = i;
+                    values(i) = -lines[i].end;
+                }
+                quicksort(by_end,values);
+                floatarray ends(n);
+                for(int p=0;p<n;p++)
+                    ends(p) = lines[by_end(p)].end;
+                nspanning.resize(n);
+                for(int i=0;i<n;i++) {
+                    int lo = 0, hi = n;
+                    while(lo<hi) {
+                        int mid = (lo+hi)/2;
+                        if(ends(mid) >= lines[i].start) lo = mid+1;
+                        else hi = mid;
+                    }
+                    nspanning(i) = lo;
+                }
+                source = -1;
+            }
 
-        for(int i = 0; i<graph_length; i++){
-            for(int j = i; j<graph_length; j++){
+            // Sweep the lines by decreasing end, keeping the nearest c on
+            // either side of the source among those starting before the
+            // source ends; a prefix of by_end is then exactly the set of
+            // lines that reach some other line's start.
+            void set_source(int k) {
+                source = k;
+                line &a = lines[k];
+                greater.resize(n+1);
+                less.resize(n+1);
+                greater(0) = 1e38;
+                less(0) = -1e38;
+                for(int p=0;p<n;p++) {
+                    line &m = lines[by_end(p)];
+                    float g = greater(p), l = less(p);
+                    if(a.end >= m.start) {
+                        if(m.c > a.c && m.c < g) g = m.c;
+                        if(m.c < a.c && m.c > l) l = m.c;
+                    }
+                    greater(p+1) = g;
+                    less(p+1) = l;
+                }
+            }
 
-                if(i == j){ lines_dag(i,j) = 1; continue; }
+            bool separated(int k,int i) {
+                line &a = lines[k], &b = lines[i];
+                // the sweep assumes b starts after a starts and ends after a
+                // ends; anything else (extend_lines can produce odd lines)
+                // takes the slow path
+                if(!(b.start >= a.start && a.end <= b.end))
+                    return separator_segment_found(a,b,lines);
+                if(source!=k) set_source(k);
+                int p = nspanning(i);
+                if(b.c > a.c) return greater(p) < b.c;
+                if(b.c < a.c) return less(p) > b.c;
+                return false;
+            }
 
-                if( x_overlap(lines[i],lines[j]) ){
-                    //assuming parallel horizontal lines and page origin and bottom left corner
-                    if(lines[i].top > lines[j].top) { lines_dag(i,j) = 1; }
-                    else { lines_dag(j,i) = 1; }
+            // is there an edge from k to i?
+            bool edge(int k,int i) {
+                line &a = lines[k], &b = lines[i];
+                if(x_overlap(a,b)) {
+                    if(k<i) return a.top > b.top;
+                    else return !(b.top > a.top);
                 }
-
-                else{
-                    if( separator_segment_found(lines[i],lines[j],lines) )        continue;
-                    else if(lines[i].end <= lines[j].start)  { lines_dag(i,j) = 1; }
-                    else  { lines_dag(j,i) = 1; }
+                if(k<i) {
+                    if(!(a.end <= b.start)) return false;
+                } else {
+                    if(b.end <= a.start) return false;
                 }
+                return !separated(k,i);
             }
-        }
+        };
     }
 
-    ReadingOrderByTopologicalSort::ReadingOrderByTopologicalSort(){
-        id = 0;
+    // next unvisited index >= i; visited lines point past themselves
+    static int next_unvisited(intarray &next,int i) {
+        int j = i;
+        while(next(j)!=j) j = next(j);
+        while(next(i)!=j) {
+            int t = next(i);
+            next(i) = j;
+            i = t;
+        }
+        return j;
     }
 
-    void ReadingOrderByTopologicalSort::visit(int k, narray<bool> &lines_dag){
-        int size = lines_dag.dim(0);
-        val(k) = ++id;
-        for (int i = 0; i< size; i++){
-            if(lines_dag(k,i) != 0)
-                if(val(i) == 0)
-                    visit(i, lines_dag);
+    void topological_reading_order(intarray &order,narray<line> &lines) {
+        int n = lines.length();
+        ReadingOrderGraph graph(lines);
+        intarray next(n+1);
+        for(int i=0;i<=n;i++) next(i) = i;
+        // explicit stack instead of recursion; cursor holds the index
+        // at which the scan for further successors resumes
+        intarray stack,cursor,finished;
+        for(int root=next_unvisited(next,0);root<n;root=next_unvisited(next,root)) {
+            next(root) = root+1;
+            stack.push(root);
+            cursor.push(0);
+            while(stack.length()>0) {
+                int k = stack.last();
+                int i = next_unvisited(next,cursor.last());
+                while(i<n && !graph.edge(k,i))
+                    i = next_unvisited(next,i+1);
+                if(i<n) {
+                    cursor.last() = i+1;
+                    next(i) = i+1;
+                    stack.push(i);
+                    cursor.push(0);
+                } else {
+                    finished.push(k);
+                    stack.pop();
+                    cursor.pop();
+                }
+            }
         }
-        ro_index.push(k);
+        order.resize(n);
+        for(int i=0;i<n;i++)
+            order(i) = finished(n-1-i);
     }
 
-    void ReadingOrderByTopologicalSort::depthFirstSearch(narray<bool> &lines_dag){
-        int size = lines_dag.dim(0);
-        val.resize(size);
-        fill(val,false);
-        for (int k = 0; k< size; k++)
-            if (val(k) == 0)
-                visit(k, lines_dag);
+    ReadingOrderByTopologicalSort::ReadingOrderByTopologicalSort(){
     }
 
     void ReadingOrderByTopologicalSort::sortTextlines(narray<TextLine> &textlines,
                                                       rectarray &gutters,
                                                       CharStats &charstats){
-        id = 0;
-        val.clear();
-        ro_index.clear();
         narray<line> lines;
         for(int i = 0; i<textlines.length(); i++)
             lines.push(line(textlines[i]));
@@ -164,16 +262,11 @@ namespace ocropus {
         }
 
         // Determine reading order
-        narray<bool> lines_dag; // Directed acyclic graph of lines
-        lines_dag.resize( lines.length(), lines.length() );
-        fill(lines_dag,false);
-
-        construct_graph(lines, lines_dag);
-        depthFirstSearch(lines_dag);
-        int size = ro_index.length();
+        intarray order;
+        topological_reading_order(order, lines);
         textlines.clear();
-        for(int i = 1; i <= size; i++){
-            textlines.push(lines[ro_index[size-i]].getTextLine());
+        for(int i = 0; i < order.length(); i++){
+            textlines.push(lines[order[i]].getTextLine());
         }
     }
 
@@ -182,9 +275,6 @@ namespace ocropus {
                                                       rectarray &hor_rulings,
                                                       rectarray &vert_rulings,
                                                       CharStats &charstats){
-        id = 0;
-        val.clear();
-        ro_index.clear();
         narray<line> lines;
         for(int i = 0; i<textlines.length(); i++)
             lines.push(line(textlines[i]));
@@ -230,16 +320,11 @@ namespace ocropus {
         }
 
         // Determine reading order
-        narray<bool> lines_dag; // Directed acyclic graph of lines
-        lines_dag.resize( lines.length(), lines.length() );
-        fill(lines_dag,false);
-
-        construct_graph(lines, lines_dag);
-        depthFirstSearch(lines_dag);
-        int size = ro_index.length();
+        intarray order;
+        topological_reading_order(order, lines);
         textlines.clear();
-        for(int i = 1; i <= size; i++){
-            TextLine tl=lines[ro_index[size-i]].getTextLine();
+        for(int i = 0; i < order.length(); i++){
+            TextLine tl=lines[order[i]].getTextLine();
             if(tl.xheight>0) // Remove dummy lines
                 textlines.push(tl);
         }
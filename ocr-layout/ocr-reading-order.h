@@ -41,6 +41,12 @@ namespace ocropus {
                       colib::rectarray &wboxes,
                       int image_width);
 
+    // Topologically sort lines by the reading order precedence relation;
+    // order holds indexes into lines.  Takes O(n) memory and, in the worst
+    // case, O(n^2) time.
+    void topological_reading_order(colib::intarray &order,
+                                   colib::narray<line> &lines);
+
     struct ReadingOrderByTopologicalSort {
         ReadingOrderByTopologicalSort();
         ~ReadingOrderByTopologicalSort() {}
@@ -57,13 +63,6 @@ namespace ocropus {
                            colib::rectarray &hor_rulings,
                            colib::rectarray &vert_rulings,
                            CharStats &charstats);
-    private:
-        int  id;
-        colib::narray<int> val;
-        colib::narray<int> ro_index;
-
-        void visit(int k, colib::narray<bool> &lines_dag);
-        void depthFirstSearch(colib::narray<bool> &lines_dag);
     };
 
     ReadingOrderByTopologicalSort *make_ReadingOrderByTopologicalSort();
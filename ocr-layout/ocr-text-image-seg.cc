@@ -144,46 +144,44 @@ namespace ocropus {
                                                  rectarray &bboxes,
                                                  bytearray &image){
 
-        autodel<LogReg> logistic_regression(make_LogReg());
+        LogReg logistic_regression;
         autodel<ZoneFeatures> zone_features(make_ZoneFeatures());
 
-        logistic_regression->loadData();
-        class_prob.resize(bboxes.length(),logistic_regression->class_num);
-        fill(class_prob,-1);
+        logistic_regression.loadData();
+        int feature_len = logistic_regression.feature_len;
 
-        int x0, y0, x1, y1, xi, yi;
-        floatarray feature;
+        // extract the features of all zones in parallel, directly from
+        // the page image, and score them together afterwards
+        int nzones = bboxes.length();
+        floatarray features(nzones, feature_len);
+        fill(features,0);
+        bytearray valid(nzones);
+        fill(valid,0);
         int image_width   = image.dim(0);
         int image_height  = image.dim(1);
-        bytearray image_tmp;
-        for (int i = 0; i < bboxes.length(); i++){
+#pragma omp parallel for schedule(dynamic,4)
+        for (int i = 0; i < nzones; i++){
             if(!bboxes[i].area() || bboxes[i].area()>=image_width*image_height)
                 continue;
-            //bboxes[i].println();
-            x0 = ( bboxes[i].x0 > 0 ) ? bboxes[i].x0 : 0;
-            y0 = ( bboxes[i].y0 > 0 ) ? bboxes[i].y0 : 0;
-            x1 = ( bboxes[i].x1 < image_width)  ? bboxes[i].x1 : image_width-1;
-            y1 = ( bboxes[i].y1 < image_height) ? bboxes[i].y1 : image_height-1;
+            int x0 = ( bboxes[i].x0 > 0 ) ? bboxes[i].x0 : 0;
+            int y0 = ( bboxes[i].y0 > 0 ) ? bboxes[i].y0 : 0;
+            int x1 = ( bboxes[i].x1 < image_width)  ? bboxes[i].x1 : image_width-1;
+            int y1 = ( bboxes[i].y1 < image_height) ? bboxes[i].y1 : image_height-1;
             if(x1<=x0 || y1<=y0)
                 continue;
 
-            image_tmp.resize(x1 - x0 + 1, y1 - y0 + 1);
-            for (xi = x0; xi <= x1; xi++){
-                for (yi = y0; yi <= y1; yi++){
-                    image_tmp(xi - x0, yi - y0) = image(xi, yi);
-                }
-            }
-
-            feature.clear();
-            zone_features->extractFeatures(feature, image_tmp);
-
-            //logistic regression
-            floatarray probs;
-            logistic_regression->getClassProbabilities(probs,feature);
-            ASSERT(probs.length()==class_prob.dim(1));
-            for(int j=0; j<probs.length(); j++)
-                class_prob(i,j) = probs[j];
+            floatarray feature;
+            zone_features->extractFeatures(feature, image,
+                                           rectangle(x0, y0, x1 + 1, y1 + 1));
+            if(feature.length() != feature_len)
+                continue;
+            for(int j=0; j<feature_len; j++)
+                features(i,j) = feature[j];
+            valid[i] = 1;
         }
+
+        //logistic regression
+        logistic_regression.getClassProbabilities(class_prob,features,valid);
     }
 
     void TextImageSegByLogReg::textImageProbabilities(intarray &out,
@@ -64,9 +64,9 @@ namespace {
         // Do connected component analysis
         intarray charimage;
         copy(charimage,in);
-        label_components(charimage,false);
-        rectarray bboxes;
-        bounding_boxes(bboxes,charimage);
+        ConnectedComponents components;
+        components.label(charimage);
+        rectarray &bboxes = components.boxes;
         if(bboxes.length()==0){
             makelike(image,in);
             fill(image,0x00ffffff);
@@ -109,9 +109,9 @@ namespace {
         //write_image_gray("inverted.png",in);
         binary_close_rect(in,2*charstats->char_spacing,charstats->char_spacing);
         copy(charimage,in);
-        label_components(charimage,false);
-        rectarray wordboxes;
-        bounding_boxes(wordboxes,charimage);
+        ConnectedComponents words;
+        words.label(charimage);
+        rectarray &wordboxes = words.boxes;
         makelike(image,in_not_inverted);
         for(int i=0,l=in_not_inverted.length1d(); i<l; i++){
             if(in_not_inverted.at1d(i) == 0xff || charimage.at1d(i)==0)
@@ -0,0 +1,93 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: coarse to fine skew estimation against a single RAST pass
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include <math.h>
+#include "ocropus.h"
+#include "ocr-deskew-rast.h"
+
+using namespace colib;
+using namespace ocropus;
+
+// Character boxes of a page w pixels wide with nlines text lines of
+// skewed text, as bounding_boxes would return them (box 0 is the page).
+static void make_page(rectarray &boxes,int w,double slope,int nlines,int nchars,int seed) {
+    srand(seed);
+    int h = 3300;
+    boxes.clear();
+    boxes.push(rectangle(0,0,w,h));
+    for(int l=0;l<nlines;l++) {
+        int base = 200+l*(h-400)/nlines;
+        int x = 100;
+        for(int c=0;c<nchars && x<w-120;c++) {
+            int cw = 10+rand()%6, ch = 18+rand()%5;
+            // ascenders and descenders now and then
+            int y0 = base, y1 = base+ch;
+            if(rand()%5==0) y1 += 8;
+            else if(rand()%7==0) y0 -= 7;
+            int dy = int(floor(slope*x+0.5));
+            boxes.push(rectangle(x,y0+dy,x+cw,y1+dy));
+            x += cw+3;
+            if(rand()%6==0) x += 12;
+        }
+    }
+}
+
+static double skew(rectarray &boxes,bool single_pass) {
+    DeskewPageByRAST deskewer;
+    if(single_pass) deskewer.pset("coarse_n",deskewer.max_n);
+    rectarray temp;
+    copy(temp,boxes);
+    return deskewer.getSkewAngle(temp);
+}
+
+int main() {
+    double slopes[] = {0.0,0.012,-0.027,0.045,-0.004};
+    for(int i=0;i<int(sizeof slopes/sizeof slopes[0]);i++) {
+        // between coarse_n and max_n boxes: these pages used to get a
+        // single pass and are now searched coarse to fine
+        rectarray boxes;
+        make_page(boxes,2500,slopes[i],45,120,i);
+        CHECK_CONDITION(boxes.length()>2000 && boxes.length()<=10000);
+        double fine = skew(boxes,false);
+        double single = skew(boxes,true);
+        fprintf(stderr,"slope %g: single pass %g, coarse to fine %g\n",
+                slopes[i],single,fine);
+        // both within the 0.001 slope resolution of each other and of
+        // the true skew; the lines are fit in the coordinates of the
+        // boxes, so the angle has the sign of the slope
+        CHECK_CONDITION(fabs(fine-single)<0.002);
+        CHECK_CONDITION(fabs(fine-atan(slopes[i]))<0.003);
+    }
+
+    // pages with more than max_n boxes used to fail; now they get
+    // sampled
+    rectarray dense;
+    make_page(dense,4000,0.02,80,200,99);
+    CHECK_CONDITION(dense.length()>10000);
+    double angle = skew(dense,false);
+    CHECK_CONDITION(fabs(angle-atan(0.02))<0.003);
+    return 0;
+}
@@ -0,0 +1,301 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: column strip NoiseFilter and remove_border_noise against
+//          the original window-by-window loops
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include "ocropus.h"
+#include "ocr-noisefilter.h"
+#include "ocr-pageframe-rast.h"
+
+using namespace colib;
+using namespace ocropus;
+
+// NoiseFilter as it was before it counted pixels per column and row;
+// the border decisions depend on the exact float ratios, so these
+// are kept verbatim.
+
+static float old_black_ratio(int x0,int y0,int x1,int y1,bytearray &image){
+    float result=0.0;
+    int blackpixels=0;
+    int total = (x1-x0+1) * (y1-y0+1);
+    for(int i=x0 ;i<=x1 ;i++) {
+        for(int j=y0; j<=y1 ;j++) {
+            if(image(i,j)==black) {blackpixels++;}
+        }
+    }
+    result=(float)blackpixels/(float)total;
+    return result;
+}
+
+static float old_white_ratio(int x0,int y0,int x1,int y1,bytearray &image) {
+    return 1.0-old_black_ratio(x0,y0,x1,y1,image);
+}
+
+static void old_remove(int x0,int y0,int x1,int y1,bytearray &image) {
+    for (int i=x0 ; i<=x1 ;i++) {
+        for (int j=y0; j<=y1 ;j++) {
+            if(image(i,j)==black){image(i,j)=white;}
+        }
+    }
+}
+
+static void old_black_filter(bytearray &out,bytearray &original,float threshold,
+                             int xstep,int ystep,int xwidth,int yheight){
+    bytearray in,in_removable;
+    copy(in_removable,original);
+    copy(in,original);
+    int ximage=in.dim(0);
+    int yimage=in.dim(1);
+    int left,right,top,bottom;
+    int leftr=0;
+    int rightr=ximage-1;
+    //scan the left border first
+    int start = (int) ximage/3;
+    right=start;
+    bottom=0;
+    top=yimage-1;
+    left=start-xwidth+1;
+    while(left>=0) {
+        if(old_black_ratio(left,bottom,right,top,in)>threshold) {
+            old_remove(0,0,right,top,in_removable);
+            leftr=right;
+            break;
+        }
+        right=right-xstep;
+        left=left-xstep;
+    }
+    //scan the right border now
+    start=(int) (ximage*2)/3;
+    left=start;
+    bottom=0;
+    top=yimage-1;
+    right=start+xwidth-1;
+    while(right<ximage) {
+        if(old_black_ratio(left,bottom,right,top,in)>threshold) {
+            old_remove(left,bottom,ximage-1,top,in_removable);
+            rightr=left;
+            break;
+        }
+        right=right+xstep;
+        left=left+xstep;
+    }
+    //scan the top border now
+    start = (int) (yimage*24)/25;
+    left=leftr;
+    right=rightr;
+    bottom=start;
+    top=start+yheight-1;
+    while(top<yimage) {
+        if(old_black_ratio(left,bottom,right,top,in)>threshold){
+            old_remove(0,bottom,ximage-1,yimage-1,in_removable);
+            break;
+        }
+        top=top+ystep;
+        bottom=bottom+ystep;
+    }
+    //scan bottom border
+    start = (int) yimage/25;
+    left=leftr;
+    right=rightr;
+    top=start;
+    bottom=start-yheight+1;
+    while(bottom>=0){
+        if(old_black_ratio(left,bottom,right,top,in)>threshold){
+            old_remove(0,0,ximage-1,top,in_removable);
+            break;
+        }
+        top=top-ystep;
+        bottom=bottom-ystep;
+    }
+    copy(out,in_removable);
+}
+
+static void old_white_filter(bytearray &out,bytearray &original,float threshold,
+                             int xstep,int ystep,int xwidth,int yheight) {
+    bytearray in,in_removable;
+    copy(in,original);
+    copy(in_removable,original);
+    int ximage=in.dim(0);
+    int yimage=in.dim(1);
+    int left,right,top,bottom;
+    int leftr=0;
+    int rightr=ximage-1;
+    //scanning the left border first
+    int start= (int) ximage/5;
+    right=start;
+    bottom=0;
+    top=yimage-1;
+    left=start-xwidth+1;
+    while(left>=0){
+        if(old_white_ratio(left,bottom,right,top,in)>threshold){
+            old_remove(0,0,right-xwidth+1,top,in_removable);
+            leftr=right;
+            break;
+        }
+        right=right-xstep;
+        left=left-xstep;
+    }
+    //scan the right border now
+    start=(int) (ximage*4)/5;
+    left=start;
+    bottom=0;
+    top=yimage-1;
+    right=start+xwidth-1;
+    while(right<ximage) {
+        if(old_white_ratio(left,bottom,right,top,in)>threshold) {
+            old_remove(left+xwidth-1,bottom,ximage-1,top,in_removable);
+            rightr=left;
+            break;
+        }
+        right=right+xstep;
+        left=left+xstep;
+    }
+    //scan the top border now
+    start = (int) (yimage*24)/25;
+    left=leftr;
+    right=rightr;
+    bottom=start;
+    top=start+yheight-1;
+    while(top<yimage) {
+        if(old_white_ratio(left,bottom,right,top,in)>threshold){
+            old_remove(0,bottom+yheight-1,ximage-1,yimage-1,in_removable);
+            break;
+        }
+        top=top+ystep;
+        bottom=bottom+ystep;
+    }
+    //scan the bottom border now
+    start =(int) (yimage)/50;
+    left=leftr;
+    right=rightr;
+    top=start;
+    bottom=start-yheight+1;
+    while(bottom>=0){
+        if(old_white_ratio(left,bottom,right,top,in)>threshold){
+            old_remove(0,0,ximage-1,top-yheight+1,in_removable);
+            break;
+        }
+        top=top-ystep;
+        bottom=bottom-ystep;
+    }
+    copy(out,in_removable);
+}
+
+static void old_ccanalysis(bytearray &out,bytearray &in,rectarray &bboxes,
+                           int border_margin){
+    int max_width = in.dim(0);
+    int max_height = in.dim(1);
+    for(int i=0; i<bboxes.length(); i++){
+        if(bboxes(i).width()  >= max_width)  continue;
+        if(bboxes(i).height() >= max_height) continue;
+        if(bboxes(i).x0 < border_margin )    continue;
+        if(bboxes(i).y0 < border_margin )    continue;
+        if(bboxes(i).x1 > in.dim(0) - border_margin )   continue;
+        if(bboxes(i).y1 > in.dim(1) - border_margin )   continue;
+        for(int y=bboxes(i).y0; y<bboxes(i).y1; y++){
+            for(int x=bboxes(i).x0; x<bboxes(i).x1; x++){
+                out(x,y) = in(x,y);
+            }
+        }
+    }
+}
+
+static void old_remove_border_noise(bytearray &out,bytearray &in,rectangle &pageframe){
+    makelike(out,in);
+    fill(out,255);
+    for(int x=pageframe.x0;x<pageframe.x1;x++)
+        for(int y=pageframe.y0;y<pageframe.y1;y++)
+            if(!in(x,y))
+                out(x,y)=in(x,y);
+}
+
+static bool same(bytearray &a,bytearray &b) {
+    if(a.dim(0)!=b.dim(0) || a.dim(1)!=b.dim(1)) return false;
+    for(int i=0;i<a.length1d();i++)
+        if(a.at1d(i)!=b.at1d(i)) return false;
+    return true;
+}
+
+// a page of sparse text with dense, sparse or medium noise along the
+// borders, so that every branch of the border scans gets taken; pages
+// wider than a column strip check the merging of the partial counts
+static void make_page(bytearray &page,int seed) {
+    srand(seed);
+    int w = 50+rand()%300, h = 50+rand()%300;
+    int mode = rand()%3;
+    page.resize(w,h);
+    for(int x=0;x<w;x++) {
+        for(int y=0;y<h;y++) {
+            bool border = x<w/6+rand()%5 || y<h/20 || y>h-h/20 || x>w-w/7;
+            int p = border ? (mode==0 ? 95 : mode==1 ? 2 : 60) : 8;
+            page(x,y) = rand()%100<p ? black : white;
+        }
+    }
+}
+
+int main() {
+    NoiseFilter filter;
+    int changed_black = 0, changed_white = 0;
+    for(int seed=0;seed<300;seed++) {
+        bytearray page,expected,actual;
+        make_page(page,seed);
+        int w = page.dim(0), h = page.dim(1);
+
+        float bt = 0.3+0.6*(rand()%100)/100.0;
+        old_black_filter(expected,page,bt,5,5,5,5);
+        filter.blackFilter(actual,page,bt,5,5,5,5);
+        CHECK_CONDITION(same(expected,actual));
+        if(!same(actual,page)) changed_black++;
+
+        float wt = 0.8+0.2*(rand()%100)/100.0;
+        old_white_filter(expected,page,wt,5,5,5,5);
+        filter.whiteFilter(actual,page,wt,5,5,5,5);
+        CHECK_CONDITION(same(expected,actual));
+        if(!same(actual,page)) changed_white++;
+
+        // overlapping boxes, some near or across the margins
+        rectarray boxes;
+        for(int i=0;i<50;i++) {
+            int x0 = rand()%w, y0 = rand()%h;
+            boxes.push(rectangle(x0,y0,min(w,x0+rand()%80),min(h,y0+rand()%80)));
+        }
+        makelike(expected,page);
+        fill(expected,white);
+        makelike(actual,page);
+        fill(actual,white);
+        old_ccanalysis(expected,page,boxes,filter.border_margin);
+        filter.ccanalysis(actual,page,boxes);
+        CHECK_CONDITION(same(expected,actual));
+
+        int x0 = rand()%w, y0 = rand()%h;
+        rectangle frame(x0,y0,x0+1+rand()%(w-x0),y0+1+rand()%(h-y0));
+        old_remove_border_noise(expected,page,frame);
+        remove_border_noise(actual,page,frame);
+        CHECK_CONDITION(same(expected,actual));
+    }
+    // the pages must actually exercise the removal code
+    CHECK_CONDITION(changed_black>0 && changed_white>0);
+    return 0;
+}
@@ -0,0 +1,175 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: compare reading order against the dense matrix version
+// Responsible: faisal
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <time.h>
+#include "ocropus.h"
+#include "ocr-layout-internal.h"
+
+using namespace colib;
+using namespace ocropus;
+
+// The reading order computation as it was originally written: an
+// n x n adjacency matrix and a recursive depth first search.
+
+static bool overlapping(line &a,line &b) {
+    return a.end>=b.start && b.end>=a.start;
+}
+
+static bool separated(line &a,line &b,narray<line> &lines) {
+    float y_min = min(a.c,b.c);
+    float y_max = max(a.c,b.c);
+    for(int i=0;i<lines.length();i++)
+        if(overlapping(lines[i],a) && overlapping(lines[i],b))
+            if(lines[i].c>y_min && lines[i].c<y_max)
+                return true;
+    return false;
+}
+
+static void visit(int k,bytearray &dag,intarray &val,intarray &finished) {
+    val(k) = 1;
+    for(int i=0;i<dag.dim(0);i++)
+        if(dag(k,i) && !val(i))
+            visit(i,dag,val,finished);
+    finished.push(k);
+}
+
+static void dense_reading_order(intarray &order,narray<line> &lines) {
+    int n = lines.length();
+    bytearray dag(n,n);
+    fill(dag,0);
+    for(int i=0;i<n;i++) {
+        for(int j=i+1;j<n;j++) {
+            if(overlapping(lines[i],lines[j])) {
+                if(lines[i].top>lines[j].top) dag(i,j) = 1;
+                else dag(j,i) = 1;
+            } else if(!separated(lines[i],lines[j],lines)) {
+                if(lines[i].end<=lines[j].start) dag(i,j) = 1;
+                else dag(j,i) = 1;
+            }
+        }
+    }
+    intarray val(n),finished;
+    fill(val,0);
+    for(int k=0;k<n;k++)
+        if(!val(k)) visit(k,dag,val,finished);
+    order.resize(n);
+    for(int i=0;i<n;i++)
+        order(i) = finished(n-1-i);
+}
+
+static void random_lines(narray<line> &lines,int n,int kind) {
+    lines.clear();
+    for(int i=0;i<n;i++) {
+        line l;
+        if(kind==0) {
+            // columns with some lines spanning several of them
+            int column = rand()%4;
+            l.start = column*100+rand()%10;
+            l.end = column*100+80+rand()%10;
+            if(rand()%10==0) l.end += 100*(rand()%3);
+            l.c = 10*(rand()%50);
+        } else if(kind==1) {
+            l.start = rand()%100;
+            l.end = l.start+rand()%60;
+            l.c = rand()%100;
+        } else {
+            // lots of ties, and lines with start>end like extend_lines
+            // can produce
+            l.start = rand()%100;
+            l.end = rand()%100;
+            l.c = rand()%20;
+        }
+        l.m = 0;
+        l.d = 0;
+        l.top = l.c+rand()%3;
+        l.bottom = l.c-5;
+        l.istart = l.start;
+        l.iend = l.end;
+        l.xheight = 5;
+        lines.push(l);
+    }
+}
+
+static void page_lines(narray<line> &lines,int n,int ncolumns) {
+    lines.clear();
+    int rows = (n+ncolumns-1)/ncolumns;
+    for(int i=0;i<n;i++) {
+        int column = i%ncolumns, row = i/ncolumns;
+        line l;
+        l.start = column*1000;
+        l.end = column*1000+900;
+        l.c = (rows-row)*30;
+        l.m = 0;
+        l.d = 0;
+        l.top = l.c+20;
+        l.bottom = l.c;
+        l.istart = l.start;
+        l.iend = l.end;
+        l.xheight = 10;
+        lines.push(l);
+    }
+}
+
+static bool same(intarray &a,intarray &b) {
+    if(a.length()!=b.length()) return false;
+    for(int i=0;i<a.length();i++)
+        if(a(i)!=b(i)) return false;
+    return true;
+}
+
+void test_same_order() {
+    for(int trial=0;trial<600;trial++) {
+        narray<line> lines;
+        random_lines(lines,1+rand()%100,trial%3);
+        intarray expected,order;
+        dense_reading_order(expected,lines);
+        topological_reading_order(order,lines);
+        CHECK_CONDITION(same(expected,order));
+    }
+}
+
+void test_scaling() {
+    for(int n=1250;n<=10000;n*=2) {
+        narray<line> lines;
+        page_lines(lines,n,8);
+        intarray order;
+        clock_t start = clock();
+        topological_reading_order(order,lines);
+        double elapsed = (clock()-start)/double(CLOCKS_PER_SEC);
+        fprintf(stderr,"reading order: %5d lines in 8 columns %.3f s\n",n,elapsed);
+        CHECK_CONDITION(order.length()==n);
+        // column by column, top to bottom
+        for(int i=1;i<n;i++) {
+            line &a = lines[order(i-1)], &b = lines[order(i)];
+            CHECK_CONDITION(a.start<b.start || (a.start==b.start && a.c>b.c));
+        }
+    }
+}
+
+int main() {
+    test_same_order();
+    test_scaling();
+    return 0;
+}
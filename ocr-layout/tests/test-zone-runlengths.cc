@@ -0,0 +1,504 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: single pass run-length zone features against the original
+//          per-direction loops
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include "ocropus.h"
+#include "ocr-classify-zones.h"
+
+using namespace colib;
+using namespace ocropus;
+
+// The per-direction run-length features as ZoneFeatures computed them
+// before runLengths(), including their quirks; the classifier weights
+// were trained on these.
+
+static void horizontalRunLengths(ZoneFeatures &zf,floatarray &resulthist,
+                                 floatarray &resultstats,
+                                 const bytearray &image,
+                                 const rectangle &r){
+
+    int imwidth  = r.x1 - r.x0;
+    int imheight = r.y1 - r.y0;
+
+    intarray histogram_fg;
+    histogram_fg.resize(MAX_LEN);
+    fill(histogram_fg,0);
+    intarray histogram_bg;
+    histogram_bg.resize(MAX_LEN);
+    fill(histogram_bg,0);
+
+    int current_run_length_bg = 0;
+    int current_run_length_fg = 0;
+    int run_length_count_fg = 0;
+    int run_length_count_bg = 0;
+    bool end_fg = false;
+    bool end_bg = false;
+    // indicator that the end of the running segment occurs
+    float mean_fg = 0, variance_fg = 0;
+    float mean_bg = 0, variance_bg = 0;
+    for(int j = 0; j < imheight; j++){
+        for(int i = 0; i < imwidth; i++){
+            if(image(r.x0+i,r.y0+j) == 0){
+                current_run_length_fg++;
+                end_fg = false;
+            }
+            else
+                end_fg = true;
+
+            if((current_run_length_fg > 0) && (end_fg || (i == imwidth-1))){
+                current_run_length_fg = min(current_run_length_fg, MAX_LEN);
+                histogram_fg(current_run_length_fg-1)++;
+                run_length_count_fg++;
+                mean_fg += current_run_length_fg;
+                variance_fg += current_run_length_fg * current_run_length_fg;
+                current_run_length_fg = 0;
+                end_fg = false;
+            }
+
+            if(image(r.x0+i,r.y0+j) == 255){
+                current_run_length_bg++;
+                end_bg = false;
+            }
+            else
+                end_bg = true;
+
+            if((current_run_length_bg > 0) && (end_bg || (i == imwidth-1))){
+                current_run_length_bg = min(current_run_length_bg, MAX_LEN);
+                histogram_bg(current_run_length_bg-1)++;
+                run_length_count_bg++;
+                mean_bg += current_run_length_bg;
+                variance_bg += current_run_length_bg * current_run_length_bg;
+                current_run_length_bg = 0;
+                end_bg = false;
+            }
+
+        }
+    }
+    zf.compressHist(histogram_fg);
+    zf.compressHist(histogram_bg);
+    for(int i=0, l=histogram_fg.length(); i<l; i++)
+        resulthist.push(histogram_fg[i]);
+    for(int i=0, l=histogram_bg.length(); i<l; i++)
+        resulthist.push(histogram_bg[i]);
+
+    if(run_length_count_fg){
+        mean_fg/= run_length_count_fg;
+        variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
+    }
+    else{
+        mean_fg=0; variance_fg=0;
+    }
+    resultstats.push(run_length_count_fg);
+    resultstats.push(mean_fg);
+    resultstats.push(variance_fg);
+
+    if(run_length_count_bg){
+        mean_bg/= run_length_count_bg;
+        variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
+    }
+    else{
+        mean_bg=0; variance_bg=0;
+    }
+    resultstats.push(run_length_count_bg);
+    resultstats.push(mean_bg);
+    resultstats.push(variance_bg);
+
+}
+
+static void verticalRunLengths(ZoneFeatures &zf,floatarray &resulthist,
+                               floatarray &resultstats,
+                               const bytearray &image,
+                               const rectangle &r){
+
+    int imwidth  = r.x1 - r.x0;
+    int imheight = r.y1 - r.y0;
+
+    intarray histogram_fg;
+    histogram_fg.resize(MAX_LEN);
+    fill(histogram_fg,0);
+    intarray histogram_bg;
+    histogram_bg.resize(MAX_LEN);
+    fill(histogram_bg,0);
+
+    int current_run_length_bg = 0;
+    int current_run_length_fg = 0;
+    int run_length_count_fg = 0;
+    int run_length_count_bg = 0;
+    bool end_fg = false;
+    bool end_bg = false;
+    // indicator that the end of the running segment occurs
+    float mean_fg = 0, variance_fg = 0;
+    float mean_bg = 0, variance_bg = 0;
+    for(int i = 0; i < imwidth; i++){
+        for(int j = 0; j < imheight; j++){
+            if(image(r.x0+i,r.y0+j) == 0){
+                current_run_length_fg++;
+                end_fg = false;
+            }
+            else
+                end_fg = true;
+
+            if((current_run_length_fg > 0) && (end_fg || (i == imheight-1))){
+                current_run_length_fg = min(current_run_length_fg, MAX_LEN);
+                histogram_fg(current_run_length_fg-1)++;
+                run_length_count_fg++;
+                mean_fg += current_run_length_fg;
+                variance_fg += current_run_length_fg * current_run_length_fg;
+                current_run_length_fg = 0;
+                end_fg = false;
+            }
+
+            if(image(r.x0+i,r.y0+j) == 255){
+                current_run_length_bg++;
+                end_bg = false;
+            }
+            else
+                end_bg = true;
+
+            if((current_run_length_bg > 0) && (end_bg || (i == imheight-1))){
+                current_run_length_bg = min(current_run_length_bg, MAX_LEN);
+                histogram_bg(current_run_length_bg-1)++;
+                run_length_count_bg++;
+                mean_bg += current_run_length_bg;
+                variance_bg += current_run_length_bg * current_run_length_bg;
+                current_run_length_bg = 0;
+                end_bg = false;
+            }
+
+        }
+    }
+    zf.compressHist(histogram_fg);
+    zf.compressHist(histogram_bg);
+    for(int i=0, l=histogram_fg.length(); i<l; i++)
+        resulthist.push(histogram_fg[i]);
+    for(int i=0, l=histogram_bg.length(); i<l; i++)
+        resulthist.push(histogram_bg[i]);
+
+    if(run_length_count_fg){
+        mean_fg/= run_length_count_fg;
+        variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
+    }
+    else{
+        mean_fg=0; variance_fg=0;
+    }
+    resultstats.push(run_length_count_fg);
+    resultstats.push(mean_fg);
+    resultstats.push(variance_fg);
+
+    if(run_length_count_bg){
+        mean_bg/= run_length_count_bg;
+        variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
+    }
+    else{
+        mean_bg=0; variance_bg=0;
+    }
+    resultstats.push(run_length_count_bg);
+    resultstats.push(mean_bg);
+    resultstats.push(variance_bg);
+
+}
+
+static void mainDiagRunLengths(ZoneFeatures &zf,floatarray &resulthist,
+                               floatarray &resultstats,
+                               const bytearray &image,
+                               const rectangle &r){
+
+    int imwidth  = r.x1 - r.x0;
+    int imheight = r.y1 - r.y0;
+
+    intarray histogram_fg;
+    histogram_fg.resize(MAX_LEN);
+    fill(histogram_fg,0);
+    intarray histogram_bg;
+    histogram_bg.resize(MAX_LEN);
+    fill(histogram_bg,0);
+
+    int current_run_length_bg = 0;
+    int current_run_length_fg = 0;
+    int run_length_count_fg = 0;
+    int run_length_count_bg = 0;
+    bool end_fg = false;
+    bool end_bg = false;
+    // indicator that the end of the running segment occurs
+    float mean_fg = 0, variance_fg = 0;
+    float mean_bg = 0, variance_bg = 0;
+
+    int pix = 0;
+    for(int i = 0; i < imwidth + imheight; i++){
+        for(int j = 0; j < min(imwidth, imheight); j++){
+            if(i < imwidth){
+                if(j < i+1)
+                    pix = image(r.x0+i-j, r.y0+j);
+                else
+                    j = imwidth*imheight;
+            }
+            else{
+                if(j < imwidth-1+imheight-i)
+                    pix = image(r.x0+imwidth-j-1, r.y0+i-(imwidth-1)+j);
+                else
+                    j = imwidth*imheight;
+            }
+
+            if((pix == 0) && (j != imwidth*imheight)){
+                current_run_length_fg++;
+                end_fg = false;
+            }
+            else
+                end_fg = true;
+
+            if( (current_run_length_fg > 0) &&
+                (end_fg || (j == imwidth*imheight))){
+                current_run_length_fg = min(current_run_length_fg, MAX_LEN);
+                histogram_fg(current_run_length_fg-1)++;
+                run_length_count_fg++;
+                mean_fg += current_run_length_fg;
+                variance_fg += current_run_length_fg * current_run_length_fg;
+                current_run_length_fg = 0;
+                end_fg = false;
+            }
+
+            if((pix == 255) && (j != imwidth*imheight)){
+                current_run_length_bg++;
+                end_bg = false;
+            }
+            else
+                end_bg = true;
+
+            if( (current_run_length_bg > 0) &&
+                (end_bg || (j == imwidth*imheight))){
+                current_run_length_bg = min(current_run_length_bg, MAX_LEN);
+                histogram_bg(current_run_length_bg-1)++;
+                run_length_count_bg++;
+                mean_bg += current_run_length_bg;
+                variance_bg += current_run_length_bg * current_run_length_bg;
+                current_run_length_bg = 0;
+                end_bg = false;
+            }
+        }
+    }
+
+
+    zf.compressHist(histogram_fg);
+    zf.compressHist(histogram_bg);
+    for(int i=0, l=histogram_fg.length(); i<l; i++)
+        resulthist.push(histogram_fg[i]);
+    for(int i=0, l=histogram_bg.length(); i<l; i++)
+        resulthist.push(histogram_bg[i]);
+
+    if(run_length_count_fg){
+        mean_fg/= run_length_count_fg;
+        variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
+    }
+    else{
+        mean_fg=0; variance_fg=0;
+    }
+    resultstats.push(run_length_count_fg);
+    resultstats.push(mean_fg);
+    resultstats.push(variance_fg);
+
+    if(run_length_count_bg){
+        mean_bg/= run_length_count_bg;
+        variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
+    }
+    else{
+        mean_bg=0; variance_bg=0;
+    }
+    resultstats.push(run_length_count_bg);
+    resultstats.push(mean_bg);
+    resultstats.push(variance_bg);
+
+}
+
+static void sideDiagRunLengths(ZoneFeatures &zf,floatarray &resulthist,
+                               floatarray &resultstats,
+                               const bytearray &image,
+                               const rectangle &r){
+
+    int imwidth  = r.x1 - r.x0;
+    int imheight = r.y1 - r.y0;
+
+    intarray histogram_fg;
+    histogram_fg.resize(MAX_LEN);
+    fill(histogram_fg,0);
+    intarray histogram_bg;
+    histogram_bg.resize(MAX_LEN);
+    fill(histogram_bg,0);
+
+    int current_run_length_bg = 0;
+    int current_run_length_fg = 0;
+    int run_length_count_fg = 0;
+    int run_length_count_bg = 0;
+    bool end_fg = false;
+    bool end_bg = false;
+    // indicator that the end of the running segment occurs
+    float mean_fg = 0, variance_fg = 0;
+    float mean_bg = 0, variance_bg = 0;
+
+    int pix = 0;
+    for(int i = 0; i < imwidth + imheight; i++){
+        for(int j = 0; j < min(imwidth, imheight); j++){
+            if(i < imheight){
+                if(j < i+1)
+                    pix = image(r.x0+j, r.y0+(imheight-1)-i+j);
+                else
+                    j = imwidth*imheight;
+            }
+            else{
+                if(j < imwidth-1+imheight-i)
+                    pix = image(r.x0+i-(imheight-1)+j, r.y0+j);
+                else
+                    j = imwidth*imheight;
+            }
+
+            if((pix == 0) && (j != imwidth*imheight)){
+                current_run_length_fg++;
+                end_fg = false;
+            }
+            else
+                end_fg = true;
+
+            if( (current_run_length_fg > 0) &&
+                (end_fg || (j == imwidth*imheight))){
+                current_run_length_fg = min(current_run_length_fg, MAX_LEN);
+                histogram_fg(current_run_length_fg-1)++;
+                run_length_count_fg++;
+                mean_fg += current_run_length_fg;
+                variance_fg += current_run_length_fg * current_run_length_fg;
+                current_run_length_fg = 0;
+                end_fg = false;
+            }
+
+            if((pix == 255) && (j != imwidth*imheight)){
+                current_run_length_bg++;
+                end_bg = false;
+            }
+            else
+                end_bg = true;
+
+            if( (current_run_length_bg > 0) &&
+                (end_bg || (j == imwidth*imheight))){
+                current_run_length_bg = min(current_run_length_bg, MAX_LEN);
+                histogram_bg(current_run_length_bg-1)++;
+                run_length_count_bg++;
+                mean_bg += current_run_length_bg;
+                variance_bg += current_run_length_bg * current_run_length_bg;
+                current_run_length_bg = 0;
+                end_bg = false;
+            }
+        }
+    }
+
+
+    zf.compressHist(histogram_fg);
+    zf.compressHist(histogram_bg);
+    for(int i=0, l=histogram_fg.length(); i<l; i++)
+        resulthist.push(histogram_fg[i]);
+    for(int i=0, l=histogram_bg.length(); i<l; i++)
+        resulthist.push(histogram_bg[i]);
+
+    if(run_length_count_fg){
+        mean_fg/= run_length_count_fg;
+        variance_fg = variance_fg/run_length_count_fg - mean_fg*mean_fg;
+    }
+    else{
+        mean_fg=0; variance_fg=0;
+    }
+    resultstats.push(run_length_count_fg);
+    resultstats.push(mean_fg);
+    resultstats.push(variance_fg);
+
+    if(run_length_count_bg){
+        mean_bg/= run_length_count_bg;
+        variance_bg = variance_bg/run_length_count_bg - mean_bg*mean_bg;
+    }
+    else{
+        mean_bg=0; variance_bg=0;
+    }
+    resultstats.push(run_length_count_bg);
+    resultstats.push(mean_bg);
+    resultstats.push(variance_bg);
+
+}
+
+static void make_zone(bytearray &image,int w,int h,int density) {
+    image.resize(w,h);
+    for(int i=0;i<image.length1d();i++)
+        image.at1d(i) = rand()%100<density ? 0 : 255;
+    // some longer runs, so that the upper bins get used
+    for(int k=0;k<3;k++) {
+        int x = rand()%w, y = rand()%h;
+        byte c = rand()%2 ? 0 : 255;
+        for(int i=0;i<200;i++) {
+            image(x,y) = c;
+            if(k==0) x = (x+1)%w;
+            else if(k==1) y = (y+1)%h;
+            else { x = (x+1)%w; y = (y+1)%h; }
+        }
+    }
+}
+
+// Histograms have to be identical.  The reference accumulates the
+// moments in float and runLengths() in double, so those are compared
+// with a tolerance.
+static bool same_features(bytearray &image,const rectangle &r) {
+    ZoneFeatures zf;
+    floatarray hist,stats,expected,actual;
+    horizontalRunLengths(zf,hist,stats,image,r);
+    verticalRunLengths(zf,hist,stats,image,r);
+    mainDiagRunLengths(zf,hist,stats,image,r);
+    sideDiagRunLengths(zf,hist,stats,image,r);
+    copy(expected,hist);
+    for(int i=0;i<stats.length();i++)
+        expected.push(stats(i));
+    zf.runLengths(actual,image,r);
+    if(actual.length()!=expected.length()) return false;
+    for(int i=0;i<hist.length();i++)
+        if(actual(i)!=expected(i)) return false;
+    for(int i=hist.length();i<expected.length();i++) {
+        float e = expected(i), a = actual(i);
+        if(fabs(a-e)>1e-3*max(1.0f,fabs(e))) return false;
+    }
+    return true;
+}
+
+int main() {
+    srand(0);
+    int sizes[][2] = {{1,1},{1,17},{23,1},{5,5},{40,13},{13,40},{130,90},{300,301}};
+    int nsizes = sizeof sizes/sizeof sizes[0];
+    for(int i=0;i<nsizes;i++) {
+        for(int density=5;density<100;density+=30) {
+            bytearray image;
+            int w = sizes[i][0], h = sizes[i][1];
+            make_zone(image,w,h,density);
+            CHECK_CONDITION(same_features(image,rectangle(0,0,w,h)));
+            // a zone inside a larger page
+            bytearray page;
+            make_zone(page,w+20,h+10,density);
+            CHECK_CONDITION(same_features(page,rectangle(7,3,w+7,h+3)));
+        }
+    }
+    return 0;
+}
@@ -1,5 +1,9 @@
+#include <stdlib.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "glinerec.h"
 #ifdef HAVE_GSL
 #include "gsl.h"
@@ -14,28 +18,9 @@ namespace glinerec {
 
     typedef long long uint64;
 
-    int bitcount0(uint64 v) {
-        int total = 0;
-        for(int i=0;i<64;i++) {
-            if(v&1) total++;
-            v>>=1;
-        }
-        return total;
-    }
-
-    static int counts16[65536];
-    int counts16_init() {
-        for(int i=0;i<65536;i++)
-            counts16[i] = bitcount0(i);
-        return 0;
-    }
-
-    int init_0 = counts16_init();
-
-    int bitcount(uint64 v) {
-        // this is about twice as fast as bitcount1
-        return counts16[v&0xffff]+counts16[(v>>16)&0xffff]+
-            counts16[(v>>32)&0xffff]+counts16[(v>>48)&0xffff];
+    inline int bitcount(uint64 v) {
+        // compiles to a single POPCNT instruction where available
+        return __builtin_popcountll(v);
     }
 
     struct bitvec {
@@ -128,12 +113,16 @@ namespace glinerec {
         }
     };
 
-    void bitvec_write(FILE *stream,bitvec &v) {
+    void bitvec_write(FILE *stream,uint64 *data,int nwords) {
         magic_write(stream,"BV");
-        CHECK(unsigned(v.nwords)<1000000);
-        scalar_write(stream,v.nwords);
-        CHECK(fwrite(v.data,sizeof *v.data,v.nwords,stream)==
-              unsigned(v.nwords));
+        CHECK(unsigned(nwords)<1000000);
+        scalar_write(stream,nwords);
+        CHECK(fwrite(data,sizeof *data,nwords,stream)==
+              unsigned(nwords));
+    }
+
+    void bitvec_write(FILE *stream,bitvec &v) {
+        bitvec_write(stream,v.data,v.nwords);
     }
 
     void bitvec_read(FILE *stream,bitvec &v) {
@@ -253,9 +242,117 @@ namespace glinerec {
               unsigned(v.nwords));
     }
 
+    // All prototypes in one block of memory, one row per prototype.
+    // Rows are padded with zero words to a multiple of four words and
+    // aligned to 32 bytes, so distances can be computed 256 bits at a
+    // time without any tail handling.
+
+    struct BitMatrix {
+        enum { align=4 };
+        int nrows,nwords,stride,capacity;
+        uint64 *data;
+        BitMatrix() {
+            nrows = nwords = stride = capacity = 0;
+            data = 0;
+        }
+        ~BitMatrix() {
+            free(data);
+        }
+        void clear() {
+            free(data);
+            nrows = nwords = stride = capacity = 0;
+            data = 0;
+        }
+        void reserve(int n) {
+            if(n<=capacity) return;
+            void *block = 0;
+            if(posix_memalign(&block,align*sizeof *data,
+                              size_t(n)*stride*sizeof *data))
+                throw "out of memory";
+            if(data) memcpy(block,data,size_t(nrows)*stride*sizeof *data);
+            free(data);
+            data = (uint64*)block;
+            capacity = n;
+        }
+        uint64 *row(int i) {
+            return data+size_t(i)*stride;
+        }
+        void push(bitvec &v) {
+            if(nrows==0) {
+                clear();
+                nwords = v.nwords;
+                stride = (nwords+align-1)/align*align;
+            }
+            CHECK(v.nwords==nwords);
+            if(nrows==capacity) reserve(max(64,2*capacity));
+            uint64 *p = row(nrows++);
+            memcpy(p,v.data,nwords * sizeof *p);
+            for(int i=nwords;i<stride;i++) p[i] = 0;
+        }
+    private:
+        BitMatrix(const BitMatrix &);
+        void operator=(const BitMatrix &);
+    };
+
+    // Hamming distance between two padded rows.
+    inline int hamming(const uint64 *p,const uint64 *q,int stride) {
+#ifdef __AVX2__
+        // nibble lookup with vpshufb; the byte counts are summed with
+        // vpsadbw.  Prototypes are only a few hundred to a few thousand
+        // bits, too short for a full Harley-Seal carry-save block.
+        const __m256i lookup = _mm256_setr_epi8(
+            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        __m256i acc = _mm256_setzero_si256();
+        for(int i=0;i<stride;i+=4) {
+            __m256i v = _mm256_xor_si256(
+                _mm256_load_si256((const __m256i*)(p+i)),
+                _mm256_load_si256((const __m256i*)(q+i)));
+            __m256i lo = _mm256_shuffle_epi8(lookup,_mm256_and_si256(v,nibble));
+            __m256i hi = _mm256_shuffle_epi8(lookup,
+                _mm256_and_si256(_mm256_srli_epi16(v,4),nibble));
+            acc = _mm256_add_epi64(acc,_mm256_sad_epu8(_mm256_add_epi8(lo,hi),
+                                                       _mm256_setzero_si256()));
+        }
+        return int(_mm256_extract_epi64(acc,0)+_mm256_extract_epi64(acc,1)+
+                   _mm256_extract_epi64(acc,2)+_mm256_extract_epi64(acc,3));
+#else
+        int total = 0;
+        for(int i=0;i<stride;i++)
+            total += bitcount(p[i]^q[i]);
+        return total;
+#endif
+    }
+
+    // The k smallest distances seen so far, in increasing order; among
+    // equal distances, the earliest one added comes first.
+    struct TopK {
+        int k,n;
+        int *dists,*ids;
+        void init(int k_,int *dists_,int *ids_) {
+            k = k_;
+            n = 0;
+            dists = dists_;
+            ids = ids_;
+        }
+        void add(int d,int id) {
+            if(n==k && d>=dists[k-1]) return;
+            int i = n<k ? n++ : k-1;
+            while(i>0 && dists[i-1]>d) {
+                dists[i] = dists[i-1];
+                ids[i] = ids[i-1];
+                i--;
+            }
+            dists[i] = d;
+            ids[i] = id;
+        }
+    };
+
     struct BitNN : IBatchDense {
+        enum { block_size=1024 };
         int nfeat;
-        objlist<bitvec> prototypes;
+        BitMatrix prototypes;
         intarray classes;
         BitNN() {
             pdef("k",1,"number of nearest neighbors");
@@ -269,21 +366,22 @@ namespace glinerec {
             pprint(stream,depth);
             int k = pgetf("k");
             iprintf(stream,depth,"nfeat %d nprotos %d nclasses %d k %d\n",
-                    nfeat,prototypes.length(),max(classes)+1,k);
+                    nfeat,prototypes.nrows,max(classes)+1,k);
         }
         void save(FILE *stream) {
             psave(stream);
             narray_write(stream,classes);
-            for(int i=0;i<classes.length();i++) {
-                bitvec_write(stream,prototypes[i]);
-            }
+            for(int i=0;i<classes.length();i++)
+                bitvec_write(stream,prototypes.row(i),prototypes.nwords);
         }
         void load(FILE *stream) {
             pload(stream);
             narray_read(stream,classes);
-            prototypes.resize(classes.length());
+            prototypes.clear();
+            bitvec v;
             for(int i=0;i<classes.length();i++) {
-                bitvec_read(stream,prototypes[i]);
+                bitvec_read(stream,v);
+                prototypes.push(v);
             }
         }
         int nfeatures() {
@@ -293,7 +391,7 @@ namespace glinerec {
             return max(classes)+1;
         }
         void print() {
-            printf("<BitNN #protos %d>\n",prototypes.length());
+            printf("<BitNN #protos %d>\n",prototypes.nrows);
         }
         void train_dense(IDataset &ds) {
             floatarray v;
@@ -305,24 +403,102 @@ namespace glinerec {
         void train1(floatarray &v,int c) {
             if(nfeat==0) nfeat = v.length();
             else CHECK(nfeat==v.length());
-            prototypes.push().set(v);
+            bitvec bv;
+            bv.set(v);
+            prototypes.push(bv);
             classes.push(c);
         }
-        float outputs_dense(floatarray &result,floatarray &v) {
-            floatarray p;
+
+        // Find the k nearest prototypes for each row of queries.
+        // Prototypes are scanned in blocks in parallel, each block
+        // keeping its own top k per query, and the per-block lists
+        // are merged in block order, so the result does not depend
+        // on the number of threads.
+        void nearest(intarray &ids,intarray &dists,BitMatrix &queries,int k) {
+            int n = prototypes.nrows;
+            int nq = queries.nrows;
+            k = min(k,n);
+            ids.resize(nq,k);
+            dists.resize(nq,k);
+            if(k<1) return;
+            CHECK(queries.stride==prototypes.stride);
+            int nblocks = (n+block_size-1)/block_size;
+            intarray block_ids(nblocks*nq,k),block_dists(nblocks*nq,k);
+            intarray block_counts(nblocks*nq);
+#pragma omp parallel for schedule(dynamic,1)
+            for(int b=0;b<nblocks;b++) {
+                int start = b*block_size, end = min(n,start+block_size);
+                for(int q=0;q<nq;q++) {
+                    int row = b*nq+q;
+                    TopK top;
+                    top.init(k,&block_dists(row,0),&block_ids(row,0));
+                    uint64 *query = queries.row(q);
+                    for(int j=start;j<end;j++)
+                        top.add(hamming(prototypes.row(j),query,prototypes.stride),j);
+                    block_counts(row) = top.n;
+                }
+            }
+            for(int q=0;q<nq;q++) {
+                TopK top;
+                top.init(k,&dists(q,0),&ids(q,0));
+                for(int b=0;b<nblocks;b++) {
+                    int row = b*nq+q;
+                    for(int i=0;i<block_counts(row);i++)
+                        top.add(block_dists(row,i),block_ids(row,i));
+                }
+            }
+        }
+
+        // Classify every row of vs at once; result gets one row of
+        // class posteriors per query, costs the matching cost.  (Not
+        // called outputs_batch, which would hide the IModel one.)
+        void outputs_rows(floatarray &result,floatarray &costs,floatarray &vs) {
             int k = pgetf("k");
+            int nq = vs.dim(0);
+            BitMatrix queries;
+            floatarray v;
             bitvec bv;
-            bv.set(v);
-            int n = prototypes.length();
-            floatarray dists(n);
-#pragma omp parallel for
-            for(int j=0;j<n;j++)
-                dists(j) = prototypes[j].dist(bv);
-            knn_posterior(p,classes,dists,k);
-            int nearest = argmin(dists);
-            float cost = dists(nearest)/10.0;
-            result = p;
-            return cost;
+            for(int q=0;q<nq;q++) {
+                rowget(v,vs,q);
+                bv.set(v);
+                queries.push(bv);
+            }
+            intarray ids,dists;
+            nearest(ids,dists,queries,k);
+            int nc = max(classes)+1;
+            result.resize(nq,nc);
+            fill(result,0);
+            costs.resize(nq);
+            for(int q=0;q<nq;q++) {
+                int found = ids.dim(1);
+                for(int i=0;i<found;i++)
+                    result(q,classes(ids(q,i))) += 1.0/found;
+                costs(q) = found>0 ? dists(q,0)/10.0 : 0.0;
+            }
+        }
+
+        float outputs_dense(floatarray &result,floatarray &v) {
+            floatarray vs,results,costs;
+            vs.resize(1,v.length());
+            for(int i=0;i<v.length();i++) vs(0,i) = v(i);
+            outputs_rows(results,costs,vs);
+            rowget(result,results,0);
+            return costs(0);
+        }
+
+        void outputs_dense_batch(narray<floatarray> &results,floatarray &costs,
+                                 narray<floatarray> &vs) {
+            int n = vs.length();
+            results.resize(n);
+            costs.resize(n);
+            if(n==0) return;
+            floatarray rows,out;
+            rows.resize(n,vs(0).length());
+            for(int q=0;q<n;q++)
+                rowput(rows,q,vs(q));
+            outputs_rows(out,costs,rows);
+            for(int q=0;q<n;q++)
+                rowget(results(q),out,q);
         }
     };
 
@@ -0,0 +1,151 @@
+// -*- C++ -*-
+
+// Copyright 2006-2007 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File: glcache.cc
+// Purpose: cache for per-line feature maps and estimates
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de, www.ocropus.org
+
+#include "ocropus.h"
+#include "glcache.h"
+
+using namespace colib;
+using namespace ocropus;
+using namespace glinerec;
+
+namespace {
+    param_int line_cache_mbytes("line_cache_mbytes",64,
+                                "memory used for caching per-line feature maps (Mbytes)");
+
+    enum { max_entries = 256 };
+
+    struct Entry {
+        uint64_t h1,h2;
+        int w,h;
+        int64_t used;
+        int nbytes;
+        LineMaps maps;
+        Entry() {
+            h1 = h2 = 0;
+            w = h = 0;
+            used = -1;
+            nbytes = 0;
+        }
+    };
+
+    Entry entries[max_entries];
+    int64_t ticks = 0;
+    int64_t total = 0;
+
+    int find(uint64_t h1,uint64_t h2,int w,int h) {
+        for(int i=0;i<max_entries;i++) {
+            Entry &e = entries[i];
+            if(e.used>=0 && e.h1==h1 && e.h2==h2 && e.w==w && e.h==h)
+                return i;
+        }
+        return -1;
+    }
+
+    void drop(int i) {
+        total -= entries[i].nbytes;
+        entries[i].maps.clear();
+        entries[i].nbytes = 0;
+        entries[i].used = -1;
+    }
+
+    // least recently used entry, or -1 if the cache is empty
+    int oldest() {
+        int oldest = -1;
+        for(int i=0;i<max_entries;i++) {
+            if(entries[i].used<0) continue;
+            if(oldest<0 || entries[i].used<entries[oldest].used) oldest = i;
+        }
+        return oldest;
+    }
+
+    void copy_maps(LineMaps &out,LineMaps &in) {
+        out.bytes.resize(in.bytes.length());
+        for(int i=0;i<in.bytes.length();i++)
+            out.bytes(i) = in.bytes(i);
+        out.floats.resize(in.floats.length());
+        for(int i=0;i<in.floats.length();i++)
+            out.floats(i) = in.floats(i);
+    }
+}
+
+namespace glinerec {
+    bool line_cache_get(LineMaps &maps,LineKey &key) {
+        if(line_cache_mbytes<=0) return false;
+        uint64_t h1,h2;
+        key.hash.digest(h1,h2);
+        bool found = false;
+#pragma omp critical(line_cache)
+        {
+            int i = find(h1,h2,key.w,key.h);
+            if(i>=0) {
+                entries[i].used = ticks++;
+                copy_maps(maps,entries[i].maps);
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    void line_cache_put(LineKey &key,LineMaps &maps) {
+        int64_t limit = int64_t(line_cache_mbytes) * 1000000;
+        int nbytes = maps.nbytes();
+        if(nbytes>limit) return;
+        uint64_t h1,h2;
+        key.hash.digest(h1,h2);
+#pragma omp critical(line_cache)
+        {
+            int i = find(h1,h2,key.w,key.h);
+            if(i>=0) drop(i);
+            while(total+nbytes>limit) {
+                int j = oldest();
+                if(j<0) break;
+                drop(j);
+            }
+            i = 0;
+            while(i<max_entries && entries[i].used>=0) i++;
+            if(i==max_entries) {
+                i = oldest();
+                drop(i);
+            }
+            Entry &e = entries[i];
+            e.h1 = h1;
+            e.h2 = h2;
+            e.w = key.w;
+            e.h = key.h;
+            e.used = ticks++;
+            e.nbytes = nbytes;
+            copy_maps(e.maps,maps);
+            total += nbytes;
+        }
+    }
+
+    void line_cache_clear() {
+#pragma omp critical(line_cache)
+        {
+            for(int i=0;i<max_entries;i++)
+                if(entries[i].used>=0) drop(i);
+        }
+    }
+}
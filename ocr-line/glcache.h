@@ -0,0 +1,87 @@
+// -*- C++ -*-
+
+// Copyright 2006-2007 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File: glcache.h
+// Purpose: cache for per-line feature maps and estimates
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de, www.ocropus.org
+
+#ifndef glcache_h__
+#define glcache_h__
+
+#include <stdint.h>
+#include "ocropus.h"
+
+namespace glinerec {
+    using namespace colib;
+    using namespace ocropus;
+
+    // Results computed from a text line image that are expensive to
+    // recompute, like the distance transforms and skeletal features
+    // of a feature map or the baseline of a line.  The same lines
+    // get set repeatedly (MetaLinerec dispatch, alignment, retraining
+    // epochs), so these are kept in a process-wide cache.
+
+    struct LineMaps {
+        narray<bytearray> bytes;
+        narray<floatarray> floats;
+        void clear() {
+            bytes.clear();
+            floats.clear();
+        }
+        int nbytes() {
+            int total = 0;
+            for(int i=0;i<bytes.length();i++)
+                total += bytes(i).length();
+            for(int i=0;i<floats.length();i++)
+                total += floats(i).length() * sizeof (float);
+            return total;
+        }
+    };
+
+    // Keys hash a tag naming whoever computed the maps and the line
+    // image with the stage cache's StageKey; mix in the parameters the
+    // maps depend on with add.  The dimensions of the image are kept
+    // next to the hash, and lookups compare both.  Also used by the
+    // line size estimates in linerec.cc.
+
+    struct LineKey {
+        StageKey hash;
+        int w,h;
+        LineKey(bytearray &image,const char *tag) : hash(tag) {
+            w = image.dim(0);
+            h = image.dim(1);
+            hash.add(image);
+        }
+        void add(const char *s) {
+            hash.add(s);
+        }
+    };
+
+    // The cache holds copies; get copies the entry into maps and
+    // marks it as recently used.  When the cache grows beyond the
+    // line_cache_mbytes limit, the least recently used entries are
+    // dropped; a limit of 0 turns caching off.
+    bool line_cache_get(LineMaps &maps,LineKey &key);
+    void line_cache_put(LineKey &key,LineMaps &maps);
+    void line_cache_clear();
+}
+
+#endif
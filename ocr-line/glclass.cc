@@ -1457,6 +1457,38 @@ namespace glinerec {
             result /= sum(result);
             return 0.0;
         }
+
+        // Same as outputs_dense, but each round's model scores the
+        // whole batch at once instead of one sample at a time.
+        void outputs_dense_batch(narray<floatarray> &results,floatarray &costs,
+                                 narray<floatarray> &vs) {
+            int n = vs.length();
+            int nc = nclasses();
+            results.resize(n);
+            costs.resize(n);
+            costs = 0;
+            for(int j=0;j<n;j++) {
+                results(j).resize(nc);
+                results(j) = 0;
+            }
+            narray<OutputVector> ps;
+            floatarray pcosts;
+            for(int round=0;round<models.length();round++) {
+                models(round)->xoutputs_batch(ps,pcosts,vs);
+                double alpha = alphas(round);
+#pragma omp parallel for schedule(static)
+                for(int j=0;j<n;j++) {
+                    floatarray &result = results(j);
+                    OutputVector &p = ps(j);
+                    for(int i=0;i<p.length();i++)
+                        result(i) += alpha * p(i);
+                }
+            }
+            for(int j=0;j<n;j++) {
+                results(j) += min(results(j));
+                results(j) /= sum(results(j));
+            }
+        }
     };
 
     ////////////////////////////////////////////////////////////////
@@ -1665,6 +1697,15 @@ namespace glinerec {
             }
         }
 
+        void add_junk(OutputVector &result,OutputVector &jv) {
+            result.normalize();
+            floatarray junk;
+            jv.as_array(junk);
+            for(int i=0;i<result.nkeys();i++)
+                result.values(i) *= junk(0);
+            result(jc()) = junk(1);
+        }
+
         float outputs(OutputVector &result,floatarray &v) {
             OutputVector ov;
 
@@ -1673,14 +1714,9 @@ namespace glinerec {
             CHECK(result.nkeys()>0);
 
             if(pgetf("junk") && junkclass) {
-                result.normalize();
                 OutputVector jv;
                 junkclass->xoutputs(jv,v);
-                floatarray junk;
-                jv.as_array(junk);
-                for(int i=0;i<result.nkeys();i++)
-                    result.values(i) *= junk(0);
-                result(jc()) = junk(1);
+                add_junk(result,jv);
             }
 
             if(pgetf("ul") && ulclass) {
@@ -1689,6 +1725,33 @@ namespace glinerec {
 
             return 0.0;
         }
+
+        // Run the character classifier over the whole batch, then
+        // the junk classifier over the whole batch, and combine.
+        void outputs_batch(narray<OutputVector> &results,floatarray &costs,
+                           narray<floatarray> &vs) {
+            int n = vs.length();
+            floatarray ccosts;
+            charclass->xoutputs_batch(results,ccosts,vs);
+            for(int j=0;j<n;j++)
+                CHECK(results(j).nkeys()>0);
+            costs.resize(n);
+            costs = 0;
+
+            if(pgetf("junk") && junkclass) {
+                narray<OutputVector> jvs;
+                floatarray jcosts;
+                junkclass->xoutputs_batch(jvs,jcosts,vs);
+                jc(); // look up the parameter before going parallel
+#pragma omp parallel for schedule(static)
+                for(int j=0;j<n;j++)
+                    add_junk(results(j),jvs(j));
+            }
+
+            if(pgetf("ul") && ulclass) {
+                throw "ulclass not implemented";
+            }
+        }
     };
 
     struct RaveledExtractor : virtual IExtractor {
@@ -1772,15 +1835,13 @@ namespace glinerec {
             components = 0;
             for(int i=0;i<components.length();i++)
                 components[i] = (input[i]>threshold);
-            int n = label_components(components);
+            ocropus::ConnectedComponents ccs;
+            int n = ccs.label(components);
             dshowr(components,"d");
-            intarray totals(n+1);
-            totals = 0;
-            for(int i=0;i<components.length();i++)
-                totals[components[i]]++;
+            intarray totals;
+            copy(totals,ccs.areas);
             totals[0] = 0;
-            rectarray boxes;
-            bounding_boxes(boxes,components);
+            rectarray &boxes = ccs.boxes;
             int biggest = argmax(totals);
             rectangle r = boxes[biggest];
             int pad = int(pgetf("pad")+0.5);
@@ -1840,10 +1901,10 @@ namespace glinerec {
             for(int i=0;i<components.length();i++) components[i] = (input[i]>threshold);
 
             // compute the number of pixels in each component
-            int n = label_components(components);
-            intarray totals(n+1);
-            totals = 0;
-            for(int i=0;i<components.length();i++) totals[components[i]]++;
+            ocropus::ConnectedComponents ccs;
+            int n = ccs.label(components);
+            intarray totals;
+            copy(totals,ccs.areas);
             totals[0] = 0;
             int biggest = argmax(totals);
 
@@ -1986,12 +2047,15 @@ namespace glinerec {
             int n = pgetf("n");
             float step = pgetf("step");
             bool bs = pgetf("binsmooth");
+            BitImage packed,dilated_bits;
+            if(!bs) bits_pack(packed,thresholded);
             for(int i=0;i<n;i++) {
                 float sigma = step*i;
                 if(bs) binsmooth(binary,input,sigma);
                 else {
-                    binary = thresholded;
-                    binary_dilate_circle(binary,int(sigma));
+                    bits_copy(dilated_bits,packed);
+                    bits_dilate_circle(dilated_bits,int(sigma));
+                    bits_unpack(binary,dilated_bits);
                 }
                 skeletal_features(endpoints1,junctions1,binary,0.0,0.0);
                 greater(junctions1,0,0,1);
@@ -2015,20 +2079,48 @@ namespace glinerec {
 #ifdef HAVE_SQLITE3
 #include <sqlite3.h>
 
-    struct SqliteDataset : IDataset {
+#define SQLCHECK(S) \
+    if((S)!=SQLITE_OK) { const char *err = sqlite3_errmsg(db); throwf("sqlite error: %s\n",err); }
+
+    // Samples are rows of a table; features go into a blob holding
+    // a type byte ('f' for floats, '8' for float8), the rank, the
+    // dimensions and the values.  Inserts use one prepared statement
+    // and are grouped into transactions of "batch" rows.  On reading,
+    // the ids and classes of all rows are loaded when the database is
+    // opened; features are read on demand, a block of "prefetch" rows
+    // at a time when samples are accessed in order, and one at a time
+    // otherwise.  Rows written by older versions (class in the cls
+    // text column, features in the pickled image column) can still
+    // be read.
+
+    struct SqliteDataset : IExtDataset {
         sqlite3 *db;
-        int n;
+        sqlite3_stmt *insert_stmt;
+        sqlite3_stmt *block_stmt;
+        sqlite3_stmt *row_stmt;
+        int pending;
+        bool in_transaction;
+        intarray ids;
+        intarray classes;
         int nc;
         int nf;
+        // features of samples [buffer_start,buffer_start+buffer.length())
+        objlist<floatarray> buffer;
+        int buffer_start;
+        int last;
 
         SqliteDataset() {
             pdef("table","chars","table name for characters");
             pdef("file","dataset.sqlite3","location for dataset");
             pdef("sync",0,"commit after each insert");
-            n = 0;
-            nc = 0;
-            nf = -1;
+            pdef("batch",10000,"number of inserts per transaction");
+            pdef("prefetch",1000,"number of samples read at once for sequential access");
+            pdef("float8",0,"store features as float8 (values in [-1.2,1.2])");
             db = 0;
+            insert_stmt = 0;
+            block_stmt = 0;
+            row_stmt = 0;
+            reset();
         }
         ~SqliteDataset() {
             close();
@@ -2036,11 +2128,45 @@ namespace glinerec {
         const char *name() {
             return "sqliteds";
         }
+        void reset() {
+            pending = 0;
+            in_transaction = false;
+            ids.clear();
+            classes.clear();
+            nc = 0;
+            nf = -1;
+            buffer.clear();
+            buffer_start = 0;
+            last = -2;
+        }
         void save(FILE *stream) {
         }
         void load(FILE *stream) {
         }
+        // the data lives in the database, so these just bind to it
+        void save(const char *file) {
+            if(!db) open(file);
+            commit();
+        }
+        void load(const char *file) {
+            open(file);
+        }
+        void exec(const char *cmd) {
+            char *err = 0;
+            if(sqlite3_exec(db,cmd,0,0,&err)!=SQLITE_OK) {
+                strg message;
+                message = err?err:"unknown error";
+                sqlite3_free(err);
+                throwf("%s: %s",cmd,message.c_str());
+            }
+        }
+        void prepare(sqlite3_stmt *&stmt,const char *cmd) {
+            char cmd_buf[1024];
+            sprintf(cmd_buf,cmd,pget("table"));
+            SQLCHECK(sqlite3_prepare_v2(db,cmd_buf,-1,&stmt,0));
+        }
         void open(const char *file) {
+            close();
             debugf("info","binding to database %s\n",file);
             int status = sqlite3_open_v2(file,&db,
                                          SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE,0);
@@ -2059,33 +2185,74 @@ namespace glinerec {
                 "pred text,"
                 "cost real,"
                 "style text,"
-                "which text"
+                "which text,"
+                "label integer,"
+                "features blob"
                 ")";
             char schema_buf[10000];
             sprintf(schema_buf,schema,pget("table"));
             if(sqlite3_exec(db,schema_buf,0,0,0)!=SQLITE_OK) {
                 debugf("info","create table: %s\n",sqlite3_errmsg(db));
+                // tables from older versions lack these; fails if present
+                sprintf(schema_buf,"alter table %s add column label integer",pget("table"));
+                sqlite3_exec(db,schema_buf,0,0,0);
+                sprintf(schema_buf,"alter table %s add column features blob",pget("table"));
+                sqlite3_exec(db,schema_buf,0,0,0);
             }
             sqlite3_exec(db,"PRAGMA synchronous=off",0,0,0);
+            prepare(insert_stmt,"insert into %s (style,which,image,cls,pred,cost,label,features) "
+                    "values (?,?,null,?,?,?,?,?)");
+            prepare(block_stmt,"select id,features,image from %s where id>=? order by id limit ?");
+            prepare(row_stmt,"select id,features,image from %s where id=?");
+            read_index();
         }
         void close() {
+            if(!db) return;
+            try {
+                commit();
+            } catch(const char *error) {
+                debugf("error","%s: %s\n",pget("file"),error);
+            }
+            sqlite3_finalize(insert_stmt);
+            sqlite3_finalize(block_stmt);
+            sqlite3_finalize(row_stmt);
+            insert_stmt = block_stmt = row_stmt = 0;
             sqlite3_close(db);
             db = 0;
+            reset();
+        }
+        void commit() {
+            if(!db || !in_transaction) return;
+            exec("COMMIT");
+            in_transaction = false;
+            pending = 0;
         }
-        static void pickle(bytearray &v,floatarray &image) {
-            int w = image.dim(0);
-            int h = image.dim(1);
-            floatarray temp(h,w);
-            float m = max(image);
-            for(int i=0;i<w;i++)
-                for(int j=0;j<h;j++)
-                    temp(h-j-1,i) = image(i,j)*255.0/m;
-            v.clear();
-            v.push(h);
-            v.push(w);
-            for(int i=0;i<temp.length();i++)
-                v.push(int(temp[i]));
+        void read_index() {
+            sqlite3_stmt *stmt;
+            prepare(stmt,"select id,label,cls from %s order by id");
+            int status;
+            while((status = sqlite3_step(stmt))==SQLITE_ROW) {
+                ids.push(sqlite3_column_int(stmt,0));
+                int c;
+                if(sqlite3_column_type(stmt,1)!=SQLITE_NULL) {
+                    c = sqlite3_column_int(stmt,1);
+                } else {
+                    const unsigned char *text = sqlite3_column_text(stmt,2);
+                    c = text && *text ? *text : -1;
+                }
+                classes.push(c);
+                if(c>=nc) nc = c+1;
+            }
+            sqlite3_finalize(stmt);
+            if(status!=SQLITE_DONE) throwf("sqlite error: %s\n",sqlite3_errmsg(db));
+            if(ids.length()>0) {
+                floatarray v;
+                input(v,0);
+                nf = v.length();
+            }
+            debugf("info","%d samples in table %s\n",ids.length(),pget("table"));
         }
+
         static void unpickle(floatarray &image,bytearray &v) {
             int h = v[0];
             int w = v[1];
@@ -2094,55 +2261,113 @@ namespace glinerec {
                 for(int i=0;i<w;i++)
                     image(i,j) = v[2+(h-j-1)*w+i]/255.0;
         }
+        static void encode(bytearray &blob,floatarray &v,bool use_float8) {
+            int rank = v.rank();
+            int header = 2+4*rank;
+            int size = use_float8 ? 1 : sizeof (float);
+            blob.resize(header+size*v.length());
+            blob(0) = use_float8 ? '8' : 'f';
+            blob(1) = rank;
+            for(int i=0;i<rank;i++) {
+                int d = v.dim(i);
+                memcpy(&blob(2+4*i),&d,4);
+            }
+            if(use_float8) {
+                for(int i=0;i<v.length();i++) {
+                    float8 value(v.at1d(i));
+                    blob(header+i) = byte(value.val);
+                }
+            } else if(v.length()>0) {
+                memcpy(&blob(header),&v.at1d(0),size*v.length());
+            }
+        }
+        static void decode(floatarray &v,const void *data,int nbytes) {
+            const byte *p = (const byte *)data;
+            if(nbytes<2) throw "sqliteds: bad feature blob";
+            int rank = p[1];
+            int header = 2+4*rank;
+            if(rank<1 || rank>4 || nbytes<header) throw "sqliteds: bad feature blob";
+            int dims[4] = {0,0,0,0};
+            for(int i=0;i<rank;i++) memcpy(&dims[i],p+2+4*i,4);
+            v.resize(dims[0],dims[1],dims[2],dims[3]);
+            int size = p[0]=='8' ? 1 : sizeof (float);
+            if(nbytes!=header+size*v.length()) throw "sqliteds: bad feature blob";
+            if(p[0]=='8') {
+                for(int i=0;i<v.length();i++) {
+                    float8 value;
+                    value.val = (signed char)p[header+i];
+                    v.at1d(i) = value;
+                }
+            } else if(v.length()>0) {
+                memcpy(&v.at1d(0),p+header,size*v.length());
+            }
+        }
+        // features of the current row of stmt
+        void column_features(floatarray &v,sqlite3_stmt *stmt) {
+            if(sqlite3_column_type(stmt,1)!=SQLITE_NULL) {
+                decode(v,sqlite3_column_blob(stmt,1),sqlite3_column_bytes(stmt,1));
+            } else {
+                int nbytes = sqlite3_column_bytes(stmt,2);
+                const byte *p = (const byte *)sqlite3_column_blob(stmt,2);
+                if(!p || nbytes<2) throw "sqliteds: sample without features";
+                bytearray bv(nbytes);
+                memcpy(&bv(0),p,nbytes);
+                unpickle(v,bv);
+            }
+        }
+
         void add(const char *style,const char *which,floatarray &v,int c,
                  int pred,float cost) {
-            CHECK(v.rank()==2);
-            CHECK(v.dim(0)>0);
-            CHECK(v.dim(0)<256);
-            CHECK(v.dim(1)>0);
-            CHECK(v.dim(1)<256);
+            CHECK(v.length()>0);
+            CHECK(c>=-1);
             if(!db) open(pget("file"));
-            const char *cmd = "insert into %s (style,which,image,cls,pred,cost) "
-                "values (?,?,?,?,?,?)";
-            char cmd_buf[1024];
-            sprintf(cmd_buf,cmd,pget("table"));
-            sqlite3_stmt *stmt;
-#define SQLCHECK(S) \
-    if((S)!=SQLITE_OK) { const char *err = sqlite3_errmsg(db); throwf("sqlite error: %s\n",err); }
-            SQLCHECK(sqlite3_prepare(db,cmd_buf,-1,&stmt,0));
+            // encoding fails on values float8 can't hold
+            bytearray blob;
+            encode(blob,v,pgetf("float8"));
+            // a failed insert leaves the transaction open with nothing
+            // pending, so pending can't tell whether one was begun
+            if(!in_transaction) {
+                exec("BEGIN");
+                in_transaction = true;
+            }
+            sqlite3_stmt *stmt = insert_stmt;
             // style, which
             SQLCHECK(sqlite3_bind_text(stmt,1,style,strlen(style),SQLITE_TRANSIENT));
             SQLCHECK(sqlite3_bind_text(stmt,2,which,strlen(which),SQLITE_TRANSIENT));
-            // image
-            bytearray bv;
-            pickle(bv,v);
-            CHECK(bv.length()==v.length()+2);
-            SQLCHECK(sqlite3_bind_blob(stmt,3,&bv(0),bv.length(),SQLITE_TRANSIENT));
-            // cls, pred
+            // cls, pred as characters, like older versions
             char text[2];
-            text[0] = c; text[1] = 0;
+            text[0] = c>0 && c<256 ? c : 0; text[1] = 0;
+            SQLCHECK(sqlite3_bind_text(stmt,3,text,strlen(text),SQLITE_TRANSIENT));
+            text[0] = pred>0 && pred<256 ? pred : 0; text[1] = 0;
             SQLCHECK(sqlite3_bind_text(stmt,4,text,strlen(text),SQLITE_TRANSIENT));
-            text[0] = pred; text[1] = 0;
-            SQLCHECK(sqlite3_bind_text(stmt,5,text,strlen(text),SQLITE_TRANSIENT));
             // cost
-            SQLCHECK(sqlite3_bind_double(stmt,6,cost));
-            CHECK(sqlite3_step(stmt)==SQLITE_DONE);
-            SQLCHECK(sqlite3_finalize(stmt));
-            if(pgetf("sync")) {
-                char *err = 0;
-                if(sqlite3_exec(db,"COMMIT",0,0,&err)!=SQLITE_OK)
-                    throwf("%s:COMMIT",err);
-            }
-            debugf("debug","inserted\n");
-            n++;
+            SQLCHECK(sqlite3_bind_double(stmt,5,cost));
+            // label, features
+            SQLCHECK(sqlite3_bind_int(stmt,6,c));
+            SQLCHECK(sqlite3_bind_blob(stmt,7,&blob(0),blob.length(),SQLITE_TRANSIENT));
+            int status = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            if(status!=SQLITE_DONE) throwf("sqlite error: %s\n",sqlite3_errmsg(db));
+            ids.push(int(sqlite3_last_insert_rowid(db)));
+            classes.push(c);
+            pending++;
+            if(pgetf("sync") || pending>=pgetf("batch")) commit();
             if(c>=nc) nc = c+1;
             if(nf<0) nf = v.length();
         }
         void add(floatarray &v,int c) {
             add("","",v,c,-1,-1);
         }
+        void add(floatarray &ds,intarray &cs) {
+            floatarray v;
+            for(int i=0;i<ds.dim(0);i++) {
+                rowget(v,ds,i);
+                add(v,cs(i));
+            }
+        }
         int nsamples() {
-            return n;
+            return ids.length();
         }
         int nclasses() {
             return nc;
@@ -2151,16 +2376,71 @@ namespace glinerec {
             return nf;
         }
         void clear() {
-            throw "unimplemented";
+            if(!db) open(pget("file"));
+            commit();
+            char cmd_buf[1024];
+            sprintf(cmd_buf,"delete from %s",pget("table"));
+            exec(cmd_buf);
+            reset();
         }
         int cls(int i) {
-            throw "unimplemented";
-        }
-        void input(floatarray &v,int i) {
-            throw "unimplemented";
+            return classes(i);
         }
         int id(int i) {
-            throw "unimplemented";
+            return ids(i);
+        }
+        void fill_buffer(int start) {
+            buffer.clear();
+            buffer_start = start;
+            int count = min(int(pgetf("prefetch")),ids.length()-start);
+            sqlite3_stmt *stmt = block_stmt;
+            SQLCHECK(sqlite3_bind_int(stmt,1,ids(start)));
+            SQLCHECK(sqlite3_bind_int(stmt,2,count));
+            int status;
+            try {
+                while((status = sqlite3_step(stmt))==SQLITE_ROW) {
+                    int k = buffer_start+buffer.length();
+                    // rows added by someone else since opening
+                    if(k>=ids.length() || sqlite3_column_int(stmt,0)!=ids(k)) break;
+                    column_features(buffer.push(),stmt);
+                }
+            } catch(...) {
+                sqlite3_reset(stmt);
+                buffer.clear();
+                throw;
+            }
+            sqlite3_reset(stmt);
+            if(status!=SQLITE_ROW && status!=SQLITE_DONE) {
+                buffer.clear();
+                throwf("sqlite error: %s\n",sqlite3_errmsg(db));
+            }
+        }
+        void read_row(floatarray &v,int i) {
+            sqlite3_stmt *stmt = row_stmt;
+            SQLCHECK(sqlite3_bind_int(stmt,1,ids(i)));
+            int status = sqlite3_step(stmt);
+            if(status!=SQLITE_ROW) {
+                sqlite3_reset(stmt);
+                throwf("sqliteds: sample %d (id %d) not found",i,ids(i));
+            }
+            try {
+                column_features(v,stmt);
+            } catch(...) {
+                sqlite3_reset(stmt);
+                throw;
+            }
+            sqlite3_reset(stmt);
+        }
+        void input(floatarray &v,int i) {
+            CHECK_ARG(i>=0 && i<ids.length());
+            bool buffered = i>=buffer_start && i<buffer_start+buffer.length();
+            if(!buffered && i==last+1) {
+                fill_buffer(i);
+                buffered = buffer.length()>0;
+            }
+            last = i;
+            if(buffered) v.copy(buffer(i-buffer_start));
+            else read_row(v,i);
         }
     };
 
@@ -2200,6 +2480,7 @@ namespace glinerec {
             n++;
         }
         void updateModel() {
+            if(ds) ds->commit();
         }
         // ignore these
         void save(FILE *stream) {
@@ -174,6 +174,22 @@ namespace glinerec {
             return outputs(ov,temp);
         }
 
+        // Classify a whole batch of samples (e.g., all the candidate
+        // characters of a line); costs(i) is what xoutputs would
+        // have returned for vs(i).
+        void xoutputs_batch(narray<OutputVector> &ovs,floatarray &costs,
+                            narray<floatarray> &vs) {
+            if(!extractor) {
+                outputs_batch(ovs,costs,vs);
+                return;
+            }
+            narray<floatarray> temp(vs.length());
+#pragma omp parallel for schedule(dynamic,8)
+            for(int i=0;i<vs.length();i++)
+                extractor->extract(temp(i),vs(i));
+            outputs_batch(ovs,costs,temp);
+        }
+
         void xtrain(IDataset &ds) {
             if(!extractor) {
                 train(ds);
@@ -192,6 +208,17 @@ namespace glinerec {
         virtual float outputs(OutputVector &ov,floatarray &x) {
             throw Unimplemented();
         }
+        // Compound models override this to run each of their
+        // sub-models over the entire batch in turn.
+        virtual void outputs_batch(narray<OutputVector> &ovs,floatarray &costs,
+                                   narray<floatarray> &vs) {
+            int n = vs.length();
+            ovs.resize(n);
+            costs.resize(n);
+#pragma omp parallel for schedule(dynamic,8)
+            for(int i=0;i<n;i++)
+                costs(i) = outputs(ovs(i),vs(i));
+        }
         virtual void train(IDataset &ds) {
             floatarray v;
             for(int i=0;i<ds.nsamples();i++) {
@@ -308,6 +335,19 @@ namespace glinerec {
             return cost;
         }
 
+        void outputs_batch(narray<OutputVector> &results,floatarray &costs,
+                           narray<floatarray> &vs) {
+            narray<floatarray> outs;
+            outputs_dense_batch(outs,costs,vs);
+            results.resize(outs.length());
+            for(int j=0;j<outs.length();j++) {
+                OutputVector &result = results(j);
+                result.clear();
+                for(int i=0;i<outs(j).length();i++)
+                    result(i2c(i)) = outs(j)(i);
+            }
+        }
+
         struct TranslatedDataset : virtual IDataset {
             IDataset &ds;
             intarray &c2i;
@@ -346,6 +386,15 @@ namespace glinerec {
         virtual float outputs_dense(floatarray &result,floatarray &v) {
             throw Unimplemented();
         }
+        virtual void outputs_dense_batch(narray<floatarray> &results,floatarray &costs,
+                                         narray<floatarray> &vs) {
+            int n = vs.length();
+            results.resize(n);
+            costs.resize(n);
+#pragma omp parallel for schedule(dynamic,8)
+            for(int i=0;i<n;i++)
+                costs(i) = outputs_dense(results(i),vs(i));
+        }
     };
 
     struct IDistComp : IComponent {
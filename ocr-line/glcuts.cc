@@ -34,6 +34,7 @@
 #include <math.h>
 #include <ctype.h>
 #include "ocropus.h"
+#include "seg-dpcuts.h"
 #include "glcuts.h"
 
 using namespace ocropus;
@@ -234,11 +235,7 @@ namespace glinerec {
         int where;
 
         // output
-        intarray costs;
-        intarray sources;
-        int direction;
-        int limit;
-
+        DpCuts dp;
         intarray bestcuts;
 
         strbuf debug;
@@ -277,108 +274,14 @@ namespace glinerec {
             if(strcmp(pget("debug"),"none")) debug = pget("debug");
         }
 
-        // this function calculates the actual costs
-        void step(int x0,int x1,int y) {
-            int w = wimage.dim(0),h = wimage.dim(1);
-            Queue<point> queue(w*h);
-            for(int i=x0;i<x1;i++) queue.enqueue(point(i,y));
-            int low = 1;
-            int high = wimage.dim(0)-1;
-
-            while(!queue.empty()) {
-                point p = queue.dequeue();
-                int i = p.x, j = p.y;
-                int cost = costs(i,j);
-                int ncost = cost+wimage(i,j)+down_cost;
-                if(costs(i,j+direction)>ncost) {
-                    costs(i,j+direction) = ncost;
-                    sources(i,j+direction) = i;
-                    if(j+direction!=limit) queue.enqueue(point(i,j+direction));
-                }
-                if(i>low) {
-                    if(wimage(i,j)==0)
-                        ncost = cost+wimage(i,j)+outside_diagonal_cost;
-                    else
-                        ncost = cost+wimage(i,j)+inside_diagonal_cost;
-                    if(costs(i-1,j+direction)>ncost) {
-                        costs(i-1,j+direction) = ncost;
-                        sources(i-1,j+direction) = i;
-                        if(j+direction!=limit) queue.enqueue(point(i-1,j+direction));
-                    }
-                }
-                if(i<high) {
-                    if(wimage(i,j)==0)
-                        ncost = cost+wimage(i,j)+outside_diagonal_cost_r;
-                    else
-                        ncost = cost+wimage(i,j)+inside_diagonal_cost;
-                    if(costs(i+1,j+direction)>ncost) {
-                        costs(i+1,j+direction) = ncost;
-                        sources(i+1,j+direction) = i;
-                        if(j+direction!=limit) queue.enqueue(point(i+1,j+direction));
-                    }
-                }
-            }
-        }
-
         void findAllCuts() {
-            int w = wimage.dim(0), h = wimage.dim(1);
-            // initialize dimensions of cuts, costs etc
-            cuts.resize(w);
-            cutcosts.resize(w);
-            costs.resize(w,h);
-            sources.resize(w,h);
-
-            fill(costs, 1000000000);
-            for(int i=0;i<w;i++) costs(i,0) = 0;
-            fill(sources, -1);
-            limit = where;
-            direction = 1;
-            step(0,w,0);
-
-            for(int x=0;x<w;x++) {
-                cutcosts(x) = costs(x,where);
-                cuts(x).clear();
-                // bottom should probably be initialized with 2*where instead of
-                // h, because where cannot be assumed to be h/2. In the most extreme
-                // case, the cut could go through 2 pixels in each row
-                narray<point> bottom;
-                int i = x, j = where;
-                while(j>=0) {
-                    bottom.push(point(i,j));
-                    i = sources(i,j);
-                    j--;
-                }
-                //cuts(x).resize(h);
-                for(i=bottom.length()-1;i>=0;i--) cuts(x).push(bottom(i));
-            }
-
-            fill(costs, 1000000000);
-            for(int i=0;i<w;i++) costs(i,h-1) = 0;
-            fill(sources, -1);
-            limit = where;
-            direction = -1;
-            step(0,w,h-1);
-
-            for(int x=0;x<w;x++) {
-                cutcosts(x) += costs(x,where);
-                // top should probably be initialized with 2*(h-where) instead of
-                // h, because where cannot be assumed to be h/2. In the most extreme
-                // case, the cut could go through 2 pixels in each row
-                narray<point> top;
-                int i = x, j = where;
-                while(j<h) {
-                    if(j>where) top.push(point(i,j));
-                    i = sources(i,j);
-                    j++;
-                }
-                for(i=0;i<top.length();i++) cuts(x).push(top(i));
-            }
-
-            // add costs for line "where"
-            for(int x=0;x<w;x++) {
-                cutcosts(x) += wimage(x,where);
-            }
-
+            dp.down_cost = down_cost;
+            dp.outside_left_cost = outside_diagonal_cost;
+            dp.outside_right_cost = outside_diagonal_cost_r;
+            dp.inside_diagonal_cost = inside_diagonal_cost;
+            // any nonzero weight counts as inside here
+            dp.boundary_diagonal_cost = inside_diagonal_cost;
+            dp.compute(cutcosts,wimage,where);
         }
 
         void findBestCuts() {
@@ -388,8 +291,11 @@ namespace glinerec {
             gauss1d(temp,cutcosts,cost_smooth);
             cutcosts.move(temp);
             local_minima(bestcuts,cutcosts,min_range,min_thresh);
+            // only trace back the cuts we are actually going to use
+            cuts.resize(bestcuts.length());
             for(int i=0;i<bestcuts.length();i++) {
-                narray<point> &cut = cuts(bestcuts(i));
+                narray<point> &cut = cuts(i);
+                dp.cut(cut,bestcuts(i));
                 for(int j=0;j<cut.length();j++) {
                     point p = cut(j);
                     ext(dimage,p.x,p.y) = 0x00ff00;
@@ -436,7 +342,7 @@ namespace glinerec {
 
         virtual void charseg(intarray &segmentation,bytearray &raw) {
             setParams();
-            log_main("segmenting", raw);
+            OCRO_LOG(log_main,("segmenting", raw));
             enum {PADDING = 3};
             optional_check_background_is_lighter(raw);
             bytearray image;
@@ -457,8 +363,7 @@ namespace glinerec {
 
             for(int r=0;r<bestcuts.length();r++) {
                 int w = seg.dim(0);
-                int c = bestcuts(r);
-                narray<point> &cut = cuts(c);
+                narray<point> &cut = cuts(r);
                 for(int y=0;y<image.dim(1);y++) {
                     for(int i=-1;i<=1;i++) {
                         int x = cut(y).x;
@@ -493,7 +398,7 @@ namespace glinerec {
 
             make_line_segmentation_white(segmentation);
             // set_line_number(segmentation, 1);
-            log_main("resulting segmentation", segmentation);
+            OCRO_LOG(log_main,("resulting segmentation", segmentation));
         }
     };
 
@@ -170,9 +170,98 @@ namespace glinerec {
             reimport();
         }
 
-        virtual void setLine(bytearray &image_) {
+        // everything that the maps computed by setLine depend on
+        LineKey lineKey(bytearray &image) {
+            static const char *params[] = {
+                "ftypes","ridge_nmaps",
+                "skel_pre_smooth","skel_post_dilate",
+                "ridge_pre_smooth","ridge_post_smooth","ridge_asigma","ridge_mpower",
+                "dt_power","dt_which","dt_grad_smooth",
+                0
+            };
+            LineKey key(image,name());
+            for(int i=0;params[i];i++)
+                key.add(pget(params[i]));
+            return key;
+        }
+
+        // only the maps that computeMaps fills in for these ftypes;
+        // the others are left over from earlier lines
+        static bool any_of(const char *ftypes,const char *chars) {
+            return strpbrk(ftypes,chars)!=0;
+        }
+
+        void saveMaps(LineMaps &cached) {
+            const char *ftypes = pget("ftypes");
+            cached.clear();
+            cached.bytes.push() = line;
+            cached.bytes.push() = binarized;
+            if(any_of(ftypes,"je")) {
+                cached.bytes.push() = junctions;
+                cached.bytes.push() = endpoints;
+            }
+            if(any_of(ftypes,"h"))
+                cached.bytes.push() = holes;
+            if(any_of(ftypes,"r"))
+                for(int i=0;i<maps.length();i++)
+                    cached.floats.push() = maps(i);
+            if(any_of(ftypes,"t"))
+                cached.floats.push() = troughs;
+            if(any_of(ftypes,"DGM"))
+                cached.floats.push() = dt;
+            if(any_of(ftypes,"GM")) {
+                cached.floats.push() = dt_x;
+                cached.floats.push() = dt_y;
+            }
+            if(any_of(ftypes,"M"))
+                for(int i=0;i<dt_maps.length();i++)
+                    cached.floats.push() = dt_maps(i);
+        }
+
+        void restoreMaps(LineMaps &cached) {
             const char *ftypes = pget("ftypes");
+            int nb = 0, nf = 0;
+            line.move(cached.bytes(nb++));
+            binarized.move(cached.bytes(nb++));
+            if(any_of(ftypes,"je")) {
+                junctions.move(cached.bytes(nb++));
+                endpoints.move(cached.bytes(nb++));
+            }
+            if(any_of(ftypes,"h"))
+                holes.move(cached.bytes(nb++));
+            if(any_of(ftypes,"r"))
+                for(int i=0;i<maps.length();i++)
+                    maps(i).move(cached.floats(nf++));
+            if(any_of(ftypes,"t"))
+                troughs.move(cached.floats(nf++));
+            if(any_of(ftypes,"DGM"))
+                dt.move(cached.floats(nf++));
+            if(any_of(ftypes,"GM")) {
+                dt_x.move(cached.floats(nf++));
+                dt_y.move(cached.floats(nf++));
+            }
+            if(any_of(ftypes,"M")) {
+                dt_maps.resize(cached.floats.length()-nf);
+                for(int i=0;i<dt_maps.length();i++)
+                    dt_maps(i).move(cached.floats(nf++));
+            }
+        }
+
+        virtual void setLine(bytearray &image_) {
             maps.resize(int(pgetf("ridge_nmaps")));
+            LineKey key = lineKey(image_);
+            LineMaps cached;
+            if(line_cache_get(cached,key)) {
+                restoreMaps(cached);
+                return;
+            }
+            computeMaps(image_);
+            saveMaps(cached);
+            line_cache_put(key,cached);
+        }
+
+        void computeMaps(bytearray &image_) {
+            const char *ftypes = pget("ftypes");
             line = image_;
             dsection("setline");
             dclear(0);
@@ -38,6 +38,7 @@
 #include "glclass.h"
 #include "glcuts.h"
 #include "glfmaps.h"
+#include "glcache.h"
 
 namespace glinerec {
     struct BadTextLine {};
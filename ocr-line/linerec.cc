@@ -52,6 +52,56 @@ namespace {
             else v.push(0.0);
         }
     }
+
+    // MetaLinerec needs the line size and stroke width to pick a
+    // bucket, and the feature map of the recognizer it dispatches to
+    // needs them again for the same pixels.  Both estimates are full
+    // passes over the image with sorting, so remember them for the
+    // last few lines, keyed on the image like the line cache.  (Two
+    // floats per line aren't worth an entry in the line cache.)
+
+    struct LineSizeEntry {
+        uint64_t h1,h2;
+        int w,h;
+        float size,strokewidth;
+    };
+
+    enum { nline_sizes = 16 };
+    LineSizeEntry line_sizes[nline_sizes];
+    int line_sizes_next = 0;
+
+    void estimate_line_size(float &size,float &strokewidth,bytearray &image) {
+        LineKey key(image,"line_size");
+        uint64_t h1,h2;
+        key.hash.digest(h1,h2);
+        int w = key.w, h = key.h;
+        bool found = false;
+#pragma omp critical(line_sizes)
+        {
+            for(int i=0;i<nline_sizes;i++) {
+                LineSizeEntry &e = line_sizes[i];
+                if(e.h1!=h1 || e.h2!=h2 || e.w!=w || e.h!=h) continue;
+                size = e.size;
+                strokewidth = e.strokewidth;
+                found = true;
+                break;
+            }
+        }
+        if(found) return;
+        strokewidth = estimate_strokewidth(image,0.5);
+        size = estimate_linesize(image,0.5,1.5*strokewidth);
+#pragma omp critical(line_sizes)
+        {
+            LineSizeEntry &e = line_sizes[line_sizes_next];
+            line_sizes_next = (line_sizes_next+1)%nline_sizes;
+            e.h1 = h1;
+            e.h2 = h2;
+            e.w = w;
+            e.h = h;
+            e.size = size;
+            e.strokewidth = strokewidth;
+        }
+    }
 }
 
 namespace glinerec {
@@ -136,25 +186,53 @@ namespace glinerec {
             }
 #endif
             get_rast_info(intercept,slope,image_);
-            float strokewidth = estimate_strokewidth(image,0.5);
-            float size = estimate_linesize(image,0.5,1.5*strokewidth);
+            float size,strokewidth;
+            estimate_line_size(size,strokewidth,image);
             xheight = size;
         }
 
         float intercept,slope,xheight;
 
+        // the baseline entry is keyed on all of our parameters, so a
+        // differently configured cfmap never shares it
+        LineKey lineKey(bytearray &image) {
+            static const char *params[] = {
+                "csize","minheight","maxheight","context",
+                "mdilate","minsize_factor","use_props",
+                0
+            };
+            LineKey key(image,name());
+            for(int i=0;params[i];i++)
+                key.add(pget(params[i]));
+            return key;
+        }
+
         void setLine(bytearray &image) {
             this->image = image;
             fmap->setLine(image);
 
-
-            get_line_info(intercept,slope,xheight,image);
+            LineKey key = lineKey(image);
+            LineMaps cached;
+            if(line_cache_get(cached,key)) {
+                intercept = cached.floats(0)(0);
+                slope = cached.floats(0)(1);
+                xheight = cached.floats(0)(2);
+            } else {
+                get_line_info(intercept,slope,xheight,image);
+                floatarray &v = cached.floats.push();
+                v.push(intercept);
+                v.push(slope);
+                v.push(xheight);
+                line_cache_put(key,cached);
+            }
             if(xheight<4) throw BadTextLine();
 
             show_baseline(slope,intercept,xheight,image,"YYY");
-            bytearray baseline_image;
-            debug_baseline(baseline_image,slope,intercept,xheight,image);
-            logger.log("baseline\n",baseline_image);
+            if(logger.enabled) {
+                bytearray baseline_image;
+                debug_baseline(baseline_image,slope,intercept,xheight,image);
+                logger.log("baseline\n",baseline_image);
+            }
             debugf("lineinfo","LineInfo %g %g %g\n",intercept,slope,xheight);
         }
 
@@ -278,9 +356,12 @@ namespace glinerec {
         return sum(a)/a.length();
     }
 
-    struct MetaLinerec : IRecognizeLine {
+    struct MetaLinerec : IRecognizeLine, ISectionedModel {
         // this is a 10x10 grid; (9,9) is the default recognizer
         narray< autodel<IRecognizeLine> > recognizers;
+        // when loaded from a sectioned model, buckets stay on disk
+        // until they are first used
+        autodel<ModelSections> sections;
         intarray raw_counts;    // characters in each bucket
         intarray counts;        // characters actually trained in each bucket
         int sbucket,wbucket;
@@ -314,6 +395,76 @@ namespace glinerec {
             raw_counts.reshape(10,10);
             counts.reshape(10,10);
         }
+        void save(FILE *stream) {
+            load_all();
+            this->IComponent::save(stream);
+        }
+        static void section_name(strg &name,int s,int w) {
+            sprintf(name,"bucket-%d-%d",s,w);
+        }
+        IRecognizeLine *recognizer(int s,int w) {
+            if(!sections) return recognizers(s,w).ptr();
+            strg name;
+            section_name(name,s,w);
+            IComponent *component = 0;
+            bool failed = false;
+            strg error;
+            // exceptions can't leave the critical section, so they
+            // are rethrown after it
+#pragma omp critical(metalinerec_sections)
+            {
+                if(!recognizers(s,w) && sections->has(name.c_str())) {
+                    try {
+                        component = sections->load(name.c_str());
+                    } catch(const char *message) {
+                        failed = true;
+                        error = message;
+                    }
+                    IRecognizeLine *result = dynamic_cast<IRecognizeLine*>(component);
+                    if(result) {
+                        recognizers(s,w) = result;
+                    } else if(!failed) {
+                        delete component;
+                        failed = true;
+                        error = "not a line recognizer";
+                    }
+                }
+            }
+            if(failed) throwf("%s: %s",name.c_str(),error.c_str());
+            return recognizers(s,w).ptr();
+        }
+        void load_all() {
+            if(!sections) return;
+            for(int i=0;i<recognizers.dim(0);i++)
+                for(int j=0;j<recognizers.dim(1);j++)
+                    recognizer(i,j);
+            sections = 0;
+        }
+        void saveSections(ModelSections &out) {
+            load_all();
+            // the root holds everything but the recognizers
+            narray< autodel<IRecognizeLine> > saved;
+            saved.move(recognizers);
+            recognizers.resize(10,10);
+            try {
+                out.add("root",this);
+            } catch(...) {
+                recognizers.move(saved);
+                throw;
+            }
+            recognizers.move(saved);
+            for(int i=0;i<recognizers.dim(0);i++) {
+                for(int j=0;j<recognizers.dim(1);j++) {
+                    if(!recognizers(i,j)) continue;
+                    strg name;
+                    section_name(name,i,j);
+                    out.add(name.c_str(),recognizers(i,j).ptr());
+                }
+            }
+        }
+        void attachSections(ModelSections *in) {
+            sections = in;
+        }
         const char *interface() {
             return "IRecognizeLine";
         }
@@ -325,14 +476,20 @@ namespace glinerec {
             pprint(stream,depth);
             for(int i=0;i<recognizers.dim(0);i++) {
                 for(int j=0;j<recognizers.dim(1);j++) {
-                    if(!recognizers(i,j)) continue;
+                    if(!recognizers(i,j)) {
+                        strg name;
+                        section_name(name,i,j);
+                        if(sections && sections->has(name.c_str()))
+                            iprintf(stream,depth,"%2d %2d (not loaded)\n",i,j);
+                        continue;
+                    }
                     iprintf(stream,depth,"%2d %2d %s\n",i,j,recognizers(i,j)->name());
                 }
             }
         }
         void bucket(int &s,int &w,bytearray &image) {
-            float strokewidth = estimate_strokewidth(image,0.5);
-            float size = estimate_linesize(image,0.5,1.5*strokewidth);
+            float size,strokewidth;
+            estimate_line_size(size,strokewidth,image);
             debugf("sizeinfo","size %g strokewidth %g\n",size,strokewidth);
             s = int(log(max(1.0,0.5+size)));
             w = int(log(max(1.0,0.5+strokewidth)));
@@ -340,11 +497,9 @@ namespace glinerec {
         virtual void recognizeLine(intarray &segmentation,IGenericFst &result,bytearray &image) {
             int s,w;
             bucket(s,w,image);
-            if(recognizers(s,w)) {
-                recognizers(s,w)->recognizeLine(segmentation,result,image);
-            } else {
-                recognizers(9,9)->recognizeLine(segmentation,result,image);
-            }
+            IRecognizeLine *r = recognizer(s,w);
+            if(!r) r = recognizer(9,9);
+            r->recognizeLine(segmentation,result,image);
         }
         virtual void recognizeLine(IGenericFst &result,bytearray &image) {
             intarray segmentation;
@@ -370,6 +525,7 @@ namespace glinerec {
         }
         virtual bool addTrainingLine(intarray &segmentation, bytearray &image_grayscale,
                                      ustrg &transcription) {
+            load_all();
             int s,w;
             bucket(s,w,image_grayscale);
             if(current_epoch==0)
@@ -422,11 +578,9 @@ namespace glinerec {
                            bytearray &image,IGenericFst &transcription) {
             int s,w;
             bucket(s,w,image);
-            if(recognizers(s,w)) {
-                recognizers(s,w)->align(chars,seg,costs,image,transcription);
-            } else {
-                recognizers(9,9)->align(chars,seg,costs,image,transcription);
-            }
+            IRecognizeLine *r = recognizer(s,w);
+            if(!r) r = recognizer(9,9);
+            r->align(chars,seg,costs,image,transcription);
         }
         virtual ~MetaLinerec() {
         }
@@ -582,10 +736,10 @@ namespace glinerec {
             // debugging info
             IDpSegmenter *dp = dynamic_cast<IDpSegmenter*>(segmenter.ptr());
             if(dp) {
-                logger.log("DpSegmenter",dp->dimage);
+                OCRO_LOG(logger,("DpSegmenter",dp->dimage));
                 dshow(dp->dimage,"YYy");
             }
-            logger.recolor("segmentation",segmentation);
+            if(logger.enabled) logger.recolor("segmentation",segmentation);
             dshowr(segmentation,"YYY");
         }
 
@@ -701,9 +855,9 @@ namespace glinerec {
         void estimateSpaceSize() {
             intarray labels;
             labels = segmentation;
-            label_components(labels);
-            rectarray boxes;
-            bounding_boxes(boxes,labels);
+            ConnectedComponents components;
+            components.label(labels);
+            rectarray &boxes = components.boxes;
             floatarray distances;
             distances.resize(boxes.length()) = 99999;
             for(int i=1;i<boxes.length();i++) {
@@ -733,12 +887,11 @@ namespace glinerec {
             bytearray image;
             image = image_;
             dsection("recognizing");
-            logger.log("input\n",image);
+            OCRO_LOG(logger,("input\n",image));
             setLine(image);
             segmentation_ = segmentation;
             bytearray available;
             floatarray cp,ccosts,props;
-            OutputVector p;
             int ncomponents = grouper->length();
             int minclass = pgetf("minclass");
             float minprob = pgetf("minprob");
@@ -764,78 +917,97 @@ namespace glinerec {
 
             estimateSpaceSize();
 
-#pragma omp parallel for schedule(dynamic,10) private(p,props)
+            // extract features for all candidates first, then let the
+            // classifier score them as a single batch
+            narray<floatarray> vs(ncomponents);
+            rectarray boxes(ncomponents);
+            intarray ok(ncomponents);
+            ok = 0;
+#pragma omp parallel for schedule(dynamic,10)
             for(int i=0;i<ncomponents;i++) {
                 rectangle b;
                 bytearray mask;
                 grouper->getMask(b,mask,i,0);
-                floatarray v;
+                boxes(i) = b;
                 try {
-                    featuremap->extractFeatures(v,b,mask);
+                    featuremap->extractFeatures(vs(i),b,mask);
                 } catch(const char *msg) {
                     debugf("warn","feature extraction failed [%d]: %s\n",i,msg);
                     continue;
                 }
-                float ccost = classifier->xoutputs(p,v);
-#pragma omp critical
-                {
-                    if(use_reject) {
-                        ccost = 0;
-                        float total = sum(p.values);
-                        if(total>1e-11)
-                            p.values /= total;
-                        else
-                            p.values = 0.0;
-                    }
-                    int count = 0;
+                ok(i) = 1;
+            }
+            intarray which;
+            narray<floatarray> batch;
+            for(int i=0;i<ncomponents;i++) {
+                if(!ok(i)) continue;
+                which.push(i);
+                batch.push().move(vs(i));
+            }
+            narray<OutputVector> ps;
+            classifier->xoutputs_batch(ps,ccosts,batch);
+
+            for(int k=0;k<which.length();k++) {
+                int i = which(k);
+                rectangle b = boxes(i);
+                OutputVector &p = ps(k);
+                float ccost = ccosts(k);
+                if(use_reject) {
+                    ccost = 0;
+                    float total = sum(p.values);
+                    if(total>1e-11)
+                        p.values /= total;
+                    else
+                        p.values = 0.0;
+                }
+                int count = 0;
 #if 0
-                    for(int j=minclass;j<p.length();j++) {
-                        if(j==reject_class) continue;
-                        if(p(j)<minprob) continue;
-                        float pcost = -log(p(j));
-                        debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
-                        double total_cost = pcost+ccost;
-                        if(total_cost<maxcost) {
-                            grouper->setClass(i,j,total_cost);
-                            count++;
-                        }
+                for(int j=minclass;j<p.length();j++) {
+                    if(j==reject_class) continue;
+                    if(p(j)<minprob) continue;
+                    float pcost = -log(p(j));
+                    debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
+                    double total_cost = pcost+ccost;
+                    if(total_cost<maxcost) {
+                        grouper->setClass(i,j,total_cost);
+                        count++;
                     }
+                }
 #else
-                    debugf("dcost","output %d\n",p.keys.length());
-                    for(int index=0;index<p.keys.length();index++) {
-                        int j = p.keys[index];
-                        if(j<minclass) continue;
-                        if(j==reject_class) continue;
-                        float value = p.values[index];
-                        if(value<=0.0) continue;
-                        if(value<minprob) continue;
-                        float pcost = -log(value);
-                        debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
-                        double total_cost = pcost+ccost;
-                        if(total_cost<maxcost) {
-                            if(use_priors) {
-                                total_cost -= -log(priors(j));
-                            }
-                            grouper->setClass(i,j,total_cost);
-                            count++;
+                debugf("dcost","output %d\n",p.keys.length());
+                for(int index=0;index<p.keys.length();index++) {
+                    int j = p.keys[index];
+                    if(j<minclass) continue;
+                    if(j==reject_class) continue;
+                    float value = p.values[index];
+                    if(value<=0.0) continue;
+                    if(value<minprob) continue;
+                    float pcost = -log(value);
+                    debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
+                    double total_cost = pcost+ccost;
+                    if(total_cost<maxcost) {
+                        if(use_priors) {
+                            total_cost -= -log(priors(j));
                         }
+                        grouper->setClass(i,j,total_cost);
+                        count++;
                     }
-                    debugf("dcost","\n");
+                }
+                debugf("dcost","\n");
 #endif
-                    if(count==0) {
-                        float xheight = 10.0;
-                        if(b.height()<xheight/2 && b.width()<xheight/2) {
-                            grouper->setClass(i,'~',high_cost/2);
-                        } else {
-                            grouper->setClass(i,'#',(b.width()/xheight)*high_cost);
-                        }
-                    }
-                    if(grouper->pixelSpace(i)>space_threshold) {
-                        debugf("spaces","space %d\n",grouper->pixelSpace(i));
-                        grouper->setSpaceCost(i,space_yes,space_no);
+                if(count==0) {
+                    float xheight = 10.0;
+                    if(b.height()<xheight/2 && b.width()<xheight/2) {
+                        grouper->setClass(i,'~',high_cost/2);
+                    } else {
+                        grouper->setClass(i,'#',(b.width()/xheight)*high_cost);
                     }
-                    // dwait();
                 }
+                if(grouper->pixelSpace(i)>space_threshold) {
+                    debugf("spaces","space %d\n",grouper->pixelSpace(i));
+                    grouper->setSpaceCost(i,space_yes,space_no);
+                }
+                // dwait();
             }
             grouper->getLattice(result);
         }
@@ -1013,10 +1185,10 @@ namespace glinerec {
             // debugging info
             IDpSegmenter *dp = dynamic_cast<IDpSegmenter*>(segmenter.ptr());
             if(dp) {
-                logger.log("DpSegmenter",dp->dimage);
+                OCRO_LOG(logger,("DpSegmenter",dp->dimage));
                 dshow(dp->dimage,"YYy");
             }
-            logger.recolor("segmentation",segmentation);
+            if(logger.enabled) logger.recolor("segmentation",segmentation);
             dshowr(segmentation,"YYY");
         }
 
@@ -1139,9 +1311,9 @@ namespace glinerec {
         void estimateSpaceSize() {
             intarray labels;
             labels = segmentation;
-            label_components(labels);
-            rectarray boxes;
-            bounding_boxes(boxes,labels);
+            ConnectedComponents components;
+            components.label(labels);
+            rectarray &boxes = components.boxes;
             floatarray distances;
             distances.resize(boxes.length()) = 99999;
             for(int i=1;i<boxes.length();i++) {
@@ -1171,13 +1343,12 @@ namespace glinerec {
             bytearray image;
             image = image_;
             dsection("recognizing");
-            logger.log("input\n",image);
+            OCRO_LOG(logger,("input\n",image));
             setLine(image_);
             if(pgetf("invert")) sub(max(image),image);
             segmentation_ = segmentation;
             bytearray available;
             floatarray cp,ccosts,props;
-            OutputVector p;
             int ncomponents = grouper->length();
             int minclass = pgetf("minclass");
             float minprob = pgetf("minprob");
@@ -1203,76 +1374,84 @@ namespace glinerec {
 
             estimateSpaceSize();
 
-#pragma omp parallel for schedule(dynamic,10) private(p,props)
+            // extract features for all candidates first, then let the
+            // classifier score them as a single batch
+            narray<floatarray> vs(ncomponents);
+            rectarray boxes(ncomponents);
+#pragma omp parallel for schedule(dynamic,10)
             for(int i=0;i<ncomponents;i++) {
                 rectangle b;
                 bytearray mask;
                 grouper->getMask(b,mask,i,0);
+                boxes(i) = b;
                 bytearray cv;
                 grouper->extractWithMask(cv,mask,image,i,0);
-                floatarray v;
-                v = cv;
-                v /= 255.0;
-                float ccost = classifier->xoutputs(p,v);
-#pragma omp critical
-                {
-                    if(use_reject) {
-                        ccost = 0;
-                        float total = sum(p.values);
-                        if(total>1e-11)
-                            p.values /= total;
-                        else
-                            p.values = 0.0;
-                    }
-                    int count = 0;
+                vs(i) = cv;
+                vs(i) /= 255.0;
+            }
+            narray<OutputVector> ps;
+            classifier->xoutputs_batch(ps,ccosts,vs);
+
+            for(int i=0;i<ncomponents;i++) {
+                rectangle b = boxes(i);
+                OutputVector &p = ps(i);
+                float ccost = ccosts(i);
+                if(use_reject) {
+                    ccost = 0;
+                    float total = sum(p.values);
+                    if(total>1e-11)
+                        p.values /= total;
+                    else
+                        p.values = 0.0;
+                }
+                int count = 0;
 #if 0
-                    for(int j=minclass;j<p.length();j++) {
-                        if(j==reject_class) continue;
-                        if(p(j)<minprob) continue;
-                        float pcost = -log(p(j));
-                        debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
-                        double total_cost = pcost+ccost;
-                        if(total_cost<maxcost) {
-                            grouper->setClass(i,j,total_cost);
-                            count++;
-                        }
+                for(int j=minclass;j<p.length();j++) {
+                    if(j==reject_class) continue;
+                    if(p(j)<minprob) continue;
+                    float pcost = -log(p(j));
+                    debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
+                    double total_cost = pcost+ccost;
+                    if(total_cost<maxcost) {
+                        grouper->setClass(i,j,total_cost);
+                        count++;
                     }
+                }
 #else
-                    debugf("dcost","output %d\n",p.keys.length());
-                    for(int index=0;index<p.keys.length();index++) {
-                        int j = p.keys[index];
-                        if(j<minclass) continue;
-                        if(j==reject_class) continue;
-                        float value = p.values[index];
-                        if(value<=0.0) continue;
-                        if(value<minprob) continue;
-                        float pcost = -log(value);
-                        debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
-                        double total_cost = pcost+ccost;
-                        if(total_cost<maxcost) {
-                            if(use_priors) {
-                                total_cost -= -log(priors(j));
-                            }
-                            grouper->setClass(i,j,total_cost);
-                            count++;
+                debugf("dcost","output %d\n",p.keys.length());
+                for(int index=0;index<p.keys.length();index++) {
+                    int j = p.keys[index];
+                    if(j<minclass) continue;
+                    if(j==reject_class) continue;
+                    float value = p.values[index];
+                    if(value<=0.0) continue;
+                    if(value<minprob) continue;
+                    float pcost = -log(value);
+                    debugf("dcost","%3d %10g %c\n",j,pcost+ccost,(j>32?j:'_'));
+                    double total_cost = pcost+ccost;
+                    if(total_cost<maxcost) {
+                        if(use_priors) {
+                            total_cost -= -log(priors(j));
                         }
+                        grouper->setClass(i,j,total_cost);
+                        count++;
                     }
-                    debugf("dcost","\n");
+                }
+                debugf("dcost","\n");
 #endif
-                    if(count==0) {
-                        float xheight = 10.0;
-                        if(b.height()<xheight/2 && b.width()<xheight/2) {
-                            grouper->setClass(i,'~',high_cost/2);
-                        } else {
-                            grouper->setClass(i,'#',(b.width()/xheight)*high_cost);
-                        }
-                    }
-                    if(grouper->pixelSpace(i)>space_threshold) {
-                        debugf("spaces","space %d\n",grouper->pixelSpace(i));
-                        grouper->setSpaceCost(i,space_yes,space_no);
+                if(count==0) {
+                    float xheight = 10.0;
+                    if(b.height()<xheight/2 && b.width()<xheight/2) {
+                        grouper->setClass(i,'~',high_cost/2);
+                    } else {
+                        grouper->setClass(i,'#',(b.width()/xheight)*high_cost);
                     }
-                    // dwait();
                 }
+                if(grouper->pixelSpace(i)>space_threshold) {
+                    debugf("spaces","space %d\n",grouper->pixelSpace(i));
+                    grouper->setSpaceCost(i,space_yes,space_no);
+                }
+                // dwait();
             }
             grouper->getLattice(result);
         }
@@ -1303,7 +1482,7 @@ namespace glinerec {
     }
 
     IRecognizeLine *load_linerec(const char *file) {
-        IComponent *component = load_component(stdio(file,"r"));
+        IComponent *component = load_any_model(file);
 
         IRecognizeLine *recognizer = dynamic_cast<IRecognizeLine*>(component);
         if(recognizer) {
@@ -0,0 +1,161 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: samples written to a sqlite dataset read back the same,
+//          and inserts are committed in batches
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ocropus.h"
+#include "glinerec.h"
+
+using namespace colib;
+using namespace ocropus;
+using namespace glinerec;
+
+enum { nsamples = 10 };
+
+// features of different shapes, with values float8 can hold
+static void make_features(floatarray &v,int i) {
+    if(i%2) v.resize(3+i%3,2);
+    else v.resize(5+i);
+    for(int j=0;j<v.length();j++)
+        v.at1d(j) = ((i*31+j*7)%23)/20.0-0.5;
+}
+
+static int make_label(int i) {
+    if(i==4) return -1;
+    if(i==7) return 300;
+    return i%3;
+}
+
+static bool same_features(floatarray &a,floatarray &b,float eps) {
+    if(a.rank()!=b.rank()) return false;
+    for(int k=0;k<a.rank();k++)
+        if(a.dim(k)!=b.dim(k)) return false;
+    for(int j=0;j<a.length();j++)
+        if(fabs(a.at1d(j)-b.at1d(j))>eps) return false;
+    return true;
+}
+
+static void check_sample(IExtDataset &ds,int i,float eps) {
+    floatarray v,expected;
+    ds.input(v,i);
+    make_features(expected,i);
+    CHECK_CONDITION(same_features(expected,v,eps));
+    CHECK_CONDITION(ds.cls(i)==make_label(i));
+}
+
+int main() {
+#ifdef HAVE_SQLITE3
+    init_glclass();
+    char dir[] = "/tmp/test-sqliteds-XXXXXX";
+    CHECK_CONDITION(mkdtemp(dir));
+    strg file;
+    sprintf(file,"%s/data.sqlite3",dir);
+
+    {
+        autodel<IExtDataset> ds;
+        make_component("sqliteds",ds);
+        ds->pset("file",file);
+        ds->pset("batch",4);
+        floatarray v;
+        for(int i=0;i<nsamples;i++) {
+            make_features(v,i);
+            ds->add(v,make_label(i));
+        }
+        CHECK_CONDITION(ds->nsamples()==nsamples);
+        CHECK_CONDITION(ds->nclasses()==301);
+        // the first two batches are committed, the last two samples
+        // aren't yet
+        {
+            autodel<IExtDataset> reader;
+            make_component("sqliteds",reader);
+            reader->load(file);
+            CHECK_CONDITION(reader->nsamples()==8);
+        }
+        // the writer still reads its own samples
+        check_sample(*ds,9,0);
+        ds->save(file);
+        autodel<IExtDataset> reader;
+        make_component("sqliteds",reader);
+        reader->load(file);
+        CHECK_CONDITION(reader->nsamples()==nsamples);
+    }
+
+    // in order (through the prefetch buffer) and out of order
+    {
+        autodel<IExtDataset> ds;
+        make_component("sqliteds",ds);
+        ds->pset("prefetch",3);
+        ds->load(file);
+        CHECK_CONDITION(ds->nsamples()==nsamples);
+        CHECK_CONDITION(ds->nclasses()==301);
+        floatarray v;
+        make_features(v,0);
+        CHECK_CONDITION(ds->nfeatures()==v.length());
+        for(int i=0;i<nsamples;i++)
+            check_sample(*ds,i,0);
+        int order[] = {9,2,5,6,0,8,3};
+        for(int k=0;k<int(sizeof order/sizeof order[0]);k++)
+            check_sample(*ds,order[k],0);
+    }
+
+    // a sample that can't be stored doesn't get in the way of the
+    // ones after it
+    {
+        autodel<IExtDataset> ds;
+        make_component("sqliteds",ds);
+        ds->pset("file",file);
+        ds->pset("table","float8");
+        ds->pset("float8",1);
+        floatarray bad(3);
+        fill(bad,5.0);
+        bool thrown = false;
+        try {
+            ds->add(bad,1);
+        } catch(const char *message) {
+            thrown = true;
+        }
+        CHECK_CONDITION(thrown);
+        floatarray v;
+        for(int i=0;i<nsamples;i++) {
+            make_features(v,i);
+            ds->add(v,make_label(i));
+        }
+        ds->save(file);
+        autodel<IExtDataset> reader;
+        make_component("sqliteds",reader);
+        reader->pset("table","float8");
+        reader->load(file);
+        CHECK_CONDITION(reader->nsamples()==nsamples);
+        for(int i=0;i<nsamples;i++)
+            check_sample(*reader,i,0.011);
+    }
+
+    unlink(file);
+    rmdir(dir);
+#endif
+    return 0;
+}
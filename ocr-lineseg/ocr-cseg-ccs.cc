@@ -99,9 +99,9 @@ struct SegmentLineByGCCS : ISegmentLine {
         copy(temp,image);
         intarray labels;
         copy(labels,temp);
-        label_components(labels);
-        narray<rectangle> boxes;
-        bounding_boxes(boxes,labels);
+        ConnectedComponents components;
+        components.label(labels);
+        narray<rectangle> &boxes = components.boxes;
         intarray equiv(boxes.length());
         for(int i=0;i<boxes.length();i++)
             equiv[i] = i;
@@ -0,0 +1,143 @@
+// -*- C++ -*-
+
+// Copyright 2006-2007 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+// Copyright 1995-2005 by Thomas M. Breuel
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: seg-dpcuts.cc
+// Purpose: dynamic programming kernel for the curved cut segmenters
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#include "ocropus.h"
+#include "seg-dpcuts.h"
+
+using namespace colib;
+using namespace ocropus;
+
+namespace {
+    enum { unreached = 1000000000 };
+
+    template <class T>
+    inline T diagonal_cost(T weight,T outside,T inside,T boundary) {
+        if(weight==0) return outside;
+        else if(weight>0) return inside;
+        else return boundary;
+    }
+
+    // Relax the rows from start towards limit.  The segmenters used
+    // to do this with a work queue; since all cells of one row are
+    // final before any cell of the next row is expanded, and cells
+    // were expanded left to right, the parent of (k,j) is the first
+    // strictly cheapest of: a right step from k-1, a down step from
+    // k, a left step from k+1.  We keep that order so that ties are
+    // broken exactly as before.  On return, cost holds the costs of
+    // row limit, and the parent codes (0,1,2 for columns k-1,k,k+1)
+    // are stored in the two bits of parents at shift.
+
+    template <class T>
+    void dp_pass(intarray &cost,bytearray &parents,int shift,
+                 narray<T> &wimage,int start,int limit,int direction,
+                 DpCuts &dp) {
+        int w = wimage.dim(0);
+        T down = T(dp.down_cost);
+        T outside_l = T(dp.outside_left_cost);
+        T outside_r = T(dp.outside_right_cost);
+        T inside = T(dp.inside_diagonal_cost);
+        T boundary = T(dp.boundary_diagonal_cost);
+        intarray a(w),b(w);
+        fill(a,0);
+        intarray *prev = &a, *next = &b;
+        for(int j=start;j!=limit;j+=direction) {
+            intarray &p = *prev;
+            intarray &q = *next;
+            for(int k=0;k<w;k++) {
+                int best = unreached;
+                int parent = 1;
+                if(k>0) {
+                    T weight = wimage(k-1,j);
+                    int ncost = int(p(k-1)+weight+
+                                    diagonal_cost(weight,outside_r,inside,boundary));
+                    if(ncost<best) { best = ncost; parent = 0; }
+                }
+                {
+                    T weight = wimage(k,j);
+                    int ncost = int(p(k)+weight+down);
+                    if(ncost<best) { best = ncost; parent = 1; }
+                }
+                if(k>0 && k+1<w) {
+                    T weight = wimage(k+1,j);
+                    int ncost = int(p(k+1)+weight+
+                                    diagonal_cost(weight,outside_l,inside,boundary));
+                    if(ncost<best) { best = ncost; parent = 2; }
+                }
+                q(k) = best;
+                parents(k,j+direction) |= parent<<shift;
+            }
+            intarray *temp = prev;
+            prev = next;
+            next = temp;
+        }
+        cost.move(*prev);
+    }
+
+    template <class T>
+    void dp_cuts(floatarray &cutcosts,DpCuts &dp,narray<T> &wimage,int where) {
+        int w = wimage.dim(0), h = wimage.dim(1);
+        CHECK_ARG(where>=0 && where<h);
+        dp.where = where;
+        dp.parents.resize(w,h);
+        fill(dp.parents,0);
+        intarray top,bottom;
+        dp_pass(top,dp.parents,0,wimage,0,where,1,dp);
+        dp_pass(bottom,dp.parents,2,wimage,h-1,where,-1,dp);
+        cutcosts.resize(w);
+        for(int x=0;x<w;x++) {
+            cutcosts(x) = top(x);
+            cutcosts(x) += bottom(x);
+            // add costs for line "where"
+            cutcosts(x) += wimage(x,where);
+        }
+    }
+}
+
+namespace ocropus {
+    void DpCuts::compute(floatarray &cutcosts,floatarray &wimage,int where) {
+        dp_cuts(cutcosts,*this,wimage,where);
+    }
+
+    void DpCuts::compute(floatarray &cutcosts,intarray &wimage,int where) {
+        dp_cuts(cutcosts,*this,wimage,where);
+    }
+
+    void DpCuts::cut(narray<point> &cut,int x) {
+        int h = parents.dim(1);
+        CHECK_ARG(where>=0 && where<h);
+        cut.resize(h);
+        int i = x;
+        for(int j=where;j>=0;j--) {
+            cut(j) = point(i,j);
+            if(j>0) i += (parents(i,j)&3)-1;
+        }
+        i = x;
+        for(int j=where+1;j<h;j++) {
+            i += ((parents(i,j-1)>>2)&3)-1;
+            cut(j) = point(i,j);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+// -*- C++ -*-
+
+// Copyright 2006-2007 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: seg-dpcuts.h
+// Purpose: dynamic programming kernel for the curved cut segmenters
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#ifndef h_seg_dpcuts_
+#define h_seg_dpcuts_
+
+#include "ocropus.h"
+
+namespace ocropus {
+    using namespace colib;
+
+    // Minimum cost curved cuts, as used by DpSegmenter and
+    // CurvedCutSegmenter.  For every column x, the best cut runs from
+    // the top of the weight image down to (x,where) and from the
+    // bottom up to (x,where); each step moves to the next row and
+    // at most one column sideways.  A step costs the weight of the
+    // pixel it starts from plus down_cost or a diagonal cost; the
+    // diagonal cost depends on whether that weight is zero
+    // (outside), positive (inside) or negative (boundary).
+    //
+    // Costs are computed one row at a time; only the last row of
+    // costs and a two bit parent code per pixel and direction are
+    // kept, and the actual cut through a column is traced back only
+    // when it is asked for.
+
+    struct DpCuts {
+        float down_cost;
+        float outside_left_cost;
+        float outside_right_cost;
+        float inside_diagonal_cost;
+        float boundary_diagonal_cost;
+
+        int where;
+        bytearray parents;
+
+        DpCuts() {
+            down_cost = 0;
+            outside_left_cost = outside_right_cost = 0;
+            inside_diagonal_cost = boundary_diagonal_cost = 0;
+            where = -1;
+        }
+
+        // cutcosts(x) is the total cost of the best cut through (x,where)
+        void compute(floatarray &cutcosts,floatarray &wimage,int where);
+        void compute(floatarray &cutcosts,intarray &wimage,int where);
+
+        // cut(y) is the point of the cut through column x in row y
+        void cut(narray<point> &cut,int x);
+    };
+}
+
+#endif
@@ -0,0 +1,214 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: DpCuts against the queue relaxation that DpSegmenter and
+//          CurvedCutSegmenter used before
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include "ocropus.h"
+#include "seg-dpcuts.h"
+
+using namespace colib;
+using namespace ocropus;
+
+// The cost computation and backtracking of findAllCuts as both
+// segmenters had it; glcuts.cc differed only in using a separate
+// outside cost for right steps and no boundary pixels.
+
+template <class T>
+struct QueueCuts {
+    narray<T> wimage;
+    intarray costs;
+    intarray sources;
+    int direction;
+    int limit;
+    T down_cost,outside_left_cost,outside_right_cost;
+    T inside_diagonal_cost,boundary_diagonal_cost;
+
+    T diagonal(T weight,T outside) {
+        if(weight==0) return outside;
+        else if(weight>0) return inside_diagonal_cost;
+        else return boundary_diagonal_cost;
+    }
+
+    void step(int x0,int x1,int y) {
+        int w = wimage.dim(0),h = wimage.dim(1);
+        Queue<point> queue(w*h);
+        for(int i=x0;i<x1;i++) queue.enqueue(point(i,y));
+        int low = 1;
+        int high = wimage.dim(0)-1;
+
+        while(!queue.empty()) {
+            point p = queue.dequeue();
+            int i = p.x, j = p.y;
+            int cost = costs(i,j);
+            int ncost = int(cost+wimage(i,j)+down_cost);
+            if(costs(i,j+direction)>ncost) {
+                costs(i,j+direction) = ncost;
+                sources(i,j+direction) = i;
+                if(j+direction!=limit) queue.enqueue(point(i,j+direction));
+            }
+            if(i>low) {
+                ncost = int(cost+wimage(i,j)+diagonal(wimage(i,j),outside_left_cost));
+                if(costs(i-1,j+direction)>ncost) {
+                    costs(i-1,j+direction) = ncost;
+                    sources(i-1,j+direction) = i;
+                    if(j+direction!=limit) queue.enqueue(point(i-1,j+direction));
+                }
+            }
+            if(i<high) {
+                ncost = int(cost+wimage(i,j)+diagonal(wimage(i,j),outside_right_cost));
+                if(costs(i+1,j+direction)>ncost) {
+                    costs(i+1,j+direction) = ncost;
+                    sources(i+1,j+direction) = i;
+                    if(j+direction!=limit) queue.enqueue(point(i+1,j+direction));
+                }
+            }
+        }
+    }
+
+    void findAllCuts(floatarray &cutcosts,narray< narray<point> > &cuts,int where) {
+        int w = wimage.dim(0), h = wimage.dim(1);
+        cuts.resize(w);
+        cutcosts.resize(w);
+        costs.resize(w,h);
+        sources.resize(w,h);
+
+        fill(costs, 1000000000);
+        for(int i=0;i<w;i++) costs(i,0) = 0;
+        fill(sources, -1);
+        limit = where;
+        direction = 1;
+        step(0,w,0);
+
+        for(int x=0;x<w;x++) {
+            cutcosts(x) = costs(x,where);
+            cuts(x).clear();
+            narray<point> bottom;
+            int i = x, j = where;
+            while(j>=0) {
+                bottom.push(point(i,j));
+                i = sources(i,j);
+                j--;
+            }
+            for(i=bottom.length()-1;i>=0;i--) cuts(x).push(bottom(i));
+        }
+
+        fill(costs, 1000000000);
+        for(int i=0;i<w;i++) costs(i,h-1) = 0;
+        fill(sources, -1);
+        limit = where;
+        direction = -1;
+        step(0,w,h-1);
+
+        for(int x=0;x<w;x++) {
+            cutcosts(x) += costs(x,where);
+            narray<point> top;
+            int i = x, j = where;
+            while(j<h) {
+                if(j>where) top.push(point(i,j));
+                i = sources(i,j);
+                j++;
+            }
+            for(i=0;i<top.length();i++) cuts(x).push(top(i));
+        }
+
+        for(int x=0;x<w;x++) {
+            cutcosts(x) += wimage(x,where);
+        }
+    }
+};
+
+// CurvedCutSegmenter labels a pixel by the number of cuts at or left
+// of it; equal cuts give equal segmentations, but check that too
+static void cut_segmentation(intarray &seg,narray< narray<point> > &cuts,int w,int h) {
+    seg.resize(w,h);
+    fill(seg,1);
+    for(int r=0;r<cuts.length();r++)
+        for(int y=0;y<h;y++)
+            for(int x=cuts(r)(y).x;x<w;x++)
+                seg(x,y)++;
+}
+
+// Weight images as the segmenters build them: DpSegmenter uses float
+// weights and no boundary pixels, CurvedCutSegmenter int weights with
+// negative boundary pixels.  Small weights and costs make ties common,
+// which is where the order of relaxation matters.
+template <class T>
+static bool same_cuts(int seed,bool boundary) {
+    srand(seed);
+    int w = 1+rand()%40, h = 3+rand()%30;
+    QueueCuts<T> ref;
+    ref.wimage.resize(w,h);
+    T values[4] = {0,T(8),T(boundary?4:0.7),T(-1)};
+    for(int i=0;i<w;i++)
+        for(int j=0;j<h;j++)
+            ref.wimage(i,j) = i==0 ? 0 : values[rand()%(boundary?4:3)];
+    ref.down_cost = T(rand()%2);
+    if(!boundary) ref.down_cost += T(0.3);
+    ref.outside_left_cost = T(rand()%5);
+    ref.outside_right_cost = T(rand()%5);
+    ref.inside_diagonal_cost = T(rand()%5);
+    ref.boundary_diagonal_cost = boundary ? T(rand()%3) : ref.inside_diagonal_cost;
+    int where = 1+rand()%(h-2);
+
+    floatarray expected;
+    narray< narray<point> > expected_cuts;
+    ref.findAllCuts(expected,expected_cuts,where);
+
+    DpCuts dp;
+    dp.down_cost = ref.down_cost;
+    dp.outside_left_cost = ref.outside_left_cost;
+    dp.outside_right_cost = ref.outside_right_cost;
+    dp.inside_diagonal_cost = ref.inside_diagonal_cost;
+    dp.boundary_diagonal_cost = ref.boundary_diagonal_cost;
+    floatarray actual;
+    dp.compute(actual,ref.wimage,where);
+
+    if(actual.length()!=w) return false;
+    narray< narray<point> > actual_cuts(w);
+    for(int x=0;x<w;x++) {
+        if(actual(x)!=expected(x)) return false;
+        narray<point> &cut = actual_cuts(x);
+        dp.cut(cut,x);
+        if(cut.length()!=expected_cuts(x).length()) return false;
+        for(int y=0;y<cut.length();y++)
+            if(cut(y).x!=expected_cuts(x)(y).x || cut(y).y!=expected_cuts(x)(y).y)
+                return false;
+    }
+
+    intarray expected_seg,actual_seg;
+    cut_segmentation(expected_seg,expected_cuts,w,h);
+    cut_segmentation(actual_seg,actual_cuts,w,h);
+    for(int i=0;i<expected_seg.length1d();i++)
+        if(expected_seg.at1d(i)!=actual_seg.at1d(i)) return false;
+    return true;
+}
+
+int main() {
+    for(int seed=0;seed<2000;seed++) {
+        CHECK_CONDITION(same_cuts<float>(seed,false));
+        CHECK_CONDITION(same_cuts<int>(seed,true));
+    }
+    return 0;
+}
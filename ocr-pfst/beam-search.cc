@@ -147,7 +147,9 @@ namespace {
                    int trail_index) {
             //logger.format("relaxing %d %d -> %d %d (bcost %f, cost %f)", f1, f2, t1, t2, base_cost, cost);
 
-            if(!nbest.add_replacing_id(t1 * fst2.nStates() + t2,
+            // 64 bit state pair ids; the product overflows an int
+            // for large dictionary FSTs
+            if(!nbest.add_replacing_id(int64_t(t1) * fst2.nStates() + t2,
                                        all_costs.length(),
                                        - base_cost - cost))
                 return;
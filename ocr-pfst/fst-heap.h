@@ -25,56 +25,78 @@
 #define fst_heap_h_
 
 
+#include <stdint.h>
 #include "ocr-pfst.h"
 
 namespace ocropus {    
     
+    /// The n best (highest value) entries seen so far, each with a
+    /// unique 64-bit id.  Ids are found through an open addressing
+    /// hash table and the entries are kept in a min-heap, so adding
+    /// or replacing an entry costs O(log n) instead of O(n).  Ranks
+    /// are only computed when they are first asked for.
     class PriorityQueue {
         int n;
         int fill;
-        intarray ids;
-        intarray tags;
-        floatarray values;
+        narray<int64_t> ids;    // by slot
+        intarray tags;          // by slot
+        floatarray values;      // by slot
+        intarray heap;          // slots, worst entry first
+        intarray heappos;       // position of each slot in the heap
+        intarray table;         // hash table of slots, -1 if empty
+        int mask;
+        intarray order;         // slots by rank, valid if ranked
+        bool ranked;
+
+        int home(int64_t id) {
+            return int((uint64_t(id)*0x9E3779B97F4A7C15ULL)>>32)&mask;
+        }
+        bool worse(int a,int b) {
+            if(values[a]!=values[b]) return values[a]<values[b];
+            return tags[a]>tags[b];
+        }
+        void heapswap(int i,int j);
+        void heapify_down(int i);
+        void heapify_up(int i);
+        void erase_id(int64_t id);
+        void rank();
     public:
         /// constructor for a NBest data structure of size n
-        PriorityQueue(int n):n(n) {
-            ids.resize(n+1);
-            tags.resize(n+1);
-            values.resize(n+1);
-            clear();
-        }
+        PriorityQueue(int n);
 
         //void log(Logger &logger);
 
         /// remove all elements
         void clear();
 
-        void move_value(int id, int tag, float value, int start, int end);
-
         /// Add the id with the corresponding value
         /// \returns True if the queue was changed
-        bool add(int id, int tag, float value);
+        bool add(int64_t id, int tag, float value);
 
-        int find_id(int id);
+        /// \returns the slot holding the id, or -1
+        int find_id(int64_t id);
 
         /// This function will move the existing id up
         /// instead of creating a new one.
         /// \returns True if the queue was changed
-        bool add_replacing_id(int id, int tag, float value);
+        bool add_replacing_id(int64_t id, int tag, float value);
 
         /// get the value corresponding to rank i
         float value(int i) {
             if(unsigned(i)>=unsigned(fill)) throw "range error";
-            return values[i];
+            if(!ranked) rank();
+            return values[order[i]];
         }
         int tag(int i) {
             if(unsigned(i)>=unsigned(fill)) throw "range error";
-            return tags[i];
+            if(!ranked) rank();
+            return tags[order[i]];
         }
         /// get the id corresponding to rank i
-        int operator[](int i) {
+        int64_t operator[](int i) {
             if(unsigned(i)>=unsigned(fill)) throw "range error";
-            return ids[i];
+            if(!ranked) rank();
+            return ids[order[i]];
         }
         /// get the number of elements in the NBest structure (between 0 and n)
         int length() {
@@ -31,8 +31,25 @@ namespace {
 }
 
 namespace ocropus {
+    PriorityQueue::PriorityQueue(int n):n(n) {
+        CHECK_ARG(n>0);
+        ids.resize(n);
+        tags.resize(n);
+        values.resize(n);
+        heap.resize(n);
+        heappos.resize(n);
+        int size = 1;
+        while(size<2*n) size <<= 1;
+        table.resize(size);
+        mask = size-1;
+        clear();
+    }
+
     void PriorityQueue::clear() {
         fill = 0;
+        colib::fill(table, -1);
+        order.clear();
+        ranked = false;
     }
 
     /*void PriorityQueue::log(Logger &logger) {
@@ -41,57 +58,118 @@ namespace ocropus {
         logger("values", values);
     }*/
 
-    void PriorityQueue::move_value(int id, int tag, float value, int start, int end) {
-        int i = start;
-        while(i>end) {
-            if(values[i-1]>=value) break;
-            values[i] = values[i-1];
-            tags[i] = tags[i-1];
-            ids[i] = ids[i-1];
-            i--;
-        }
-        values[i] = value;
-        tags[i] = tag;
-        ids[i] = id;
+    void PriorityQueue::heapswap(int i, int j) {
+        int t = heap[i];
+        heap[i] = heap[j];
+        heap[j] = t;
+        heappos[heap[i]] = i;
+        heappos[heap[j]] = j;
     }
 
+    void PriorityQueue::heapify_down(int i) {
+        while(1) {
+            int j = left(i);
+            if(j >= fill) return;
+            int k = right(i);
+            if(k < fill && worse(heap[k], heap[j])) j = k;
+            if(!worse(heap[j], heap[i])) return;
+            heapswap(i, j);
+            i = j;
+        }
+    }
 
-
-    bool PriorityQueue::add(int id, int tag, float value) {
-        if(fill == n) {
-            if(values[n-1]>=value) return false;
-            move_value(id, tag, value, n-1, 0);
-        } else if(fill == 0) {
-            values[0] = value;
-            ids[0] = id;
-            tags[0] = tag;
-            fill++;
-        } else {
-            move_value(id, tag, value, fill, 0);
-            fill++;
+    void PriorityQueue::heapify_up(int i) {
+        while(i) {
+            int j = parent(i);
+            if(!worse(heap[i], heap[j])) return;
+            heapswap(i, j);
+            i = j;
         }
-        return true;
     }
 
-    int PriorityQueue::find_id(int id) {
-        for(int i = 0; i < fill; i++) {
-            if(ids[i] == id)
-                return i;
+    int PriorityQueue::find_id(int64_t id) {
+        for(int i = home(id); table[i] != -1; i = (i + 1) & mask) {
+            if(ids[table[i]] == id)
+                return table[i];
         }
         return -1;
     }
 
+    // Remove an id from the hash table, shifting back the entries
+    // of its probe sequence (linear probing needs no tombstones).
+    void PriorityQueue::erase_id(int64_t id) {
+        int i = home(id);
+        while(ids[table[i]] != id) i = (i + 1) & mask;
+        int j = i;
+        while(1) {
+            j = (j + 1) & mask;
+            if(table[j] == -1) break;
+            int k = home(ids[table[j]]);
+            bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+            if(stays) continue;
+            table[i] = table[j];
+            i = j;
+        }
+        table[i] = -1;
+    }
+
+    bool PriorityQueue::add(int64_t id, int tag, float value) {
+        int slot;
+        bool evicted = (fill == n);
+        if(evicted) {
+            // the new entry takes over the slot of the worst one
+            slot = heap[0];
+            if(values[slot]>=value) return false;
+            erase_id(ids[slot]);
+        } else {
+            slot = fill;
+            heap[fill] = slot;
+            heappos[slot] = fill;
+            fill++;
+        }
+        ids[slot] = id;
+        tags[slot] = tag;
+        values[slot] = value;
+        int i = home(id);
+        while(table[i] != -1) i = (i + 1) & mask;
+        table[i] = slot;
+        if(evicted) heapify_down(0);
+        else heapify_up(heappos[slot]);
+        ranked = false;
+        return true;
+    }
 
-    bool PriorityQueue::add_replacing_id(int id, int tag, float value) {
+    bool PriorityQueue::add_replacing_id(int64_t id, int tag, float value) {
         int former = find_id(id);
         if(former == -1)
             return add(id, tag, value);
         if(values[former]>=value)
             return false;
-        move_value(id, tag, value, former, 0);
+        tags[former] = tag;
+        values[former] = value;
+        heapify_down(heappos[former]);
+        ranked = false;
         return true;
     }
 
+    // Sort the slots by decreasing value; ties go to the earlier tag.
+    void PriorityQueue::rank() {
+        intarray saved;
+        copy(saved, heap);
+        int total = fill;
+        order.resize(total);
+        for(int i = total - 1; i >= 0; i--) {
+            order[i] = heap[0];
+            heapswap(0, fill - 1);
+            fill--;
+            heapify_down(0);
+        }
+        fill = total;
+        copy(heap, saved);
+        for(int i = 0; i < fill; i++) heappos[heap[i]] = i;
+        ranked = true;
+    }
+
     int Heap::rotate(int i) {
         int size = heap.length();
         int j = left(i);
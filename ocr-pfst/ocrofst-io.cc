@@ -23,7 +23,10 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
 #include "ocr-pfst.h"
 
 using namespace colib;
@@ -41,114 +44,172 @@ enum {
     PROPERTIES = 3 // expanded, mutable
 };
 
-static int32_t read_int32_LE(FILE *stream) {
-    int n = fgetc(stream);
-    n |= fgetc(stream) << 8;
-    n |= fgetc(stream) << 16;
-    n |= fgetc(stream) << 24;
-    return n;
+// The reader fetches the fixed part of a state and then all of its
+// arcs with one fread each and decodes the fields from there; the
+// writer collects fields in a buffer and writes it out in large
+// blocks.  This is much faster than one stdio call per field for big
+// dictionary FSTs.  The reader never asks for more bytes than the
+// format says follow, so the stream is left just after the FST, and
+// it only holds the arcs of one state at a time.
+
+static inline int32_t get_int32_LE(const unsigned char *p) {
+    return int32_t(uint32_t(p[0]) | (uint32_t(p[1]) << 8)
+                   | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24));
 }
 
-static void write_int32_LE(FILE *stream, int32_t n) {
-    fputc(n, stream);
-    fputc(n >> 8, stream);
-    fputc(n >> 16, stream);
-    fputc(n >> 24, stream);
-}
-
-static int64_t read_int64_LE(FILE *stream) {
-    int64_t n = read_int32_LE(stream);
-    n |= int64_t(read_int32_LE(stream)) << 32;
-    return n;
-}
-
-static void write_int64_LE(FILE *stream, int64_t n) {
-    write_int32_LE(stream, n);
-    write_int32_LE(stream, n >> 32);
-}
-
-static bool read_magic_string(FILE *stream, const char *s) {
-    int n = read_int32_LE(stream);
-    if(strlen(s) != n)
-        return false;
-    for(int i = 0; i < n; i++) {
-        if(fgetc(stream) != s[i])
-            return false;
-    }
-    return true;
-}
-
-static void skip_string(FILE *stream) {
-    int n = read_int32_LE(stream);
-    fseek(stream, n, SEEK_CUR);
-}
-
-static void write_string(FILE *stream, const char *s) {
-    int n = strlen(s);
-    write_int32_LE(stream, n);
-    for(int i = 0; i < n; i++)
-        fputc(s[i], stream);
+static inline int64_t get_int64_LE(const unsigned char *p) {
+    return int64_t(uint64_t(uint32_t(get_int32_LE(p)))
+                   | (uint64_t(uint32_t(get_int32_LE(p + 4))) << 32));
 }
 
 // This is probably not a good way but that's what OpenFST does anyway.
-static bool write_float(FILE *stream, float f) {
-    return fwrite(&f, 1, sizeof(f), stream) == sizeof(f);
-}
-
-static float read_float(FILE *stream) {
+static inline float get_float(const unsigned char *p) {
     float result;
-    if(fread(&result, 1, sizeof(result), stream) != sizeof(result)) {
-        // cry
-    }
+    memcpy(&result, p, sizeof(result));
     return result;
 }
 
+namespace {
+    struct FstReadBuffer {
+        FILE *stream;
+        unsigned char *data;
+        size_t capacity;
+        int64_t limit;      // bytes left in a regular file, -1 if unknown
+        int64_t pos;        // bytes taken so far
+
+        FstReadBuffer(FILE *stream) : stream(stream), data(0), capacity(0), pos(0) {
+            limit = -1;
+            struct stat st;
+            long here = ftell(stream);
+            if(here >= 0 && fstat(fileno(stream), &st) == 0 && S_ISREG(st.st_mode))
+                limit = st.st_size > here ? st.st_size - here : 0;
+        }
+        ~FstReadBuffer() { free(data); }
+
+        /// \returns whether n more bytes can be there; on pipes,
+        /// running out is only noticed when reading
+        bool fits(int64_t n) {
+            return n >= 0 && (limit < 0 || n <= limit - pos);
+        }
+
+        /// \returns a pointer to the next n bytes, valid until the
+        /// next call
+        const unsigned char *take(size_t n) {
+            if(!fits(n))
+                throw "unexpected EOF";
+            if(n > capacity) {
+                unsigned char *grown = (unsigned char *) realloc(data, n);
+                if(!grown) throw "out of memory reading FST";
+                data = grown;
+                capacity = n;
+            }
+            if(n && fread(data, 1, n, stream) != n) {
+                if(ferror(stream)) throw "error in the stream";
+                throw "unexpected EOF";
+            }
+            pos += n;
+            return data;
+        }
+
+        int32_t int32() { return get_int32_LE(take(4)); }
+        int64_t int64() { return get_int64_LE(take(8)); }
+        float float32() { return get_float(take(4)); }
+
+        void skip_string() {
+            int32_t n = int32();
+            if(n < 0) throw "invalid string length";
+            take(n);
+        }
+    };
+
+    struct FstWriteBuffer {
+        enum { CAPACITY = 1 << 16 };
+        FILE *stream;
+        unsigned char data[CAPACITY];
+        int fill;
+
+        FstWriteBuffer(FILE *stream) : stream(stream), fill(0) {}
+
+        void flush() {
+            if(fill && fwrite(data, 1, fill, stream) != size_t(fill))
+                throw "error writing FST";
+            fill = 0;
+        }
+
+        unsigned char *reserve(int n) {
+            if(fill + n > CAPACITY) flush();
+            unsigned char *result = data + fill;
+            fill += n;
+            return result;
+        }
+
+        void int32(int32_t n) {
+            unsigned char *p = reserve(4);
+            p[0] = n;
+            p[1] = n >> 8;
+            p[2] = n >> 16;
+            p[3] = n >> 24;
+        }
+
+        void int64(int64_t n) {
+            int32(n);
+            int32(n >> 32);
+        }
+
+        void float32(float f) {
+            memcpy(reserve(sizeof(f)), &f, sizeof(f));
+        }
+
+        void string(const char *s) {
+            int n = strlen(s);
+            int32(n);
+            for(int i = 0; i < n; i++)
+                *reserve(1) = s[i];
+        }
+    };
+}
+
 // _______________________   high-level functions   ___________________________
 
-static bool skip_symbol_table(FILE *stream) {
-    if(read_int32_LE(stream) != OPENFST_SYMBOL_TABLE_MAGIC)
-        return false;
-    skip_string(stream); // name
-    read_int64_LE(stream); // available key
-    int64_t n = read_int64_LE(stream);
-    for(int i = 0; i < n; i++) {
-        skip_string(stream);    // key
-        read_int64_LE(stream);  // value
+static void skip_symbol_table(FstReadBuffer &in) {
+    if(in.int32() != OPENFST_SYMBOL_TABLE_MAGIC)
+        throw "invalid symbol table";
+    in.skip_string(); // name
+    in.int64(); // available key
+    int64_t n = in.int64();
+    for(int64_t i = 0; i < n; i++) {
+        in.skip_string();   // key
+        in.int64();         // value
     }
-    return !ferror(stream) && !feof(stream);
 }
 
-static const char *read_header_and_symbols(IGenericFst &fst, FILE *stream) {
-    if(read_int32_LE(stream) != OPENFST_MAGIC)
-        return "invalid magic number";
-    read_magic_string(stream, "vector");
-    read_magic_string(stream, "standard");
-    int version = read_int32_LE(stream);
+static void read_header_and_symbols(IGenericFst &fst, FstReadBuffer &in) {
+    if(in.int32() != OPENFST_MAGIC)
+        throw "invalid magic number";
+    in.skip_string(); // "vector"
+    in.skip_string(); // "standard"
+    int version = in.int32();
     if(version < MIN_VERSION)
-        return "file has too old version";
-    int flags = read_int32_LE(stream);
-    read_int64_LE(stream); // properties
-    int64_t start = read_int64_LE(stream);
-    int64_t nstates = read_int64_LE(stream);
-    if(nstates < 0)
-        return false;   // to prevent creating 2^31 nodes in case of sudden EOF
+        throw "file has too old version";
+    int flags = in.int32();
+    in.int64(); // properties
+    int64_t start = in.int64();
+    int64_t nstates = in.int64();
+    // every state takes at least 12 bytes; this also keeps us from
+    // creating 2^31 nodes on a truncated file
+    if(nstates < 0 || nstates > 0x7fffffff || !in.fits(nstates * 12))
+        throw "invalid number of states";
     fst.clear();
     for(int i = 0; i < nstates; i++)
         fst.newState();
     fst.setStart(start);
 
-    read_int64_LE(stream); // narcs
+    in.int64(); // narcs
 
     if(flags & FLAG_HAS_ISYMBOLS)
-        skip_symbol_table(stream);
+        skip_symbol_table(in);
     if(flags & FLAG_HAS_OSYMBOLS)
-        skip_symbol_table(stream);
-
-    if(ferror(stream))
-        return "error in the stream";
-    if(feof(stream))
-        return "unexpected EOF";
-    return NULL;
+        skip_symbol_table(in);
 }
 
 /*static int64_t narcs(IGenericFst &fst) {
@@ -164,73 +225,117 @@ static const char *read_header_and_symbols(IGenericFst &fst, FILE *stream) {
     return result;
 }*/
 
-static void write_header_and_symbols(FILE *stream, IGenericFst &fst) {
-    write_int32_LE(stream, OPENFST_MAGIC);
-    write_string(stream, "vector");
-    write_string(stream, "standard");
-    write_int32_LE(stream, MIN_VERSION);
-    write_int32_LE(stream, /* flags: */ 0);
-    write_int64_LE(stream, PROPERTIES);
-    write_int64_LE(stream, fst.getStart());
-    write_int64_LE(stream, fst.nStates());
-    write_int64_LE(stream, /* narcs (seems to be unused): */ 0);
+static void write_header_and_symbols(FstWriteBuffer &out, IGenericFst &fst) {
+    out.int32(OPENFST_MAGIC);
+    out.string("vector");
+    out.string("standard");
+    out.int32(MIN_VERSION);
+    out.int32(/* flags: */ 0);
+    out.int64(PROPERTIES);
+    out.int64(fst.getStart());
+    out.int64(fst.nStates());
+    out.int64(/* narcs (seems to be unused): */ 0);
 }
 
-static void write_node(FILE *stream, IGenericFst &fst, int index) {
-    intarray inputs;
-    intarray targets;
-    intarray outputs;
-    floatarray costs;
-    fst.arcs(inputs, targets, outputs, costs, index);
+static void write_arcs(FstWriteBuffer &out, intarray &inputs,
+                       intarray &targets, intarray &outputs,
+                       floatarray &costs) {
     int narcs = targets.length();
+    out.int64(narcs);
+    for(int i = 0; i < narcs; i++) {
+        out.int32(inputs[i]);
+        out.int32(outputs[i]);
+        out.float32(costs[i]);
+        out.int32(targets[i]);
+    }
+}
 
+static void write_node(FstWriteBuffer &out, IGenericFst &fst,
+                       OcroFST *ocrofst, int index) {
     // By convention, anything larger than 1e37 is treated
     // as infinite accept cost (=no final state) in OCRopus.
     // This makes such files look right in the OpenFST tools.
 
     float cost = fst.getAcceptCost(index);
     if(cost>1e37) cost = INFINITY;
-    write_float(stream,cost);
-
-    write_int64_LE(stream, narcs);
-    for(int i = 0; i < narcs; i++) {
-        write_int32_LE(stream, inputs[i]);
-        write_int32_LE(stream, outputs[i]);
-        write_float(stream, costs[i]);
-        write_int32_LE(stream, targets[i]);
+    out.float32(cost);
+
+    if(ocrofst) {
+        // write straight from the arc arrays, without copying them
+        write_arcs(out, ocrofst->inputs(index), ocrofst->targets(index),
+                   ocrofst->outputs(index), ocrofst->costs(index));
+    } else {
+        intarray inputs;
+        intarray targets;
+        intarray outputs;
+        floatarray costs;
+        fst.arcs(inputs, targets, outputs, costs, index);
+        write_arcs(out, inputs, targets, outputs, costs);
     }
 }
 
-static void read_node(FILE *stream, IGenericFst &fst, int index) {
+static void read_node(FstReadBuffer &in, IGenericFst &fst,
+                      OcroFST *ocrofst, int index) {
 
     // We don't bother undoing the "inf" from the binary FST files;
     // the OCRopus search algorithms should deal fine with them.
 
-    fst.setAccept(index, read_float(stream));
-    int narcs = read_int64_LE(stream);
-    for(int i = 0; i < narcs; i++) {
-        int input = read_int32_LE(stream);
-        int output = read_int32_LE(stream);
-        float cost = read_float(stream);
-        int target = read_int32_LE(stream);
-        fst.addTransition(index, target, output, cost, input);
+    const unsigned char *q = in.take(12);
+    fst.setAccept(index, get_float(q));
+    int64_t narcs = get_int64_LE(q + 4);
+    if(narcs < 0 || narcs > 0x7fffffff / 16 || !in.fits(narcs * 16))
+        throw "invalid number of arcs";
+    const unsigned char *p = in.take(narcs * 16);
+    int nstates = fst.nStates();
+    if(ocrofst) {
+        // the arc count is known up front, so fill the arc arrays
+        // in place instead of pushing one transition at a time
+        intarray &inputs = ocrofst->inputs(index);
+        intarray &outputs = ocrofst->outputs(index);
+        floatarray &costs = ocrofst->costs(index);
+        intarray &targets = ocrofst->targets(index);
+        inputs.resize(narcs);
+        outputs.resize(narcs);
+        costs.resize(narcs);
+        targets.resize(narcs);
+        for(int i = 0; i < narcs; i++, p += 16) {
+            inputs[i] = get_int32_LE(p);
+            outputs[i] = get_int32_LE(p + 4);
+            costs[i] = get_float(p + 8);
+            targets[i] = get_int32_LE(p + 12);
+            if(unsigned(targets[i]) >= unsigned(nstates))
+                throw "invalid arc target";
+        }
+    } else {
+        for(int i = 0; i < narcs; i++, p += 16) {
+            int target = get_int32_LE(p + 12);
+            if(unsigned(target) >= unsigned(nstates))
+                throw "invalid arc target";
+            fst.addTransition(index, target, get_int32_LE(p + 4),
+                              get_float(p + 8), get_int32_LE(p));
+        }
     }
 }
 
 namespace ocropus {
 
     void fst_write(FILE *stream, IGenericFst &fst) {
-        write_header_and_symbols(stream, fst);
+        OcroFST *ocrofst = dynamic_cast<OcroFST *>(&fst);
+        FstWriteBuffer out(stream);
+        write_header_and_symbols(out, fst);
         for(int i = 0; i < fst.nStates(); i++)
-            write_node(stream, fst, i);
+            write_node(out, fst, ocrofst, i);
+        out.flush();
     }
 
     void fst_read(IGenericFst &fst, FILE *stream) {
-        const char *errmsg = read_header_and_symbols(fst, stream);
-        if(errmsg)
-            throw errmsg;
+        OcroFST *ocrofst = dynamic_cast<OcroFST *>(&fst);
+        FstReadBuffer in(stream);
+        read_header_and_symbols(fst, in);
         for(int i = 0; i < fst.nStates(); i++)
-            read_node(stream, fst, i);
+            read_node(in, fst, ocrofst, i);
+        if(ocrofst)
+            ocrofst->clearFlags();
     }
 
     void fst_write(const char *path, IGenericFst &fst) {
@@ -0,0 +1,134 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: n-best queue of the beam search against a sorted list
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include "ocropus.h"
+#include "fst-heap.h"
+
+using namespace colib;
+using namespace ocropus;
+
+// The n best entries kept in decreasing order of value, the way the
+// queue used to do it.  Values are distinct in this test, so ties
+// don't matter.
+struct SortedNBest {
+    int n;
+    narray<int64_t> ids;
+    intarray tags;
+    floatarray values;
+    SortedNBest(int n) : n(n) {}
+    int find(int64_t id) {
+        for(int i=0;i<ids.length();i++)
+            if(ids[i]==id) return i;
+        return -1;
+    }
+    void erase(int i) {
+        for(int j=i;j<ids.length()-1;j++) {
+            ids[j] = ids[j+1];
+            tags[j] = tags[j+1];
+            values[j] = values[j+1];
+        }
+        ids.pop();
+        tags.pop();
+        values.pop();
+    }
+    void insert(int64_t id,int tag,float value) {
+        int i = 0;
+        while(i<values.length() && values[i]>value) i++;
+        ids.push(id);
+        tags.push(tag);
+        values.push(value);
+        for(int j=ids.length()-1;j>i;j--) {
+            ids[j] = ids[j-1];
+            tags[j] = tags[j-1];
+            values[j] = values[j-1];
+        }
+        ids[i] = id;
+        tags[i] = tag;
+        values[i] = value;
+    }
+    bool add(int64_t id,int tag,float value) {
+        if(ids.length()==n) {
+            if(values[n-1]>=value) return false;
+            erase(n-1);
+        }
+        insert(id,tag,value);
+        return true;
+    }
+    bool add_replacing_id(int64_t id,int tag,float value) {
+        int i = find(id);
+        if(i<0) return add(id,tag,value);
+        if(values[i]>=value) return false;
+        erase(i);
+        insert(id,tag,value);
+        return true;
+    }
+};
+
+static bool same(PriorityQueue &queue,SortedNBest &expected) {
+    if(queue.length()!=expected.ids.length()) return false;
+    for(int i=0;i<queue.length();i++) {
+        if(queue[i]!=expected.ids[i]) return false;
+        if(queue.tag(i)!=expected.tags[i]) return false;
+        if(queue.value(i)!=expected.values[i]) return false;
+        if(queue.find_id(expected.ids[i])<0) return false;
+    }
+    return true;
+}
+
+int main() {
+    srand(0);
+    int sizes[] = {1,2,7,100};
+    for(int s=0;s<4;s++) {
+        int n = sizes[s];
+        PriorityQueue queue(n);
+        SortedNBest expected(n);
+        int counter = 0;
+        for(int step=0;step<5000;step++) {
+            // few distinct ids, so that replacing and re-adding
+            // evicted ids happen often; some need more than 32 bits
+            int64_t id = rand()%(3*n+5);
+            if(id%3==0) id += int64_t(1)<<40;
+            int tag = rand()%1000;
+            // distinct, in random order
+            float value = float((counter++*7919)%100003);
+            bool replacing = rand()%2;
+            bool changed = replacing ? queue.add_replacing_id(id,tag,value) : false;
+            if(replacing) {
+                CHECK_CONDITION(changed==expected.add_replacing_id(id,tag,value));
+            } else if(expected.find(id)<0) {
+                // plain add is only used for ids that aren't queued
+                CHECK_CONDITION(queue.add(id,tag,value)==expected.add(id,tag,value));
+            }
+            // reading ranks in between must not disturb the queue
+            if(step%7==0) CHECK_CONDITION(same(queue,expected));
+        }
+        CHECK_CONDITION(same(queue,expected));
+        queue.clear();
+        CHECK_CONDITION(queue.length()==0);
+        CHECK_CONDITION(queue.find_id(expected.ids[0])==-1);
+    }
+    return 0;
+}
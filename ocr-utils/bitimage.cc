@@ -0,0 +1,418 @@
+// -*- C++ -*-
+
+// Copyright 2006 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: bitimage.cc
+// Purpose: bit-packed binary images and word-parallel morphology
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#include "ocropus.h"
+#include "bitimage.h"
+
+using namespace colib;
+
+namespace ocropus {
+
+    namespace {
+        inline int popcount(uint64_t v) {
+            return __builtin_popcountll(v);
+        }
+
+        inline uint64_t low_mask(int n) {
+            return n>=64 ? ~uint64_t(0) : (uint64_t(1)<<n)-1;
+        }
+
+        inline uint64_t word_at(uint64_t *p,int n,int k) {
+            return (k>=0 && k<n) ? p[k] : 0;
+        }
+
+        // p(y) := p(y-s), or p(y) |= p(y-s) if accumulate; in place
+        void shift_words(uint64_t *p,int n,int s,bool accumulate) {
+            if(s>=0) {
+                int q = s>>6, r = s&63;
+                for(int k=n-1;k>=0;k--) {
+                    uint64_t v = word_at(p,n,k-q)<<r;
+                    if(r) v |= word_at(p,n,k-q-1)>>(64-r);
+                    p[k] = accumulate ? (p[k]|v) : v;
+                }
+            } else {
+                int q = (-s)>>6, r = (-s)&63;
+                for(int k=0;k<n;k++) {
+                    uint64_t v = word_at(p,n,k+q)>>r;
+                    if(r) v |= word_at(p,n,k+q+1)<<(64-r);
+                    p[k] = accumulate ? (p[k]|v) : v;
+                }
+            }
+        }
+
+        // image(x) |= image(x-s); in place
+        void or_shift_x(BitImage &image,int s) {
+            int n = image.words;
+            if(s>0) {
+                for(int x=image.w-1;x>=s;x--) {
+                    uint64_t *dst = image.column(x), *src = image.column(x-s);
+                    for(int k=0;k<n;k++) dst[k] |= src[k];
+                }
+            } else if(s<0) {
+                for(int x=0;x<image.w+s;x++) {
+                    uint64_t *dst = image.column(x), *src = image.column(x-s);
+                    for(int k=0;k<n;k++) dst[k] |= src[k];
+                }
+            }
+        }
+
+        // image(x) := image(x-s), shifting in background
+        void translate_x(BitImage &image,int s) {
+            int n = image.words;
+            if(s>0) {
+                for(int x=image.w-1;x>=0;x--) {
+                    uint64_t *dst = image.column(x);
+                    if(x>=s) {
+                        uint64_t *src = image.column(x-s);
+                        for(int k=0;k<n;k++) dst[k] = src[k];
+                    } else {
+                        for(int k=0;k<n;k++) dst[k] = 0;
+                    }
+                }
+            } else if(s<0) {
+                for(int x=0;x<image.w;x++) {
+                    uint64_t *dst = image.column(x);
+                    if(x-s<image.w) {
+                        uint64_t *src = image.column(x-s);
+                        for(int k=0;k<n;k++) dst[k] = src[k];
+                    } else {
+                        for(int k=0;k<n;k++) dst[k] = 0;
+                    }
+                }
+            }
+        }
+
+        void or_shift_y(BitImage &image,int s) {
+            for(int x=0;x<image.w;x++)
+                shift_words(image.column(x),image.words,s,true);
+            image.clear_padding();
+        }
+
+        void translate_y(BitImage &image,int s) {
+            if(s==0) return;
+            for(int x=0;x<image.w;x++)
+                shift_words(image.column(x),image.words,s,false);
+            image.clear_padding();
+        }
+
+        // Or together n consecutive shifts s*0, s*1, ..., s*(n-1)
+        // using log2(n) passes: after each pass the covered run of
+        // shifts is extended by at most its own length.
+        void or_run(BitImage &image,int s,int n,bool along_x) {
+            int len = 1;
+            while(len<n) {
+                int step = min(len,n-len);
+                if(along_x) or_shift_x(image,s*step);
+                else or_shift_y(image,s*step);
+                len += step;
+            }
+        }
+
+        // image(x) := max_{lo<=d<=hi} image(x-d); out of range pixels
+        // are background
+        void dilate_run(BitImage &image,int lo,int hi,bool along_x) {
+            if(hi<lo) return;
+            if(lo>=0) {
+                or_run(image,1,hi-lo+1,along_x);
+                if(along_x) translate_x(image,lo);
+                else translate_y(image,lo);
+            } else if(hi<=0) {
+                or_run(image,-1,hi-lo+1,along_x);
+                if(along_x) translate_x(image,hi);
+                else translate_y(image,hi);
+            } else {
+                BitImage temp;
+                bits_copy(temp,image);
+                or_run(image,1,hi+1,along_x);
+                or_run(temp,-1,1-lo,along_x);
+                bits_or(image,temp);
+            }
+        }
+
+        // transpose a 64x64 bit block in place; bit j of a[i]
+        // ends up as bit i of a[j]
+        void transpose64(uint64_t a[64]) {
+            uint64_t m = 0x00000000FFFFFFFFULL;
+            for(int j=32;j!=0;j>>=1,m^=m<<j) {
+                for(int k=0;k<64;k=((k|j)+1)&~j) {
+                    uint64_t t = ((a[k]>>j)^a[k|j])&m;
+                    a[k] ^= t<<j;
+                    a[k|j] ^= t;
+                }
+            }
+        }
+
+        inline void set_range(uint64_t *p,int y0,int y1) {
+            for(int y=y0;y<y1;) {
+                int k = y>>6, b = y&63;
+                int n = min(64-b,y1-y);
+                p[k] |= low_mask(n)<<b;
+                y += n;
+            }
+        }
+
+        // index of the first set bit at or after y, or -1
+        inline int next_set(uint64_t *p,int words,int y) {
+            int k = y>>6;
+            if(k>=words) return -1;
+            uint64_t v = p[k] & (~uint64_t(0)<<(y&63));
+            while(!v) {
+                if(++k>=words) return -1;
+                v = p[k];
+            }
+            return (k<<6)+__builtin_ctzll(v);
+        }
+
+        inline int next_clear(uint64_t *p,int words,int y) {
+            int k = y>>6;
+            if(k>=words) return words<<6;
+            uint64_t v = ~p[k] & (~uint64_t(0)<<(y&63));
+            while(!v) {
+                if(++k>=words) return words<<6;
+                v = ~p[k];
+            }
+            return (k<<6)+__builtin_ctzll(v);
+        }
+    }
+
+    void BitImage::clear_padding() {
+        if(h%64==0) return;
+        uint64_t mask = low_mask(h%64);
+        for(int x=0;x<w;x++) bits[x*words+words-1] &= mask;
+    }
+
+    void bits_pack(BitImage &out,bytearray &in) {
+        int w = in.dim(0), h = in.dim(1);
+        out.resize(w,h);
+#pragma omp parallel for schedule(static)
+        for(int x=0;x<w;x++) {
+            byte *src = &in(x,0);
+            uint64_t *dst = out.column(x);
+            for(int y=0;y<h;y++)
+                if(src[y]) dst[y>>6] |= uint64_t(1)<<(y&63);
+        }
+    }
+
+    void bits_unpack(bytearray &out,BitImage &in,byte on,byte off) {
+        int w = in.w, h = in.h;
+        out.resize(w,h);
+#pragma omp parallel for schedule(static)
+        for(int x=0;x<w;x++) {
+            byte *dst = &out(x,0);
+            uint64_t *src = in.column(x);
+            for(int y=0;y<h;y++)
+                dst[y] = ((src[y>>6]>>(y&63))&1) ? on : off;
+        }
+    }
+
+    void bits_copy(BitImage &out,BitImage &in) {
+        out.w = in.w;
+        out.h = in.h;
+        out.words = in.words;
+        copy(out.bits,in.bits);
+    }
+
+    void bits_transpose(BitImage &out,BitImage &in) {
+        out.resize(in.h,in.w);
+        int xblocks = (in.w+63)/64;
+#pragma omp parallel for schedule(static)
+        for(int xb=0;xb<xblocks;xb++) {
+            uint64_t block[64];
+            for(int k=0;k<in.words;k++) {
+                for(int i=0;i<64;i++) {
+                    int x = xb*64+i;
+                    block[i] = x<in.w ? in.column(x)[k] : 0;
+                }
+                transpose64(block);
+                for(int j=0;j<64;j++) {
+                    int y = k*64+j;
+                    if(y<in.h) out.column(y)[xb] = block[j];
+                }
+            }
+        }
+    }
+
+    int bits_count(BitImage &image) {
+        int total = 0;
+        int n = image.bits.length();
+        for(int i=0;i<n;i++) total += popcount(image.bits[i]);
+        return total;
+    }
+
+    int bits_count(BitImage &image,int x0,int y0,int x1,int y1) {
+        x0 = max(x0,0); y0 = max(y0,0);
+        x1 = min(x1,image.w); y1 = min(y1,image.h);
+        if(x0>=x1 || y0>=y1) return 0;
+        int k0 = y0>>6, k1 = (y1-1)>>6;
+        uint64_t first = ~uint64_t(0)<<(y0&63);
+        uint64_t last = low_mask(y1-(k1<<6));
+        int total = 0;
+        for(int x=x0;x<x1;x++) {
+            uint64_t *p = image.column(x);
+            if(k0==k1) {
+                total += popcount(p[k0]&first&last);
+            } else {
+                total += popcount(p[k0]&first);
+                for(int k=k0+1;k<k1;k++) total += popcount(p[k]);
+                total += popcount(p[k1]&last);
+            }
+        }
+        return total;
+    }
+
+    void bits_column_profile(intarray &profile,BitImage &image) {
+        profile.resize(image.w);
+        for(int x=0;x<image.w;x++) {
+            uint64_t *p = image.column(x);
+            int total = 0;
+            for(int k=0;k<image.words;k++) total += popcount(p[k]);
+            profile(x) = total;
+        }
+    }
+
+    void bits_row_profile(intarray &profile,BitImage &image) {
+        profile.resize(image.h);
+        fill(profile,0);
+        for(int x=0;x<image.w;x++) {
+            uint64_t *p = image.column(x);
+            for(int k=0;k<image.words;k++) {
+                for(uint64_t v=p[k];v;v&=v-1)
+                    profile((k<<6)+__builtin_ctzll(v))++;
+            }
+        }
+    }
+
+    void bits_invert(BitImage &image) {
+        int n = image.bits.length();
+        for(int i=0;i<n;i++) image.bits[i] = ~image.bits[i];
+        image.clear_padding();
+    }
+
+    void bits_or(BitImage &image,BitImage &other) {
+        CHECK_ARG(image.w==other.w && image.h==other.h);
+        int n = image.bits.length();
+        for(int i=0;i<n;i++) image.bits[i] |= other.bits[i];
+    }
+
+    void bits_and(BitImage &image,BitImage &other) {
+        CHECK_ARG(image.w==other.w && image.h==other.h);
+        int n = image.bits.length();
+        for(int i=0;i<n;i++) image.bits[i] &= other.bits[i];
+    }
+
+    void bits_andnot(BitImage &image,BitImage &other) {
+        CHECK_ARG(image.w==other.w && image.h==other.h);
+        int n = image.bits.length();
+        for(int i=0;i<n;i++) image.bits[i] &= ~other.bits[i];
+    }
+
+    void bits_dilate_rect(BitImage &image,int rw,int rh) {
+        if(rw>0) dilate_run(image,-(rw/2),rw-1-rw/2,true);
+        if(rh>0) dilate_run(image,-(rh/2),rh-1-rh/2,false);
+    }
+
+    void bits_erode_rect(BitImage &image,int rw,int rh) {
+        bits_invert(image);
+        bits_dilate_rect(image,rw,rh);
+        bits_invert(image);
+    }
+
+    void bits_open_rect(BitImage &image,int rw,int rh) {
+        bits_erode_rect(image,rw,rh);
+        bits_dilate_rect(image,rw,rh);
+    }
+
+    void bits_close_rect(BitImage &image,int rw,int rh) {
+        bits_dilate_rect(image,rw,rh);
+        bits_erode_rect(image,rw,rh);
+    }
+
+    void bits_dilate_circle(BitImage &image,int r) {
+        if(r<=0) return;
+        // the disk is a stack of horizontal runs; dilate by each run
+        // once and or it in at the two rows it belongs to
+        BitImage out,run,temp;
+        out.resize(image.w,image.h);
+        int last = -1;
+        for(int j=0;j<=r;j++) {
+            int k = 0;
+            while((k+1)*(k+1)+j*j<=r*r) k++;
+            if(k!=last) {
+                bits_copy(run,image);
+                dilate_run(run,-k,k,true);
+                last = k;
+            }
+            bits_copy(temp,run);
+            translate_y(temp,j);
+            bits_or(out,temp);
+            if(j==0) continue;
+            bits_copy(temp,run);
+            translate_y(temp,-j);
+            bits_or(out,temp);
+        }
+        move(image.bits,out.bits);
+    }
+
+    void bits_erode_circle(BitImage &image,int r) {
+        bits_invert(image);
+        bits_dilate_circle(image,r);
+        bits_invert(image);
+    }
+
+    void bits_open_circle(BitImage &image,int r) {
+        bits_erode_circle(image,r);
+        bits_dilate_circle(image,r);
+    }
+
+    void bits_close_circle(BitImage &image,int r) {
+        bits_dilate_circle(image,r);
+        bits_erode_circle(image,r);
+    }
+
+    void bits_smear_y(BitImage &image,int maxgap) {
+        if(maxgap<=0) return;
+#pragma omp parallel for schedule(static)
+        for(int x=0;x<image.w;x++) {
+            uint64_t *p = image.column(x);
+            int y = next_set(p,image.words,0);
+            while(y>=0) {
+                int gap = next_clear(p,image.words,y);
+                if(gap>=image.h) break;
+                int next = next_set(p,image.words,gap);
+                if(next<0) break;
+                if(next-gap<=maxgap) set_range(p,gap,next);
+                y = next;
+            }
+        }
+    }
+
+    void bits_smear_x(BitImage &image,int maxgap) {
+        if(maxgap<=0) return;
+        BitImage temp;
+        bits_transpose(temp,image);
+        bits_smear_y(temp,maxgap);
+        bits_transpose(image,temp);
+    }
+}
@@ -0,0 +1,111 @@
+// -*- C++ -*-
+
+// Copyright 2006 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: bitimage.h
+// Purpose: bit-packed binary images and word-parallel morphology
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#ifndef h_bitimage_
+#define h_bitimage_
+
+#include <stdint.h>
+#include "colib/colib.h"
+
+namespace ocropus {
+    using namespace colib;
+
+    // A binary image with one bit per pixel.  Like bytearray images,
+    // pixel (x,y) is addressed with x along dim(0); each column is
+    // stored as words 64-bit words with y running along the bits, so
+    // that whole columns can be shifted, or'ed and counted a word at a
+    // time.  Padding bits past the height are always zero.
+
+    struct BitImage {
+        int w,h,words;
+        narray<uint64_t> bits;
+
+        BitImage() {
+            w = h = words = 0;
+        }
+        BitImage(int w,int h) {
+            resize(w,h);
+        }
+        void resize(int w_,int h_) {
+            w = w_;
+            h = h_;
+            words = (h+63)/64;
+            bits.resize(w*words);
+            fill(bits,0);
+        }
+        int dim(int i) {
+            return i==0?w:h;
+        }
+        uint64_t *column(int x) {
+            return &bits[x*words];
+        }
+        bool operator()(int x,int y) {
+            return (bits[x*words+(y>>6)]>>(y&63))&1;
+        }
+        void set(int x,int y,bool value) {
+            uint64_t mask = uint64_t(1)<<(y&63);
+            if(value) bits[x*words+(y>>6)] |= mask;
+            else bits[x*words+(y>>6)] &= ~mask;
+        }
+        void clear_padding();
+    };
+
+    // conversion; any nonzero pixel is foreground
+    void bits_pack(BitImage &out,bytearray &in);
+    void bits_unpack(bytearray &out,BitImage &in,byte on=255,byte off=0);
+    void bits_copy(BitImage &out,BitImage &in);
+    void bits_transpose(BitImage &out,BitImage &in);
+
+    // pixel counts; rectangles are half-open like rectangle
+    int bits_count(BitImage &image);
+    int bits_count(BitImage &image,int x0,int y0,int x1,int y1);
+    void bits_column_profile(intarray &profile,BitImage &image);
+    void bits_row_profile(intarray &profile,BitImage &image);
+
+    // pixelwise logic
+    void bits_invert(BitImage &image);
+    void bits_or(BitImage &image,BitImage &other);
+    void bits_and(BitImage &image,BitImage &other);
+    void bits_andnot(BitImage &image,BitImage &other);
+
+    // Morphology with the same structuring elements and the same
+    // treatment of the border as the binary_* functions in iulib,
+    // so results are identical to packing the output of those.
+    void bits_dilate_rect(BitImage &image,int rw,int rh);
+    void bits_erode_rect(BitImage &image,int rw,int rh);
+    void bits_open_rect(BitImage &image,int rw,int rh);
+    void bits_close_rect(BitImage &image,int rw,int rh);
+    void bits_dilate_circle(BitImage &image,int r);
+    void bits_erode_circle(BitImage &image,int r);
+    void bits_open_circle(BitImage &image,int r);
+    void bits_close_circle(BitImage &image,int r);
+
+    // run-length smearing: fill background runs of at most maxgap
+    // pixels that have foreground on both ends
+    void bits_smear_x(BitImage &image,int maxgap);
+    void bits_smear_y(BitImage &image,int maxgap);
+}
+
+#endif
@@ -177,6 +177,10 @@ namespace ocropus {
             return lines.length();
         }
 
+        // line names have four decimal digits, too few for colors
+        bool linesByNumber() {
+            return true;
+        }
     };
 
     struct BookStore : OldBookStore {
@@ -207,6 +211,9 @@ namespace ocropus {
             }
             return file;
         }
+        bool linesByNumber() {
+            return false;
+        }
 
     };
 
@@ -248,6 +255,7 @@ namespace ocropus {
         virtual int numberOfPages() { return p->numberOfPages(); }
         virtual int linesOnPage(int i) { return p->linesOnPage(i); }
         virtual int getLineId(int i,int j) { return p->getLineId(i,j); }
+        virtual bool linesByNumber() { return p->linesByNumber(); }
     };
 
     IBookStore *make_OldBookStore() {
@@ -28,6 +28,9 @@ namespace ocropus {
         virtual int numberOfPages() = 0;
         virtual int linesOnPage(int i) = 0;
         virtual int getLineId(int i,int j) = 0;
+        /// true if lines are stored under their number in the page,
+        /// false if under their pseg color
+        virtual bool linesByNumber() { return false; }
 
         void getLineBin(bytearray &image,int page,int line,const char *variant=0) {
             strg v = "bin";
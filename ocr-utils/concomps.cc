@@ -0,0 +1,280 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: concomps.cc
+// Purpose: parallel connected component labeling with component statistics
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#include "ocropus.h"
+#include "concomps.h"
+
+using namespace colib;
+
+namespace ocropus {
+
+    namespace {
+        // columns per strip; the strip borders are merged sequentially
+        const int strip = 128;
+
+        // Provisional labels are unique across the page: every run
+        // gets at most one, and the labels of a strip begin after
+        // those of the strips to its left, as counted by count_runs.
+        // Every label points to a smaller or equal one, and roots are
+        // the smallest label of their component.
+
+        inline int find(int *parent,int l) {
+            while(parent[l]!=l) {
+                parent[l] = parent[parent[l]];
+                l = parent[l];
+            }
+            return l;
+        }
+
+        inline int unite(int *parent,int a,int b) {
+            a = find(parent,a);
+            b = find(parent,b);
+            if(a<b) {
+                parent[b] = a;
+                return a;
+            }
+            parent[a] = b;
+            return b;
+        }
+
+        // pixel runs within a column, summarized
+        struct Moments {
+            int x0,y0,x1,y1,area;
+            double sx,sy;
+            Moments() {
+                area = 0;
+                sx = sy = 0;
+                x0 = y0 = x1 = y1 = 0;
+            }
+            void add(int x,int start,int end) {
+                int len = end-start;
+                if(area==0) {
+                    x0 = x1 = x;
+                    y0 = start;
+                    y1 = end-1;
+                } else {
+                    x0 = min(x0,x);
+                    x1 = max(x1,x);
+                    y0 = min(y0,start);
+                    y1 = max(y1,end-1);
+                }
+                area += len;
+                sx += double(x)*len;
+                sy += 0.5*(start+end-1)*len;
+            }
+            void add(Moments &m) {
+                if(m.area==0) return;
+                if(area==0) {
+                    *this = m;
+                    return;
+                }
+                x0 = min(x0,m.x0);
+                x1 = max(x1,m.x1);
+                y0 = min(y0,m.y0);
+                y1 = max(y1,m.y1);
+                area += m.area;
+                sx += m.sx;
+                sy += m.sy;
+            }
+        };
+
+        // number of runs of non-zero pixels in the columns [x0,x1)
+        int count_runs(intarray &image,int x0,int x1) {
+            int h = image.dim(1);
+            int count = 0;
+            for(int x=x0;x<x1;x++) {
+                int *col = &image(x,0);
+                for(int y=0;y<h;y++)
+                    if(col[y] && (y==0 || !col[y-1])) count++;
+            }
+            return count;
+        }
+
+        // label the columns [x0,x1) without looking outside of them,
+        // with labels starting at base
+        void label_strip(intarray &image,intarray &parent,narray<Moments> &moments,
+                         Moments &background,int base,int x0,int x1,bool four_connected) {
+            int h = image.dim(1);
+            int *p = &parent.at1d(0);
+            for(int x=x0;x<x1;x++) {
+                int *col = &image(x,0);
+                int *prev = x>x0 ? &image(x-1,0) : 0;
+                int y = 0;
+                while(y<h) {
+                    int start = y;
+                    if(!col[y]) {
+                        while(y<h && !col[y]) y++;
+                        background.add(x,start,y);
+                        continue;
+                    }
+                    while(y<h && col[y]) y++;
+                    // the run keeps one label, which is united with
+                    // the labels of the runs it touches on the left
+                    int label = 0, last = 0;
+                    if(prev) {
+                        int lo = start, hi = y;
+                        if(!four_connected) {
+                            lo = max(lo-1,0);
+                            hi = min(hi+1,h);
+                        }
+                        for(int k=lo;k<hi;k++) {
+                            int q = prev[k];
+                            if(!q || q==last) continue;
+                            last = q;
+                            label = label ? unite(p,label,q) : q;
+                        }
+                    }
+                    if(!label) {
+                        label = base+moments.length();
+                        p[label] = label;
+                        moments.push(Moments());
+                    }
+                    moments(label-base).add(x,start,y);
+                    for(int k=start;k<y;k++)
+                        col[k] = label;
+                }
+            }
+        }
+
+        // unite the labels on both sides of the border left of x
+        void merge_border(intarray &image,intarray &parent,int x,bool four_connected) {
+            int h = image.dim(1);
+            int *p = &parent.at1d(0);
+            int *col = &image(x,0);
+            int *prev = &image(x-1,0);
+            for(int y=0;y<h;y++) {
+                int a = col[y];
+                if(!a) continue;
+                if(prev[y]) unite(p,a,prev[y]);
+                if(four_connected) continue;
+                if(y>0 && prev[y-1]) unite(p,a,prev[y-1]);
+                if(y<h-1 && prev[y+1]) unite(p,a,prev[y+1]);
+            }
+        }
+    }
+
+    int ConnectedComponents::label(intarray &image,bool four_connected) {
+        CHECK_ARG(image.rank()==2);
+        int w = image.dim(0), h = image.dim(1);
+        CHECK_ARG(double(w)*((h+1)/2)<2147483647.0);
+        int nstrips = (w+strip-1)/strip;
+
+        // one entry of parent per run; counting them first costs a
+        // read of the page, but parent would otherwise have to be
+        // sized for the worst case of w*(h+1)/2 runs
+        intarray bases(nstrips);
+#pragma omp parallel for schedule(dynamic)
+        for(int s=0;s<nstrips;s++)
+            bases(s) = count_runs(image,s*strip,min(w,(s+1)*strip));
+        int nlabels = 1;
+        for(int s=0;s<nstrips;s++) {
+            int count = bases(s);
+            bases(s) = nlabels;
+            nlabels += count;
+        }
+        intarray parent(nlabels);
+        objlist< narray<Moments> > moments;
+        for(int s=0;s<nstrips;s++) moments.push();
+        narray<Moments> background(nstrips);
+
+#pragma omp parallel for schedule(dynamic)
+        for(int s=0;s<nstrips;s++)
+            label_strip(image,parent,moments(s),background(s),bases(s),
+                        s*strip,min(w,(s+1)*strip),four_connected);
+
+        for(int s=1;s<nstrips;s++)
+            merge_border(image,parent,s*strip,four_connected);
+
+        // Replace every provisional label by its final number.  Labels
+        // only point to smaller ones, which have been replaced already,
+        // so one pass in increasing order is enough; numbering the
+        // roots in that order numbers the components by first pixel.
+        n = 0;
+        for(int s=0;s<nstrips;s++) {
+            int base = bases(s);
+            for(int k=0;k<moments(s).length();k++) {
+                int l = base+k;
+                int q = parent(l);
+                parent(l) = q==l ? ++n : parent(q);
+            }
+        }
+        parent(0) = 0;
+
+        int total = image.length1d();
+#pragma omp parallel for schedule(static)
+        for(int i=0;i<total;i++)
+            image.at1d(i) = parent(image.at1d(i));
+
+        narray<Moments> sums(n+1);
+        for(int s=0;s<nstrips;s++) {
+            int base = bases(s);
+            sums(0).add(background(s));
+            for(int k=0;k<moments(s).length();k++)
+                sums(parent(base+k)).add(moments(s)(k));
+        }
+
+        boxes.clear();
+        areas.resize(n+1);
+        xcenters.resize(n+1);
+        ycenters.resize(n+1);
+        if(n>0) boxes.resize(n+1);
+        for(int i=0;i<=n;i++) {
+            Moments &m = sums(i);
+            areas(i) = m.area;
+            xcenters(i) = m.area ? m.sx/m.area : 0;
+            ycenters(i) = m.area ? m.sy/m.area : 0;
+            if(n==0) continue;
+            if(m.area) boxes(i) = rectangle(m.x0,m.y0,m.x1+1,m.y1+1);
+            else boxes(i) = rectangle();
+        }
+        return n;
+    }
+
+    void ConnectedComponents::remove(intarray &image,int i) {
+        CHECK_ARG(i>0 && i<=n);
+        if(!present(i)) return;
+        rectangle b = boxes(i);
+        for(int x=b.x0;x<b.x1;x++)
+            for(int y=b.y0;y<b.y1;y++)
+                if(image(x,y)==i) image(x,y) = 0;
+        areas(i) = 0;
+        xcenters(i) = ycenters(i) = 0;
+        boxes(i) = rectangle(0,0,0,0);
+    }
+
+    void ConnectedComponents::remove(intarray &image,bytearray &which) {
+        CHECK_ARG(which.length()==n+1 && !which(0));
+        int total = image.length1d();
+#pragma omp parallel for schedule(static)
+        for(int k=0;k<total;k++)
+            if(which(image.at1d(k))) image.at1d(k) = 0;
+        for(int i=1;i<=n;i++) {
+            if(!which(i)) continue;
+            areas(i) = 0;
+            xcenters(i) = ycenters(i) = 0;
+            boxes(i) = rectangle(0,0,0,0);
+        }
+    }
+}
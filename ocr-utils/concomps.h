@@ -0,0 +1,76 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: concomps.h
+// Purpose: parallel connected component labeling with component statistics
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#ifndef h_concomps_
+#define h_concomps_
+
+#include "colib/colib.h"
+
+namespace ocropus {
+    using namespace colib;
+
+    // Connected components of the non-zero pixels of an image and
+    // their statistics, computed together.  label() replaces the
+    // pixels with component numbers 1..n, like label_components, and
+    // fills in what bounding_boxes would return, so callers don't need
+    // another pass over the page.  Entry 0 describes the background.
+    //
+    // The page is labeled in vertical strips in parallel; labels are
+    // merged along the strip borders afterwards.  Components are
+    // numbered in the order in which they are first met scanning the
+    // image column by column, independent of the number of threads.
+
+    struct ConnectedComponents {
+        int n;
+        // as bounding_boxes returns them: empty if there are no
+        // components, otherwise n+1 boxes
+        rectarray boxes;
+        intarray areas;
+        floatarray xcenters,ycenters;
+
+        ConnectedComponents() {
+            n = 0;
+        }
+        int length() {
+            return boxes.length();
+        }
+        // label image in place and compute the statistics; returns n
+        int label(intarray &image,bool four_connected=false);
+        bool present(int i) {
+            return areas(i)>0;
+        }
+        // erase component i from the labeled image, keeping the
+        // statistics of the others valid; entry 0 is left alone.  This
+        // scans the box of i, which can overlap the boxes of others,
+        // so don't call it for several components in parallel.
+        void remove(intarray &image,int i);
+        // erase every component i with which(i) set (which has n+1
+        // entries, and which(0) must be 0), in one parallel pass over
+        // the image
+        void remove(intarray &image,bytearray &which);
+    };
+}
+
+#endif
@@ -22,6 +22,7 @@
 // Web Sites: www.iupr.org, www.dfki.de, www.ocropus.org
 
 
+#include <stdlib.h>
 #include "iulib/imglib.h"
 #include "didegrade.h"
 #include "logger.h"
@@ -33,45 +34,27 @@ using namespace ocropus;
 namespace {
     Logger logger("degrade");
 
-    double rand_uniform() {
-        return double(rand())/double(RAND_MAX);
-    }
-
-    // Definitely a reimplementation of something
-    // generate a number approx N(mean,sigma) using the Box-Muller Transform
-    float rand_gauss(float mean, float sigma) {
-        float r,phi;
-        if(sigma == 0)
-            return 0;
-        do {
-            r = rand_uniform();
-            phi = rand_uniform();
-        } while(r == 0.0 || phi == 0.0);
-        return mean + sigma*cos(2*M_PI*phi)*sqrt(-2*log(r));
-    }
-
     void elastic_transform_map(floatarray &result, int w, int h,
-                               float alpha, float sigma) {
+                               float alpha, float sigma,
+                               DegradationRandom &random) {
         result.resize(w, h);
         for(int i = 0; i < result.length1d(); i++)
-            result.at1d(i) = alpha * (2 * rand_uniform() - 1);
+            result.at1d(i) = alpha * (2 * random.uniform() - 1);
         gauss2d(result, sigma, sigma);
     }
 
     void elastic_transform(floatarray &out, floatarray &in,
-                           float alpha = 6, float sigma = 4) {
-        floatarray dx, dy;
-        elastic_transform_map(dx, in.dim(0), in.dim(1), alpha, sigma);
-        elastic_transform_map(dy, in.dim(0), in.dim(1), alpha, sigma);
+                           floatarray &dx, floatarray &dy) {
         makelike(out, in);
-        for(int x = 0; x < in.dim(0); x++) {
-            for(int y = 0; y < in.dim(1); y++) {
+        int w = in.dim(0), h = in.dim(1);
+        for(int x = 0; x < w; x++) {
+            for(int y = 0; y < h; y++) {
                 float nx = x + dx(x,y);
                 float ny = y + dy(x,y);
-                int x0 = min(max(int(floor(nx)), 0), in.dim(0) - 1);
-                int y0 = min(max(int(floor(ny)), 0), in.dim(1) - 1);
-                int x1 = min(x0 + 1, in.dim(0) - 1);
-                int y1 = min(y0 + 1, in.dim(1) - 1);
+                int x0 = min(max(int(floor(nx)), 0), w - 1);
+                int y0 = min(max(int(floor(ny)), 0), h - 1);
+                int x1 = min(x0 + 1, w - 1);
+                int y1 = min(y0 + 1, h - 1);
                 float xx = nx - x0;
                 float yy = ny - y0;
                 float co_00 = (1 - xx) * (1 - yy);
@@ -91,7 +74,8 @@ namespace {
         }
     }
 
-    void jitter(floatarray &out, floatarray &in, float mean, float sigma) {
+    void jitter(floatarray &out, floatarray &in, float mean, float sigma,
+                DegradationRandom &random) {
         float delta_x=0.0;
         float delta_y=0.0;
         int x1,x2,y1,y2;
@@ -103,8 +87,8 @@ namespace {
 
         for(int i=2;i<out.dim(0)-2;i++) {
             for(int j=2;j<out.dim(1)-2;j++) {
-                delta_x=rand_gauss(mean,sigma);
-                delta_y=rand_gauss(mean,sigma);
+                delta_x=random.gauss(mean,sigma);
+                delta_y=random.gauss(mean,sigma);
                 x1=i;
                 y1=j;
                 x2=(delta_x>0)?i+1:i-1;
@@ -128,23 +112,92 @@ namespace {
         }
     }
 
-    void adjust_sensitivity(floatarray &a, double mean, double sigma) {
+    void adjust_sensitivity(floatarray &a, double mean, double sigma,
+                            DegradationRandom &random) {
         for(int i = 0; i < a.length1d(); i++)
-            a.at1d(i) -= 255 * rand_gauss(mean,sigma);
+            a.at1d(i) -= 255 * random.gauss(mean,sigma);
     }
 
-    void threshold(floatarray &a, double mean, double sigma) {
+    void threshold(floatarray &a, double mean, double sigma,
+                   DegradationRandom &random) {
         double threshold;
         for(int i = 0; i < a.length1d(); i++) {
-            threshold = 255 - 255 * rand_gauss(mean,sigma);
+            threshold = 255 - 255 * random.gauss(mean,sigma);
             a.at1d(i) = (a.at1d(i) <= threshold  ?  0  : 255);
         }
     }
 
+    // splitmix64 step, for turning a seed and an index into
+    // well separated stream states
+    unsigned long long mix(unsigned long long z) {
+        z += 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
 }
 
 namespace ocropus {
+    void DegradationRandom::seed(long seed,long index) {
+        unsigned long long z = mix(mix((unsigned long long)seed) ^ (unsigned long long)index);
+        state[0] = z & 0xffff;
+        state[1] = (z >> 16) & 0xffff;
+        state[2] = (z >> 32) & 0xffff;
+    }
+
+    double DegradationRandom::uniform() {
+        return erand48(state);
+    }
+
+    // Definitely a reimplementation of something
+    // generate a number approx N(mean,sigma) using the Box-Muller Transform
+    double DegradationRandom::gauss(double mean,double sigma) {
+        double r,phi;
+        if(sigma == 0)
+            return 0;
+        do {
+            r = uniform();
+            phi = uniform();
+        } while(r == 0.0 || phi == 0.0);
+        return mean + sigma*cos(2*M_PI*phi)*sqrt(-2*log(r));
+    }
+
+    void ElasticMaps::init(DegradationRandom &random,int w,int h,
+                           float alpha,float sigma) {
+        this->alpha = alpha;
+        this->sigma = sigma;
+        elastic_transform_map(dx, w, h, alpha, sigma, random);
+        elastic_transform_map(dy, w, h, alpha, sigma, random);
+    }
+
+    void ElasticMaps::get(floatarray &dx,floatarray &dy,int w,int h,
+                          DegradationRandom &random) {
+        // stay away from the borders of the precomputed fields, where
+        // the smoothing sees fewer samples
+        int margin = int(3*sigma);
+        int xrange = this->dx.dim(0) - 2*margin - w;
+        int yrange = this->dx.dim(1) - 2*margin - h;
+        if(this->dx.length()==0 || xrange < 0 || yrange < 0) {
+            elastic_transform_map(dx, w, h, alpha, sigma, random);
+            elastic_transform_map(dy, w, h, alpha, sigma, random);
+            return;
+        }
+        int x0 = margin + int(random.uniform() * (xrange + 1));
+        int y0 = margin + int(random.uniform() * (yrange + 1));
+        dx.resize(w, h);
+        dy.resize(w, h);
+        for(int x = 0; x < w; x++) {
+            for(int y = 0; y < h; y++) {
+                dx(x,y) = this->dx(x0+x,y0+y);
+                dy(x,y) = this->dy(x0+x,y0+y);
+            }
+        }
+    }
+
     void degrade(bytearray &image,
+            DegradationRandom &random,
+            ElasticMaps *maps,
             double jitter_mean,
             double jitter_sigma,
             double sensitivity_mean,
@@ -153,15 +206,37 @@ namespace ocropus {
             double threshold_sigma) {
         floatarray a;
         copy(a, image);
+        floatarray dx, dy;
+        if(maps) {
+            maps->get(dx, dy, a.dim(0), a.dim(1), random);
+        } else {
+            elastic_transform_map(dx, a.dim(0), a.dim(1), 6, 4, random);
+            elastic_transform_map(dy, a.dim(0), a.dim(1), 6, 4, random);
+        }
         floatarray elastic;
-        elastic_transform(elastic, a);
-        jitter(a, elastic,jitter_mean,jitter_sigma);
-        adjust_sensitivity(a, sensitivity_mean, sensitivity_sigma);
+        elastic_transform(elastic, a, dx, dy);
+        jitter(a, elastic, jitter_mean, jitter_sigma, random);
+        adjust_sensitivity(a, sensitivity_mean, sensitivity_sigma, random);
         if(threshold_mean)
-            threshold(a, threshold_mean, threshold_sigma);
+            threshold(a, threshold_mean, threshold_sigma, random);
         copy(image, a);
     }
 
+    void degrade(bytearray &image,
+            double jitter_mean,
+            double jitter_sigma,
+            double sensitivity_mean,
+            double sensitivity_sigma,
+            double threshold_mean,
+            double threshold_sigma) {
+        // still reproducible through srand()
+        DegradationRandom random(rand());
+        degrade(image, random, 0,
+                jitter_mean, jitter_sigma,
+                sensitivity_mean, sensitivity_sigma,
+                threshold_mean, threshold_sigma);
+    }
+
     struct Degradation : ICleanupGray {
         Degradation() {
             pdef("jitter_mean", 0.2, "jitter mean");
@@ -39,6 +39,55 @@ namespace ocropus {
                  double threshold_mean = .4,
                  double threshold_sigma = .04);
 
+    /// A random number stream with its own state.  Samples degraded
+    /// in parallel each get their own stream, seeded from a base seed
+    /// and the index of the sample, so the result for a sample doesn't
+    /// depend on which thread degrades it or in what order.
+    struct DegradationRandom {
+        unsigned short state[3];
+        DegradationRandom(long seed=0,long index=0) {
+            this->seed(seed,index);
+        }
+        void seed(long seed,long index=0);
+        /// uniform in [0,1)
+        double uniform();
+        double gauss(double mean,double sigma);
+    };
+
+    /// Smoothed random displacement fields for the elastic transform.
+    /// Smoothing a field per sample dominates the cost of degrading a
+    /// small image, so a large pair of fields is computed once and
+    /// samples take randomly placed windows out of it.  The fields are
+    /// only read after init(), so one instance can be shared by all
+    /// threads.
+    struct ElasticMaps {
+        colib::floatarray dx,dy;
+        float alpha,sigma;
+        ElasticMaps() {
+            alpha = 6;
+            sigma = 4;
+        }
+        void init(DegradationRandom &random,int w,int h,
+                  float alpha=6,float sigma=4);
+        /// Displacements for a w x h image; falls back to computing
+        /// fresh fields if the image is larger than the precomputed ones.
+        void get(colib::floatarray &dx,colib::floatarray &dy,int w,int h,
+                 DegradationRandom &random);
+    };
+
+    /// Same as above, drawing all random numbers from random and
+    /// taking the elastic displacements from maps (if not null).
+    /// Safe to call from several threads with different streams.
+    void degrade(colib::bytearray &image,
+                 DegradationRandom &random,
+                 ElasticMaps *maps,
+                 double jitter_mean = .2,
+                 double jitter_sigma = .1,
+                 double sensitivity_mean = .125,
+                 double sensitivity_sigma = .04,
+                 double threshold_mean = .4,
+                 double threshold_sigma = .04);
+
     ICleanupGray *make_Degradation();
 };
 #endif
@@ -70,7 +70,8 @@ namespace ocropus {
         return d(str1.length(), str2.length());
     }
 
-    float edit_distance(intarray &confusion,
+    float edit_distance(intarray &from,
+                        intarray &to,
                         ustrg &str1,
                         ustrg &str2,
                         float del_cost,
@@ -78,39 +79,61 @@ namespace ocropus {
                         float sub_cost) {
         floatarray d;
         fill_edit_distance_table(d, str1, str2, del_cost, ins_cost, sub_cost);
+        from.clear();
+        to.clear();
 
         /// backtrack the journey until we touch a border
         int i = str1.length();
         int j = str2.length();
+        floatarray temp_del_ins_sub(3);
         while(i && j) {
-            floatarray temp_del_ins_sub(3);
             temp_del_ins_sub(0) = d(i-1,j) + del_cost;
             temp_del_ins_sub(1) = d(i,j-1) + ins_cost;
             temp_del_ins_sub(2) = d(i-1,j-1) + (str1[i-1] == str2[j-1] ? 0. : sub_cost);
             switch(argmin(temp_del_ins_sub)) {
                 case 0:
                     i--;
-                    confusion(str1[i].ord(), 0)++;
+                    from.push(str1[i].ord());
+                    to.push(0);
                 break;
                 case 1:
                     j--;
-                    confusion(0, str2[j].ord())++;
+                    from.push(0);
+                    to.push(str2[j].ord());
                 break;
                 case 2:
                     i--; j--;
-                    confusion(str1[i].ord(), str2[j].ord())++;
+                    from.push(str1[i].ord());
+                    to.push(str2[j].ord());
             }
         }
 
         /// we've touched the border, now we have just one way to go
-        while(i--)
-            confusion(str1[i].ord(), 0)++;
-        while(j--)
-            confusion(0, str2[j].ord())++;
+        while(i--) {
+            from.push(str1[i].ord());
+            to.push(0);
+        }
+        while(j--) {
+            from.push(0);
+            to.push(str2[j].ord());
+        }
 
         return d(str1.length(), str2.length());
     }
 
+    float edit_distance(intarray &confusion,
+                        ustrg &str1,
+                        ustrg &str2,
+                        float del_cost,
+                        float ins_cost,
+                        float sub_cost) {
+        intarray from, to;
+        float dist = edit_distance(from, to, str1, str2, del_cost, ins_cost, sub_cost);
+        for(int k = 0; k < from.length(); k++)
+            confusion(from[k], to[k])++;
+        return dist;
+    }
+
     float block_move_edit_cost(ustrg &from, ustrg &to, float c) {
         floatarray upper, row;
         row.resize(from.length() + 1);
@@ -29,6 +29,19 @@
 namespace ocropus {
     float edit_distance(colib::ustrg &str1, colib::ustrg &str2, float del_cost=1, float ins_cost=1, float sub_cost=1);
 
+    /// A variant of edit_distance() that records the alignment.
+    /// On return, from[k] and to[k] hold the code points of the k-th
+    /// aligned pair (in reverse order); 0 stands for an insertion or
+    /// deletion. Unlike the confusion matrix variant, this works for
+    /// arbitrary Unicode code points.
+    float edit_distance(colib::intarray &from,
+                        colib::intarray &to,
+                        colib::ustrg &str1,
+                        colib::ustrg &str2,
+                        float del_cost=1,
+                        float ins_cost=1,
+                        float sub_cost=1);
+
     /// A variant of edit_distance() with a confusion matrix.
     /// The confusion matrix should be pre-initialized.
     float edit_distance(colib::intarray &confusion,
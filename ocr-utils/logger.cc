@@ -23,18 +23,135 @@
 
 #include <stdarg.h>
 #include <time.h>
+#include <pthread.h>
 #include "ocropus.h"
 #include "logger.h"
 
+#ifndef _OPENMP
+#define OCRO_THREAD 0
+#else
+#include <omp.h>
+#define OCRO_THREAD omp_get_thread_num()
+#endif
+
 using namespace colib;
 using namespace iulib;
 using namespace ocropus;
 
 namespace {
+
+    // Log entries are formatted completely by the thread logging them
+    // (into a buffer of its own), then appended to the pending text
+    // under a short lock.  A writer thread moves the pending text to
+    // the files, so logging threads never wait for the disk.  Images
+    // and other attachments are written by the logging thread itself,
+    // under a name taken from an atomic counter, before the entry that
+    // refers to them is queued.
+
     struct Log {
         narray<strg> enabled_logs;
         strg dir;
         stdio file;
+        stdio events;
+
+        // text waiting for the writer; guarded by queue_lock
+        pthread_mutex_t queue_lock;
+        pthread_cond_t queue_changed;
+        strg *pending_html;
+        strg *pending_json;
+        bool stopping;
+
+        // held while writing to the files or switching them
+        pthread_mutex_t io_lock;
+
+        pthread_t writer;
+        bool writer_running;
+
+        Log() {
+            pthread_mutex_init(&queue_lock,0);
+            pthread_cond_init(&queue_changed,0);
+            pthread_mutex_init(&io_lock,0);
+            pending_html = new strg();
+            pending_json = new strg();
+            stopping = false;
+            writer_running = false;
+        }
+        ~Log() {
+            stop();
+            delete pending_html;
+            delete pending_json;
+            pthread_mutex_destroy(&queue_lock);
+            pthread_cond_destroy(&queue_changed);
+            pthread_mutex_destroy(&io_lock);
+        }
+
+        void append(const char *html,const char *json) {
+            pthread_mutex_lock(&queue_lock);
+            *pending_html += html;
+            if(json) *pending_json += json;
+            pthread_cond_signal(&queue_changed);
+            pthread_mutex_unlock(&queue_lock);
+            if(!writer_running) drain();
+        }
+
+        // move whatever is pending to the files; the caller holds
+        // io_lock, which keeps the chunks in order
+        void write_pending() {
+            strg *html = new strg();
+            strg *json = new strg();
+            pthread_mutex_lock(&queue_lock);
+            strg *t = html; html = pending_html; pending_html = t;
+            t = json; json = pending_json; pending_json = t;
+            pthread_mutex_unlock(&queue_lock);
+            if(!html->empty() && !!file) {
+                fputs(html->c_str(),file);
+                fflush(file);
+            }
+            if(!json->empty() && !!events) {
+                fputs(json->c_str(),events);
+                fflush(events);
+            }
+            delete html;
+            delete json;
+        }
+
+        void drain() {
+            pthread_mutex_lock(&io_lock);
+            write_pending();
+            pthread_mutex_unlock(&io_lock);
+        }
+
+        static void *write_loop(void *arg) {
+            Log *log = (Log *)arg;
+            for(;;) {
+                pthread_mutex_lock(&log->queue_lock);
+                while(!log->stopping && log->pending_html->empty() &&
+                      log->pending_json->empty())
+                    pthread_cond_wait(&log->queue_changed,&log->queue_lock);
+                bool stopping = log->stopping;
+                pthread_mutex_unlock(&log->queue_lock);
+                log->drain();
+                if(stopping) return 0;
+            }
+        }
+
+        void start() {
+            if(writer_running) return;
+            writer_running = !pthread_create(&writer,0,write_loop,this);
+        }
+
+        void stop() {
+            if(writer_running) {
+                pthread_mutex_lock(&queue_lock);
+                stopping = true;
+                pthread_cond_signal(&queue_changed);
+                pthread_mutex_unlock(&queue_lock);
+                pthread_join(writer,0);
+                writer_running = false;
+                stopping = false;
+            }
+            drain();
+        }
     };
 
     // sorry for all that.
@@ -52,10 +169,54 @@ namespace {
         }
     } delete_log;
 
-    int indent_level = 0;
+    // indentation is per thread, since threads log independently
+    __thread int indent_level = 0;
     int image_counter = 0;
+    int event_counter = 0;
     bool self_logging;
 
+    int next_image() {
+        return __sync_fetch_and_add(&image_counter,1);
+    }
+
+    void vappendf(strg &out,const char *format,va_list va) {
+        char buffer[1024];
+        va_list copy;
+        va_copy(copy,va);
+        int n = vsnprintf(buffer,sizeof buffer,format,copy);
+        va_end(copy);
+        if(n<int(sizeof buffer)) {
+            out += buffer;
+            return;
+        }
+        narray<char> big(n+1);
+        vsnprintf(&big[0],n+1,format,va);
+        out += &big[0];
+    }
+
+    void appendf(strg &out,const char *format,...) {
+        va_list va;
+        va_start(va,format);
+        vappendf(out,format,va);
+        va_end(va);
+    }
+
+    void append_json_string(strg &out,const char *s) {
+        out += "\"";
+        for(const unsigned char *p=(const unsigned char *)s;*p;p++) {
+            if(*p=='"' || *p=='\\') {
+                char escaped[3] = {'\\',char(*p),0};
+                out += escaped;
+            } else if(*p<0x20) {
+                appendf(out,"\\u%04x",*p);
+            } else {
+                char c[2] = {char(*p),0};
+                out += c;
+            }
+        }
+        out += "\"";
+    }
+
     /// Returns true if the given specification chunk turns on a log with the given name.
     /// The simplest way would be to use !strcmp, but we have an extension:
     /// a spec "X" would turn on a log named "X.Y".
@@ -103,65 +264,80 @@ namespace ocropus {
         }
         set_logger_directory(ocrologdir);
 
-        fprintf(get_log()->file, "logging turned on for the following loggers:<BR /><UL>\n");
+        strg html;
+        appendf(html, "logging turned on for the following loggers:<BR /><UL>\n");
         for(int i = 0; i < get_log()->enabled_logs.length(); i++)
-            fprintf(get_log()->file, "    <LI>%s</LI>\n", get_log()->enabled_logs[i].c_str());
-        fprintf(get_log()->file, "</UL>\n");
+            appendf(html, "    <LI>%s</LI>\n", get_log()->enabled_logs[i].c_str());
+        appendf(html, "</UL>\n");
 
         time_t rawtime;
         time (&rawtime);
-        fprintf(get_log()->file, "Started %s <BR /><BR />\n", ctime (&rawtime));
-        fflush(get_log()->file);
+        appendf(html, "Started %s <BR /><BR />\n", ctime (&rawtime));
+        get_log()->append(html, 0);
+        get_log()->start();
     }
 
-    void Logger::putIndent() {
-        fprintf(get_log()->file, "[%s] ", name.c_str());
+    void Logger::putIndent(strg &html) {
+        appendf(html, "[%s] ", name.c_str());
         for(int i = 0; i < indent_level; i++) {
-            fprintf(get_log()->file, "&nbsp;&nbsp;");
+            html += "&nbsp;&nbsp;";
         }
     }
 
-    stdio Logger::logImage(const char *description, int w, int h) {
-        strg imageFile = get_log()->dir + "/ocropus-log-" + image_counter + ".png";
-        putIndent();
-        fprintf(get_log()->file, "%s:<br> <a HREF=\"ocropus-log-%d.png\">"
-                "<IMG width=\"%d\" height=\"%d\" border=\"0\" SRC=\"ocropus-log-%d.png\">"
-                "</a><BR>\n", description, image_counter, w, h, image_counter);
-        fflush(get_log()->file);
-        image_counter++;
-        return stdio(imageFile, "wb");
+    void Logger::put(const char *html, const char *type, const char *message,
+                     const char *value, int image) {
+        strg entry;
+        putIndent(entry);
+        entry += html;
+        strg json;
+        appendf(json, "{\"seq\":%d,\"time\":%ld,\"thread\":%d,\"logger\":",
+                __sync_fetch_and_add(&event_counter,1), (long)time(0), OCRO_THREAD);
+        append_json_string(json, name);
+        json += ",\"type\":";
+        append_json_string(json, type);
+        json += ",\"message\":";
+        append_json_string(json, message);
+        if(value) {
+            json += ",\"value\":";
+            append_json_string(json, value);
+        }
+        if(image >= 0)
+            appendf(json, ",\"file\":\"ocropus-log-%d.%s\"", image,
+                    strcmp(type, "text") ? "png" : "txt");
+        json += "}\n";
+        get_log()->append(entry, json);
     }
-    stdio Logger::logImageHtml() {
-        strg imageFile = get_log()->dir + "/ocropus-log-" + image_counter + ".png";
-        //putIndent();
-        fprintf(get_log()->file, "<IMG SRC=\"ocropus-log-%d.png\">",image_counter);
-        fflush(get_log()->file);
-        image_counter++;
+
+    stdio Logger::logImage(int &image) {
+        image = next_image();
+        strg imageFile = get_log()->dir + "/ocropus-log-" + image + ".png";
         return stdio(imageFile, "wb");
     }
-    stdio Logger::logImageHtmlBorder() {
-        strg imageFile = get_log()->dir + "/ocropus-log-" + image_counter + ".png";
-        //putIndent();
-        fprintf(get_log()->file, "<IMG hspace=\"4\" vspace=\"4\" style=\"border-color:#8888FF\" SRC=\"ocropus-log-%d.png\" border=\"1\">",image_counter);
-        fflush(get_log()->file);
-        image_counter++;
-        return stdio(imageFile, "wb");
+
+    void Logger::putImage(const char *description, int image, int w, int h) {
+        strg html;
+        appendf(html, "%s:<br> <a HREF=\"ocropus-log-%d.png\">"
+                "<IMG width=\"%d\" height=\"%d\" border=\"0\" SRC=\"ocropus-log-%d.png\">"
+                "</a><BR>\n", description, image, w, h, image);
+        put(html, "image", description, 0, image);
     }
 
-    stdio Logger::logText(const char *description) {
-        strg textFile = get_log()->dir + "/ocropus-log-" + image_counter + ".txt";
-        putIndent();
-        fprintf(get_log()->file, "<A HREF=\"ocropus-log-%d.txt\">%s</A><BR>\n",
-                image_counter, description);
-        fflush(get_log()->file);
-        image_counter++;
+    stdio Logger::logText(int &image) {
+        image = next_image();
+        strg textFile = get_log()->dir + "/ocropus-log-" + image + ".txt";
         return stdio(textFile, "w");
     }
 
+    void Logger::putText(const char *description, int image) {
+        strg html;
+        appendf(html, "<A HREF=\"ocropus-log-%d.txt\">%s</A><BR>\n",
+                image, description);
+        put(html, "text", description, 0, image);
+    }
 
     Logger::Logger(const char *name) {
         this->name = name;
-
+#ifndef OCROPUS_NO_LOGGING
         if(!get_log()->enabled_logs.length()) {
             init_logging();
         }
@@ -183,148 +359,201 @@ namespace ocropus {
             return;
         }
 
-        if(self_logging)
-            fprintf(get_log()->file, "[logger] `%s': %s<BR />\n", name, enabled ? "enabled": "disabled");
+        if(self_logging) {
+            strg html;
+            appendf(html, "[logger] `%s': %s<BR />\n", name, enabled ? "enabled": "disabled");
+            get_log()->append(html, 0);
+        }
+#endif
     }
 
     void Logger::format(const char *format, ...) {
         if(!enabled) return;
+        strg message;
         va_list va;
         va_start(va, format);
-        putIndent();
-        vfprintf(get_log()->file, format, va);
-        fprintf(get_log()->file, "<BR />\n");
+        vappendf(message, format, va);
         va_end(va);
-        fflush(get_log()->file);
+        strg html;
+        appendf(html, "%s<BR />\n", message.c_str());
+        put(html, "message", message);
     }
 
     void Logger::operator()(const char *s) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s<BR>\n", s);
-        fflush(get_log()->file);
+        strg html;
+        appendf(html, "%s<BR>\n", s);
+        put(html, "message", s);
     }
     void Logger::operator()(const char *message, bool val) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s: %s<BR>\n", message, val ? "true" : "false");
-        fflush(get_log()->file);
+        strg html;
+        appendf(html, "%s: %s<BR>\n", message, val ? "true" : "false");
+        put(html, "bool", message, val ? "true" : "false");
     }
     void Logger::operator()(const char *message, int val) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s: %d<BR>\n", message, val);
-        fflush(get_log()->file);
+        strg html, value;
+        appendf(html, "%s: %d<BR>\n", message, val);
+        appendf(value, "%d", val);
+        put(html, "int", message, value);
     }
     void Logger::operator()(const char *message, double val) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s: %lf<BR>\n", message, val);
-        fflush(get_log()->file);
+        strg html, value;
+        appendf(html, "%s: %lf<BR>\n", message, val);
+        appendf(value, "%g", val);
+        put(html, "double", message, value);
     }
     void Logger::operator()(const char *message, const char *val) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s: \"%s\"<BR>\n", message, val);
-        fflush(get_log()->file);
+        strg html;
+        appendf(html, "%s: \"%s\"<BR>\n", message, val);
+        put(html, "string", message, val);
     }
     void Logger::operator()(const char *message, nuchar val) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s: \'%lc\' (hex %x, dec %x)<BR>\n",
+        strg html, value;
+        appendf(html, "%s: \'%lc\' (hex %x, dec %x)<BR>\n",
                 message, val.ord(), val.ord(), val.ord());
-        fflush(get_log()->file);
+        appendf(value, "%d", val.ord());
+        put(html, "nuchar", message, value);
     }
     void Logger::operator()(const char *description, intarray &a, float zoom) {
         if(!enabled) return;
+        int image;
         if(a.rank() == 2) {
             int w = (zoom==100.) ? a.dim(0) : int(a.dim(0)*zoom/100.+.5);
             int h = (zoom==100.) ? a.dim(1) : int(a.dim(1)*zoom/100.+.5);
-            stdio f = logImage(description, w, h);
-            write_image_packed(f,a,"png");
+            {
+                stdio f = logImage(image);
+                write_image_packed(f,a,"png");
+            }
+            putImage(description, image, w, h);
         } else {
-            stdio f = logText(description);
-            text_write(f, a);
+            {
+                stdio f = logText(image);
+                text_write(f, a);
+            }
+            putText(description, image);
         }
     }
 
     void Logger::recolor(const char *description, intarray &a, float zoom) {
         if(!enabled) return;
+        int image;
         if(a.rank() == 2) {
             int w = (zoom==100.) ? a.dim(0) : int(a.dim(0)*zoom/100.+.5);
             int h = (zoom==100.) ? a.dim(1) : int(a.dim(1)*zoom/100.+.5);
-            stdio f = logImage(description, w, h);
-            intarray tmp;
-            copy(tmp, a);
-            simple_recolor(tmp);
-            write_image_packed(f,tmp,"png");
+            {
+                stdio f = logImage(image);
+                intarray tmp;
+                copy(tmp, a);
+                simple_recolor(tmp);
+                write_image_packed(f,tmp,"png");
+            }
+            putImage(description, image, w, h);
         } else {
-            stdio f = logText(description);
-            text_write(f, a);
+            {
+                stdio f = logText(image);
+                text_write(f, a);
+            }
+            putText(description, image);
         }
     }
     void Logger::operator()(const char *description, bytearray &a, float zoom) {
         if(!enabled) return;
+        int image;
         if(a.rank() == 2) {
             int w = (zoom==100.) ? a.dim(0) : int(a.dim(0)*zoom/100.+.5);
             int h = (zoom==100.) ? a.dim(1) : int(a.dim(1)*zoom/100.+.5);
-            stdio f = logImage(description, w, h);
-            write_png(f, a);
+            {
+                stdio f = logImage(image);
+                write_png(f, a);
+            }
+            putImage(description, image, w, h);
         } else {
-            stdio f = logText(description);
-            text_write(f, a);
+            {
+                stdio f = logText(image);
+                text_write(f, a);
+            }
+            putText(description, image);
         }
     }
     void Logger::html(bytearray &a) {
         if(!enabled) return;
+        int image;
         if(a.rank() == 2) {
-            stdio f = logImageHtml();
-            write_png(f, a);
+            {
+                stdio f = logImage(image);
+                write_png(f, a);
+            }
+            strg html;
+            appendf(html, "<IMG SRC=\"ocropus-log-%d.png\">", image);
+            get_log()->append(html, 0);
         } else {
-            stdio f = logText("error");
-            text_write(f, a);
+            {
+                stdio f = logText(image);
+                text_write(f, a);
+            }
+            putText("error", image);
         }
     }
     void Logger::html(const char* s) {
         if(!enabled) return;
-        fprintf(get_log()->file, "%s\n", s);
+        strg html;
+        appendf(html, "%s\n", s);
+        get_log()->append(html, 0);
     }
     void Logger::html_border(bytearray &img) {
         if(!enabled) return;
+        int image;
         if(img.rank() == 2) {
-            stdio f = logImageHtmlBorder();
-            write_png(f, img);
+            {
+                stdio f = logImage(image);
+                write_png(f, img);
+            }
+            strg html;
+            appendf(html, "<IMG hspace=\"4\" vspace=\"4\" style=\"border-color:#8888FF\" SRC=\"ocropus-log-%d.png\" border=\"1\">", image);
+            get_log()->append(html, 0);
         } else {
-            stdio f = logText("error");
-            text_write(f, img);
+            {
+                stdio f = logText(image);
+                text_write(f, img);
+            }
+            putText("error", image);
         }
     }
 
     void Logger::operator()(const char *description, floatarray &a) {
         if(!enabled) return;
-        stdio f = logText(description);
-        text_write(f, a);
+        int image;
+        {
+            stdio f = logText(image);
+            text_write(f, a);
+        }
+        putText(description, image);
     }
     void Logger::operator()(const char *message, ustrg &val) {
         if(!enabled) return;
         utf8strg utf8;
         val.utf8EncodeTerm(utf8);
-        putIndent();
-        fprintf(get_log()->file, "%s: ustrg(\"%s\")<BR>\n", message, utf8.c_str());
-        fflush(get_log()->file);
+        strg html;
+        appendf(html, "%s: ustrg(\"%s\")<BR>\n", message, utf8.c_str());
+        put(html, "ustrg", message, utf8.c_str());
     }
     void Logger::html(ustrg &val) {
         utf8strg utf8;
         val.utf8EncodeTerm(utf8);
-        fprintf(get_log()->file, "%s", utf8.c_str());
-        fflush(get_log()->file);
+        get_log()->append(utf8.c_str(), 0);
     }
     void Logger::operator()(const char *description, rectangle &val) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s: rectangle(%d,%d,%d,%d)<BR>\n",
+        strg html, value;
+        appendf(html, "%s: rectangle(%d,%d,%d,%d)<BR>\n",
                 description, val.x0, val.y0, val.x1, val.y1);
-        fflush(get_log()->file);
+        appendf(value, "%d %d %d %d", val.x0, val.y0, val.x1, val.y1);
+        put(html, "rectangle", description, value);
     }
 
     void Logger::operator()(const char *message, IGenericFst &val) {
@@ -333,16 +562,17 @@ namespace ocropus {
         val.bestpath(s);
         utf8strg utf8;
         s.utf8EncodeTerm(utf8);
-        putIndent();
-        fprintf(get_log()->file, "%s: ICharLattice(bestpath: \"%s\")<BR>\n", message, utf8.c_str());
-        fflush(get_log()->file);
+        strg html;
+        appendf(html, "%s: ICharLattice(bestpath: \"%s\")<BR>\n", message, utf8.c_str());
+        put(html, "fst", message, utf8.c_str());
     }
 
     void Logger::operator()(const char *description, void *ptr) {
         if(!enabled) return;
-        putIndent();
-        fprintf(get_log()->file, "%s: pointer(%p)<BR>\n", description, ptr);
-        fflush(get_log()->file);
+        strg html, value;
+        appendf(html, "%s: pointer(%p)<BR>\n", description, ptr);
+        appendf(value, "%p", ptr);
+        put(html, "pointer", description, value);
     }
 
     void Logger::indent() {
@@ -354,6 +584,10 @@ namespace ocropus {
             indent_level--;
     }
 
+#ifdef OCROPUS_NO_LOGGING
+    const bool Logger::enabled;
+#endif
+
     const char* get_logger_directory() {
         return get_log()->dir.c_str();
     }
@@ -366,29 +600,45 @@ namespace ocropus {
         image_counter = v;
     }
 
+    void flush_log() {
+        if(the_log) the_log->drain();
+    }
+
     void set_logger_directory(const char *path) {
-        if(!!get_log()->file) {
-            fprintf(get_log()->file,
+        Log *log = get_log();
+        pthread_mutex_lock(&log->io_lock);
+        // everything logged so far goes to the old files
+        log->write_pending();
+        if(!!log->file) {
+            fprintf(log->file,
                     "log finished; switching to directory %s\n", path);
         }
         mkdir_if_necessary(path);
         strg old_dir;
-        if(get_log()->dir)
-            old_dir = get_log()->dir;
-        get_log()->dir = path;
+        if(log->dir)
+            old_dir = log->dir;
+        log->dir = path;
         strg html;
         html = path;
         html += "/index.html";
-        get_log()->file = fopen(html,"wt");
-        if(!get_log()->file) {
+        log->file = fopen(html,"wt");
+        if(!log->file) {
             fprintf(stderr, "unable to open log file `%s' for writing\n",
                     html.c_str());
+            pthread_mutex_unlock(&log->io_lock);
+            return;
         }
-        fprintf(get_log()->file, "<HTML>\n<HEAD>\n<meta http-equiv=\"content-type\" "
+        strg json;
+        json = path;
+        json += "/events.jsonl";
+        log->events = fopen(json,"wt");
+        fprintf(log->file, "<HTML>\n<HEAD>\n<meta http-equiv=\"content-type\" "
                         "content=\"text/html\"; charset=UTF-8\">\n</HEAD>\n<BODY>\n");
         if(old_dir) {
-            fprintf(get_log()->file, "Log continued from %s<P>\n", old_dir.c_str());
+            fprintf(log->file, "Log continued from %s<P>\n", old_dir.c_str());
         }
+        fflush(log->file);
+        pthread_mutex_unlock(&log->io_lock);
     }
 
 #if 0
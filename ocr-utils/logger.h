@@ -65,16 +65,34 @@ namespace ocropus {
     /// To enable messages related to the logging itself, enable the logger
     /// named "logger".
     ///
+    /// Besides index.html, every entry is written as one line of JSON to
+    /// events.jsonl in the log directory (with the sequence number, time,
+    /// OpenMP thread, logger name, type, message, value and the name of
+    /// any attached image or text file).  Loggers can be used from
+    /// several threads at once; the files are written by a separate thread.
+    ///
+    /// Compiling with -DOCROPUS_NO_LOGGING makes every logger permanently
+    /// disabled at compile time.  Where building the arguments costs
+    /// something, wrap the call in OCRO_LOG, which only evaluates them
+    /// when the logger is enabled:
+    /// \code
+    ///     OCRO_LOG(log_stuff, ("the front view", render(engine)));
+    /// \endcode
+    ///
     /// Note: you can use logger.log() methods along with logger() operators.
     /// (This is the only way under Lua)
     class Logger {
         colib::strg name;
-        colib::stdio logImage(const char *description, int w, int h);
+        // open the next numbered attachment file
+        colib::stdio logImage(int &image);
+        colib::stdio logText(int &image);
+        // queue an entry (and its JSON line) referring to an attachment
+        void putImage(const char *description, int image, int w, int h);
+        void putText(const char *description, int image);
+        void put(const char *html, const char *type, const char *message,
+                 const char *value = 0, int image = -1);
         void html(colib::bytearray &img);
         void html(colib::ustrg &val);
-        colib::stdio logImageHtml();
-        colib::stdio logImageHtmlBorder();
-        colib::stdio logText(const char *description);
 
     public:
         /// FIXME these violate the naming conventions for methods
@@ -82,9 +100,13 @@ namespace ocropus {
         void init_logging();
         void start_logging();
 
+#ifdef OCROPUS_NO_LOGGING
+        static const bool enabled = false;
+#else
         bool enabled;
+#endif
 
-        void putIndent();
+        void putIndent(colib::strg &html);
 
         /// \brief
         /// Construct a logger with a given name
@@ -210,6 +232,14 @@ namespace ocropus {
     const char *get_logger_directory();
     int get_image_counter();
     void set_image_counter(int);
+    /// Write out everything logged so far (normally done by the writer thread).
+    void flush_log();
 };
 
+#ifdef OCROPUS_NO_LOGGING
+#define OCRO_LOG(logger,args) do { } while(0)
+#else
+#define OCRO_LOG(logger,args) do { if((logger).enabled) (logger).log args; } while(0)
+#endif
+
 #endif
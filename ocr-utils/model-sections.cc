@@ -0,0 +1,200 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: model-sections.cc
+// Purpose: indexed model files whose parts are loaded on first use
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#include <string.h>
+#include <ctype.h>
+#include "ocropus.h"
+#include "model-sections.h"
+
+using namespace colib;
+
+namespace ocropus {
+
+    namespace {
+        const char *magic = "ocrosec1";
+        // magic, a space, 12 digits of index offset, newline
+        const int header_size = 8+1+12+1;
+
+        void check_name(const char *name) {
+            if(!*name) throw "section names must not be empty";
+            for(const char *p=name;*p;p++)
+                if(isspace(*p)) throwf("%s: section names must not contain spaces",name);
+        }
+    }
+
+    ModelSections::ModelSections() {
+        stream = 0;
+        writing = false;
+    }
+
+    ModelSections::~ModelSections() {
+        close();
+    }
+
+    void ModelSections::create(const char *path) {
+        close();
+        stream = fopen(path,"wb");
+        if(!stream) throwf("%s: cannot create",path);
+        writing = true;
+        // placeholder; finish fills in the index offset
+        fprintf(stream,"%s %012lld\n",magic,0LL);
+    }
+
+    void ModelSections::add(const char *name,IComponent *component) {
+        CHECK_ARG(stream && writing);
+        check_name(name);
+        if(has(name)) throwf("%s: duplicate section",name);
+        off_t start = ftello(stream);
+        save_component(stream,component);
+        names.push() = name;
+        offsets.push(start);
+        lengths.push(ftello(stream)-start);
+        debugf("sections","section %s at %lld, %lld bytes\n",name,
+               (long long)start,(long long)lengths.last());
+    }
+
+    void ModelSections::finish() {
+        CHECK_ARG(stream && writing);
+        off_t index = ftello(stream);
+        fprintf(stream,"%d\n",names.length());
+        for(int i=0;i<names.length();i++)
+            fprintf(stream,"%s %lld %lld\n",names(i).c_str(),
+                    (long long)offsets(i),(long long)lengths(i));
+        fseeko(stream,0,SEEK_SET);
+        fprintf(stream,"%s %012lld\n",magic,(long long)index);
+        if(fclose(stream)) throw "error writing sectioned model";
+        stream = 0;
+        writing = false;
+    }
+
+    void ModelSections::open(const char *path) {
+        close();
+        stream = fopen(path,"rb");
+        if(!stream) throwf("%s: cannot open",path);
+        char tag[9];
+        long long index;
+        if(fscanf(stream,"%8s %12lld",tag,&index)!=2 || strcmp(tag,magic))
+            throwf("%s: not a sectioned model",path);
+        fseeko(stream,index,SEEK_SET);
+        int n;
+        if(fscanf(stream,"%d",&n)!=1 || n<0)
+            throwf("%s: bad section index",path);
+        for(int i=0;i<n;i++) {
+            char name[1000];
+            long long offset,length;
+            if(fscanf(stream,"%999s %lld %lld",name,&offset,&length)!=3)
+                throwf("%s: bad section index",path);
+            if(offset<header_size || offset+length>index)
+                throwf("%s: section %s out of range",path,name);
+            names.push() = name;
+            offsets.push(offset);
+            lengths.push(length);
+        }
+    }
+
+    void ModelSections::close() {
+        if(stream) fclose(stream);
+        stream = 0;
+        writing = false;
+        names.clear();
+        offsets.clear();
+        lengths.clear();
+    }
+
+    int ModelSections::find(const char *name) {
+        for(int i=0;i<names.length();i++)
+            if(names(i)==name) return i;
+        return -1;
+    }
+
+    IComponent *ModelSections::load(const char *name) {
+        CHECK_ARG(stream && !writing);
+        int i = find(name);
+        if(i<0) throwf("%s: no such section",name);
+        IComponent *result = 0;
+        off_t end = 0;
+        bool failed = false;
+        strg error;
+        // sections share the stream, so seeking and reading have
+        // to happen together; exceptions can't leave the critical
+        // section, so they are rethrown after it
+#pragma omp critical(model_sections)
+        {
+            try {
+                fseeko(stream,offsets(i),SEEK_SET);
+                result = load_component(stream);
+                end = ftello(stream);
+            } catch(const char *message) {
+                failed = true;
+                error = message;
+            } catch(...) {
+                failed = true;
+                error = "error loading section";
+            }
+        }
+        if(failed) throwf("%s: %s",name,error.c_str());
+        if(end>offsets(i)+lengths(i)) {
+            delete result;
+            throwf("%s: read past the end of the section",name);
+        }
+        debugf("sections","loaded section %s\n",name);
+        return result;
+    }
+
+    bool is_sectioned_model(const char *path) {
+        FILE *stream = fopen(path,"rb");
+        if(!stream) return false;
+        char tag[8];
+        bool result = fread(tag,1,8,stream)==8 && !memcmp(tag,magic,8);
+        fclose(stream);
+        return result;
+    }
+
+    void save_sectioned_model(const char *path,IComponent *component) {
+        ModelSections sections;
+        sections.create(path);
+        ISectionedModel *sectioned = dynamic_cast<ISectionedModel*>(component);
+        if(sectioned)
+            sectioned->saveSections(sections);
+        else
+            sections.add("root",component);
+        sections.finish();
+    }
+
+    IComponent *load_sectioned_model(const char *path) {
+        autodel<ModelSections> sections(new ModelSections());
+        sections->open(path);
+        autodel<IComponent> component(sections->load("root"));
+        if(!component) throwf("%s: empty model",path);
+        ISectionedModel *sectioned = dynamic_cast<ISectionedModel*>(component.ptr());
+        if(sectioned) sectioned->attachSections(sections.move());
+        return component.move();
+    }
+
+    IComponent *load_any_model(const char *path) {
+        if(is_sectioned_model(path)) return load_sectioned_model(path);
+        return load_component(stdio(path,"r"));
+    }
+}
@@ -0,0 +1,101 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: model-sections.h
+// Purpose: indexed model files whose parts are loaded on first use
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#ifndef h_model_sections_
+#define h_model_sections_
+
+#include <stdio.h>
+#include "colib/colib.h"
+#include "iulib/components.h"
+
+namespace ocropus {
+    using namespace colib;
+
+    // A sectioned model file holds a number of named sections, each
+    // of which is an ordinary save_component stream, followed by an
+    // index giving the offset and length of every section.  Models
+    // made up of many sub-models (MetaLinerec has a 10x10 grid of
+    // recognizers, of which a book typically uses one or two) store
+    // each sub-model in its own section and load it when it is first
+    // needed, rather than parsing the whole file up front.
+    //
+    // Layout (all numbers in ASCII, so files are portable):
+    //
+    //     ocrosec1 <index offset, 12 digits>\n
+    //     <section> <section> ...
+    //     <nsections>\n
+    //     <name> <offset> <length>\n ...
+
+    struct ModelSections {
+        FILE *stream;
+        bool writing;
+        narray<strg> names;
+        narray<off_t> offsets;
+        narray<off_t> lengths;
+
+        ModelSections();
+        ~ModelSections();
+
+        // writing: create the file, add sections, then finish
+        void create(const char *path);
+        void add(const char *name,IComponent *component);
+        void finish();
+
+        // reading; load returns a new component (or 0 if a null
+        // component was stored), and is safe to call from several
+        // threads
+        void open(const char *path);
+        void close();
+        int find(const char *name);
+        bool has(const char *name) {
+            return find(name)>=0;
+        }
+        IComponent *load(const char *name);
+    };
+
+    // Components that know how to split themselves into sections.
+    // saveSections must add a section called "root" holding what is
+    // needed to reconstruct the component itself; after loading the
+    // root, attachSections hands the open file over to the component
+    // (which takes ownership), and it loads the rest as needed.
+
+    struct ISectionedModel {
+        virtual void saveSections(ModelSections &sections) = 0;
+        virtual void attachSections(ModelSections *sections) = 0;
+        virtual ~ISectionedModel() {}
+    };
+
+    bool is_sectioned_model(const char *path);
+
+    // Any component can be saved this way; components that aren't
+    // ISectionedModel just end up in a single "root" section.
+    void save_sectioned_model(const char *path,IComponent *component);
+    IComponent *load_sectioned_model(const char *path);
+
+    // Load either format.
+    IComponent *load_any_model(const char *path);
+}
+
+#endif
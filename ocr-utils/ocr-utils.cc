@@ -478,9 +478,9 @@ namespace ocropus {
     void remove_small_components(narray<T> &bimage,int mw,int mh) {
         intarray image;
         copy(image,bimage);
-        label_components(image);
-        narray<rectangle> rects;
-        bounding_boxes(rects,image);
+        ConnectedComponents components;
+        components.label(image);
+        narray<rectangle> &rects = components.boxes;
         if(rects.length()==0) return;
         bytearray good(rects.length());
         for(int i=0;i<good.length();i++)
@@ -502,9 +502,9 @@ namespace ocropus {
     void remove_marginal_components(narray<T> &bimage,int x0,int y0,int x1,int y1) {
         intarray image;
         copy(image,bimage);
-        label_components(image);
-        narray<rectangle> rects;
-        bounding_boxes(rects,image);
+        ConnectedComponents components;
+        components.label(image);
+        narray<rectangle> &rects = components.boxes;
         if(rects.length()>0) {
             x1 = bimage.dim(0)-x1;
             y1 = bimage.dim(1)-y1;
@@ -530,9 +530,9 @@ namespace ocropus {
         invert(line);
         intarray image;
         copy(image,line);
-        label_components(image);
-        narray<rectangle> rects;
-        bounding_boxes(rects,image);
+        ConnectedComponents components;
+        components.label(image);
+        narray<rectangle> &rects = components.boxes;
         if(rects.length()>0) {
             int h = line.dim(1);
             int lower = int(h*0.33);
@@ -800,9 +800,9 @@ namespace ocropus {
     float estimate_size_by_box(bytearray &image,float f) {
         intarray labels;
         labels = image;
-        label_components(labels);
-        narray<rectangle> rects;
-        bounding_boxes(rects,labels);
+        ConnectedComponents components;
+        components.label(labels);
+        narray<rectangle> &rects = components.boxes;
         floatarray sizes;
         for(int i=1;i<rects.length();i++) {
             int d = rects[i].y1-rects[i].y0;
@@ -64,10 +64,13 @@ namespace ocropus {
 #include "grid.h"
 #include "grouper.h"
 #include "logger.h"
+#include "model-sections.h"
 #include "segmentation.h"
 #include "docproc.h"
 #include "stringutil.h"
 #include "arraypaint.h"
+#include "bitimage.h"
+#include "concomps.h"
 #include "pages.h"
 #include "queue.h"
 #include "pagesegs.h"
@@ -75,6 +78,7 @@ namespace ocropus {
 #include "resource-path.h"
 #include "segmentation.h"
 #include "sysutil.h"
+#include "stage-cache.h"
 #include "xml-entities.h"
 #include "init-ocropus.h"
 
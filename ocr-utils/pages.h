@@ -48,7 +48,11 @@ namespace ocropus {
         bytearray gray;
         intarray color;
 
+        autodel<Tiff> tiff;   /// open handle on the current multi-page TIFF
+        int tiff_image;       /// index of the image tiff belongs to
+
         Pages() {
+            tiff_image = -1;
             rewind();
             autoinv = 1;
             pdef("binarizer","StandardPreprocessing","binarizer used for pages");
@@ -66,6 +70,9 @@ namespace ocropus {
         }
         void clear() {
             files.clear();
+            numSubpages.clear();
+            tiff = 0;
+            tiff_image = -1;
         }
         static bool isTiff(strg& filename) {
             return re_search(filename, "\\.tif\\(f\\?\\)$") >= 0;
@@ -77,6 +84,10 @@ namespace ocropus {
         void parseSpec(const char *spec) {
             current_index = -1;
             clear();
+            addSpec(spec);
+        }
+        /// like parseSpec, but appends to the files already there
+        void addSpec(const char *spec) {
             if(spec[0]=='@') {
                 char buf[9999];
                 stdio stream(spec+1,"r");
@@ -105,6 +116,20 @@ namespace ocropus {
         int length() {
             return files.length();
         }
+        /// total number of pages, counting TIFF subpages
+        int nPages() {
+            return sum(numSubpages);
+        }
+        /// use the same list of files as other, without looking
+        /// into the files again
+        void shareFiles(Pages &other) {
+            clear();
+            files.resize(other.files.length());
+            for(int i=0;i<files.length();i++)
+                files(i) = other.files(i);
+            copy(numSubpages,other.numSubpages);
+            rewind();
+        }
         void getPage(int index) {
             current_index = 0;
             current_image = 0;
@@ -144,7 +169,11 @@ namespace ocropus {
                 if(!isTiff(current_file)) {
                     throw "subpage requested but not a TIFF image";
                 }
-                Tiff(current_file, "r").getPage(gray, current_subpage);
+                if(!tiff || tiff_image!=current_image) {
+                    tiff = new Tiff(current_file, "r");
+                    tiff_image = current_image;
+                }
+                tiff->getPage(gray, current_subpage);
             } else {
                 iulib::read_image_gray(gray,current_file);
             }
@@ -190,6 +219,14 @@ namespace ocropus {
         void getColor(intarray &dst) {
             copy(dst,color);
         }
+        /// Hand over the current images without copying them;
+        /// they are no longer available from Pages afterwards.
+        void takeBinary(bytearray &dst) {
+            move(dst,binary);
+        }
+        void takeGray(bytearray &dst) {
+            move(dst,gray);
+        }
     private:
         //FIXME already in ocr-utils/docproc.h / ocr-utils/ocr-utils.cc
         //      can it be removed? --remat
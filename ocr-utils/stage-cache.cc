@@ -0,0 +1,304 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: stage-cache.cc
+// Purpose: on-disk cache of recognition results keyed on their inputs
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "ocropus.h"
+#include "stage-cache.h"
+
+using namespace colib;
+
+namespace ocropus {
+
+    namespace {
+        // MurmurHash3 x64_128, in pieces so that keys can be built
+        // incrementally; blocks are read little endian, so that hosts
+        // sharing a cache directory agree on the keys
+        const uint64_t c1 = 0x87c37b91114253d5ULL;
+        const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+        inline uint64_t rotl(uint64_t x,int r) {
+            return (x<<r)|(x>>(64-r));
+        }
+
+        inline uint64_t fmix(uint64_t k) {
+            k ^= k>>33;
+            k *= 0xff51afd7ed558ccdULL;
+            k ^= k>>33;
+            k *= 0xc4ceb9fe1a85ec53ULL;
+            k ^= k>>33;
+            return k;
+        }
+
+        inline uint64_t load64(const unsigned char *p,int n=8) {
+            uint64_t k = 0;
+            for(int i=n-1;i>=0;i--) k = (k<<8)|p[i];
+            return k;
+        }
+
+        inline void mix_block(uint64_t &h1,uint64_t &h2,const unsigned char *p) {
+            uint64_t k1 = load64(p), k2 = load64(p+8);
+            k1 *= c1; k1 = rotl(k1,31); k1 *= c2; h1 ^= k1;
+            h1 = rotl(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
+            k2 *= c2; k2 = rotl(k2,33); k2 *= c1; h2 ^= k2;
+            h2 = rotl(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
+        }
+
+        // bump this when the format of cached results changes
+        const char *cache_version = "stage-cache-1";
+
+        int tmp_counter = 0;
+
+        bool copy_file(const char *dest,const char *src) {
+            FILE *in = fopen(src,"rb");
+            if(!in) return false;
+            FILE *out = fopen(dest,"wb");
+            if(!out) {
+                fclose(in);
+                return false;
+            }
+            char buf[65536];
+            bool ok = true;
+            size_t n;
+            while((n = fread(buf,1,sizeof buf,in))>0)
+                if(fwrite(buf,1,n,out)!=n) {
+                    ok = false;
+                    break;
+                }
+            if(ferror(in)) ok = false;
+            fclose(in);
+            if(fclose(out)) ok = false;
+            return ok;
+        }
+
+        struct CacheFile {
+            strg path;
+            time_t used;
+            off_t size;
+        };
+
+        // least recently used first
+        void sort_by_use(intarray &order,objlist<CacheFile> &files) {
+            int n = files.length();
+            order.resize(n);
+            if(n==0) return;
+            time_t oldest = files(0).used;
+            for(int i=1;i<n;i++)
+                oldest = min(oldest,files(i).used);
+            // relative times, so floats keep one second resolution
+            // over months of history
+            floatarray used(n);
+            for(int i=0;i<n;i++) {
+                order(i) = i;
+                used(i) = files(i).used-oldest;
+            }
+            quicksort(order,used);
+        }
+    }
+
+    StageKey::StageKey(const char *stage) {
+        h1 = 0;
+        h2 = 0;
+        ntail = 0;
+        length = 0;
+        add(cache_version);
+        add(stage);
+    }
+
+    void StageKey::add(const void *data,int n) {
+        const unsigned char *p = (const unsigned char *)data;
+        // the length separates consecutive fields
+        unsigned char len[4];
+        for(int k=0;k<4;k++) len[k] = (unsigned char)(n>>(8*k));
+        for(int pass=0;pass<2;pass++) {
+            const unsigned char *q = pass ? len : p;
+            int m = pass ? 4 : n;
+            length += m;
+            if(ntail>0) {
+                int k = min(m,16-ntail);
+                memcpy(tail+ntail,q,k);
+                ntail += k;
+                q += k;
+                m -= k;
+                if(ntail<16) continue;
+                mix_block(h1,h2,tail);
+                ntail = 0;
+            }
+            for(;m>=16;q+=16,m-=16)
+                mix_block(h1,h2,q);
+            memcpy(tail,q,m);
+            ntail = m;
+        }
+    }
+
+    void StageKey::add(const char *s) {
+        add(s,strlen(s));
+    }
+
+    void StageKey::add(int value) {
+        add(&value,sizeof value);
+    }
+
+    void StageKey::add(double value) {
+        add(&value,sizeof value);
+    }
+
+    void StageKey::add(bytearray &image) {
+        add(image.dim(0));
+        add(image.dim(1));
+        if(image.length1d()>0) add(&image.at1d(0),image.length1d());
+    }
+
+    void StageKey::add(IComponent &component) {
+        add(component.name());
+        FILE *stream = tmpfile();
+        if(!stream) throw "StageKey: cannot create temporary file";
+        component.info(0,stream);
+        rewind(stream);
+        char buf[65536];
+        size_t n;
+        while((n = fread(buf,1,sizeof buf,stream))>0)
+            add(buf,n);
+        fclose(stream);
+    }
+
+    void StageKey::add_file(const char *path) {
+        stdio stream(path,"rb");
+        char buf[65536];
+        size_t n;
+        while((n = fread(buf,1,sizeof buf,stream))>0)
+            add(buf,n);
+    }
+
+    void StageKey::digest(uint64_t &a,uint64_t &b) {
+        // finish on copies, so that more can be added afterwards
+        a = h1;
+        b = h2;
+        if(ntail>8) {
+            uint64_t k2 = load64(tail+8,ntail-8);
+            k2 *= c2; k2 = rotl(k2,33); k2 *= c1; b ^= k2;
+        }
+        if(ntail>0) {
+            uint64_t k1 = load64(tail,min(ntail,8));
+            k1 *= c1; k1 = rotl(k1,31); k1 *= c2; a ^= k1;
+        }
+        a ^= length;
+        b ^= length;
+        a += b;
+        b += a;
+        a = fmix(a);
+        b = fmix(b);
+        a += b;
+        b += a;
+    }
+
+    void StageKey::hex(strg &result) {
+        uint64_t a,b;
+        digest(a,b);
+        char buf[33];
+        sprintf(buf,"%016llx%016llx",(unsigned long long)a,(unsigned long long)b);
+        result = buf;
+    }
+
+    void StageCache::entry(strg &result,const char *key,const char *ext) {
+        CHECK_ARG(strlen(key)>2);
+        sprintf(result,"%s/%.2s/%s.%s",dir.c_str(),key,key,ext);
+    }
+
+    bool StageCache::find(strg &path,const char *key,const char *ext) {
+        if(!enabled()) return false;
+        entry(path,key,ext);
+        if(!file_exists(path)) return false;
+        // mark as used for cache-gc
+        utime(path,0);
+        return true;
+    }
+
+    bool StageCache::get(const char *key,const char *ext,const char *dest) {
+        strg path;
+        if(!find(path,key,ext)) return false;
+        // the entry may have been collected in the meantime
+        return copy_file(dest,path);
+    }
+
+    void StageCache::put(const char *key,const char *ext,const char *src) {
+        if(!enabled()) return;
+        strg path,subdir,tmp;
+        entry(path,key,ext);
+        mkdir_if_necessary(dir);
+        sprintf(subdir,"%s/%.2s",dir.c_str(),key);
+        mkdir_if_necessary(subdir);
+        sprintf(tmp,"%s.tmp%d.%d",path.c_str(),int(getpid()),
+                __sync_fetch_and_add(&tmp_counter,1));
+        // the cache only saves work, so failing to fill it isn't an error
+        if(!copy_file(tmp,src) || rename(tmp,path)) {
+            debugf("warn","%s: could not add to stage cache\n",path.c_str());
+            unlink(tmp);
+        }
+    }
+
+    int stage_cache_gc(const char *dir,double max_mbytes,double max_days) {
+        strg pattern;
+        sprintf(pattern,"%s/[0-9a-f][0-9a-f]/*",dir);
+        Glob g(pattern);
+        objlist<CacheFile> files;
+        for(int i=0;i<g.length();i++) {
+            struct stat sb;
+            if(stat(g(i),&sb) || !S_ISREG(sb.st_mode)) continue;
+            CacheFile &file = files.push();
+            file.path = g(i);
+            file.used = sb.st_mtime;
+            file.size = sb.st_size;
+        }
+        intarray order;
+        sort_by_use(order,files);
+        double total = 0;
+        for(int i=0;i<files.length();i++)
+            total += files(i).size;
+        time_t cutoff = time(0) - time_t(max_days*86400);
+        double limit = max_mbytes*1e6;
+        int removed = 0;
+        for(int i=0;i<order.length();i++) {
+            CacheFile &file = files(order(i));
+            bool old = max_days>0 && file.used<cutoff;
+            bool full = max_mbytes>0 && total>limit;
+            if(!old && !full) break;
+            if(unlink(file.path)) {
+                debugf("warn","%s: cannot remove\n",file.path.c_str());
+                continue;
+            }
+            total -= file.size;
+            removed++;
+        }
+        debugf("info","stage cache %s: removed %d files, %g Mbytes left\n",
+               dir,removed,total/1e6);
+        return removed;
+    }
+}
@@ -0,0 +1,101 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project: ocropus
+// File: stage-cache.h
+// Purpose: on-disk cache of recognition results keyed on their inputs
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites: www.iupr.org, www.dfki.de
+
+#ifndef h_stage_cache_
+#define h_stage_cache_
+
+#include <stdint.h>
+#include "colib/colib.h"
+#include "iulib/components.h"
+
+namespace ocropus {
+    using namespace colib;
+
+    // The key of a cached result is a 128 bit hash (MurmurHash3
+    // x64_128, fed incrementally) of everything the result depends
+    // on: the name of the stage, the input bytes, and the component
+    // doing the work, including its parameters and model file.  Add
+    // everything that can change the output; anything left out means
+    // stale results get reused.
+
+    struct StageKey {
+        uint64_t h1,h2;
+        // bytes not yet making up a 16 byte block, and the total length
+        unsigned char tail[16];
+        int ntail;
+        uint64_t length;
+
+        StageKey(const char *stage);
+        void add(const void *data,int n);
+        void add(const char *s);
+        void add(int value);
+        void add(double value);
+        void add(bytearray &image);
+        // the parameters of component and its subcomponents, as
+        // printed by info()
+        void add(IComponent &component);
+        // the contents of a file, like a model
+        void add_file(const char *path);
+        // the two halves of the hash of what was added so far
+        void digest(uint64_t &a,uint64_t &b);
+        // 32 hex digits
+        void hex(strg &result);
+    };
+
+    // Results live in dir/xy/<key>.<ext>, where xy are the first two
+    // digits of the key.  An entry consists of one or more files with
+    // the same key; a stage should put the file it checks for last.
+    // Files are copied in under a temporary name and renamed, so
+    // readers never see partial entries, and several processes can
+    // share a cache directory.  Looking up an entry updates its
+    // modification time, which is what cache-gc uses to decide what
+    // to throw away.
+
+    struct StageCache {
+        strg dir;
+
+        StageCache(const char *dir="") {
+            this->dir = dir;
+        }
+        bool enabled() {
+            return !dir.empty();
+        }
+        void entry(strg &result,const char *key,const char *ext);
+        // on a hit, set path to the cached file
+        bool find(strg &path,const char *key,const char *ext);
+        // copy the cached file to dest
+        bool get(const char *key,const char *ext,const char *dest);
+        // copy src into the cache
+        void put(const char *key,const char *ext,const char *src);
+    };
+
+    // Remove entries that haven't been used for more than max_days,
+    // then the least recently used ones until the cache is no larger
+    // than max_mbytes; a limit <=0 is ignored.  Returns the number of
+    // files removed.
+    int stage_cache_gc(const char *dir,double max_mbytes,double max_days);
+}
+
+#endif
@@ -64,6 +64,12 @@ namespace ocropus {
         getrusage(RUSAGE_SELF,&usage);
         return usage.ru_majflt;
     }
+    double peak_memory() {
+        struct rusage usage;
+        memset(&usage,0,sizeof usage);
+        getrusage(RUSAGE_SELF,&usage);
+        return usage.ru_maxrss;
+    }
 #endif
 
     double now() {
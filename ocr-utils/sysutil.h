@@ -68,6 +68,8 @@ inline int gettimeofday(timeval *time, timeval *temp) {
     double heap_memory();
     double stack_memory();
     double page_faults();
+    // largest resident set size so far, in kbytes
+    double peak_memory();
 #endif
 
     void mkdir_if_necessary(const char *path);
@@ -0,0 +1,108 @@
+// -*- C++ -*-
+
+// Copyright 2006 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz 
+// or its licensors, as applicable.
+// 
+// You may not use this file except under the terms of the accompanying license.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// 
+// Project:
+// File: 
+// Purpose: 
+// Responsible: mezhirov
+// Reviewer: 
+// Primary Repository: 
+// Web Sites: 
+
+
+#include "ocropus.h"
+
+using namespace colib;
+using namespace iulib;
+using namespace ocropus;
+
+static void random_image(bytearray &image,int w,int h,int density) {
+    image.resize(w,h);
+    for(int i=0;i<image.length1d();i++)
+        image.at1d(i) = (rand()%100<density) ? 255 : 0;
+}
+
+static bool same_as_packed(bytearray &image,BitImage &bits) {
+    bytearray unpacked;
+    bits_unpack(unpacked,bits);
+    if(!samedims(image,unpacked)) return false;
+    for(int i=0;i<image.length1d();i++)
+        if(!!image.at1d(i)!=!!unpacked.at1d(i)) return false;
+    return true;
+}
+
+void test_pack() {
+    bytearray image;
+    random_image(image,77,130,30);
+    BitImage bits;
+    bits_pack(bits,image);
+    CHECK_CONDITION(same_as_packed(image,bits));
+    int total = 0;
+    for(int i=10;i<50;i++) for(int j=3;j<129;j++) total += !!image(i,j);
+    CHECK_CONDITION(bits_count(bits,10,3,50,129)==total);
+}
+
+void test_morphology() {
+    for(int trial=0;trial<20;trial++) {
+        bytearray image,expected;
+        random_image(image,1+rand()%100,1+rand()%150,rand()%100);
+        int rw = rand()%9, rh = rand()%9, r = rand()%4;
+        BitImage bits;
+
+        copy(expected,image);
+        binary_close_rect(expected,rw,rh);
+        bits_pack(bits,image);
+        bits_close_rect(bits,rw,rh);
+        CHECK_CONDITION(same_as_packed(expected,bits));
+
+        copy(expected,image);
+        binary_open_rect(expected,rw,rh);
+        bits_pack(bits,image);
+        bits_open_rect(bits,rw,rh);
+        CHECK_CONDITION(same_as_packed(expected,bits));
+
+        copy(expected,image);
+        binary_dilate_circle(expected,r);
+        bits_pack(bits,image);
+        bits_dilate_circle(bits,r);
+        CHECK_CONDITION(same_as_packed(expected,bits));
+
+        copy(expected,image);
+        binary_erode_circle(expected,r);
+        bits_pack(bits,image);
+        bits_erode_circle(bits,r);
+        CHECK_CONDITION(same_as_packed(expected,bits));
+    }
+}
+
+void test_transpose() {
+    bytearray image;
+    random_image(image,70,200,50);
+    BitImage bits,transposed;
+    bits_pack(bits,image);
+    bits_transpose(transposed,bits);
+    CHECK_CONDITION(transposed.dim(0)==200 && transposed.dim(1)==70);
+    for(int i=0;i<70;i++) for(int j=0;j<200;j++)
+        CHECK_CONDITION(transposed(j,i)==!!image(i,j));
+}
+
+int main() {
+    test_pack();
+    test_morphology();
+    test_transpose();
+    return 0;
+}
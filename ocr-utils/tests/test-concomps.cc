@@ -0,0 +1,142 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: parallel labeling against label_components and bounding_boxes
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include "ocropus.h"
+
+using namespace colib;
+using namespace iulib;
+using namespace ocropus;
+
+// random blobs, dense enough for components to cross strip borders
+static void make_image(intarray &image,int w,int h,int seed) {
+    srand(seed);
+    image.resize(w,h);
+    fill(image,0);
+    int nblobs = w*h/200;
+    for(int i=0;i<nblobs;i++) {
+        int x0 = rand()%w, y0 = rand()%h;
+        int x1 = min(w,x0+1+rand()%12), y1 = min(h,y0+1+rand()%12);
+        for(int x=x0;x<x1;x++)
+            for(int y=y0;y<y1;y++)
+                if(rand()%4) image(x,y) = 255;
+    }
+}
+
+// same partition of the pixels, with consistent statistics
+static bool same_labeling(int w,int h,int seed,bool four_connected) {
+    intarray expected,actual;
+    make_image(expected,w,h,seed);
+    copy(actual,expected);
+    int n = label_components(expected,four_connected);
+    rectarray boxes;
+    bounding_boxes(boxes,expected);
+    ConnectedComponents cc;
+    if(cc.label(actual,four_connected)!=n) return false;
+    intarray map(n+1),areas(n+1);
+    fill(map,-1);
+    fill(areas,0);
+    for(int i=0;i<actual.length1d();i++) {
+        int a = actual.at1d(i), e = expected.at1d(i);
+        if(map(a)<0) map(a) = e;
+        if(map(a)!=e) return false;
+        areas(a)++;
+    }
+    if(n==0) return cc.length()==0;
+    for(int i=0;i<=n;i++) {
+        rectangle b = boxes(map(i)), c = cc.boxes(i);
+        if(b.x0!=c.x0 || b.y0!=c.y0 || b.x1!=c.x1 || b.y1!=c.y1) return false;
+        if(areas(i)!=cc.areas(i)) return false;
+        if(cc.xcenters(i)<b.x0 || cc.xcenters(i)>b.x1-1) return false;
+        if(cc.ycenters(i)<b.y0 || cc.ycenters(i)>b.y1-1) return false;
+    }
+    return true;
+}
+
+int main() {
+    CHECK_CONDITION(same_labeling(1,1,0,false));
+    CHECK_CONDITION(same_labeling(100,80,1,false));
+    CHECK_CONDITION(same_labeling(300,257,2,false));
+    CHECK_CONDITION(same_labeling(300,257,3,true));
+    CHECK_CONDITION(same_labeling(1000,700,4,false));
+
+    // a diagonal only connects with eight neighbors, also across the
+    // strip border at x=128
+    intarray image(200,10);
+    fill(image,0);
+    image(127,3) = 1;
+    image(128,4) = 1;
+    image(150,5) = 1;
+    ConnectedComponents cc;
+    CHECK_CONDITION(cc.label(image)==2);
+    CHECK_CONDITION(image(127,3)==1 && image(128,4)==1 && image(150,5)==2);
+    CHECK_CONDITION(cc.areas(1)==2 && cc.boxes(1).width()==2);
+    CHECK_CONDITION(fabs(cc.xcenters(1)-127.5)<1e-6);
+    cc.remove(image,1);
+    CHECK_CONDITION(!cc.present(1) && cc.present(2));
+    CHECK_CONDITION(image(127,3)==0 && image(128,4)==0);
+    fill(image,0);
+    image(127,3) = 1;
+    image(128,4) = 1;
+    CHECK_CONDITION(cc.label(image,true)==2);
+
+    // removing a set of components leaves the others as they were
+    intarray labels,before;
+    make_image(labels,400,300,6);
+    int n = cc.label(labels);
+    CHECK_CONDITION(n>10);
+    copy(before,labels);
+    intarray areas;
+    copy(areas,cc.areas);
+    bytearray which(n+1);
+    fill(which,0);
+    for(int i=1;i<=n;i+=3) which(i) = 1;
+    cc.remove(labels,which);
+    for(int k=0;k<labels.length1d();k++) {
+        int l = before.at1d(k);
+        CHECK_CONDITION(labels.at1d(k)==(which(l) ? 0 : l));
+    }
+    for(int i=1;i<=n;i++) {
+        CHECK_CONDITION(cc.present(i)==!which(i));
+        if(!which(i)) CHECK_CONDITION(cc.areas(i)==areas(i));
+    }
+
+    // timing on a 600dpi page
+    intarray page,temp;
+    make_image(page,5100,6600,5);
+    copy(temp,page);
+    double start = now();
+    label_components(temp);
+    rectarray boxes;
+    bounding_boxes(boxes,temp);
+    double serial = now()-start;
+    copy(temp,page);
+    start = now();
+    cc.label(temp);
+    double parallel = now()-start;
+    fprintf(stderr,"600dpi page: label_components and bounding_boxes %.3fs, ConnectedComponents %.3fs\n",
+            serial,parallel);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: degradation is reproducible from its seed, also in parallel
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include "ocropus.h"
+
+using namespace colib;
+using namespace ocropus;
+
+static void make_line(bytearray &image,int w,int h) {
+    image.resize(w,h);
+    fill(image,255);
+    for(int x=5;x<w-5;x++)
+        for(int y=h/3;y<2*h/3;y++)
+            if((x/7)%2) image(x,y) = 0;
+}
+
+template <class T>
+static bool same(narray<T> &a,narray<T> &b) {
+    if(a.dim(0)!=b.dim(0) || a.dim(1)!=b.dim(1)) return false;
+    for(int i=0;i<a.length1d();i++)
+        if(a.at1d(i)!=b.at1d(i)) return false;
+    return true;
+}
+
+int main() {
+    // streams depend only on the seed and the index
+    DegradationRandom a(17,3), b(17,3), c(17,4), d(18,3);
+    bool differ_index = false, differ_seed = false;
+    for(int i=0;i<100;i++) {
+        double x = a.uniform();
+        CHECK_CONDITION(x>=0 && x<1);
+        CHECK_CONDITION(x==b.uniform());
+        if(x!=c.uniform()) differ_index = true;
+        if(x!=d.uniform()) differ_seed = true;
+    }
+    CHECK_CONDITION(differ_index && differ_seed);
+    a.seed(17,3);
+    b.seed(17,3);
+    CHECK_CONDITION(a.gauss(1,2)==b.gauss(1,2));
+
+    // the same seed gives the same fields and the same windows
+    ElasticMaps maps,maps2;
+    DegradationRandom r1(5,-1), r2(5,-1);
+    maps.init(r1,400,120);
+    maps2.init(r2,400,120);
+    CHECK_CONDITION(same(maps.dx,maps2.dx) && same(maps.dy,maps2.dy));
+    floatarray dx1,dy1,dx2,dy2;
+    r1.seed(9,1);
+    r2.seed(9,1);
+    maps.get(dx1,dy1,200,40,r1);
+    maps.get(dx2,dy2,200,40,r2);
+    CHECK_CONDITION(same(dx1,dx2) && same(dy1,dy2));
+    CHECK_CONDITION(dx1.dim(0)==200 && dx1.dim(1)==40);
+    // too large for the precomputed fields
+    r1.seed(9,2);
+    r2.seed(9,2);
+    maps.get(dx1,dy1,600,40,r1);
+    maps.get(dx2,dy2,600,40,r2);
+    CHECK_CONDITION(same(dx1,dx2) && same(dy1,dy2));
+
+    // degrading lines in parallel gives what degrading them one by one
+    // gives, with each line's stream seeded from its index
+    enum { nlines = 16 };
+    objlist<bytearray> serial,parallel;
+    for(int i=0;i<nlines;i++) {
+        make_line(serial.push(),150+10*i,40);
+        make_line(parallel.push(),150+10*i,40);
+    }
+    for(int i=0;i<nlines;i++) {
+        DegradationRandom random(42,i);
+        degrade(serial(i),random,&maps);
+    }
+#pragma omp parallel for schedule(dynamic)
+    for(int i=nlines-1;i>=0;i--) {
+        DegradationRandom random(42,i);
+        degrade(parallel(i),random,&maps);
+    }
+    bool changed = false;
+    for(int i=0;i<nlines;i++) {
+        CHECK_CONDITION(same(serial(i),parallel(i)));
+        bytearray clean;
+        make_line(clean,150+10*i,40);
+        if(!same(clean,serial(i))) changed = true;
+    }
+    CHECK_CONDITION(changed);
+
+    // the old entry point is still reproducible through srand
+    bytearray x,y;
+    make_line(x,200,40);
+    make_line(y,200,40);
+    srand(7);
+    degrade(x);
+    srand(7);
+    degrade(y);
+    CHECK_CONDITION(same(x,y));
+    return 0;
+}
@@ -0,0 +1,163 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: entries logged from several threads all reach the files,
+//          in order per thread, once the log is flushed
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ocropus.h"
+#include "logger.h"
+
+using namespace colib;
+using namespace ocropus;
+
+enum { nentries = 2000, nthreads_max = 256 };
+
+// Reads the events logged by "test.logger" from dir/events.jsonl;
+// for each, the sequence number, the thread and the logged value.
+static void read_events(intarray &seqs,intarray &threads,intarray &values,
+                        const char *dir) {
+    seqs.clear();
+    threads.clear();
+    values.clear();
+    strg path;
+    sprintf(path,"%s/events.jsonl",dir);
+    stdio stream(path,"r");
+    char line[10000];
+    while(fgets(line,sizeof line,stream)) {
+        CHECK_CONDITION(line[strlen(line)-1]=='\n');
+        int seq,thread;
+        long time;
+        CHECK_CONDITION(sscanf(line,"{\"seq\":%d,\"time\":%ld,\"thread\":%d,",
+                               &seq,&time,&thread)==3);
+        CHECK_CONDITION(strstr(line,"\"logger\":\"test.logger\""));
+        CHECK_CONDITION(strstr(line,"\"type\":\"int\""));
+        const char *value = strstr(line,"\"value\":\"");
+        CHECK_CONDITION(value);
+        seqs.push(seq);
+        threads.push(thread);
+        values.push(atoi(value+strlen("\"value\":\"")));
+    }
+}
+
+// Counts the lines of dir/index.html that hold an entry.
+static int count_html(const char *dir) {
+    strg path;
+    sprintf(path,"%s/index.html",dir);
+    stdio stream(path,"r");
+    char line[10000];
+    int n = 0;
+    while(fgets(line,sizeof line,stream))
+        if(strstr(line,"[test.logger] entry: ")) n++;
+    return n;
+}
+
+// Checks that the events are entries first..first+n-1 logged by
+// log_entries, each once, and that every thread's entries come in the
+// order the thread logged them.
+static void check_events(const char *dir,int first,int n) {
+    intarray seqs,threads,values;
+    read_events(seqs,threads,values,dir);
+    CHECK_CONDITION(seqs.length()==n);
+    CHECK_CONDITION(count_html(dir)==n);
+    intarray seen(n),seen_seq(n);
+    fill(seen,0);
+    fill(seen_seq,0);
+    intarray last_seq(nthreads_max),last_value(nthreads_max);
+    fill(last_seq,-1);
+    fill(last_value,-1);
+    int min_seq = seqs.length()>0 ? min(seqs) : 0;
+    for(int i=0;i<n;i++) {
+        int value = values(i)-first;
+        CHECK_CONDITION(value>=0 && value<n);
+        CHECK_CONDITION(!seen(value));
+        seen(value) = 1;
+        // sequence numbers are handed out without gaps
+        CHECK_CONDITION(seqs(i)-min_seq>=0 && seqs(i)-min_seq<n);
+        CHECK_CONDITION(!seen_seq(seqs(i)-min_seq));
+        seen_seq(seqs(i)-min_seq) = 1;
+        int t = threads(i);
+        CHECK_CONDITION(t>=0 && t<nthreads_max);
+        CHECK_CONDITION(seqs(i)>last_seq(t));
+        CHECK_CONDITION(values(i)>last_value(t));
+        last_seq(t) = seqs(i);
+        last_value(t) = values(i);
+    }
+}
+
+static void log_entries(Logger &log,int first,int n) {
+    // static scheduling, so each thread logs increasing values
+#pragma omp parallel for schedule(static,7)
+    for(int i=first;i<first+n;i++)
+        log("entry",i);
+}
+
+static void remove_log(const char *dir) {
+    strg path;
+    sprintf(path,"%s/index.html",dir);
+    unlink(path);
+    sprintf(path,"%s/events.jsonl",dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+int main() {
+#ifndef OCROPUS_NO_LOGGING
+    char dir[] = "/tmp/test-logger-XXXXXX";
+    char dir2[] = "/tmp/test-logger-XXXXXX";
+    CHECK_CONDITION(mkdtemp(dir) && mkdtemp(dir2));
+    // the loggers read these when the first one is constructed
+    setenv("ocrologdir",dir,1);
+    setenv("ocrolog","test",1);
+    Logger log("test.logger");
+    CHECK_CONDITION(log.enabled);
+    CHECK_CONDITION(!strcmp(get_logger_directory(),dir));
+
+    // everything logged is in the files after a flush, while the
+    // writer keeps running
+    log_entries(log,0,nentries);
+    flush_log();
+    check_events(dir,0,nentries);
+    log_entries(log,nentries,nentries);
+    flush_log();
+    intarray seqs,threads,values;
+    read_events(seqs,threads,values,dir);
+    CHECK_CONDITION(seqs.length()==2*nentries);
+
+    // switching directories writes what is pending to the old files
+    // and everything after to the new ones
+    log_entries(log,2*nentries,nentries);
+    set_logger_directory(dir2);
+    log_entries(log,3*nentries,nentries);
+    flush_log();
+    read_events(seqs,threads,values,dir);
+    CHECK_CONDITION(seqs.length()==3*nentries);
+    check_events(dir2,3*nentries,nentries);
+
+    remove_log(dir);
+    remove_log(dir2);
+#endif
+    return 0;
+}
@@ -0,0 +1,221 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: sectioned model files, saved, loaded and converted back and forth
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "ocropus.h"
+
+using namespace colib;
+using namespace narray_io;
+using namespace ocropus;
+
+// a sub-model; a negative first value makes loading it fail with
+// something other than a string
+struct TestPart : IComponent {
+    intarray data;
+    TestPart() {
+        pdef("scale",1.0,"some parameter");
+    }
+    const char *name() {
+        return "testpart";
+    }
+    const char *interface() {
+        return "IComponent";
+    }
+    void save(FILE *stream) {
+        magic_write(stream,"testpart");
+        psave(stream);
+        narray_write(stream,data);
+    }
+    void load(FILE *stream) {
+        magic_read(stream,"testpart");
+        pload(stream);
+        narray_read(stream,data);
+        if(data.length()>0 && data(0)<0) throw 17;
+    }
+};
+
+// a model made of parts that are loaded on first use, like MetaLinerec
+struct TestModel : IComponent, ISectionedModel {
+    narray< autodel<TestPart> > parts;
+    autodel<ModelSections> sections;
+    int nloaded;
+    TestModel() {
+        pdef("nparts",0,"number of parts");
+        nloaded = 0;
+    }
+    const char *name() {
+        return "testmodel";
+    }
+    const char *interface() {
+        return "IComponent";
+    }
+    void section_name(strg &name,int i) {
+        sprintf(name,"part%d",i);
+    }
+    TestPart &part(int i) {
+        if(!parts(i).ptr() && sections.ptr()) {
+            strg name;
+            section_name(name,i);
+            parts(i) = dynamic_cast<TestPart*>(sections->load(name.c_str()));
+            CHECK(parts(i).ptr()!=0);
+            nloaded++;
+        }
+        return *parts(i);
+    }
+    void load_all() {
+        for(int i=0;i<parts.length();i++) part(i);
+    }
+    void save(FILE *stream) {
+        magic_write(stream,"testmodel");
+        pset("nparts",parts.length());
+        psave(stream);
+        for(int i=0;i<parts.length();i++)
+            save_component(stream,parts(i).ptr());
+    }
+    void load(FILE *stream) {
+        magic_read(stream,"testmodel");
+        pload(stream);
+        parts.resize(int(pgetf("nparts")));
+        for(int i=0;i<parts.length();i++)
+            parts(i) = dynamic_cast<TestPart*>(load_component(stream));
+    }
+    void saveSections(ModelSections &out) {
+        load_all();
+        narray< autodel<TestPart> > saved;
+        saved.move(parts);
+        parts.resize(saved.length());
+        out.add("root",this);
+        parts.move(saved);
+        for(int i=0;i<parts.length();i++) {
+            strg name;
+            section_name(name,i);
+            out.add(name.c_str(),parts(i).ptr());
+        }
+    }
+    void attachSections(ModelSections *in) {
+        sections = in;
+    }
+};
+
+static void make_model(TestModel &model,int nparts) {
+    model.parts.resize(nparts);
+    for(int i=0;i<nparts;i++) {
+        model.parts(i) = new TestPart();
+        model.parts(i)->pset("scale",0.5*i);
+        for(int j=0;j<=i;j++) model.parts(i)->data.push(100*i+j);
+    }
+}
+
+static bool same_model(TestModel &a,TestModel &b) {
+    if(a.parts.length()!=b.parts.length()) return false;
+    for(int i=0;i<a.parts.length();i++) {
+        TestPart &p = a.part(i), &q = b.part(i);
+        if(p.pgetf("scale")!=q.pgetf("scale")) return false;
+        if(p.data.length()!=q.data.length()) return false;
+        for(int j=0;j<p.data.length();j++)
+            if(p.data(j)!=q.data(j)) return false;
+    }
+    return true;
+}
+
+int main() {
+    component_register<TestPart>("testpart");
+    component_register<TestModel>("testmodel");
+
+    char dir[] = "/tmp/test-model-sections-XXXXXX";
+    CHECK_CONDITION(mkdtemp(dir));
+    strg sectioned,single,again;
+    sprintf(sectioned,"%s/model.sec",dir);
+    sprintf(single,"%s/model.single",dir);
+    sprintf(again,"%s/model.again",dir);
+
+    TestModel model;
+    make_model(model,5);
+    save_sectioned_model(sectioned,&model);
+    CHECK_CONDITION(is_sectioned_model(sectioned));
+
+    // parts are loaded only when they are used
+    {
+        autodel<IComponent> component(load_sectioned_model(sectioned));
+        TestModel *loaded = dynamic_cast<TestModel*>(component.ptr());
+        CHECK_CONDITION(loaded && loaded->parts.length()==5);
+        CHECK_CONDITION(loaded->nloaded==0);
+        CHECK_CONDITION(loaded->part(3).data.length()==4);
+        CHECK_CONDITION(loaded->part(3).data(2)==302);
+        CHECK_CONDITION(loaded->nloaded==1);
+        CHECK_CONDITION(same_model(model,*loaded));
+        CHECK_CONDITION(loaded->nloaded==5);
+    }
+
+    // what convert-model does: sectioned to single stream and back
+    {
+        autodel<IComponent> component(load_any_model(sectioned));
+        save_component(stdio(single,"w"),component.ptr());
+        CHECK_CONDITION(!is_sectioned_model(single));
+        autodel<IComponent> converted(load_any_model(single));
+        save_sectioned_model(again,converted.ptr());
+        autodel<IComponent> reloaded(load_any_model(again));
+        TestModel *loaded = dynamic_cast<TestModel*>(reloaded.ptr());
+        CHECK_CONDITION(loaded && same_model(model,*loaded));
+    }
+
+    // components that aren't sectioned end up in a single root
+    {
+        TestPart part;
+        part.data.push(7);
+        save_sectioned_model(again,&part);
+        ModelSections sections;
+        sections.open(again);
+        CHECK_CONDITION(sections.names.length()==1 && sections.has("root"));
+        autodel<IComponent> loaded(load_any_model(again));
+        TestPart *p = dynamic_cast<TestPart*>(loaded.ptr());
+        CHECK_CONDITION(p && p->data.length()==1 && p->data(0)==7);
+    }
+
+    // any exception while loading a section comes out as a string
+    {
+        TestModel bad;
+        make_model(bad,2);
+        bad.parts(1)->data(0) = -1;
+        save_sectioned_model(again,&bad);
+        autodel<IComponent> component(load_sectioned_model(again));
+        TestModel *loaded = dynamic_cast<TestModel*>(component.ptr());
+        CHECK_CONDITION(loaded->part(0).data.length()==1);
+        bool thrown = false;
+        try {
+            loaded->part(1);
+        } catch(const char *message) {
+            thrown = true;
+        }
+        CHECK_CONDITION(thrown);
+    }
+
+    unlink(sectioned);
+    unlink(single);
+    unlink(again);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// -*- C++ -*-
+
+// Copyright 2006-2008 Deutsches Forschungszentrum fuer Kuenstliche Intelligenz
+// or its licensors, as applicable.
+//
+// You may not use this file except under the terms of the accompanying license.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you
+// may not use this file except in compliance with the License. You may
+// obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Project:
+// File:
+// Purpose: stage cache keys, lookups and garbage collection
+// Responsible: tmb
+// Reviewer:
+// Primary Repository:
+// Web Sites:
+
+#include <unistd.h>
+#include <utime.h>
+#include "ocropus.h"
+
+using namespace colib;
+using namespace ocropus;
+
+static void image_key(strg &key,bytearray &image) {
+    StageKey k("test");
+    k.add(image);
+    k.hex(key);
+}
+
+int main() {
+    char dir[] = "/tmp/test-stage-cache-XXXXXX";
+    CHECK_CONDITION(mkdtemp(dir));
+    strg cache_dir,src;
+    sprintf(cache_dir,"%s/cache",dir);
+    sprintf(src,"%s/result",dir);
+    fprintf(stdio(src,"w"),"result\n");
+
+    bytearray image(10,20);
+    fill(image,0);
+    strg key1,key2,key3;
+    image_key(key1,image);
+    image_key(key2,image);
+    CHECK_CONDITION(key1==key2);
+    image(3,4) = 1;
+    image_key(key3,image);
+    CHECK_CONDITION(!(key1==key3));
+    CHECK_CONDITION(strlen(key1)==32);
+
+    StageCache cache(cache_dir);
+    strg path;
+    CHECK_CONDITION(!cache.find(path,key1,"fst"));
+    cache.put(key1,"fst",src);
+    cache.put(key3,"fst",src);
+    CHECK_CONDITION(cache.find(path,key1,"fst"));
+    CHECK_CONDITION(!cache.find(path,key1,"png"));
+
+    // an entry unused for a long time goes first
+    strg old;
+    cache.entry(old,key3,"fst");
+    struct utimbuf times = {1000,1000};
+    utime(old,&times);
+    CHECK_CONDITION(stage_cache_gc(cache_dir,0,30)==1);
+    CHECK_CONDITION(cache.find(path,key1,"fst"));
+    CHECK_CONDITION(!cache.find(path,key3,"fst"));
+    CHECK_CONDITION(stage_cache_gc(cache_dir,1e-6,0)==1);
+    CHECK_CONDITION(!cache.find(path,key1,"fst"));
+
+    strg command;
+    sprintf(command,"rm -rf %s",dir);
+    CHECK_CONDITION(system(command)==0);
+    return 0;
+}